@@ -11,6 +11,9 @@
 #include <cnoid/ThreadPool>
 #include <random>
 #include <set>
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
 
 using namespace std;
 using namespace cnoid;
@@ -19,6 +22,10 @@ namespace {
 
 const bool ENABLE_SHUFFLE = false;
 
+// Margin added to the world-space bounding boxes used in the broadphase to absorb
+// the single precision rounding of the vertices and transforms used by OPCODE
+const double BROADPHASE_BOX_MARGIN = 1.0e-4;
+
 typedef CollisionDetector::GeometryHandle GeometryHandle;
 
 CollisionDetector* factory()
@@ -43,8 +50,54 @@ public:
     bool isStatic;
     boost::optional<Position> localPosition;
     ColdetModelExPtr sibling;
+
+    // for the broadphase
+    int index;
+    Vector3 localBoxCenter;
+    Vector3 localBoxExtents;
+    Vector3 boxMin; // world coordinate including the siblings
+    Vector3 boxMax;
     
-    ColdetModelEx() : isStatic(false) { }
+    ColdetModelEx() : isStatic(false), index(-1) { }
+
+    void calcLocalBoundingBox(){
+        Vector3 lower = Vector3::Constant(std::numeric_limits<double>::max());
+        Vector3 upper = Vector3::Constant(-std::numeric_limits<double>::max());
+        const int n = getNumVertices();
+        for(int i=0; i < n; ++i){
+            float x, y, z;
+            getVertex(i, x, y, z);
+            const Vector3 v(x, y, z);
+            lower = lower.cwiseMin(v);
+            upper = upper.cwiseMax(v);
+        }
+        if(n == 0){
+            lower.setZero();
+            upper.setZero();
+        }
+        localBoxCenter = (lower + upper) / 2.0;
+        localBoxExtents = (upper - lower) / 2.0 + Vector3::Constant(BROADPHASE_BOX_MARGIN);
+        boxMin = localBoxCenter - localBoxExtents;
+        boxMax = localBoxCenter + localBoxExtents;
+    }
+
+    void mergeWorldBoundingBox(const ColdetModelEx* model, const Position& T, bool doReset){
+        const Vector3 c = T * model->localBoxCenter;
+        const Vector3 e = T.linear().cwiseAbs() * model->localBoxExtents;
+        if(doReset){
+            boxMin = c - e;
+            boxMax = c + e;
+        } else {
+            boxMin = boxMin.cwiseMin(c - e);
+            boxMax = boxMax.cwiseMax(c + e);
+        }
+    }
+
+    bool isBoundingBoxOverlapping(const ColdetModelEx* other) const {
+        return (boxMin.x() <= other->boxMax.x() && other->boxMin.x() <= boxMax.x() &&
+                boxMin.y() <= other->boxMax.y() && other->boxMin.y() <= boxMax.y() &&
+                boxMin.z() <= other->boxMax.z() && other->boxMin.z() <= boxMax.z());
+    }
 };
 
 class ColdetModelPairEx;
@@ -135,12 +188,32 @@ public:
     int maxNumThreads;
     set<IdPair<GeometryHandle>> nonInterfarencePairs;
     MeshExtractor* meshExtractor;
+
+    // for the sweep and prune broadphase
+    bool isBroadphaseEnabled;
+    vector<ColdetModelEx*> sortedModels;
+    unordered_map<uint64_t, int> modelIndexPairToPairIndexMap;
+    vector<int> candidatePairIndices;
+    vector<ColdetModelPairEx*> candidatePairs;
+
+    // for the cache of the built models
+    string modelCacheDirectory;
+    int numModelCacheHits;
+    int numModelCacheMisses;
         
     AISTCollisionDetectorImpl();
     ~AISTCollisionDetectorImpl();
     boost::optional<GeometryHandle> addGeometry(SgNode* geometry);
     void addMesh(ColdetModelEx* model);
     bool makeReady();
+    void setModelPosition(ColdetModelEx* model, ColdetModelEx* headModel, const Position& T);
+    void extractCandidatePairs();
+    int numTargetPairs() const {
+        return isBroadphaseEnabled ? candidatePairs.size() : modelPairs.size();
+    }
+    ColdetModelPairEx* targetPair(int index) const {
+        return isBroadphaseEnabled ? candidatePairs[index] : modelPairs[index].get();
+    }
     void detectCollisions(std::function<void(const CollisionPair&)> callback);
     void detectCollisionsInParallel(std::function<void(const CollisionPair&)> callback);
 
@@ -169,6 +242,9 @@ AISTCollisionDetectorImpl::AISTCollisionDetectorImpl()
     maxNumThreads = 0;
     numThreads = 0;
     meshExtractor = new MeshExtractor;
+    isBroadphaseEnabled = false;
+    numModelCacheHits = 0;
+    numModelCacheMisses = 0;
 }
 
 
@@ -193,7 +269,10 @@ const char* AISTCollisionDetector::name() const
 
 CollisionDetector* AISTCollisionDetector::clone() const
 {
-    return new AISTCollisionDetector;
+    auto detector = new AISTCollisionDetector;
+    detector->impl->isBroadphaseEnabled = impl->isBroadphaseEnabled;
+    detector->impl->modelCacheDirectory = impl->modelCacheDirectory;
+    return detector;
 }
 
 
@@ -202,12 +281,66 @@ void AISTCollisionDetector::setNumThreads(int n)
     impl->maxNumThreads = n;
 }
 
+
+/**
+   When the broadphase is enabled, the world-space bounding boxes of the geometries are
+   updated with their positions and only the pairs whose bounding boxes overlap are passed
+   to the narrowphase. The pairs are sorted by a sweep and prune method on the x-axis.
+   This setting must be done before calling makeReady().
+*/
+void AISTCollisionDetector::setBroadphaseEnabled(bool on)
+{
+    impl->isBroadphaseEnabled = on;
+}
+
+
+bool AISTCollisionDetector::isBroadphaseEnabled() const
+{
+    return impl->isBroadphaseEnabled;
+}
+
+
+/**
+   The AABB trees of the geometries are saved in the directory and are loaded instead of
+   building them when the same meshes are added again. The cache is disabled when the
+   directory is empty.
+*/
+void AISTCollisionDetector::setModelCacheDirectory(const std::string& directory)
+{
+    impl->modelCacheDirectory = directory;
+}
+
+
+const std::string& AISTCollisionDetector::modelCacheDirectory() const
+{
+    return impl->modelCacheDirectory;
+}
+
+
+//! The number of the geometries loaded from the cache since the geometries were cleared
+int AISTCollisionDetector::numModelCacheHits() const
+{
+    return impl->numModelCacheHits;
+}
+
+
+int AISTCollisionDetector::numModelCacheMisses() const
+{
+    return impl->numModelCacheMisses;
+}
+
         
 void AISTCollisionDetector::clearGeometries()
 {
     impl->models.clear();
     impl->modelPairs.clear();
     impl->nonInterfarencePairs.clear();
+    impl->sortedModels.clear();
+    impl->modelIndexPairToPairIndexMap.clear();
+    impl->candidatePairIndices.clear();
+    impl->candidatePairs.clear();
+    impl->numModelCacheHits = 0;
+    impl->numModelCacheMisses = 0;
 }
 
 
@@ -229,8 +362,15 @@ boost::optional<GeometryHandle> AISTCollisionDetectorImpl::addGeometry(SgNode* g
         ColdetModelExPtr model = new ColdetModelEx;
         if(meshExtractor->extract(geometry, [&]() { addMesh(model); })){
             model->setName(geometry->name());
-            model->build();
+            if(modelCacheDirectory.empty()){
+                model->build();
+            } else if(model->buildWithCache(modelCacheDirectory)){
+                ++numModelCacheHits;
+            } else {
+                ++numModelCacheMisses;
+            }
             if(model->isValid()){
+                model->calcLocalBoundingBox();
                 models.push_back(model);
                 return getHandle(model);
             }
@@ -292,7 +432,11 @@ bool AISTCollisionDetector::makeReady()
 bool AISTCollisionDetectorImpl::makeReady()
 {
     modelPairs.clear();
+    modelIndexPairToPairIndexMap.clear();
     const int n = models.size();
+    for(int i=0; i < n; ++i){
+        models[i]->index = i;
+    }
     for(int i=0; i < n; ++i){
         ColdetModelEx* model1 = models[i];
         for(int j = i + 1; j < n; ++j){
@@ -300,12 +444,26 @@ bool AISTCollisionDetectorImpl::makeReady()
             if(!model1->isStatic || !model2->isStatic){
                 IdPair<GeometryHandle> handlePair(getHandle(model1), getHandle(model2));
                 if(nonInterfarencePairs.find(handlePair) == nonInterfarencePairs.end()){
+                    if(isBroadphaseEnabled){
+                        const uint64_t key = (static_cast<uint64_t>(i) << 32) | j;
+                        modelIndexPairToPairIndexMap[key] = modelPairs.size();
+                    }
                     modelPairs.push_back(new ColdetModelPairEx(model1, model2));
                 }
             }
         }
     }
 
+    sortedModels.clear();
+    candidatePairIndices.clear();
+    candidatePairs.clear();
+    if(isBroadphaseEnabled){
+        sortedModels.reserve(n);
+        for(auto& model : models){
+            sortedModels.push_back(model);
+        }
+    }
+
     const int numPairs = modelPairs.size();
 
     if(maxNumThreads <= 0){
@@ -328,16 +486,29 @@ bool AISTCollisionDetectorImpl::makeReady()
 }
 
 
+void AISTCollisionDetectorImpl::setModelPosition(ColdetModelEx* model, ColdetModelEx* headModel, const Position& T)
+{
+    if(model->localPosition){
+        Position T2 = T * (*model->localPosition);
+        model->setPosition(T2);
+        if(isBroadphaseEnabled){
+            headModel->mergeWorldBoundingBox(model, T2, model == headModel);
+        }
+    } else {
+        model->setPosition(T);
+        if(isBroadphaseEnabled){
+            headModel->mergeWorldBoundingBox(model, T, model == headModel);
+        }
+    }
+}
+
+
 void AISTCollisionDetector::updatePosition(GeometryHandle geometry, const Position& position)
 {
-    auto model = getColdetModel(geometry);
+    auto headModel = getColdetModel(geometry);
+    auto model = headModel;
     do {
-        if(model->localPosition){
-            Position T = position * (*model->localPosition);
-            model->setPosition(T);
-        } else {
-            model->setPosition(position);
-        }
+        impl->setModelPosition(model, headModel, position);
         model = model->sibling;
     } while(model);
 }
@@ -347,15 +518,11 @@ void AISTCollisionDetector::updatePositions
 (std::function<void(Referenced* object, Position*& out_Position)> positionQuery)
 {
     for(ColdetModelEx* model : impl->models){ // Do not use auto&
+        ColdetModelEx* headModel = model;
         do {
             Position* T;
             positionQuery(model->object, T);
-            if(model->localPosition){
-                Position T2 = (*T) * (*model->localPosition);
-                model->setPosition(T2);
-            } else {
-                model->setPosition(*T);
-            }
+            impl->setModelPosition(model, headModel, *T);
             model = model->sibling; // Elements in models are overridden here if auto& is used
         } while(model);
     }
@@ -364,6 +531,9 @@ void AISTCollisionDetector::updatePositions
 
 void AISTCollisionDetector::detectCollisions(std::function<void(const CollisionPair&)> callback)
 {
+    if(impl->isBroadphaseEnabled){
+        impl->extractCandidatePairs();
+    }
     if(impl->numThreads > 0){
         impl->detectCollisionsInParallel(callback);
     } else {
@@ -372,6 +542,61 @@ void AISTCollisionDetector::detectCollisions(std::function<void(const CollisionP
 } 
 
 
+/**
+   Incremental sweep and prune. The models are kept sorted by the lower bound of their
+   bounding boxes on the x-axis. The order changes little between the simulation steps,
+   so the insertion sort used here runs in almost linear time.
+*/
+void AISTCollisionDetectorImpl::extractCandidatePairs()
+{
+    const int n = sortedModels.size();
+    for(int i=1; i < n; ++i){
+        ColdetModelEx* model = sortedModels[i];
+        const double x = model->boxMin.x();
+        int j = i - 1;
+        while(j >= 0 && sortedModels[j]->boxMin.x() > x){
+            sortedModels[j + 1] = sortedModels[j];
+            --j;
+        }
+        sortedModels[j + 1] = model;
+    }
+
+    candidatePairIndices.clear();
+    for(int i=0; i < n; ++i){
+        ColdetModelEx* model1 = sortedModels[i];
+        const double xmax = model1->boxMax.x();
+        for(int j = i + 1; j < n; ++j){
+            ColdetModelEx* model2 = sortedModels[j];
+            if(model2->boxMin.x() > xmax){
+                break;
+            }
+            if(model1->isStatic && model2->isStatic){
+                continue;
+            }
+            if(model1->isBoundingBoxOverlapping(model2)){
+                uint64_t index1 = model1->index;
+                uint64_t index2 = model2->index;
+                if(index1 > index2){
+                    std::swap(index1, index2);
+                }
+                auto iter = modelIndexPairToPairIndexMap.find((index1 << 32) | index2);
+                if(iter != modelIndexPairToPairIndexMap.end()){
+                    candidatePairIndices.push_back(iter->second);
+                }
+            }
+        }
+    }
+
+    // Keep the same order as the all-pairs mode so that the results are identical
+    std::sort(candidatePairIndices.begin(), candidatePairIndices.end());
+
+    candidatePairs.clear();
+    for(auto& index : candidatePairIndices){
+        candidatePairs.push_back(modelPairs[index]);
+    }
+}
+
+
 /**
    \todo Remeber which geometry positions are updated after the last collision detection
    and do the actual collision detection only for the updated geometry pairs.
@@ -380,14 +605,16 @@ void AISTCollisionDetectorImpl::detectCollisions(std::function<void(const Collis
 {
     CollisionPair collisionPair;
     auto& collisions = collisionPair.collisions();
-    
-    for(ColdetModelPairEx* modelPair : modelPairs){ // Do not use auto&
+
+    const int numPairs = numTargetPairs();
+    for(int i=0; i < numPairs; ++i){
+        ColdetModelPairEx* modelPair = targetPair(i);
         collisions.clear();
         do {
             if(!modelPair->detectCollisions().empty()){
                 copyCollisionPairCollisions(modelPair, collisionPair);
             }
-            modelPair = modelPair->sibling;  // Elements in models are overridden here if auto& is used
+            modelPair = modelPair->sibling;
         } while(modelPair);
 
         if(!collisions.empty()){
@@ -399,11 +626,11 @@ void AISTCollisionDetectorImpl::detectCollisions(std::function<void(const Collis
 
 void AISTCollisionDetectorImpl::detectCollisionsInParallel(std::function<void(const CollisionPair&)> callback)
 {
-    if(ENABLE_SHUFFLE){
+    if(ENABLE_SHUFFLE && !isBroadphaseEnabled){
         std::random_shuffle(shuffledPairIndices.begin(), shuffledPairIndices.end());
     }
 
-    const int numPairs = modelPairs.size();
+    const int numPairs = numTargetPairs();
     const int minSize = numPairs / numThreads;
     int remainder = numPairs % numThreads;
     int index = 0;
@@ -414,7 +641,8 @@ void AISTCollisionDetectorImpl::detectCollisionsInParallel(std::function<void(co
             --remainder;
         }
         if(size == 0){
-            break;
+            collisionPairArrays[i].clear();
+            continue;
         }
         threadPool->start([this, i, index, size](){
                 extractCollisionsOfAssignedPairs(index, index + size, collisionPairArrays[i]); });
@@ -434,10 +662,10 @@ void AISTCollisionDetectorImpl::extractCollisionsOfAssignedPairs
 
     for(int i=pairIndexBegin; i < pairIndexEnd; ++i){
         ColdetModelPairEx* modelPair;
-        if(ENABLE_SHUFFLE){
+        if(ENABLE_SHUFFLE && !isBroadphaseEnabled){
             modelPair = modelPairs[shuffledPairIndices[i]];
         } else {
-            modelPair = modelPairs[i];
+            modelPair = targetPair(i);
         }
 
         collisionPairs.push_back(CollisionPair());
@@ -36,6 +36,12 @@ public:
 
     // experimental
     void setNumThreads(int n);
+    void setBroadphaseEnabled(bool on);
+    bool isBroadphaseEnabled() const;
+    void setModelCacheDirectory(const std::string& directory);
+    const std::string& modelCacheDirectory() const;
+    int numModelCacheHits() const;
+    int numModelCacheMisses() const;
 
 private:
     AISTCollisionDetectorImpl* impl;
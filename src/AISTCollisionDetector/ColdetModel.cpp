@@ -5,14 +5,42 @@
 #include "ColdetModel.h"
 #include "ColdetModelInternalModel.h"
 #include "Opcode/Opcode.h"
+#include <cnoid/FileUtil>
 #include <map>
+#include <fstream>
+#include <cstdio>
 #include <iostream>
 
 using namespace std;
 using namespace cnoid;
+namespace filesystem = boost::filesystem;
 
 namespace {
 
+const char treeCacheSignature[8] = { 'C', 'N', 'O', 'I', 'D', 'B', 'V', 'H' };
+const uint32_t treeCacheVersion = 1;
+
+struct TreeCacheHeader
+{
+    char signature[8];
+    uint32_t version;
+    uint32_t nodeSize;
+    uint64_t meshHash;
+    uint32_t numVertices;
+    uint32_t numTriangles;
+    uint32_t numNodes;
+    uint32_t reserved;
+};
+
+struct TreeCacheNode
+{
+    float center[3];
+    float extents[3];
+    // The primitive index * 2 + 1 for a leaf, or the index of the positive child * 2
+    uint32_t data;
+    uint32_t parent;
+};
+
 class Edge
 {
     int vertex[2];
@@ -183,6 +211,33 @@ void ColdetModel::addTriangle(int v1, int v2, int v3)
 }
 
 
+/**
+   The trees are identified by the hash of the vertices and triangles. Since the vertices
+   are given in the coordinate of the model, the hash also reflects the transforms of the
+   mesh nodes in the scene graph.
+*/
+bool ColdetModel::buildWithCache(const std::string& cacheDirectory)
+{
+    uint64_t hash = internalModel->computeMeshHash();
+    char hashString[20];
+    sprintf(hashString, "%016llx", static_cast<unsigned long long>(hash));
+    filesystem::path path = filesystem::path(cacheDirectory) / (string(hashString) + ".bvh");
+    string filename = getNativePathString(path);
+    
+    if(internalModel->loadTree(filename, hash)){
+        isValid_ = true;
+        return true;
+    }
+    
+    build();
+    
+    if(isValid_){
+        internalModel->saveTree(filename, hash);
+    }
+    return false;
+}
+
+
 void ColdetModel::build()
 {
     isValid_ = internalModel->build();
@@ -273,12 +328,7 @@ bool ColdetModelInternalModel::build()
         OPCC.mKeepOriginal = false;
         
         model.Build(OPCC);
-        if(model.GetTree()){
-            AABBTreeMaxDepth = computeDepth(((Opcode::AABBCollisionTree*)model.GetTree())->GetNodes(), 0, -1) + 1;
-            for(int i=0; i<AABBTreeMaxDepth; i++)
-                for(int j=0; j<i; j++)
-                    numBBMap.at(i) += numLeafMap.at(j);
-        }
+        updateTreeDepthInfo();
         result = true;
     }
 
@@ -286,6 +336,206 @@ bool ColdetModelInternalModel::build()
 }
 
 
+void ColdetModelInternalModel::updateTreeDepthInfo()
+{
+    if(model.GetTree()){
+        AABBTreeMaxDepth = computeDepth(((Opcode::AABBCollisionTree*)model.GetTree())->GetNodes(), 0, -1) + 1;
+        for(int i=0; i<AABBTreeMaxDepth; i++)
+            for(int j=0; j<i; j++)
+                numBBMap.at(i) += numLeafMap.at(j);
+    }
+}
+
+
+//! FNV-1a hash of the vertices and the triangles
+uint64_t ColdetModelInternalModel::computeMeshHash() const
+{
+    uint64_t hash = 14695981039346656037ULL;
+    auto addData = [&hash](const void* data, size_t size){
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for(size_t i=0; i < size; ++i){
+            hash ^= p[i];
+            hash *= 1099511628211ULL;
+        }
+    };
+    uint32_t sizes[2] = { static_cast<uint32_t>(vertices.size()), static_cast<uint32_t>(triangles.size()) };
+    addData(sizes, sizeof(sizes));
+    if(!vertices.empty()){
+        addData(&vertices[0], vertices.size() * sizeof(IceMaths::Point));
+    }
+    if(!triangles.empty()){
+        addData(&triangles[0], triangles.size() * sizeof(IceMaths::IndexedTriangle));
+    }
+    return hash;
+}
+
+
+/**
+   The optimized AABB tree and the neighbor triangles are restored from the file
+   instead of building them. The vertices and triangles must be set before calling this.
+*/
+bool ColdetModelInternalModel::loadTree(const std::string& filename, uint64_t meshHash)
+{
+    ifstream ifs(filename.c_str(), ios::in | ios::binary);
+    if(!ifs.is_open()){
+        return false;
+    }
+    TreeCacheHeader header;
+    ifs.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if(!ifs ||
+       !std::equal(header.signature, header.signature + 8, treeCacheSignature) ||
+       header.version != treeCacheVersion ||
+       header.nodeSize != sizeof(TreeCacheNode) ||
+       header.meshHash != meshHash ||
+       header.numVertices != vertices.size() ||
+       header.numTriangles != triangles.size() ||
+       header.numTriangles == 0 ||
+       header.numNodes != header.numTriangles * 2 - 1){
+        return false;
+    }
+
+    const uint32_t numNodes = header.numNodes;
+    vector<TreeCacheNode> cacheNodes(numNodes);
+    ifs.read(reinterpret_cast<char*>(&cacheNodes[0]), numNodes * sizeof(TreeCacheNode));
+    vector<int> neighborData(triangles.size() * 3);
+    ifs.read(reinterpret_cast<char*>(&neighborData[0]), neighborData.size() * sizeof(int));
+    if(!ifs){
+        return false;
+    }
+    
+    for(uint32_t i=0; i < numNodes; ++i){
+        const TreeCacheNode& node = cacheNodes[i];
+        if(node.parent >= numNodes){
+            return false;
+        }
+        if(node.data & 1){
+            if((node.data >> 1) >= triangles.size()){
+                return false;
+            }
+        } else if((node.data >> 1) + 1 >= numNodes){
+            return false;
+        }
+    }
+    
+    iMesh.SetPointers(&triangles[0], &vertices[0]);
+    iMesh.SetNbTriangles(triangles.size());
+    iMesh.SetNbVertices(vertices.size());
+
+    Opcode::AABBCollisionTree* tree = model.CreateTreeToRestore(&iMesh);
+    if(!tree){
+        return false;
+    }
+    Opcode::AABBCollisionNode* nodes = tree->AllocateNodes(numNodes);
+    for(uint32_t i=0; i < numNodes; ++i){
+        const TreeCacheNode& src = cacheNodes[i];
+        Opcode::AABBCollisionNode& node = nodes[i];
+        node.mAABB.mCenter.Set(src.center[0], src.center[1], src.center[2]);
+        node.mAABB.mExtents.Set(src.extents[0], src.extents[1], src.extents[2]);
+        node.mAABB.CreateSSV();
+        if(src.data & 1){
+            node.mData = src.data;
+        } else {
+            node.mData = (EXWORD)&nodes[src.data >> 1];
+        }
+        node.mB = &nodes[src.parent];
+    }
+
+    neighbors.resize(triangles.size());
+    for(size_t i=0; i < neighbors.size(); ++i){
+        for(int j=0; j < 3; ++j){
+            neighbors[i].neighbors[j] = neighborData[i * 3 + j];
+        }
+    }
+
+    numBBMap.clear();
+    numLeafMap.clear();
+    updateTreeDepthInfo();
+    
+    return true;
+}
+
+
+/**
+   The file is written with a temporary name and renamed so that other processes
+   sharing the cache directory never read an incomplete file.
+*/
+bool ColdetModelInternalModel::saveTree(const std::string& filename, uint64_t meshHash)
+{
+    const Opcode::AABBCollisionTree* tree = dynamic_cast<const Opcode::AABBCollisionTree*>(model.GetTree());
+    if(!tree){
+        return false;
+    }
+    const uint32_t numNodes = tree->GetNbNodes();
+    const Opcode::AABBCollisionNode* nodes = tree->GetNodes();
+
+    TreeCacheHeader header;
+    std::copy(treeCacheSignature, treeCacheSignature + 8, header.signature);
+    header.version = treeCacheVersion;
+    header.nodeSize = sizeof(TreeCacheNode);
+    header.meshHash = meshHash;
+    header.numVertices = vertices.size();
+    header.numTriangles = triangles.size();
+    header.numNodes = numNodes;
+    header.reserved = 0;
+
+    vector<TreeCacheNode> cacheNodes(numNodes);
+    for(uint32_t i=0; i < numNodes; ++i){
+        const Opcode::AABBCollisionNode& node = nodes[i];
+        TreeCacheNode& dest = cacheNodes[i];
+        const IceMaths::Point& c = node.mAABB.mCenter;
+        const IceMaths::Point& e = node.mAABB.mExtents;
+        dest.center[0] = c.x;
+        dest.center[1] = c.y;
+        dest.center[2] = c.z;
+        dest.extents[0] = e.x;
+        dest.extents[1] = e.y;
+        dest.extents[2] = e.z;
+        if(node.IsLeaf()){
+            dest.data = node.mData;
+        } else {
+            dest.data = (node.GetPos() - nodes) << 1;
+        }
+        dest.parent = node.mB ? (node.mB - nodes) : 0;
+    }
+
+    vector<int> neighborData(neighbors.size() * 3);
+    for(size_t i=0; i < neighbors.size(); ++i){
+        for(int j=0; j < 3; ++j){
+            neighborData[i * 3 + j] = neighbors[i][j];
+        }
+    }
+
+    filesystem::path path(filename);
+    boost::system::error_code ec;
+    filesystem::create_directories(path.parent_path(), ec);
+    filesystem::path tmpPath = path;
+    tmpPath += filesystem::unique_path(".%%%%%%%%.tmp", ec);
+    if(ec){
+        return false;
+    }
+    {
+        ofstream ofs(getNativePathString(tmpPath).c_str(), ios::out | ios::binary | ios::trunc);
+        if(!ofs.is_open()){
+            return false;
+        }
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(&cacheNodes[0]), numNodes * sizeof(TreeCacheNode));
+        ofs.write(reinterpret_cast<const char*>(&neighborData[0]), neighborData.size() * sizeof(int));
+        if(!ofs){
+            ofs.close();
+            filesystem::remove(tmpPath, ec);
+            return false;
+        }
+    }
+    filesystem::rename(tmpPath, path, ec);
+    if(ec){
+        filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
+
+
 void ColdetModel::setPosition(const Position& T)
 {
     transform->Set((float)T(0,0), (float)T(1,0), (float)T(2,0), 0.0f,
@@ -378,6 +628,21 @@ double ColdetModel::computeDistanceWithRay(const double *point,
 }
 
 
+double ColdetModel::computeDistanceWithRay(const Vector3& point, const Vector3& dir, double maxDistance)
+{
+    Opcode::RayCollider RC;
+    Ray world_ray(Point(point.x(), point.y(), point.z()),
+                  Point(dir.x(), dir.y(), dir.z()));
+    Opcode::CollisionFace CF;
+    Opcode::SetupClosestHit(RC, CF);
+    if(maxDistance < FLT_MAX){
+        RC.SetMaxDist(maxDistance);
+    }
+    RC.Collide(world_ray, internalModel->model, transform);
+    return CF.mDistance;
+}
+
+
 bool ColdetModel::checkCollisionWithPointCloud(const std::vector<Vector3> &i_cloud, double i_radius)
 {
     Opcode::SphereCollider SC;
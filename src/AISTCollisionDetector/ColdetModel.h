@@ -123,6 +123,16 @@ public:
      */
     void build();
 
+    /**
+     * @brief build tree of bounding boxes with the cache of the trees built before
+     *
+     * The tree is loaded from the cache directory if the tree of the same mesh
+     * has been saved. Otherwise the tree is built and saved to the directory.
+     * @param cacheDirectory directory to store the cached trees
+     * @return true if the tree is loaded from the cache, false otherwise
+     */
+    bool buildWithCache(const std::string& cacheDirectory);
+
     /**
      * @brief check if build() is already called or not
      * @return true if build() is already called, false otherwise
@@ -195,6 +205,16 @@ public:
      */
     double computeDistanceWithRay(const double *point, const double *dir);
 
+    /**
+     * @brief compute distance between a point and this mesh along ray within a given distance
+     * @param point a point
+     * @param dir normalized direction of ray
+     * @param maxDistance maximum distance checked along ray
+     * @return distance if ray collides with this mesh, FLT_MAX otherwise
+     * @note This function is thread-safe as long as the position of the model is not changed.
+     */
+    double computeDistanceWithRay(const Vector3& point, const Vector3& dir, double maxDistance);
+
     /**
      * @brief check collision between this triangle mesh and a point cloud
      * @param i_cloud points
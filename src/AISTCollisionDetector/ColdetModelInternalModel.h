@@ -8,6 +8,8 @@
 #include "ColdetModel.h"
 #include "Opcode/Opcode.h"
 #include <vector>
+#include <string>
+#include <cstdint>
 
 namespace cnoid {
 
@@ -47,6 +49,10 @@ public:
 
     bool build();
 
+    uint64_t computeMeshHash() const;
+    bool loadTree(const std::string& filename, uint64_t meshHash);
+    bool saveTree(const std::string& filename, uint64_t meshHash);
+
     // need two instances ?
     Opcode::Model model;
     Opcode::MeshInterface iMesh;
@@ -77,6 +83,7 @@ private:
     std::vector<int> numLeafMap;
 
     void extractNeghiborTriangles();
+    void updateTreeDepthInfo();
     int computeDepth(const Opcode::AABBCollisionNode* node, int currentDepth, int max );
 
     friend class ColdetModel;
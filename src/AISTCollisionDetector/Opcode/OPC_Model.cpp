@@ -129,6 +129,16 @@ void Model::Release()
 #endif // __MESHMERIZER_H__
 }
 
+#if 1 // Added by AIST
+AABBCollisionTree* Model::CreateTreeToRestore(const MeshInterface* imesh)
+{
+	Release();
+	SetMeshInterface(imesh);
+	if(!CreateTree(false, false))	return null;
+	return static_cast<AABBCollisionTree*>(mTree);
+}
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Builds a collision model.
@@ -54,6 +54,17 @@
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		override(BaseModel)	udword				GetUsedBytes()	const;
 
+#if 1 // Added by AIST
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+		/**
+		 *	Creates an empty normal tree which is restored by the caller instead of building it.
+		 *	\param		imesh		[in] mesh interface of the model
+		 *	\return		the tree to restore, or null if failed
+		 */
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+							AABBCollisionTree*	CreateTreeToRestore(const MeshInterface* imesh);
+#endif
+
 		private:
 #ifdef __MESHMERIZER_H__
 							CollisionHull*		mHull;			//!< Possible convex hull
@@ -135,6 +135,9 @@
 		inline_						const node*		GetNodes()		const	{ return mNodes;					}	\
 		/* Stats */																									\
 		override(AABBOptimizedTree)	udword			GetUsedBytes()	const	{ return mNbNodes*sizeof(node);		}	\
+		/* Added by AIST to restore a tree saved before */															\
+		inline_						node*			AllocateNodes(udword nb_nodes)										\
+													{ DELETEARRAY(mNodes); mNbNodes = nb_nodes; mNodes = new node[nb_nodes]; return mNodes; }	\
 		private:																									\
 									node*			mNodes;
 
@@ -20,6 +20,7 @@
 #include "SceneItem.h"
 #include "PointSetItem.h"
 #include "MultiPointSetItem.h"
+#include "PointCloudOctreeItem.h"
 #include "ViewManager.h"
 #include "MessageView.h"
 #include "ItemTreeView.h"
@@ -228,6 +229,7 @@ void AppImpl::initialize( const char* appName, const char* vendorName, const QIc
     SceneItem::initializeClass(ext);
     PointSetItem::initializeClass(ext);
     MultiPointSetItem::initializeClass(ext);
+    PointCloudOctreeItem::initializeClass(ext);
 
     MovieRecorder::initialize(ext);
 
@@ -9,6 +9,7 @@
 #include <cnoid/SceneCameras>
 #include <cnoid/SceneLights>
 #include <cnoid/SceneEffects>
+#include <cnoid/ScenePicker>
 #include <cnoid/EigenUtil>
 #include <cnoid/NullOut>
 #include <Eigen/StdVector>
@@ -24,6 +25,7 @@ namespace {
 
 const bool USE_FBO_FOR_PICKING = true;
 const bool SHOW_IMAGE_FOR_PICKING = false;
+const bool USE_SCENE_PICKER = true;
 
 const float MinLineWidthForPicking = 5.0f;
 
@@ -62,10 +64,11 @@ typedef ref_ptr<GLResource> GLResourcePtr;
 class VertexResource : public GLResource
 {
 public:
-    static const int MAX_NUM_BUFFERS = 4;
+    static const int MAX_NUM_BUFFERS = 5;
     GLuint vao;
     GLuint vbos[MAX_NUM_BUFFERS];
     GLsizei numVertices;
+    GLsizei numIndices;
     int numBuffers;
     SgObjectPtr sceneObject;
     ScopedConnection connection;
@@ -92,6 +95,7 @@ public:
         }
         numBuffers = 0;
         numVertices = 0;
+        numIndices = 0;
     }
 
     virtual void discard() override { clearHandles(); }
@@ -193,6 +197,30 @@ struct SgObjectPtrHash {
 
 typedef std::unordered_map<SgObjectPtr, GLResourcePtr, SgObjectPtrHash> GLResourceMap;
 
+/*
+  A combination of the vertex, normal, texture coordinate and color indices referred by a
+  triangle corner. Each unique combination becomes a vertex of the indexed vertex buffers.
+*/
+struct MeshCornerKey {
+    int vertex;
+    int normal;
+    int texCoord;
+    int color;
+    bool operator==(const MeshCornerKey& rhs) const {
+        return vertex == rhs.vertex && normal == rhs.normal && texCoord == rhs.texCoord && color == rhs.color;
+    }
+};
+
+struct MeshCornerKeyHash {
+    std::size_t operator()(const MeshCornerKey& key) const {
+        std::size_t h = key.vertex;
+        h = h * 31 + key.normal;
+        h = h * 31 + key.texCoord;
+        h = h * 31 + key.color;
+        return h;
+    }
+};
+
 }
 
 namespace cnoid {
@@ -237,6 +265,8 @@ public:
     Affine3 viewMatrix;
     Matrix4 projectionMatrix;
     Matrix4 PV;
+    Vector4 frustumPlanes[6];
+    bool isFrustumCullingEnabled;
 
     vector<function<void()>> postRenderingFunctions;
     vector<function<void()>> transparentRenderingFunctions;
@@ -282,6 +312,7 @@ public:
     SgNodePath currentNodePath;
     vector<SgNodePathPtr> pickingNodePathList;
     SgNodePath pickedNodePath;
+    ScenePicker scenePicker;
     Vector3 pickedPoint;
 
     ostream* os_;
@@ -324,10 +355,13 @@ public:
     bool initializeGL();
     void doRender();
     bool doPick(int x, int y);
+    bool pickWithScenePicker(int x, int y, bool& out_isPicked);
     void renderScene();
     bool renderShadowMap(int lightIndex);
     void beginRendering();
     void renderCamera(SgCamera* camera, const Affine3& cameraPosition);
+    void updateViewFrustum();
+    bool isInViewFrustum(const BoundingBox& bbox, const Affine3& T) const;
     void renderLights(LightingProgram* program);
     void renderFog(LightingProgram* program);
     void endRendering();
@@ -350,15 +384,16 @@ public:
     void renderOutlineGroupMain(SgOutlineGroup* outline, const Affine3& T);
     void flushNolightingTransformMatrices();
     VertexResource* getOrCreateVertexResource(SgObject* obj);
+    void keepResource(SgObject* obj);
     void drawVertexResource(VertexResource* resource, GLenum primitiveMode, const Affine3& position);
     void renderTransparentObjects();
     void renderMaterial(const SgMaterial* material);
     bool renderTexture(SgTexture* texture);
     bool loadTextureImage(TextureResource* resource, const Image& image);
     void writeMeshVertices(SgMesh* mesh, VertexResource* resource);
-    void writeMeshNormals(SgMesh* mesh, GLuint buffer, SgNormalArray& normals);
-    void writeMeshTexCoords(SgMesh* mesh, GLuint buffer);
-    void writeMeshColors(SgMesh* mesh, GLuint buffer);
+    void writeMeshNormals(SgMesh* mesh, GLuint buffer, const vector<int>& vertexCorners, SgNormalArray& normals);
+    void writeMeshTexCoords(SgMesh* mesh, GLuint buffer, const vector<int>& vertexCorners);
+    void writeMeshColors(SgMesh* mesh, GLuint buffer, const vector<int>& vertexCorners);
     void renderPlot(SgPlot* plot, GLenum primitiveMode, std::function<SgVertexArrayPtr()> getVertices);
     void clearGLState();
     void setDiffuseColor(const Vector3f& color);
@@ -432,6 +467,9 @@ void GLSLSceneRendererImpl::initialize()
     modelMatrixStack.reserve(16);
     viewMatrix.setIdentity();
     projectionMatrix.setIdentity();
+    PV.setIdentity();
+    isFrustumCullingEnabled = true;
+    updateViewFrustum();
 
     defaultLighting = true;
     defaultSmoothShading = true;
@@ -477,6 +515,10 @@ void GLSLSceneRendererImpl::initialize()
 
     self->applyExtensions();
     renderingFunctions.updateDispatchTable();
+
+    scenePicker.setRoot(self->sceneRoot());
+    scenePicker.setRenderingFunctions(&renderingFunctions);
+    scenePicker.setMinPickingWidth(MinLineWidthForPicking);
 }
 
 
@@ -644,6 +686,7 @@ void GLSLSceneRendererImpl::doRender()
 {
     if(self->applyNewExtensions()){
         renderingFunctions.updateDispatchTable();
+        scenePicker.invalidate();
     }
 
     self->extractPreprocessedNodes();
@@ -711,6 +754,13 @@ bool GLSLSceneRenderer::doPick(int x, int y)
 
 bool GLSLSceneRendererImpl::doPick(int x, int y)
 {
+    if(USE_SCENE_PICKER && !SHOW_IMAGE_FOR_PICKING){
+        bool isPicked;
+        if(pickWithScenePicker(x, y, isPicked)){
+            return isPicked;
+        }
+    }
+    
     if(USE_FBO_FOR_PICKING){
         if(!fboForPicking){
             glGenFramebuffers(1, &fboForPicking);
@@ -809,6 +859,45 @@ bool GLSLSceneRendererImpl::doPick(int x, int y)
 }
 
 
+/**
+   The picking is first tried with the bounding volume hierarchies of the scene on the CPU side.
+   The picking with the rendering for the custom-rendered nodes is done when this function returns false.
+*/
+bool GLSLSceneRendererImpl::pickWithScenePicker(int x, int y, bool& out_isPicked)
+{
+    if(isUpsideDownEnabled){
+        return false;
+    }
+    self->extractPreprocessedNodes();
+    SgCamera* camera = self->currentCamera();
+    if(!camera){
+        return false;
+    }
+    renderCamera(camera, self->currentCameraPosition());
+
+    // The ray from the near clip plane to the far clip plane and the pixel sizes on the planes
+    Vector3 p0, p1, q0, q1;
+    if(!self->unproject(x, y, 0.0, p0) || !self->unproject(x, y, 1.0, p1) ||
+       !self->unproject(x + 1, y, 0.0, q0) || !self->unproject(x + 1, y, 1.0, q1)){
+        return false;
+    }
+    
+    auto result = scenePicker.pick(p0, p1, (q0 - p0).norm(), (q1 - p1).norm());
+    if(result == ScenePicker::UNDETERMINED){
+        return false;
+    }
+    if(result == ScenePicker::PICKED){
+        pickedNodePath = scenePicker.pickedNodePath();
+        pickedPoint = scenePicker.pickedPoint();
+        out_isPicked = true;
+    } else {
+        pickedNodePath.clear();
+        out_isPicked = false;
+    }
+    return true;
+}
+
+
 void GLSLSceneRendererImpl::renderScene()
 {
     SgCamera* camera = self->currentCamera();
@@ -880,12 +969,40 @@ void GLSLSceneRendererImpl::renderCamera(SgCamera* camera, const Affine3& camera
         viewMatrix = cameraPosition.inverse(Eigen::Isometry);
     }
     PV = projectionMatrix * viewMatrix.matrix();
+    updateViewFrustum();
 
     modelMatrixStack.clear();
     modelMatrixStack.push_back(Affine3::Identity());
 }
 
 
+void GLSLSceneRendererImpl::updateViewFrustum()
+{
+    // Extract the clipping planes from the view projection matrix
+    for(int i=0; i < 3; ++i){
+        frustumPlanes[i * 2] = (PV.row(3) + PV.row(i)).transpose();
+        frustumPlanes[i * 2 + 1] = (PV.row(3) - PV.row(i)).transpose();
+    }
+}
+
+
+bool GLSLSceneRendererImpl::isInViewFrustum(const BoundingBox& bbox, const Affine3& T) const
+{
+    if(!isFrustumCullingEnabled || bbox.empty()){
+        return true;
+    }
+    const Vector3 c = T * bbox.center();
+    const Vector3 h = T.linear().cwiseAbs() * (0.5 * bbox.size());
+    for(int i=0; i < 6; ++i){
+        const Vector3 n = frustumPlanes[i].head<3>();
+        if(n.dot(c) + n.cwiseAbs().dot(h) + frustumPlanes[i][3] < 0.0){
+            return false;
+        }
+    }
+    return true;
+}
+
+
 void GLSLSceneRendererImpl::beginRendering()
 {
     isCheckingUnusedResources = isPicking ? false : doUnusedResourceCheck;
@@ -1252,7 +1369,25 @@ void GLSLSceneRendererImpl::drawVertexResource(VertexResource* resource, GLenum
         currentNolightingProgram->setProjectionMatrix(PVM);
     }
     glBindVertexArray(resource->vao);
-    glDrawArrays(primitiveMode, 0, resource->numVertices);
+    if(resource->numIndices > 0){
+        glDrawElements(primitiveMode, resource->numIndices, GL_UNSIGNED_INT, ((GLubyte*)NULL + (0)));
+    } else {
+        glDrawArrays(primitiveMode, 0, resource->numVertices);
+    }
+}
+
+
+/**
+   The resource of the object is moved to the next resource map without being used.
+*/
+void GLSLSceneRendererImpl::keepResource(SgObject* obj)
+{
+    if(obj){
+        auto p = currentResourceMap->find(obj);
+        if(p != currentResourceMap->end()){
+            nextResourceMap->insert(*p);
+        }
+    }
 }
 
 
@@ -1261,6 +1396,18 @@ void GLSLSceneRendererImpl::renderShape(SgShape* shape)
     SgMesh* mesh = shape->mesh();
     if(mesh && mesh->hasVertices()){
 
+        if(!isInViewFrustum(mesh->boundingBox(), modelMatrixStack.back())){
+            // The resources of a culled shape are kept so that they are not uploaded again
+            // when the shape comes into the view
+            if(isCheckingUnusedResources){
+                keepResource(mesh);
+                if(SgTexture* texture = shape->texture()){
+                    keepResource(texture->image());
+                }
+            }
+            return;
+        }
+
         VertexResource* resource = getOrCreateVertexResource(mesh);
         if(!resource->isValid()){
             writeMeshVertices(mesh, resource);
@@ -1487,23 +1634,76 @@ void GLSLSceneRenderer::onImageUpdated(SgImage* image)
 void GLSLSceneRendererImpl::writeMeshVertices(SgMesh* mesh, VertexResource* resource)
 {
     auto& triangleVertices = mesh->triangleVertices();
-    const int totalNumVertices = triangleVertices.size();
-    
-    const auto& orgVertices = *mesh->vertices();
-    SgVertexArray vertices;
-    vertices.reserve(totalNumVertices);
-    resource->numVertices = totalNumVertices;
+    const int numCorners = triangleVertices.size();
+
+    const bool hasSmoothNormals = defaultSmoothShading && mesh->normals();
+    const bool hasTexCoords = mesh->hasTexCoords();
+    const bool hasColors = mesh->hasColors();
+    const auto& normalIndices = mesh->normalIndices();
+    const auto& texCoordIndices = mesh->texCoordIndices();
+    const auto& colorIndices = mesh->colorIndices();
 
-    const int numTriangles = mesh->numTriangles();
-    int faceVertexIndex = 0;
+    /*
+      Each vertex of the buffers is a unique combination of the attribute indices, and
+      vertexCorners stores the first triangle corner referring to each combination.
+    */
+    vector<int> vertexCorners;
+    vector<GLuint> indices;
     
-    for(int i=0; i < numTriangles; ++i){
-        for(int j=0; j < 3; ++j){
-            const int orgVertexIndex = triangleVertices[faceVertexIndex++];
-            vertices.push_back(orgVertices[orgVertexIndex]);
+    if(!hasSmoothNormals){
+        // The normals of flat shading are not shared between triangles
+        vertexCorners.resize(numCorners);
+        for(int i=0; i < numCorners; ++i){
+            vertexCorners[i] = i;
+        }
+    } else {
+        const bool hasNormalIndices = !normalIndices.empty();
+        const bool hasTexCoordIndices = hasTexCoords && !texCoordIndices.empty();
+        const bool hasColorIndices = hasColors && !colorIndices.empty();
+        vertexCorners.reserve(mesh->vertices()->size());
+        indices.resize(numCorners);
+
+        if(!hasNormalIndices && !hasTexCoordIndices && !hasColorIndices){
+            vector<int> vertexMap(mesh->vertices()->size(), -1);
+            for(int i=0; i < numCorners; ++i){
+                int& index = vertexMap[triangleVertices[i]];
+                if(index < 0){
+                    index = vertexCorners.size();
+                    vertexCorners.push_back(i);
+                }
+                indices[i] = index;
+            }
+        } else {
+            std::unordered_map<MeshCornerKey, int, MeshCornerKeyHash> cornerMap;
+            cornerMap.reserve(numCorners);
+            MeshCornerKey key;
+            for(int i=0; i < numCorners; ++i){
+                const int vertexIndex = triangleVertices[i];
+                key.vertex = vertexIndex;
+                key.normal = hasNormalIndices ? normalIndices[i] : vertexIndex;
+                key.texCoord = hasTexCoordIndices ? texCoordIndices[i] : vertexIndex;
+                key.color = hasColorIndices ? colorIndices[i] : vertexIndex;
+                auto inserted = cornerMap.insert(std::make_pair(key, (int)vertexCorners.size()));
+                if(inserted.second){
+                    vertexCorners.push_back(i);
+                }
+                indices[i] = inserted.first->second;
+            }
+        }
+        if((int)vertexCorners.size() == numCorners){
+            // No vertex is shared, so the index buffer is useless
+            indices.clear();
         }
     }
 
+    const int numVertices = vertexCorners.size();
+    const auto& orgVertices = *mesh->vertices();
+    SgVertexArray vertices(numVertices);
+    for(int i=0; i < numVertices; ++i){
+        vertices[i] = orgVertices[triangleVertices[vertexCorners[i]]];
+    }
+    resource->numVertices = numVertices;
+
     {
         LockVertexArrayAPI lock;
         glBindVertexArray(resource->vao);
@@ -1513,8 +1713,19 @@ void GLSLSceneRendererImpl::writeMeshVertices(SgMesh* mesh, VertexResource* reso
     glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vector3f), vertices.data(), GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
 
+    if(indices.empty()){
+        resource->numIndices = 0;
+    } else {
+        {
+            LockVertexArrayAPI lock;
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, resource->newBuffer());
+        }
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+        resource->numIndices = indices.size();
+    }
+
     SgNormalArray normals;
-    writeMeshNormals(mesh, resource->newBuffer(), normals);
+    writeMeshNormals(mesh, resource->newBuffer(), vertexCorners, normals);
     if(isNormalVisualizationEnabled){
         auto lines = new SgLineSet;
         auto lineVertices = lines->getOrCreateVertices();
@@ -1528,53 +1739,43 @@ void GLSLSceneRendererImpl::writeMeshVertices(SgMesh* mesh, VertexResource* reso
         resource->normalVisualization = lines;
     }
 
-    if(mesh->hasTexCoords()){
-        writeMeshTexCoords(mesh, resource->newBuffer());
+    if(hasTexCoords){
+        writeMeshTexCoords(mesh, resource->newBuffer(), vertexCorners);
     }
     
-    if(mesh->hasColors()){
-        writeMeshColors(mesh, resource->newBuffer());
+    if(hasColors){
+        writeMeshColors(mesh, resource->newBuffer(), vertexCorners);
     }
 }
 
 
-void GLSLSceneRendererImpl::writeMeshNormals(SgMesh* mesh, GLuint buffer, SgNormalArray& normals)
+void GLSLSceneRendererImpl::writeMeshNormals
+(SgMesh* mesh, GLuint buffer, const vector<int>& vertexCorners, SgNormalArray& normals)
 {
     auto& triangleVertices = mesh->triangleVertices();
-    const int totalNumVertices = triangleVertices.size();
-    normals.reserve(totalNumVertices);
-    const int numTriangles = mesh->numTriangles();
+    const int numVertices = vertexCorners.size();
+    normals.resize(numVertices);
 
     if(defaultSmoothShading && mesh->normals()){
         const auto& orgNormals = *mesh->normals();
         const auto& normalIndices = mesh->normalIndices();
-        int faceVertexIndex = 0;
         if(normalIndices.empty()){
-            for(int i=0; i < numTriangles; ++i){
-                for(int j=0; j < 3; ++j){
-                    const int orgVertexIndex = triangleVertices[faceVertexIndex++];
-                    normals.push_back(orgNormals[orgVertexIndex]);
-                }
+            for(int i=0; i < numVertices; ++i){
+                normals[i] = orgNormals[triangleVertices[vertexCorners[i]]];
             }
         } else {
-            for(int i=0; i < numTriangles; ++i){
-                for(int j=0; j < 3; ++j){
-                    const int normalIndex = normalIndices[faceVertexIndex++];
-                    normals.push_back(orgNormals[normalIndex]);
-                }
+            for(int i=0; i < numVertices; ++i){
+                normals[i] = orgNormals[normalIndices[vertexCorners[i]]];
             }
         }
     } else {
         // flat shading
         const auto& orgVertices = *mesh->vertices();
-        for(int i=0; i < numTriangles; ++i){
-            SgMesh::TriangleRef triangle = mesh->triangle(i);
+        for(int i=0; i < numVertices; ++i){
+            SgMesh::TriangleRef triangle = mesh->triangle(vertexCorners[i] / 3);
             const Vector3f e1 = orgVertices[triangle[1]] - orgVertices[triangle[0]];
             const Vector3f e2 = orgVertices[triangle[2]] - orgVertices[triangle[0]];
-            const Vector3f normal = e1.cross(e2).normalized();
-            for(int j=0; j < 3; ++j){
-                normals.push_back(normal);
-            }
+            normals[i] = e1.cross(e2).normalized();
         }
     }
 
@@ -1588,14 +1789,13 @@ void GLSLSceneRendererImpl::writeMeshNormals(SgMesh* mesh, GLuint buffer, SgNorm
 }
 
 
-void GLSLSceneRendererImpl::writeMeshTexCoords(SgMesh* mesh, GLuint buffer)
+void GLSLSceneRendererImpl::writeMeshTexCoords(SgMesh* mesh, GLuint buffer, const vector<int>& vertexCorners)
 {
     auto& triangleVertices = mesh->triangleVertices();
-    const int totalNumVertices = triangleVertices.size();
+    const int numVertices = vertexCorners.size();
     SgTexCoordArrayPtr pOrgTexCoords;
     const auto& texCoordIndices = mesh->texCoordIndices();
-    SgTexCoordArray texCoords;
-    texCoords.reserve(totalNumVertices);
+    SgTexCoordArray texCoords(numVertices);
     if(!hasValidTextureTransform){
         pOrgTexCoords = mesh->texCoords();
     } else {
@@ -1607,22 +1807,13 @@ void GLSLSceneRendererImpl::writeMeshTexCoords(SgMesh* mesh, GLuint buffer)
         }
     }
 
-    const int numTriangles = mesh->numTriangles();
-    int faceVertexIndex = 0;
-    
     if(texCoordIndices.empty()){
-        for(int i=0; i < numTriangles; ++i){
-            for(int j=0; j < 3; ++j){
-                const int orgVertexIndex = triangleVertices[faceVertexIndex++];
-                texCoords.push_back((*pOrgTexCoords)[orgVertexIndex]);
-            }
+        for(int i=0; i < numVertices; ++i){
+            texCoords[i] = (*pOrgTexCoords)[triangleVertices[vertexCorners[i]]];
         }
     } else {
-        for(int i=0; i < numTriangles; ++i){
-            for(int j=0; j < 3; ++j){
-                const int texCoordIndex = texCoordIndices[faceVertexIndex++];
-                texCoords.push_back((*pOrgTexCoords)[texCoordIndex]);
-            }
+        for(int i=0; i < numVertices; ++i){
+            texCoords[i] = (*pOrgTexCoords)[texCoordIndices[vertexCorners[i]]];
         }
     }
 
@@ -1636,30 +1827,21 @@ void GLSLSceneRendererImpl::writeMeshTexCoords(SgMesh* mesh, GLuint buffer)
 }
 
 
-void GLSLSceneRendererImpl::writeMeshColors(SgMesh* mesh, GLuint buffer)
+void GLSLSceneRendererImpl::writeMeshColors(SgMesh* mesh, GLuint buffer, const vector<int>& vertexCorners)
 {
     auto& triangleVertices = mesh->triangleVertices();
-    const int totalNumVertices = triangleVertices.size();
+    const int numVertices = vertexCorners.size();
     const auto& orgColors = *mesh->colors();
     const auto& colorIndices = mesh->colorIndices();
-    SgColorArray colors;
-    colors.reserve(totalNumVertices);
-    const int numTriangles = mesh->numTriangles();
-    int faceVertexIndex = 0;
+    SgColorArray colors(numVertices);
 
     if(colorIndices.empty()){
-        for(int i=0; i < numTriangles; ++i){
-            for(int j=0; j < 3; ++j){
-                const int orgVertexIndex = triangleVertices[faceVertexIndex++];
-                colors.push_back(orgColors[orgVertexIndex]);
-            }
+        for(int i=0; i < numVertices; ++i){
+            colors[i] = orgColors[triangleVertices[vertexCorners[i]]];
         }
     } else {
-        for(int i=0; i < numTriangles; ++i){
-            for(int j=0; j < 3; ++j){
-                const int colorIndex = colorIndices[faceVertexIndex++];
-                colors.push_back(orgColors[colorIndex]);
-            }
+        for(int i=0; i < numVertices; ++i){
+            colors[i] = orgColors[colorIndices[vertexCorners[i]]];
         }
     }
 
@@ -1817,10 +1999,12 @@ void GLSLSceneRendererImpl::renderOverlay(SgOverlay* overlay)
     const Array4i vp = self->viewport();
     overlay->calcViewVolume(vp[2], vp[3], v);
     self->getOrthographicProjectionMatrix(v.left, v.right, v.bottom, v.top, v.zNear, v.zFar, PV);
+    updateViewFrustum();
             
     renderGroup(overlay);
 
     PV = PV0;
+    updateViewFrustum();
     modelMatrixStack.pop_back();
     popProgram();
 }
@@ -2091,6 +2275,7 @@ void GLSLSceneRenderer::setDefaultPointSize(double size)
 {
     if(size != impl->defaultPointSize){
         impl->defaultPointSize = size;
+        impl->scenePicker.setDefaultPointSize(size);
     }
 }
 
@@ -2099,6 +2284,7 @@ void GLSLSceneRenderer::setDefaultLineWidth(double width)
 {
     if(width != impl->defaultLineWidth){
         impl->defaultLineWidth = width;
+        impl->scenePicker.setDefaultLineWidth(width);
     }
 }
 
@@ -2127,3 +2313,9 @@ void GLSLSceneRenderer::setUpsideDown(bool on)
 {
     impl->isUpsideDownEnabled = on;
 }
+
+
+void GLSLSceneRenderer::setFrustumCullingEnabled(bool on)
+{
+    impl->isFrustumCullingEnabled = on;
+}
@@ -76,6 +76,7 @@ class CNOID_EXPORT GLSLSceneRenderer : public GLSceneRenderer
     virtual void setColor(const Vector3f& color) override;
 
     virtual void setUpsideDown(bool on) override;
+    void setFrustumCullingEnabled(bool on);
 
     void setDiffuseColor(const Vector3f& color);
     void setAmbientColor(const Vector3f& color);
@@ -6,6 +6,7 @@
 #include "MultiSE3SeqItem.h"
 #include "MultiSeqItemCreationPanel.h"
 #include "ItemManager.h"
+#include <cnoid/BinarySeqFile>
 #include "gettext.h"
 
 using namespace cnoid;
@@ -16,6 +17,16 @@ template<> void MultiSeqItem<MultiSE3Seq>::initializeClass(ExtensionManager* ext
     
     ext->itemManager().addCreationPanel<MultiSE3SeqItem>(
         new MultiSeqItemCreationPanel(_("Number of SE3 values in a frame")));
+
+    ext->itemManager().addLoaderAndSaver<MultiSE3SeqItem>(
+        _("Binary Format of a Multi SE3 Sequence"), "BINARY-MULTI-SE3-SEQ", "bseq",
+        [](MultiSE3SeqItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return loadSeqFromBinaryFile(item->seq().get(), filename, os);
+        },
+        [](MultiSE3SeqItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return saveSeqAsBinaryFile(item->seq().get(), filename, os);
+        },
+        ItemManager::PRIORITY_OPTIONAL);
 }
 
 #ifdef WIN32
@@ -6,6 +6,7 @@
 #include "MultiValueSeqItem.h"
 #include "MultiSeqItemCreationPanel.h"
 #include "ItemManager.h"
+#include <cnoid/BinarySeqFile>
 #include "gettext.h"
 
 using namespace cnoid;
@@ -45,6 +46,16 @@ template<> void MultiSeqItem<MultiValueSeq>::initializeClass(ExtensionManager* e
         _("Plain Format of a Multi Value Sequence"), "PLAIN-MULTI-VALUE-SEQ", "*",
         std::bind(loadPlainSeqFormat, _1, _2, _3), std::bind(saveAsPlainSeqFormat, _1, _2, _3), 
         ItemManager::PRIORITY_CONVERSION);
+
+    ext->itemManager().addLoaderAndSaver<MultiValueSeqItem>(
+        _("Binary Format of a Multi Value Sequence"), "BINARY-MULTI-VALUE-SEQ", "bseq",
+        [](MultiValueSeqItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return loadSeqFromBinaryFile(item->seq().get(), filename, os);
+        },
+        [](MultiValueSeqItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return saveSeqAsBinaryFile(item->seq().get(), filename, os);
+        },
+        ItemManager::PRIORITY_OPTIONAL);
 }
 
 #ifdef WIN32
@@ -0,0 +1,808 @@
+/**
+   @file
+*/
+
+#include "PointCloudOctreeItem.h"
+#include "SceneView.h"
+#include "SceneWidget.h"
+#include "SceneWidgetEditable.h"
+#include "RectRegionMarker.h"
+#include "LazyCaller.h"
+#include "MessageView.h"
+#include <cnoid/ItemManager>
+#include <cnoid/MenuManager>
+#include <cnoid/Archive>
+#include <cnoid/SceneDrawables>
+#include <cnoid/SceneMarkers>
+#include <cnoid/SceneRenderer>
+#include <cnoid/PointCloudOctree>
+#include <cnoid/PolyhedralRegion>
+#include <cnoid/FileUtil>
+#include <cnoid/NullOut>
+#include <boost/format.hpp>
+#include <map>
+#include <set>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "gettext.h"
+
+using namespace std;
+using namespace std::placeholders;
+using namespace cnoid;
+using boost::format;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+class SceneOctreePointCloud : public SgGroup, public SceneWidgetEditable
+{
+public:
+    weak_ref_ptr<PointCloudOctreeItem> weakItem;
+    SgGroupPtr pointGroup;
+    SgUpdate update;
+    RectRegionMarkerPtr regionMarker;
+    ScopedConnection eraserModeMenuItemConnection;
+    bool isEditable_;
+
+    Signal<void()> sigAttentionPointsChanged;
+    SgGroupPtr attentionPointMarkerGroup;
+
+    SceneOctreePointCloud(PointCloudOctreeItem* item);
+
+    int numAttentionPoints() const;
+    Vector3 attentionPoint(int index) const;
+    void clearAttentionPoints(bool doNotify);
+    void addAttentionPoint(const Vector3& point, bool doNotify);
+    bool removeAttentionPoint(const Vector3& point, double distanceThresh, bool doNotify);
+    void notifyAttentionPointChange();
+    Vector3 findNearestPoint(const Vector3& point);
+
+    virtual bool onButtonPressEvent(const SceneWidgetEvent& event);
+    virtual void onContextMenuRequest(const SceneWidgetEvent& event, MenuManager& menuManager);
+    void onContextMenuRequestInEraserMode(const SceneWidgetEvent& event, MenuManager& menuManager);
+};
+
+typedef ref_ptr<SceneOctreePointCloud> SceneOctreePointCloudPtr;
+
+}
+
+namespace cnoid {
+
+class PointCloudOctreeItemImpl
+{
+public:
+    PointCloudOctreeItem* self;
+    PointCloudOctree octree;
+    SceneOctreePointCloudPtr scene;
+    std::map<int, SgPointSetPtr> loadedNodes;
+    std::set<int> visibleNodeIndices;
+    double pointSize;
+    int pointBudget;
+    double lodThreshold;
+    SceneWidget* sceneWidget;
+    SgPosTransformPtr cameraTransform;
+    ScopedConnection cameraConnection;
+    LazyCaller updateVisibleNodesLater;
+    Signal<void(const PolyhedralRegion& region)> sigPointsInRegionRemoved;
+
+    /*
+      The points of the nodes are read by the loader thread so that the main thread is not
+      blocked by the file access. The requests are replaced with the new ones whenever the
+      visible nodes are updated, and the loaded nodes are passed to the main thread.
+      The generation is incremented when the loaded data may be obsolete, and the nodes
+      loaded in the older generation are discarded.
+    */
+    struct LoadedNode {
+        int index;
+        int generation;
+        SgPointSetPtr pointSet;
+    };
+    std::thread nodeLoaderThread;
+    std::mutex nodeLoadMutex;
+    std::condition_variable nodeLoadCondition;
+    std::deque<int> nodeLoadRequests;
+    vector<LoadedNode> loadedNodeResults;
+    int nodeLoadGeneration;
+    bool isNodeLoaderStopRequested;
+    bool isNodeLoadNotificationPending;
+    QueuedCaller nodeLoadNotifier;
+
+    PointCloudOctreeItemImpl(PointCloudOctreeItem* self);
+    PointCloudOctreeItemImpl(PointCloudOctreeItem* self, const PointCloudOctreeItemImpl& org);
+    ~PointCloudOctreeItemImpl();
+    void initialize();
+    void connectToCamera();
+    bool openOctree(const string& filename, ostream& os);
+    bool getViewVolume(Vector3& out_viewpoint, PolyhedralRegion& out_volume);
+    void updateVisibleNodes();
+    void requestNodeLoading(std::deque<int>& nodeIndices);
+    void cancelNodeLoading();
+    void loadNodes();
+    void onNodesLoaded();
+    void setPointSize(double size);
+    void removePoints(const PolyhedralRegion& region);
+};
+
+}
+
+
+static bool loadOctree(PointCloudOctreeItem* item, const std::string& filename, std::ostream& os)
+{
+    return item->openOctree(filename, os);
+}
+
+
+static bool loadPCDAsOctree(PointCloudOctreeItem* item, const std::string& filename, std::ostream& os)
+{
+    return item->openPCD(filename, os);
+}
+
+
+void PointCloudOctreeItem::initializeClass(ExtensionManager* ext)
+{
+    static bool initialized = false;
+    if(!initialized){
+        ItemManager& im = ext->itemManager();
+        im.registerClass<PointCloudOctreeItem>(N_("PointCloudOctreeItem"));
+        im.addLoader<PointCloudOctreeItem>(
+            _("Point Cloud Octree"), "POINT-CLOUD-OCTREE", "octree",
+            std::bind(::loadOctree, _1, _2, _3));
+        im.addLoader<PointCloudOctreeItem>(
+            _("Point Cloud (PCD) as Octree"), "PCD-FILE-OCTREE", "pcd",
+            std::bind(::loadPCDAsOctree, _1, _2, _3),
+            ItemManager::PRIORITY_CONVERSION);
+
+        initialized = true;
+    }
+}
+
+
+PointCloudOctreeItem::PointCloudOctreeItem()
+{
+    impl = new PointCloudOctreeItemImpl(this);
+}
+
+
+PointCloudOctreeItemImpl::PointCloudOctreeItemImpl(PointCloudOctreeItem* self)
+    : self(self)
+{
+    pointSize = 0.0;
+    pointBudget = 5000000;
+    lodThreshold = 0.1;
+    initialize();
+}
+
+
+PointCloudOctreeItem::PointCloudOctreeItem(const PointCloudOctreeItem& org)
+    : Item(org)
+{
+    impl = new PointCloudOctreeItemImpl(this, *org.impl);
+}
+
+
+PointCloudOctreeItemImpl::PointCloudOctreeItemImpl(PointCloudOctreeItem* self, const PointCloudOctreeItemImpl& org)
+    : self(self)
+{
+    pointSize = org.pointSize;
+    pointBudget = org.pointBudget;
+    lodThreshold = org.lodThreshold;
+    initialize();
+    scene->isEditable_ = org.scene->isEditable_;
+
+    if(org.octree.isOpen()){
+        openOctree(org.octree.filename(), nullout());
+    }
+}
+
+
+void PointCloudOctreeItemImpl::initialize()
+{
+    sceneWidget = nullptr;
+    nodeLoadGeneration = 0;
+    isNodeLoaderStopRequested = false;
+    isNodeLoadNotificationPending = false;
+    scene = new SceneOctreePointCloud(self);
+    updateVisibleNodesLater.setFunction([&](){ updateVisibleNodes(); });
+    updateVisibleNodesLater.setPriority(LazyCaller::PRIORITY_LOW);
+}
+
+
+PointCloudOctreeItem::~PointCloudOctreeItem()
+{
+    delete impl;
+}
+
+
+PointCloudOctreeItemImpl::~PointCloudOctreeItemImpl()
+{
+    if(nodeLoaderThread.joinable()){
+        {
+            std::lock_guard<std::mutex> lock(nodeLoadMutex);
+            isNodeLoaderStopRequested = true;
+        }
+        nodeLoadCondition.notify_all();
+        nodeLoaderThread.join();
+    }
+}
+
+
+Item* PointCloudOctreeItem::doDuplicate() const
+{
+    return new PointCloudOctreeItem(*this);
+}
+
+
+void PointCloudOctreeItem::setName(const std::string& name)
+{
+    impl->scene->setName(name);
+    Item::setName(name);
+}
+
+
+SgNode* PointCloudOctreeItem::getScene()
+{
+    impl->connectToCamera();
+    return impl->scene;
+}
+
+
+/**
+   The nodes are selected again when the camera of the scene view is moved.
+*/
+void PointCloudOctreeItemImpl::connectToCamera()
+{
+    if(!cameraConnection.connected()){
+        if(SceneView* sceneView = SceneView::instance()){
+            sceneWidget = sceneView->sceneWidget();
+            cameraTransform = sceneWidget->builtinCameraTransform();
+            cameraConnection.reset(
+                cameraTransform->sigUpdated().connect(
+                    [&](const SgUpdate&){ updateVisibleNodesLater(); }));
+            updateVisibleNodesLater();
+        }
+    }
+}
+
+
+bool PointCloudOctreeItem::openOctree(const std::string& filename, std::ostream& os)
+{
+    return impl->openOctree(filename, os);
+}
+
+
+bool PointCloudOctreeItemImpl::openOctree(const string& filename, ostream& os)
+{
+    cancelNodeLoading();
+    loadedNodes.clear();
+    if(!octree.open(filename, os)){
+        updateVisibleNodes();
+        return false;
+    }
+    os << format(_("The octree of %1% points has been loaded.")) % octree.numPoints() << endl;
+    updateVisibleNodes();
+    return true;
+}
+
+
+bool PointCloudOctreeItem::openPCD(const std::string& filename, std::ostream& os)
+{
+    const string octreeFilename = filename + ".octree";
+    filesystem::path pcdPath(filename);
+    filesystem::path octreePath(octreeFilename);
+
+    if(!filesystem::exists(octreePath) ||
+       filesystem::last_write_time(octreePath) < filesystem::last_write_time(pcdPath)){
+        if(!PointCloudOctree::build(filename, octreeFilename, os)){
+            return false;
+        }
+    }
+    return impl->openOctree(octreeFilename, os);
+}
+
+
+PointCloudOctree* PointCloudOctreeItem::octree()
+{
+    return &impl->octree;
+}
+
+
+void PointCloudOctreeItem::setPointSize(double size)
+{
+    impl->setPointSize(size);
+}
+
+
+void PointCloudOctreeItemImpl::setPointSize(double size)
+{
+    if(size != pointSize){
+        pointSize = size;
+        for(auto& kv : loadedNodes){
+            kv.second->setPointSize(size);
+            kv.second->notifyUpdate(scene->update);
+        }
+    }
+}
+
+
+double PointCloudOctreeItem::pointSize() const
+{
+    return impl->pointSize;
+}
+
+
+void PointCloudOctreeItem::setPointBudget(int numPoints)
+{
+    if(numPoints != impl->pointBudget){
+        impl->pointBudget = numPoints;
+        impl->updateVisibleNodesLater();
+    }
+}
+
+
+int PointCloudOctreeItem::pointBudget() const
+{
+    return impl->pointBudget;
+}
+
+
+void PointCloudOctreeItem::setLodThreshold(double ratio)
+{
+    if(ratio != impl->lodThreshold){
+        impl->lodThreshold = ratio;
+        impl->updateVisibleNodesLater();
+    }
+}
+
+
+double PointCloudOctreeItem::lodThreshold() const
+{
+    return impl->lodThreshold;
+}
+
+
+void PointCloudOctreeItem::updateVisibleNodes()
+{
+    impl->updateVisibleNodes();
+}
+
+
+/**
+   The view volume is given by the bounding planes extracted from the product of the projection
+   matrix and the view matrix of the builtin camera. The view volume does not have any bounding
+   plane before the scene is rendered because the projection is not determined yet.
+*/
+bool PointCloudOctreeItemImpl::getViewVolume(Vector3& out_viewpoint, PolyhedralRegion& out_volume)
+{
+    out_volume.clear();
+    if(!cameraTransform){
+        out_viewpoint.setZero();
+        return false;
+    }
+    out_viewpoint = cameraTransform->translation();
+
+    SceneRenderer* renderer = sceneWidget->renderer();
+    const Array4i vp = renderer->viewport();
+    if(vp[2] <= 0 || vp[3] <= 0){
+        return false;
+    }
+    const Matrix4 M = renderer->projectionMatrix() * cameraTransform->T().inverse().matrix();
+    for(int i=0; i < 3; ++i){
+        for(double sign : { 1.0, -1.0 }){
+            const Vector4 p = M.row(3).transpose() + sign * M.row(i).transpose();
+            const Vector3 a = p.head<3>();
+            const double norm2 = a.squaredNorm();
+            if(norm2 > 0.0){
+                out_volume.addBoundingPlane(a / sqrt(norm2), -p[3] * a / norm2);
+            }
+        }
+    }
+    return true;
+}
+
+
+/**
+   The point sets of the nodes that are still visible are reused, and the newly selected
+   nodes are requested to the loader thread. The loaded nodes are added by onNodesLoaded().
+*/
+void PointCloudOctreeItemImpl::updateVisibleNodes()
+{
+    vector<int> nodeIndices;
+    if(octree.isOpen()){
+        Vector3 viewpoint;
+        PolyhedralRegion viewVolume;
+        getViewVolume(viewpoint, viewVolume);
+        octree.findVisibleNodes(viewpoint, viewVolume, lodThreshold, pointBudget, nodeIndices);
+    }
+
+    visibleNodeIndices.clear();
+    std::map<int, SgPointSetPtr> visibleNodes;
+    std::deque<int> requests;
+    for(auto index : nodeIndices){
+        visibleNodeIndices.insert(index);
+        auto p = loadedNodes.find(index);
+        if(p != loadedNodes.end()){
+            visibleNodes.insert(*p);
+        } else {
+            requests.push_back(index);
+        }
+    }
+    loadedNodes.swap(visibleNodes);
+    requestNodeLoading(requests);
+
+    scene->pointGroup->clearChildren();
+    for(auto& kv : loadedNodes){
+        scene->pointGroup->addChild(kv.second);
+    }
+    scene->pointGroup->notifyUpdate(scene->update);
+}
+
+
+/**
+   The nodes are requested in the order of the priority given by findVisibleNodes(),
+   so the coarse nodes near the viewpoint are shown first.
+*/
+void PointCloudOctreeItemImpl::requestNodeLoading(std::deque<int>& nodeIndices)
+{
+    {
+        std::lock_guard<std::mutex> lock(nodeLoadMutex);
+        nodeLoadRequests.swap(nodeIndices);
+    }
+    if(!nodeLoadRequests.empty()){
+        if(!nodeLoaderThread.joinable()){
+            nodeLoaderThread = std::thread([this](){ loadNodes(); });
+        }
+        nodeLoadCondition.notify_all();
+    }
+}
+
+
+void PointCloudOctreeItemImpl::cancelNodeLoading()
+{
+    std::lock_guard<std::mutex> lock(nodeLoadMutex);
+    nodeLoadRequests.clear();
+    loadedNodeResults.clear();
+    ++nodeLoadGeneration;
+}
+
+
+/**
+   This function is executed in the loader thread.
+*/
+void PointCloudOctreeItemImpl::loadNodes()
+{
+    while(true){
+        int index;
+        int generation;
+        {
+            std::unique_lock<std::mutex> lock(nodeLoadMutex);
+            while(!isNodeLoaderStopRequested && nodeLoadRequests.empty()){
+                nodeLoadCondition.wait(lock);
+            }
+            if(isNodeLoaderStopRequested){
+                break;
+            }
+            index = nodeLoadRequests.front();
+            nodeLoadRequests.pop_front();
+            generation = nodeLoadGeneration;
+        }
+
+        SgPointSetPtr pointSet = new SgPointSet;
+        SgColorArrayPtr colors = new SgColorArray;
+        if(octree.readPoints(index, *pointSet->getOrCreateVertices(), colors)){
+            if(!colors->empty()){
+                pointSet->setColors(colors);
+            }
+        } else {
+            pointSet.reset();
+        }
+
+        std::lock_guard<std::mutex> lock(nodeLoadMutex);
+        if(generation == nodeLoadGeneration){
+            loadedNodeResults.push_back({ index, generation, pointSet });
+            if(!isNodeLoadNotificationPending){
+                isNodeLoadNotificationPending = true;
+                nodeLoadNotifier.callLater([this](){ onNodesLoaded(); }, LazyCaller::PRIORITY_LOW);
+            }
+        }
+    }
+}
+
+
+/**
+   The loaded nodes that are not visible any more are discarded.
+*/
+void PointCloudOctreeItemImpl::onNodesLoaded()
+{
+    vector<LoadedNode> loaded;
+    int generation;
+    {
+        std::lock_guard<std::mutex> lock(nodeLoadMutex);
+        loaded.swap(loadedNodeResults);
+        isNodeLoadNotificationPending = false;
+        generation = nodeLoadGeneration;
+    }
+    bool added = false;
+    for(auto& node : loaded){
+        if(node.generation == generation && node.pointSet &&
+           visibleNodeIndices.find(node.index) != visibleNodeIndices.end() &&
+           loadedNodes.find(node.index) == loadedNodes.end()){
+            node.pointSet->setPointSize(pointSize);
+            loadedNodes[node.index] = node.pointSet;
+            scene->pointGroup->addChild(node.pointSet);
+            added = true;
+        }
+    }
+    if(added){
+        scene->pointGroup->notifyUpdate(scene->update);
+    }
+}
+
+
+void PointCloudOctreeItem::setEditable(bool on)
+{
+    impl->scene->isEditable_ = on;
+}
+
+
+bool PointCloudOctreeItem::isEditable() const
+{
+    return impl->scene->isEditable_;
+}
+
+
+int PointCloudOctreeItem::numAttentionPoints() const
+{
+    return impl->scene->numAttentionPoints();
+}
+
+
+Vector3 PointCloudOctreeItem::attentionPoint(int index) const
+{
+    return impl->scene->attentionPoint(index);
+}
+
+
+void PointCloudOctreeItem::clearAttentionPoints()
+{
+    impl->scene->clearAttentionPoints(false);
+}
+
+
+void PointCloudOctreeItem::addAttentionPoint(const Vector3& p)
+{
+    impl->scene->addAttentionPoint(p, false);
+}
+
+
+SignalProxy<void()> PointCloudOctreeItem::sigAttentionPointsChanged()
+{
+    return impl->scene->sigAttentionPointsChanged;
+}
+
+
+void PointCloudOctreeItem::removePoints(const PolyhedralRegion& region)
+{
+    impl->removePoints(region);
+}
+
+
+void PointCloudOctreeItemImpl::removePoints(const PolyhedralRegion& region)
+{
+    vector<int> modifiedNodeIndices;
+    octree.removePoints(region, modifiedNodeIndices, mvout());
+    if(!modifiedNodeIndices.empty()){
+        // The nodes being loaded may have the removed points
+        cancelNodeLoading();
+        for(auto index : modifiedNodeIndices){
+            loadedNodes.erase(index);
+        }
+        updateVisibleNodes();
+        self->notifyUpdate();
+    }
+    sigPointsInRegionRemoved(region);
+}
+
+
+SignalProxy<void(const PolyhedralRegion& region)> PointCloudOctreeItem::sigPointsInRegionRemoved()
+{
+    return impl->sigPointsInRegionRemoved;
+}
+
+
+void PointCloudOctreeItem::doPutProperties(PutPropertyFunction& putProperty)
+{
+    putProperty(_("File"), getFilename(filePath()));
+    putProperty(_("Num points"), static_cast<double>(impl->octree.numPoints()));
+    putProperty(_("Num nodes"), impl->octree.numNodes());
+    putProperty.decimals(1).min(0.0)(_("Point size"), pointSize(),
+                                     std::bind(&PointCloudOctreeItemImpl::setPointSize, impl, _1), true);
+    putProperty.min(1).max(std::numeric_limits<int>::max())(
+        _("Point budget"), pointBudget(),
+        [&](int value){ setPointBudget(value); return true; });
+    putProperty.decimals(3).min(0.0)(_("LOD threshold"), lodThreshold(),
+                                     [&](double value){ setLodThreshold(value); return true; });
+    putProperty(_("Editable"), isEditable(), [&](bool on){ setEditable(on); return true; });
+}
+
+
+bool PointCloudOctreeItem::store(Archive& archive)
+{
+    if(!filePath().empty()){
+        archive.writeRelocatablePath("file", filePath());
+        archive.write("format", fileFormat());
+    }
+    archive.write("pointSize", pointSize());
+    archive.write("pointBudget", pointBudget());
+    archive.write("lodThreshold", lodThreshold());
+    archive.write("isEditable", isEditable());
+    return true;
+}
+
+
+bool PointCloudOctreeItem::restore(const Archive& archive)
+{
+    setPointSize(archive.get("pointSize", pointSize()));
+    setPointBudget(archive.get("pointBudget", pointBudget()));
+    setLodThreshold(archive.get("lodThreshold", lodThreshold()));
+    setEditable(archive.get("isEditable", isEditable()));
+
+    std::string filename, formatId;
+    if(archive.readRelocatablePath("file", filename) && archive.read("format", formatId)){
+        return load(filename, archive.currentParentItem(), formatId);
+    }
+    return true;
+}
+
+
+SceneOctreePointCloud::SceneOctreePointCloud(PointCloudOctreeItem* item)
+    : weakItem(item)
+{
+    pointGroup = new SgGroup;
+    addChild(pointGroup);
+
+    regionMarker = new RectRegionMarker;
+    regionMarker->setEditModeCursor(QCursor(QPixmap(":/Base/icons/eraser-cursor.png"), 3, 2));
+    regionMarker->sigRegionFixed().connect(
+        [&](const PolyhedralRegion& region){
+            if(auto item = weakItem.lock()){
+                item->removePoints(region);
+            }
+        });
+    regionMarker->sigContextMenuRequest().connect(
+        std::bind(&SceneOctreePointCloud::onContextMenuRequestInEraserMode, this, _1, _2));
+
+    isEditable_ = false;
+}
+
+
+int SceneOctreePointCloud::numAttentionPoints() const
+{
+    return attentionPointMarkerGroup ? attentionPointMarkerGroup->numChildren() : 0;
+}
+
+
+Vector3 SceneOctreePointCloud::attentionPoint(int index) const
+{
+    if(index < numAttentionPoints()){
+        CrossMarker* marker = dynamic_cast<CrossMarker*>(attentionPointMarkerGroup->child(index));
+        if(marker){
+            return marker->translation();
+        }
+    }
+    return Vector3::Zero();
+}
+
+
+void SceneOctreePointCloud::clearAttentionPoints(bool doNotify)
+{
+    if(attentionPointMarkerGroup && !attentionPointMarkerGroup->empty()){
+        attentionPointMarkerGroup->clearChildren();
+        if(doNotify){
+            notifyAttentionPointChange();
+        }
+    }
+}
+
+
+void SceneOctreePointCloud::addAttentionPoint(const Vector3& point, bool doNotify)
+{
+    if(!attentionPointMarkerGroup){
+        attentionPointMarkerGroup = new SgGroup;
+        addChild(attentionPointMarkerGroup);
+    }
+    CrossMarker* marker = new CrossMarker(0.02, Vector3f(1.0f, 1.0f, 0.0f));
+    marker->setTranslation(point);
+    attentionPointMarkerGroup->addChild(marker);
+    if(doNotify){
+        notifyAttentionPointChange();
+    }
+}
+
+
+bool SceneOctreePointCloud::removeAttentionPoint(const Vector3& point, double distanceThresh, bool doNotify)
+{
+    bool removed = false;
+    if(attentionPointMarkerGroup){
+        SgGroup::iterator iter = attentionPointMarkerGroup->begin();
+        while(iter != attentionPointMarkerGroup->end()){
+            CrossMarker* marker = dynamic_cast<CrossMarker*>(iter->get());
+            if(point.isApprox(marker->translation(), distanceThresh)){
+                iter = attentionPointMarkerGroup->erase(iter);
+                removed = true;
+            } else {
+                ++iter;
+            }
+        }
+        if(removed && doNotify){
+            notifyAttentionPointChange();
+        }
+    }
+    return removed;
+}
+
+
+void SceneOctreePointCloud::notifyAttentionPointChange()
+{
+    if(attentionPointMarkerGroup){
+        attentionPointMarkerGroup->notifyUpdate(update);
+    }
+    sigAttentionPointsChanged();
+}
+
+
+/**
+   The picked position on the rendered points is replaced with the nearest point in the octree
+   because the rendered points may be a subset of the points.
+*/
+Vector3 SceneOctreePointCloud::findNearestPoint(const Vector3& point)
+{
+    Vector3 nearestPoint;
+    auto item = weakItem.lock();
+    if(item && item->octree()->isOpen() && item->octree()->findNearestPoint(point, 0.05, nearestPoint)){
+        return nearestPoint;
+    }
+    return point;
+}
+
+
+bool SceneOctreePointCloud::onButtonPressEvent(const SceneWidgetEvent& event)
+{
+    if(!isEditable_ || event.button() != Qt::LeftButton){
+        return false;
+    }
+    const Vector3 point = findNearestPoint(event.point());
+    if(event.modifiers() & Qt::ControlModifier){
+        if(!removeAttentionPoint(point, 0.01, true)){
+            addAttentionPoint(point, true);
+        }
+    } else {
+        clearAttentionPoints(false);
+        addAttentionPoint(point, true);
+    }
+    return true;
+}
+
+
+void SceneOctreePointCloud::onContextMenuRequest(const SceneWidgetEvent& event, MenuManager& menuManager)
+{
+    if(isEditable_){
+        menuManager.addItem(_("PointCloudOctree: Clear Attention Points"))->sigTriggered().connect(
+            std::bind(&SceneOctreePointCloud::clearAttentionPoints, this, true));
+
+        if(!regionMarker->isEditing()){
+            eraserModeMenuItemConnection.reset(
+                menuManager.addItem(_("PointCloudOctree: Start Eraser Mode"))->sigTriggered().connect(
+                    std::bind(&RectRegionMarker::startEditing, regionMarker.get(), event.sceneWidget())));
+        }
+    }
+}
+
+
+void SceneOctreePointCloud::onContextMenuRequestInEraserMode(const SceneWidgetEvent&, MenuManager& menuManager)
+{
+    eraserModeMenuItemConnection.reset(
+        menuManager.addItem(_("PointCloudOctree: Exit Eraser Mode"))->sigTriggered().connect(
+            std::bind(&RectRegionMarker::finishEditing, regionMarker.get())));
+}
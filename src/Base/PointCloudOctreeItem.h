@@ -0,0 +1,86 @@
+/**
+   @file
+*/
+
+#ifndef CNOID_BASE_POINT_CLOUD_OCTREE_ITEM_H
+#define CNOID_BASE_POINT_CLOUD_OCTREE_ITEM_H
+
+#include <cnoid/Item>
+#include <cnoid/SceneProvider>
+#include <cnoid/EigenTypes>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class PointCloudOctree;
+class PolyhedralRegion;
+class PointCloudOctreeItemImpl;
+
+/**
+   This item shows a large point cloud stored in an octree file. Only the points of the
+   octree nodes that are selected in the view volume of the scene view are loaded, and they
+   are read by a background thread.
+   The removal of the points is directly written to the octree file.
+*/
+class CNOID_EXPORT PointCloudOctreeItem : public Item, public SceneProvider
+{
+public:
+    static void initializeClass(ExtensionManager* ext);
+
+    PointCloudOctreeItem();
+    PointCloudOctreeItem(const PointCloudOctreeItem& org);
+    virtual ~PointCloudOctreeItem();
+
+    virtual void setName(const std::string& name);
+    virtual SgNode* getScene();
+
+    bool openOctree(const std::string& filename, std::ostream& os);
+
+    /**
+       The octree file is built as "<PCD file name>.octree" when the file does not exist
+       or it is older than the PCD file.
+    */
+    bool openPCD(const std::string& filename, std::ostream& os);
+
+    PointCloudOctree* octree();
+
+    void setPointSize(double size);
+    double pointSize() const;
+
+    //! The maximum number of the points that are loaded for rendering
+    void setPointBudget(int numPoints);
+    int pointBudget() const;
+
+    //! The minimum ratio of the size of a node to its distance from the viewpoint to render the node
+    void setLodThreshold(double ratio);
+    double lodThreshold() const;
+
+    void updateVisibleNodes();
+
+    void setEditable(bool on);
+    bool isEditable() const;
+
+    int numAttentionPoints() const;
+    Vector3 attentionPoint(int index) const;
+    void clearAttentionPoints();
+    void addAttentionPoint(const Vector3& p);
+    SignalProxy<void()> sigAttentionPointsChanged();
+
+    void removePoints(const PolyhedralRegion& region);
+    SignalProxy<void(const PolyhedralRegion& region)> sigPointsInRegionRemoved();
+
+    virtual bool store(Archive& archive);
+    virtual bool restore(const Archive& archive);
+
+protected:
+    virtual Item* doDuplicate() const;
+    virtual void doPutProperties(PutPropertyFunction& putProperty);
+
+private:
+    PointCloudOctreeItemImpl* impl;
+};
+
+typedef ref_ptr<PointCloudOctreeItem> PointCloudOctreeItemPtr;
+}
+
+#endif
@@ -15,6 +15,7 @@
 #include <cnoid/SceneCameras>
 #include <cnoid/SceneMarkers>
 #include <cnoid/PointSetUtil>
+#include <cnoid/VoxelGrid>
 #include <cnoid/Exception>
 #include <cnoid/FileUtil>
 #include <cnoid/PolyhedralRegion>
@@ -40,6 +41,9 @@ public:
     SgUpdate update;
     SgShapePtr voxels;
     float voxelSize;
+    VoxelGrid voxelGrid;
+    bool isVoxelGridValid;
+    bool doKeepVoxelGrid;
     SgInvariantGroupPtr invariant;
     Selection renderingMode;
     RectRegionMarkerPtr regionMarker;
@@ -65,6 +69,7 @@ public:
     void updateVisualization(bool updateContents);
     void updateVisiblePointSet();
     void updateVoxels();
+    void removePointsFromVoxelGrid(const vector<int>& indices);
     bool isEditable() const { return isEditable_; }
     void setEditable(bool on) { isEditable_ = on; }
 
@@ -432,6 +437,12 @@ void PointSetItemImpl::removePoints(const PolyhedralRegion& region)
     }
 
     if(!indicesToRemove.empty()){
+        // The voxel grid is updated with the removed points instead of being rebuilt
+        if(scene->isVoxelGridValid){
+            scene->removePointsFromVoxelGrid(indicesToRemove);
+            scene->doKeepVoxelGrid = true;
+        }
+        
         SgVertexArray& points = *pointSet->vertices();
         points.clear();
         int j = 0;
@@ -613,6 +624,9 @@ ScenePointSet::ScenePointSet(PointSetItemImpl* pointSetItemImpl)
     voxels = new SgShape;
     voxels->getOrCreateMaterial();
     voxelSize = 0.01f;
+    voxelGrid.setVoxelSize(voxelSize);
+    isVoxelGridValid = false;
+    doKeepVoxelGrid = false;
 
     renderingMode.setSymbol(PointSetItem::POINT, N_("Point"));
     renderingMode.setSymbol(PointSetItem::VOXEL, N_("Voxel"));
@@ -643,6 +657,8 @@ void ScenePointSet::setVoxelSize(double size)
 {
     if(size != voxelSize){
         voxelSize = size;
+        voxelGrid.setVoxelSize(size);
+        isVoxelGridValid = false;
         if(renderingMode.is(PointSetItem::VOXEL) && invariant){
             updateVisualization(true);
         }
@@ -747,6 +763,11 @@ void ScenePointSet::updateVisualization(bool updateContents)
         invariant->removeChild(voxels);
     }
     invariant = new SgInvariantGroup;
+
+    if(updateContents && !doKeepVoxelGrid){
+        isVoxelGridValid = false;
+    }
+    doKeepVoxelGrid = false;
     
     if(renderingMode.is(PointSetItem::POINT)){
         if(updateContents){
@@ -778,88 +799,33 @@ void ScenePointSet::updateVisiblePointSet()
 
 void ScenePointSet::updateVoxels()
 {
-    SgMeshPtr mesh;
-    if(orgPointSet->hasVertices()){
-        mesh = new SgMesh;
-        mesh->setSolid(true);
-        const SgVertexArray& points = *orgPointSet->vertices();
-        const int n = points.size();
-        SgVertexArray& vertices = *mesh->getOrCreateVertices();
-        vertices.reserve(n * 8);
-        SgNormalArray& normals = *mesh->setNormals(new SgNormalArray(6));
-        normals[0] <<  1.0f,  0.0f,  0.0f;
-        normals[1] << -1.0f,  0.0f,  0.0f;
-        normals[2] <<  0.0f,  1.0f,  0.0f;
-        normals[3] <<  0.0f, -1.0f,  0.0f;
-        normals[4] <<  0.0f,  0.0f,  1.0f;
-        normals[5] <<  0.0f,  0.0f, -1.0f;
-        SgIndexArray& normalIndices = mesh->normalIndices();
-        normalIndices.reserve(12 * 3 * n);
-        mesh->reserveNumTriangles(n * 12);
-        const float s = voxelSize / 2.0;
-        for(int i=0; i < n; ++i){
-            const int top = vertices.size();
-            const Vector3f& p = points[i];
-            const float x0 = p.x() + s;
-            const float x1 = p.x() - s;
-            const float y0 = p.y() + s;
-            const float y1 = p.y() - s;
-            const float z0 = p.z() + s;
-            const float z1 = p.z() - s;
-            vertices.push_back(Vector3f(x0, y0, z0));
-            vertices.push_back(Vector3f(x1, y0, z0));
-            vertices.push_back(Vector3f(x1, y1, z0));
-            vertices.push_back(Vector3f(x0, y1, z0));
-            vertices.push_back(Vector3f(x0, y0, z1));
-            vertices.push_back(Vector3f(x1, y0, z1));
-            vertices.push_back(Vector3f(x1, y1, z1));
-            vertices.push_back(Vector3f(x0, y1, z1));
-
-            static const int boxTriangles[][3] = {
-                { 0, 1, 2 }, { 0, 2, 3 }, // +Z
-                { 0, 5, 1 }, { 0, 4, 5 }, // +Y
-                { 1, 5, 2 }, { 2, 5, 6 }, // -X
-                { 2, 6, 3 }, { 3, 6, 7 }, // -Y
-                { 0, 3, 4 }, { 3, 7, 4 }, // +X
-                { 4, 6, 5 }, { 4, 7, 6 }  // -Z
-            };
-            static const int boxNormalIndices[] = {
-                4, 4, 2, 2, 1, 1, 3, 3, 0, 0, 5, 5
-            };
-            for(int j=0; j < 12; ++j){
-                const int* tri = boxTriangles[j];
-                mesh->addTriangle(top + tri[0], top + tri[1], top + tri[2]);
-                const int normalIndex = boxNormalIndices[j];
-                normalIndices.push_back(normalIndex);
-                normalIndices.push_back(normalIndex);
-                normalIndices.push_back(normalIndex);
-            }
+    if(!isVoxelGridValid){
+        voxelGrid.clear();
+        voxelGrid.addPoints(*orgPointSet);
+        isVoxelGridValid = true;
+    }
+    voxels->setMesh(voxelGrid.createMesh());
+}
+
+
+void ScenePointSet::removePointsFromVoxelGrid(const vector<int>& indices)
+{
+    const SgVertexArray& points = *orgPointSet->vertices();
+    const int numPoints = points.size();
+    const SgColorArray* colors = orgPointSet->colors();
+    const SgIndexArray& colorIndices = orgPointSet->colorIndices();
+    const bool hasColorIndices = !colorIndices.empty();
+
+    if(voxelGrid.hasColors() && colors && static_cast<int>(hasColorIndices ? colorIndices.size() : colors->size()) == numPoints){
+        for(size_t i=0; i < indices.size(); ++i){
+            const int index = indices[i];
+            voxelGrid.removePoint(points[index], (*colors)[hasColorIndices ? colorIndices[index] : index]);
         }
-        if(orgPointSet->hasColors()){
-            SgColorArray& colors = *mesh->setColors(orgPointSet->colors());
-            const int m = colors.size();
-            const SgIndexArray& orgColorIndices = orgPointSet->colorIndices();
-            SgIndexArray& colorIndices = mesh->colorIndices();
-            if(orgColorIndices.empty()){
-                colorIndices.reserve(m * 36);
-                for(int i=0; i < m; ++i){
-                    for(int j=0; j < 36; ++j){
-                        colorIndices.push_back(i);
-                    }
-                }
-            } else {
-                const int l = orgColorIndices.size();
-                colorIndices.reserve(l * 36);
-                for(int i=0; i < l; ++i){
-                    const int index = orgColorIndices[l];
-                    for(int j=0; j < 36; ++j){
-                        colorIndices.push_back(index);
-                    }
-                }
-            }
+    } else {
+        for(size_t i=0; i < indices.size(); ++i){
+            voxelGrid.removePoint(points[indices[i]]);
         }
     }
-    voxels->setMesh(mesh);
 }
 
 
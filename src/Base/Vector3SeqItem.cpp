@@ -5,6 +5,7 @@
 
 #include "Vector3SeqItem.h"
 #include "ItemManager.h"
+#include <cnoid/BinarySeqFile>
 #include "gettext.h"
 
 using namespace cnoid;
@@ -12,6 +13,16 @@ using namespace cnoid;
 void Vector3SeqItem::initializeClass(ExtensionManager* ext)
 {
     ext->itemManager().registerClass<Vector3SeqItem>(N_("Vector3SeqItem"));
+
+    ext->itemManager().addLoaderAndSaver<Vector3SeqItem>(
+        _("Binary Format of a Vector3 Sequence"), "BINARY-VECTOR3-SEQ", "bseq",
+        [](Vector3SeqItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return loadSeqFromBinaryFile(item->seq().get(), filename, os);
+        },
+        [](Vector3SeqItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return saveSeqAsBinaryFile(item->seq().get(), filename, os);
+        },
+        ItemManager::PRIORITY_OPTIONAL);
 }
 
 
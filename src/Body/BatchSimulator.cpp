@@ -0,0 +1,1145 @@
+/**
+   \file
+   \brief Implementations of the BatchSimulator class
+*/
+
+#include "BatchSimulator.h"
+#include "DyWorld.h"
+#include "DyBody.h"
+#include "ForwardDynamicsCBM.h"
+#include "ConstraintForceSolver.h"
+#include "MaterialTable.h"
+#include "BodyLoader.h"
+#include "BodyMotion.h"
+#include "SimpleController.h"
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/YAMLReader>
+#include <cnoid/EigenArchive>
+#include <cnoid/ExecutablePath>
+#include <cnoid/FileUtil>
+#include <cnoid/ConnectionSet>
+#include <cnoid/NullOut>
+#include <cnoid/Config>
+#include <boost/dynamic_bitset.hpp>
+#include <boost/format.hpp>
+#include <iostream>
+#include <map>
+#include <cstdlib>
+#include "gettext.h"
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <dlfcn.h>
+#endif
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+const double DEFAULT_GRAVITY_ACCELERATION = 9.80665;
+
+#ifdef _WIN32
+typedef HINSTANCE DllHandle;
+inline DllHandle loadDll(const char* filename) { return LoadLibrary(filename); }
+inline void* resolveDllSymbol(DllHandle handle, const char* symbol) { return GetProcAddress(handle, symbol); }
+inline void unloadDll(DllHandle handle) { FreeLibrary(handle); }
+#else
+typedef void* DllHandle;
+inline DllHandle loadDll(const char* filename) { return dlopen(filename, RTLD_LAZY); }
+inline void* resolveDllSymbol(DllHandle handle, const char* symbol) { return dlsym(handle, symbol); }
+inline void unloadDll(DllHandle handle) { dlclose(handle); }
+#endif
+
+enum {
+    INPUT_JOINT_DISPLACEMENT = 0,
+    INPUT_JOINT_FORCE = 1,
+    INPUT_JOINT_VELOCITY = 2,
+    INPUT_JOINT_ACCELERATION = 3,
+    INPUT_LINK_POSITION = 4,
+    INPUT_NONE = 5
+};
+
+int getInputStateTypeIndex(int type)
+{
+    switch(type){
+    case SimpleControllerIO::JOINT_DISPLACEMENT: return INPUT_JOINT_DISPLACEMENT;
+    case SimpleControllerIO::JOINT_VELOCITY:     return INPUT_JOINT_VELOCITY;
+    case SimpleControllerIO::JOINT_ACCELERATION: return INPUT_JOINT_ACCELERATION;
+    case SimpleControllerIO::JOINT_FORCE:        return INPUT_JOINT_FORCE;
+    case SimpleControllerIO::LINK_POSITION:      return INPUT_LINK_POSITION;
+    default:
+        return INPUT_NONE;
+    }
+}
+
+/**
+   The states of a simulation body are exchanged with its controllers through the io body
+   in the same way as SimpleControllerItem.
+*/
+class BatchControllerIO : public SimulationSimpleControllerIO
+{
+public:
+    BatchSimulatorImpl* simImpl;
+    SimpleController* controller;
+    DllHandle dll;
+    DyBody* simulationBody;
+    BodyPtr ioBody;
+    string optionString_;
+    bool isNoDelayMode_;
+    bool isActive;
+
+    vector<int> linkIndexToInputStateTypeMap;
+    vector<int> inputLinkIndices;
+    vector<int> inputStateTypes;
+    vector<bool> outputLinkFlags;
+    vector<int> outputLinkIndices;
+
+    boost::dynamic_bitset<> inputEnabledDeviceFlag;
+    boost::dynamic_bitset<> inputDeviceStateChangeFlag;
+    boost::dynamic_bitset<> outputDeviceStateChangeFlag;
+    ScopedConnectionSet inputDeviceStateConnections;
+    ScopedConnectionSet outputDeviceStateConnections;
+
+    BatchControllerIO(BatchSimulatorImpl* simImpl, DyBody* body, SimpleController* controller, DllHandle dll)
+        : simImpl(simImpl), controller(controller), dll(dll), simulationBody(body) {
+        isNoDelayMode_ = false;
+        isActive = true;
+    }
+
+    ~BatchControllerIO() {
+        inputDeviceStateConnections.disconnect();
+        outputDeviceStateConnections.disconnect();
+        delete controller;
+        if(dll){
+            unloadDll(dll);
+        }
+    }
+
+    bool initialize();
+    void updateIOStateTypes();
+    void input();
+    void output();
+
+    virtual Body* body() override { return ioBody; }
+    virtual std::string optionString() const override;
+    virtual std::ostream& os() const override;
+    virtual double timeStep() const override;
+    virtual double currentTime() const override;
+    virtual bool isNoDelayMode() const override { return isNoDelayMode_; }
+    virtual bool setNoDelayMode(bool on) override { isNoDelayMode_ = on; return on; }
+    virtual bool isImmediateMode() const override { return isNoDelayMode_; }
+    virtual void setImmediateMode(bool on) override { isNoDelayMode_ = on; }
+    virtual void enableIO(Link* link) override;
+    virtual void enableInput(Link* link) override;
+    virtual void enableInput(Link* link, int stateTypes) override;
+    virtual void enableInput(Device* device) override;
+    virtual void enableOutput(Link* link) override;
+    virtual void setLinkInput(Link* link, int stateTypes) override;
+    virtual void setJointInput(int stateTypes) override;
+    virtual void setLinkOutput(Link* link, int stateTypes) override;
+    virtual void setJointOutput(int stateTypes) override;
+};
+
+typedef std::shared_ptr<BatchControllerIO> BatchControllerIOPtr;
+
+}
+
+namespace cnoid {
+
+class BatchSimulatorImpl
+{
+public:
+    BatchSimulator* self;
+    ostream* os;
+    World<ConstraintForceSolver> world;
+    vector<DyBodyPtr> bodies;
+    vector<bool> selfCollisionDetectionFlags;
+    vector<std::shared_ptr<ForwardDynamicsCBM>> highGainDynamicsList;
+    vector<BatchControllerIOPtr> controllers;
+    vector<BodyMotion> motions;
+    double timeStep;
+    double timeLength;
+    bool isActiveControlPeriodOnly;
+    Vector3 gravity;
+    int integrationMode;
+    string materialTableFile;
+    string collisionDetectorName;
+    bool isCollisionBroadphaseEnabled;
+    string simulatorOptionString;
+    double recordingFrameRate;
+    bool isAllLinkPositionRecordingEnabled;
+    int recordingInterval;
+    int currentFrame;
+    int maxFrame;
+    bool isSimulatorItemRead;
+    double timeBarMaxTime;
+
+    BatchSimulatorImpl(BatchSimulator* self);
+    bool loadProject(const std::string& filename);
+    bool readItem(Mapping* item, const filesystem::path& projectDir, int bodyIndex);
+    string expandPath(const string& path, const filesystem::path& projectDir, bool doResolveRelativePath = true);
+    bool addController(int bodyIndex, const std::string& moduleFilename, const std::string& options);
+    void addController(int bodyIndex, SimpleController* controller, DllHandle dll, const std::string& options);
+    bool initialize();
+    void setupBody(DyBody* body, int bodyIndex);
+    void recordFrame();
+    bool step();
+};
+
+}
+
+
+BatchSimulator::BatchSimulator()
+{
+    impl = new BatchSimulatorImpl(this);
+}
+
+
+BatchSimulatorImpl::BatchSimulatorImpl(BatchSimulator* self)
+    : self(self)
+{
+    os = &nullout();
+    timeStep = 0.001;
+    timeLength = -1.0;
+    isActiveControlPeriodOnly = false;
+    gravity << 0.0, 0.0, -DEFAULT_GRAVITY_ACCELERATION;
+    integrationMode = BatchSimulator::RUNGE_KUTTA_INTEGRATION;
+    materialTableFile = (filesystem::path(shareDirectory()) / "default" / "materials.yaml").string();
+    collisionDetectorName = "AISTCollisionDetector";
+    isCollisionBroadphaseEnabled = false;
+    recordingFrameRate = 0.0;
+    isAllLinkPositionRecordingEnabled = false;
+    currentFrame = 0;
+    maxFrame = 0;
+    isSimulatorItemRead = false;
+    timeBarMaxTime = -1.0;
+}
+
+
+BatchSimulator::~BatchSimulator()
+{
+    delete impl;
+}
+
+
+void BatchSimulator::setMessageOutput(std::ostream& os)
+{
+    impl->os = &os;
+}
+
+
+std::ostream& BatchSimulator::os() const
+{
+    return *impl->os;
+}
+
+
+bool BatchSimulator::loadProject(const std::string& filename)
+{
+    return impl->loadProject(filename);
+}
+
+
+bool BatchSimulatorImpl::loadProject(const std::string& filename)
+{
+    YAMLReader reader;
+    try {
+        reader.load(filename);
+    } catch(const ValueNode::Exception& ex){
+        (*os) << ex.message() << endl;
+        return false;
+    }
+    if(reader.numDocuments() == 0){
+        return false;
+    }
+    Mapping* archive = reader.document()->toMapping();
+
+    timeBarMaxTime = -1.0;
+    Mapping* timeBar = archive->findMapping("toolbars")->findMapping("TimeBar");
+    if(timeBar->isValid()){
+        double frameRate;
+        if(timeBar->read("frameRate", frameRate) && frameRate > 0.0){
+            timeStep = 1.0 / frameRate;
+        }
+        timeBar->read("maxTime", timeBarMaxTime);
+    }
+
+    filesystem::path projectDir(filesystem::absolute(filesystem::path(filename)).parent_path());
+    isSimulatorItemRead = false;
+    Mapping* items = archive->findMapping("items");
+    if(!items->isValid()){
+        (*os) << format(_("%1% does not contain any item.")) % filename << endl;
+        return false;
+    }
+    if(!readItem(items, projectDir, -1)){
+        return false;
+    }
+
+    return !bodies.empty();
+}
+
+
+bool BatchSimulatorImpl::readItem(Mapping* item, const filesystem::path& projectDir, int bodyIndex)
+{
+    string className = item->get("class", "");
+    const string name = item->get("name", "");
+    Mapping* data = item->findMapping("data");
+
+    if(className == "WorldItem"){
+        data->read("collisionDetector", collisionDetectorName);
+        string file;
+        if(data->read("materialTableFile", file)){
+            materialTableFile = expandPath(file, projectDir);
+        }
+
+    } else if(className == "BodyItem"){
+        string modelFile;
+        if(data->read("modelFile", modelFile)){
+            BodyLoader loader;
+            loader.setMessageSink(*os);
+            BodyPtr body = loader.load(expandPath(modelFile, projectDir));
+            if(!body){
+                (*os) << format(_("The model of %1% cannot be loaded.")) % name << endl;
+            } else {
+                body->setName(name);
+                Link* rootLink = body->rootLink();
+                Vector3 p;
+                Matrix3 R;
+                if(read(*data, "initialRootPosition", p) && read(*data, "initialRootAttitude", R)){
+                    rootLink->p() = p;
+                    rootLink->R() = R;
+                } else {
+                    if(read(*data, "rootPosition", p)){
+                        rootLink->p() = p;
+                    }
+                    if(read(*data, "rootAttitude", R)){
+                        rootLink->R() = R;
+                    }
+                }
+                Listing* qs = data->findListing("initialJointPositions");
+                if(!qs->isValid()){
+                    qs = data->findListing("jointPositions");
+                }
+                if(qs->isValid()){
+                    const int nj = std::min(qs->size(), body->numAllJoints());
+                    for(int i=0; i < nj; ++i){
+                        body->joint(i)->q() = (*qs)[i].toDouble();
+                    }
+                }
+                body->calcForwardKinematics();
+                bodyIndex = self->addBody(body, data->get("selfCollisionDetection", false));
+            }
+        }
+
+    } else if(className == "SimpleControllerItem"){
+        string module;
+        if(bodyIndex >= 0 && data->read("controller", module)){
+            filesystem::path modulePath(expandPath(module, projectDir, false));
+            if(!modulePath.is_absolute()){
+                string baseDirectory = data->get("baseDirectory", data->get("RelativePathBase", "Controller directory"));
+                if(baseDirectory == "Controller directory"){
+                    modulePath = filesystem::path(executableTopDirectory()) / CNOID_PLUGIN_SUBDIR / "simplecontroller" / modulePath;
+                } else if(baseDirectory == "Project directory"){
+                    modulePath = projectDir / modulePath;
+                }
+            }
+            if(!modulePath.has_extension()){
+                modulePath += DLL_SUFFIX;
+            }
+            if(!addController(bodyIndex, modulePath.make_preferred().string(), data->get("controllerOptions", ""))){
+                return false;
+            }
+            bool on;
+            if(data->read("isNoDelayMode", on) || data->read("isImmediateMode", on)){
+                controllers.back()->isNoDelayMode_ = on;
+            }
+        }
+
+    } else if(className == "AISTSimulatorItem" && !isSimulatorItemRead){
+        // The other simulator items are alternatives of the first one
+        isSimulatorItemRead = true;
+        string symbol;
+        if(data->read("timestep", symbol)){
+            timeStep = std::stod(symbol);
+        } else {
+            double frameRate;
+            if(data->read("framerate", frameRate) && frameRate > 0.0){
+                timeStep = 1.0 / frameRate;
+            }
+        }
+        isActiveControlPeriodOnly = false;
+        timeLength = -1.0;
+        if(data->get("onlyActiveControlPeriod", false)){
+            isActiveControlPeriodOnly = true;
+        } else if(data->read("timeRangeMode", symbol)){
+            if(symbol == "Active control period"){
+                isActiveControlPeriodOnly = true;
+            } else if(symbol == "Specified time" || symbol == "Specified period"){
+                timeLength = data->get("timeLength", 180.0);
+            } else if(symbol == "Time bar range" || symbol == "TimeBar range"){
+                if(timeBarMaxTime > 0.0){
+                    timeLength = timeBarMaxTime;
+                }
+            }
+        }
+        isAllLinkPositionRecordingEnabled = data->get("allLinkPositionOutputMode", isAllLinkPositionRecordingEnabled);
+        if(data->read("integrationMode", symbol)){
+            integrationMode = (symbol == "Euler") ?
+                BatchSimulator::EULER_INTEGRATION : BatchSimulator::RUNGE_KUTTA_INTEGRATION;
+        }
+        read(*data, "gravity", gravity);
+
+        ConstraintForceSolver& cfs = world.constraintForceSolver;
+        double staticFriction = data->get("staticFriction", cfs.staticFriction());
+        double dynamicFriction = data->get("dynamicFriction", data->get("slipFriction", cfs.slipFriction()));
+        cfs.setFriction(staticFriction, dynamicFriction);
+        cfs.setContactCullingDistance(data->get("cullingThresh", cfs.contactCullingDistance()));
+        cfs.setContactCullingDepth(data->get("contactCullingDepth", cfs.contactCullingDepth()));
+        cfs.setCoefficientOfRestitution(data->get("epsilon", cfs.coefficientOfRestitution()));
+        cfs.setGaussSeidelErrorCriterion(data->get("errorCriterion", cfs.gaussSeidelErrorCriterion()));
+        cfs.setGaussSeidelMaxNumIterations(data->get("maxNumIterations", cfs.gaussSeidelMaxNumIterations()));
+        cfs.setContactDepthCorrection(
+            data->get("contactCorrectionDepth", cfs.contactCorrectionDepth()),
+            data->get("contactCorrectionVelocityRatio", cfs.contactCorrectionVelocityRatio()));
+        cfs.setIslandDecompositionEnabled(data->get("contactIslands", cfs.isIslandDecompositionEnabled()));
+        cfs.setSparseGaussSeidelEnabled(data->get("sparseGaussSeidel", cfs.isSparseGaussSeidelEnabled()));
+        cfs.set2Dmode(data->get("2Dmode", false));
+        data->read("collisionBroadphase", isCollisionBroadphaseEnabled);
+        data->read("controllerOptions", simulatorOptionString);
+    }
+
+    Listing* children = item->findListing("children");
+    if(children->isValid()){
+        for(int i=0; i < children->size(); ++i){
+            Mapping* child = children->at(i)->toMapping();
+            if(!readItem(child, projectDir, bodyIndex)){
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+string BatchSimulatorImpl::expandPath(const string& path, const filesystem::path& projectDir, bool doResolveRelativePath)
+{
+    string expanded = path;
+    const char* home = getenv("HOME");
+    const pair<string, string> variables[] = {
+        { "${SHARE}", shareDirectory() },
+        { "${PROGRAM_TOP}", executableTopDirectory() },
+        { "${HOME}", home ? home : "" },
+        { "${PROJECT_DIR}", projectDir.string() }
+    };
+    for(auto& var : variables){
+        if(expanded.compare(0, var.first.size(), var.first) == 0){
+            expanded.replace(0, var.first.size(), var.second);
+            break;
+        }
+    }
+    filesystem::path p(expanded);
+    if(doResolveRelativePath && !p.is_absolute()){
+        p = projectDir / p;
+    }
+    return getNativePathString(p);
+}
+
+
+void BatchSimulator::setTimeStep(double dt)
+{
+    impl->timeStep = dt;
+}
+
+
+double BatchSimulator::timeStep() const
+{
+    return impl->timeStep;
+}
+
+
+void BatchSimulator::setTimeLength(double length)
+{
+    impl->timeLength = length;
+}
+
+
+double BatchSimulator::timeLength() const
+{
+    return impl->timeLength;
+}
+
+
+void BatchSimulator::setActiveControlPeriodOnly(bool on)
+{
+    impl->isActiveControlPeriodOnly = on;
+}
+
+
+bool BatchSimulator::isActiveControlPeriodOnly() const
+{
+    return impl->isActiveControlPeriodOnly;
+}
+
+
+void BatchSimulator::setGravityAcceleration(const Vector3& g)
+{
+    impl->gravity = g;
+}
+
+
+void BatchSimulator::setIntegrationMode(int mode)
+{
+    impl->integrationMode = mode;
+}
+
+
+void BatchSimulator::setMaterialTableFile(const std::string& filename)
+{
+    impl->materialTableFile = filename;
+}
+
+
+void BatchSimulator::setCollisionDetector(const std::string& name)
+{
+    impl->collisionDetectorName = name;
+}
+
+
+ConstraintForceSolver& BatchSimulator::constraintForceSolver()
+{
+    return impl->world.constraintForceSolver;
+}
+
+
+int BatchSimulator::addBody(Body* body, bool isSelfCollisionDetectionEnabled)
+{
+    impl->bodies.push_back(new DyBody(*body));
+    impl->selfCollisionDetectionFlags.push_back(isSelfCollisionDetectionEnabled);
+    impl->motions.resize(impl->bodies.size());
+    return impl->bodies.size() - 1;
+}
+
+
+int BatchSimulator::numBodies() const
+{
+    return impl->bodies.size();
+}
+
+
+DyBody* BatchSimulator::body(int index)
+{
+    return impl->bodies[index];
+}
+
+
+int BatchSimulator::numControllers() const
+{
+    return impl->controllers.size();
+}
+
+
+int BatchSimulator::bodyIndex(const std::string& name) const
+{
+    for(size_t i=0; i < impl->bodies.size(); ++i){
+        if(impl->bodies[i]->name() == name){
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+bool BatchSimulator::addController(int bodyIndex, const std::string& moduleFilename, const std::string& options)
+{
+    return impl->addController(bodyIndex, moduleFilename, options);
+}
+
+
+bool BatchSimulatorImpl::addController(int bodyIndex, const std::string& moduleFilename, const std::string& options)
+{
+    DllHandle dll = loadDll(moduleFilename.c_str());
+    if(!dll){
+        (*os) << format(_("The controller module \"%1%\" cannot be loaded.")) % moduleFilename << endl;
+        return false;
+    }
+    SimpleController::Factory factory =
+        (SimpleController::Factory)resolveDllSymbol(dll, "createSimpleController");
+    if(!factory){
+        (*os) << _("The factory function \"createSimpleController()\" is not found in the controller module.") << endl;
+        unloadDll(dll);
+        return false;
+    }
+    SimpleController* controller = factory();
+    if(!controller){
+        (*os) << _("The factory failed to create a controller instance.") << endl;
+        unloadDll(dll);
+        return false;
+    }
+    addController(bodyIndex, controller, dll, options);
+    return true;
+}
+
+
+void BatchSimulator::addController(int bodyIndex, SimpleController* controller, const std::string& options)
+{
+    impl->addController(bodyIndex, controller, 0, options);
+}
+
+
+void BatchSimulatorImpl::addController
+(int bodyIndex, SimpleController* controller, DllHandle dll, const std::string& options)
+{
+    auto io = std::make_shared<BatchControllerIO>(this, bodies[bodyIndex], controller, dll);
+    io->optionString_ = options;
+    controllers.push_back(io);
+}
+
+
+void BatchSimulator::setRecordingFrameRate(double rate)
+{
+    impl->recordingFrameRate = rate;
+}
+
+
+void BatchSimulator::setAllLinkPositionRecordingEnabled(bool on)
+{
+    impl->isAllLinkPositionRecordingEnabled = on;
+}
+
+
+BodyMotion& BatchSimulator::motion(int bodyIndex)
+{
+    return impl->motions[bodyIndex];
+}
+
+
+bool BatchSimulator::saveMotions(const std::string& directory)
+{
+    filesystem::path dir(directory);
+    if(!filesystem::exists(dir)){
+        boost::system::error_code error;
+        filesystem::create_directories(dir, error);
+        if(error){
+            os() << format(_("Directory \"%1%\" cannot be created: %2%")) % directory % error.message() << endl;
+            return false;
+        }
+    }
+    bool saved = true;
+    std::map<string, int> nameCounts;
+    for(size_t i=0; i < impl->bodies.size(); ++i){
+        string name = impl->bodies[i]->name();
+        int count = nameCounts[name]++;
+        if(count > 0){
+            name = str(format("%1%-%2%") % name % count);
+        }
+        string filename = getNativePathString(dir / (name + ".seq"));
+        if(!impl->motions[i].save(filename, os())){
+            saved = false;
+        }
+    }
+    return saved;
+}
+
+
+bool BatchSimulator::initialize()
+{
+    return impl->initialize();
+}
+
+
+bool BatchSimulatorImpl::initialize()
+{
+    if(integrationMode == BatchSimulator::EULER_INTEGRATION){
+        world.setEulerMethod();
+    } else {
+        world.setRungeKuttaMethod();
+    }
+    world.setGravityAcceleration(gravity);
+    world.enableSensors(true);
+    world.setTimeStep(timeStep);
+    world.setCurrentTime(0.0);
+
+    ConstraintForceSolver& cfs = world.constraintForceSolver;
+    MaterialTablePtr materialTable = new MaterialTable;
+    if(!materialTableFile.empty()){
+        materialTable->load(materialTableFile, *os);
+    }
+    cfs.setMaterialTable(materialTable);
+
+    world.clearBodies();
+    highGainDynamicsList.clear();
+
+    for(auto& controller : controllers){
+        if(!controller->initialize()){
+            return false;
+        }
+    }
+    for(size_t i=0; i < bodies.size(); ++i){
+        setupBody(bodies[i], i);
+    }
+
+    if(collisionDetectorName == "AISTCollisionDetector"){
+        auto detector = new AISTCollisionDetector;
+        detector->setBroadphaseEnabled(isCollisionBroadphaseEnabled);
+        cfs.setCollisionDetector(detector);
+    } else {
+        int index = CollisionDetector::factoryIndex(collisionDetectorName);
+        if(index < 0){
+            (*os) << format(_("Collision detector \"%1%\" is not available.")) % collisionDetectorName << endl;
+            return false;
+        }
+        cfs.setCollisionDetector(CollisionDetector::create(index));
+    }
+    world.initialize();
+
+    for(auto& controller : controllers){
+        if(!controller->controller->start()){
+            (*os) << format(_("The controller of %1% failed to start.")) % controller->simulationBody->name() << endl;
+            return false;
+        }
+    }
+
+    recordingInterval = 0;
+    if(recordingFrameRate > 0.0){
+        recordingInterval = std::max(1, static_cast<int>(round(1.0 / (recordingFrameRate * timeStep))));
+    }
+    for(size_t i=0; i < bodies.size(); ++i){
+        BodyMotion& motion = motions[i];
+        const int numLinks = isAllLinkPositionRecordingEnabled ? bodies[i]->numLinks() : 1;
+        motion.setDimension(0, bodies[i]->numJoints(), numLinks);
+        if(recordingInterval > 0){
+            motion.setFrameRate(1.0 / (recordingInterval * timeStep));
+        }
+    }
+
+    currentFrame = 0;
+    maxFrame = (timeLength >= 0.0) ? static_cast<int>(round(timeLength / timeStep)) : std::numeric_limits<int>::max();
+
+    recordFrame();
+
+    return true;
+}
+
+
+void BatchSimulatorImpl::setupBody(DyBody* body, int bodyIndex)
+{
+    DyLink* rootLink = body->rootLink();
+    rootLink->v().setZero();
+    rootLink->dv().setZero();
+    rootLink->w().setZero();
+    rootLink->dw().setZero();
+    rootLink->vo().setZero();
+    rootLink->dvo().setZero();
+
+    bool hasHighgainJoints = false;
+
+    for(int i=0; i < body->numLinks(); ++i){
+        Link* link = body->link(i);
+        link->u() = 0.0;
+        link->dq() = 0.0;
+        link->ddq() = 0.0;
+        if(link->actuationMode() == Link::JOINT_DISPLACEMENT ||
+           link->actuationMode() == Link::JOINT_VELOCITY ||
+           link->actuationMode() == Link::LINK_POSITION){
+            hasHighgainJoints = true;
+        }
+    }
+
+    body->clearExternalForces();
+    body->calcForwardKinematics(true, true);
+
+    int index;
+    if(hasHighgainJoints){
+        auto dynamics = make_shared_aligned<ForwardDynamicsCBM>(body);
+        highGainDynamicsList.push_back(dynamics);
+        index = world.addBody(body, dynamics);
+    } else {
+        index = world.addBody(body);
+    }
+    world.constraintForceSolver.setSelfCollisionDetectionEnabled(index, selfCollisionDetectionFlags[bodyIndex]);
+}
+
+
+void BatchSimulatorImpl::recordFrame()
+{
+    if(recordingInterval == 0 || (currentFrame % recordingInterval) != 0){
+        return;
+    }
+    for(size_t i=0; i < bodies.size(); ++i){
+        DyBody* body = bodies[i];
+        BodyMotion& motion = motions[i];
+        auto q = motion.jointPosSeq()->appendFrame();
+        const int nj = body->numJoints();
+        for(int j=0; j < nj; ++j){
+            q[j] = body->joint(j)->q();
+        }
+        auto T = motion.linkPosSeq()->appendFrame();
+        const int nl = motion.numLinks();
+        for(int j=0; j < nl; ++j){
+            Link* link = body->link(j);
+            T[j].set(link->p(), link->R());
+        }
+    }
+}
+
+
+bool BatchSimulator::step()
+{
+    return impl->step();
+}
+
+
+bool BatchSimulatorImpl::step()
+{
+    if(currentFrame >= maxFrame){
+        return false;
+    }
+
+    bool doContinue = !isActiveControlPeriodOnly || controllers.empty();
+
+    world.constraintForceSolver.clearExternalForces();
+
+    for(auto& io : controllers){
+        if(io->isActive){
+            io->input();
+            io->isActive = io->controller->control();
+            doContinue |= io->isActive;
+            if(io->isNoDelayMode_){
+                io->output();
+            }
+        }
+    }
+
+    for(auto& dynamics : highGainDynamicsList){
+        dynamics->complementHighGainModeCommandValues();
+    }
+    world.calcNextState();
+
+    for(auto& io : controllers){
+        if(!io->isNoDelayMode_){
+            io->output();
+        }
+    }
+
+    ++currentFrame;
+    recordFrame();
+
+    return doContinue && currentFrame < maxFrame;
+}
+
+
+int BatchSimulator::run(int maxNumFrames)
+{
+    const int startFrame = impl->currentFrame;
+    while(maxNumFrames < 0 || impl->currentFrame - startFrame < maxNumFrames){
+        if(!impl->step()){
+            break;
+        }
+    }
+    return impl->currentFrame - startFrame;
+}
+
+
+double BatchSimulator::currentTime() const
+{
+    return impl->world.currentTime();
+}
+
+
+int BatchSimulator::currentFrame() const
+{
+    return impl->currentFrame;
+}
+
+
+bool BatchControllerIO::initialize()
+{
+    ioBody = simulationBody->clone();
+
+    const DeviceList<>& ioDevices = ioBody->devices();
+    outputDeviceStateChangeFlag.resize(ioDevices.size());
+    outputDeviceStateChangeFlag.reset();
+    outputDeviceStateConnections.disconnect();
+    for(size_t i=0; i < ioDevices.size(); ++i){
+        outputDeviceStateConnections.add(
+            ioDevices[i]->sigStateChanged().connect(
+                [this, i](){ outputDeviceStateChangeFlag.set(i); }));
+    }
+    inputEnabledDeviceFlag.resize(simulationBody->numDevices());
+    inputEnabledDeviceFlag.reset();
+
+    if(!controller->initialize(this)){
+        os() << format(_("The controller of %1% failed to initialize.")) % simulationBody->name() << endl;
+        return false;
+    }
+
+    updateIOStateTypes();
+
+    const DeviceList<>& devices = simulationBody->devices();
+    inputDeviceStateChangeFlag.resize(devices.size());
+    inputDeviceStateChangeFlag.reset();
+    inputDeviceStateConnections.disconnect();
+    for(size_t i=0; i < devices.size(); ++i){
+        if(inputEnabledDeviceFlag[i]){
+            inputDeviceStateConnections.add(
+                devices[i]->sigStateChanged().connect(
+                    [this, i](){ inputDeviceStateChangeFlag.set(i); }));
+        } else {
+            inputDeviceStateConnections.add(Connection());
+        }
+    }
+
+    return true;
+}
+
+
+void BatchControllerIO::updateIOStateTypes()
+{
+    inputLinkIndices.clear();
+    inputStateTypes.clear();
+    for(size_t i=0; i < linkIndexToInputStateTypeMap.size(); ++i){
+        bitset<5> types(linkIndexToInputStateTypeMap[i]);
+        if(types.any()){
+            inputLinkIndices.push_back(i);
+            inputStateTypes.push_back(types.count());
+            for(int j=0; j < 5; ++j){
+                if(types.test(j)){
+                    inputStateTypes.push_back(getInputStateTypeIndex(1 << j));
+                }
+            }
+        }
+    }
+
+    outputLinkIndices.clear();
+    for(size_t i=0; i < outputLinkFlags.size(); ++i){
+        if(outputLinkFlags[i]){
+            outputLinkIndices.push_back(i);
+            simulationBody->link(i)->setActuationMode(ioBody->link(i)->actuationMode());
+        }
+    }
+}
+
+
+std::string BatchControllerIO::optionString() const
+{
+    const string& opt1 = simImpl->simulatorOptionString;
+    if(opt1.empty()){
+        return optionString_;
+    } else if(optionString_.empty()){
+        return opt1;
+    }
+    return opt1 + " " + optionString_;
+}
+
+
+std::ostream& BatchControllerIO::os() const
+{
+    return *simImpl->os;
+}
+
+
+double BatchControllerIO::timeStep() const
+{
+    return simImpl->timeStep;
+}
+
+
+double BatchControllerIO::currentTime() const
+{
+    return simImpl->world.currentTime();
+}
+
+
+void BatchControllerIO::enableIO(Link* link)
+{
+    enableInput(link);
+    enableOutput(link);
+}
+
+
+void BatchControllerIO::enableInput(Link* link)
+{
+    int defaultInputStateTypes = 0;
+
+    switch(link->actuationMode()){
+    case Link::JOINT_EFFORT:
+    case Link::JOINT_SURFACE_VELOCITY:
+        defaultInputStateTypes = SimpleControllerIO::JOINT_ANGLE;
+        break;
+    case Link::JOINT_DISPLACEMENT:
+    case Link::JOINT_VELOCITY:
+        defaultInputStateTypes = SimpleControllerIO::JOINT_ANGLE | SimpleControllerIO::JOINT_TORQUE;
+        break;
+    case Link::LINK_POSITION:
+        defaultInputStateTypes = SimpleControllerIO::LINK_POSITION;
+        break;
+    default:
+        break;
+    }
+
+    enableInput(link, defaultInputStateTypes);
+}
+
+
+void BatchControllerIO::enableInput(Link* link, int stateTypes)
+{
+    if(link->index() >= static_cast<int>(linkIndexToInputStateTypeMap.size())){
+        linkIndexToInputStateTypeMap.resize(link->index() + 1, 0);
+    }
+    linkIndexToInputStateTypeMap[link->index()] |= stateTypes;
+}
+
+
+void BatchControllerIO::enableInput(Device* device)
+{
+    inputEnabledDeviceFlag.set(device->index());
+}
+
+
+void BatchControllerIO::enableOutput(Link* link)
+{
+    int index = link->index();
+    if(static_cast<int>(outputLinkFlags.size()) <= index){
+        outputLinkFlags.resize(index + 1, false);
+    }
+    outputLinkFlags[index] = true;
+}
+
+
+void BatchControllerIO::setLinkInput(Link* link, int stateTypes)
+{
+    enableInput(link, stateTypes);
+}
+
+
+void BatchControllerIO::setJointInput(int stateTypes)
+{
+    for(Link* joint : ioBody->joints()){
+        setLinkInput(joint, stateTypes);
+    }
+}
+
+
+void BatchControllerIO::setLinkOutput(Link* link, int stateTypes)
+{
+    Link::ActuationMode mode = Link::NO_ACTUATION;
+
+    if(stateTypes & SimpleControllerIO::LINK_POSITION){
+        mode = Link::LINK_POSITION;
+    } else if(stateTypes & SimpleControllerIO::JOINT_DISPLACEMENT){
+        mode = Link::JOINT_DISPLACEMENT;
+    } else if(stateTypes & SimpleControllerIO::JOINT_VELOCITY){
+        mode = Link::JOINT_VELOCITY;
+    } else if(stateTypes & SimpleControllerIO::JOINT_EFFORT){
+        mode = Link::JOINT_EFFORT;
+    }
+
+    if(mode != Link::NO_ACTUATION){
+        link->setActuationMode(mode);
+        enableOutput(link);
+    }
+}
+
+
+void BatchControllerIO::setJointOutput(int stateTypes)
+{
+    const int nj = ioBody->numJoints();
+    for(int i=0; i < nj; ++i){
+        setLinkOutput(ioBody->joint(i), stateTypes);
+    }
+}
+
+
+void BatchControllerIO::input()
+{
+    int typeArrayIndex = 0;
+    for(size_t i=0; i < inputLinkIndices.size(); ++i){
+        const int linkIndex = inputLinkIndices[i];
+        const Link* simLink = simulationBody->link(linkIndex);
+        Link* ioLink = ioBody->link(linkIndex);
+        const int n = inputStateTypes[typeArrayIndex++];
+        for(int j=0; j < n; ++j){
+            switch(inputStateTypes[typeArrayIndex++]){
+            case INPUT_JOINT_DISPLACEMENT:
+                ioLink->q() = simLink->q();
+                break;
+            case INPUT_JOINT_FORCE:
+                ioLink->u() = simLink->u();
+                break;
+            case INPUT_LINK_POSITION:
+                ioLink->T() = simLink->T();
+                break;
+            case INPUT_JOINT_VELOCITY:
+                ioLink->dq() = simLink->dq();
+                break;
+            case INPUT_JOINT_ACCELERATION:
+                ioLink->ddq() = simLink->ddq();
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    if(inputDeviceStateChangeFlag.any()){
+        const DeviceList<>& devices = simulationBody->devices();
+        const DeviceList<>& ioDevices = ioBody->devices();
+        auto i = inputDeviceStateChangeFlag.find_first();
+        while(i != inputDeviceStateChangeFlag.npos){
+            Device* ioDevice = ioDevices[i];
+            ioDevice->copyStateFrom(*devices[i]);
+            outputDeviceStateConnections.block(i);
+            ioDevice->notifyStateChange();
+            outputDeviceStateConnections.unblock(i);
+            i = inputDeviceStateChangeFlag.find_next(i);
+        }
+        inputDeviceStateChangeFlag.reset();
+    }
+}
+
+
+void BatchControllerIO::output()
+{
+    for(size_t i=0; i < outputLinkIndices.size(); ++i){
+        const int index = outputLinkIndices[i];
+        const Link* ioLink = ioBody->link(index);
+        Link* simLink = simulationBody->link(index);
+        switch(ioLink->actuationMode()){
+        case Link::JOINT_EFFORT:
+            simLink->u() = ioLink->u();
+            break;
+        case Link::JOINT_DISPLACEMENT:
+            simLink->q() = ioLink->q();
+            break;
+        case Link::JOINT_VELOCITY:
+        case Link::JOINT_SURFACE_VELOCITY:
+            simLink->dq() = ioLink->dq();
+            break;
+        case Link::LINK_POSITION:
+            simLink->T() = ioLink->T();
+            break;
+        default:
+            break;
+        }
+    }
+
+    if(outputDeviceStateChangeFlag.any()){
+        const DeviceList<>& devices = simulationBody->devices();
+        const DeviceList<>& ioDevices = ioBody->devices();
+        auto i = outputDeviceStateChangeFlag.find_first();
+        while(i != outputDeviceStateChangeFlag.npos){
+            Device* device = devices[i];
+            device->copyStateFrom(*ioDevices[i]);
+            inputDeviceStateConnections.block(i);
+            device->notifyStateChange();
+            inputDeviceStateConnections.unblock(i);
+            i = outputDeviceStateChangeFlag.find_next(i);
+        }
+        outputDeviceStateChangeFlag.reset();
+    }
+}
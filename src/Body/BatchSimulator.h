@@ -0,0 +1,111 @@
+/**
+   \file
+   \brief The header file of the BatchSimulator class
+*/
+
+#ifndef CNOID_BODY_BATCH_SIMULATOR_H
+#define CNOID_BODY_BATCH_SIMULATOR_H
+
+#include <cnoid/EigenTypes>
+#include <string>
+#include <iosfwd>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+class DyBody;
+class BodyMotion;
+class SimpleController;
+class ConstraintForceSolver;
+class BatchSimulatorImpl;
+
+/**
+   This class runs a simulation with the AIST dynamics engine and simple controllers
+   without the GUI framework. A simulation is set up by loading a project file or by adding
+   bodies and controllers directly, and the motions of the bodies are recorded in the
+   BodyMotion objects.
+   The instances do not share any state, so they can be run concurrently in separate threads.
+*/
+class CNOID_EXPORT BatchSimulator
+{
+public:
+    BatchSimulator();
+    ~BatchSimulator();
+
+    void setMessageOutput(std::ostream& os);
+    std::ostream& os() const;
+
+    /**
+       This function reads the world, body, simple controller and AIST simulator items
+       in a project file. The other items are ignored, and only the first simulator item
+       is used when the project has several ones.
+    */
+    bool loadProject(const std::string& filename);
+
+    enum IntegrationMode { EULER_INTEGRATION, RUNGE_KUTTA_INTEGRATION };
+
+    void setTimeStep(double dt);
+    double timeStep() const;
+
+    //! A negative value means that the simulation is not limited by the time.
+    void setTimeLength(double length);
+    double timeLength() const;
+
+    //! The simulation is finished when all the controllers become inactive.
+    void setActiveControlPeriodOnly(bool on);
+    bool isActiveControlPeriodOnly() const;
+
+    void setGravityAcceleration(const Vector3& g);
+    void setIntegrationMode(int mode);
+    void setMaterialTableFile(const std::string& filename);
+
+    //! The name is that of a registered collision detector. "AISTCollisionDetector" is used by default.
+    void setCollisionDetector(const std::string& name);
+
+    ConstraintForceSolver& constraintForceSolver();
+
+    //! The body is copied into the simulation
+    int addBody(Body* body, bool isSelfCollisionDetectionEnabled = false);
+    int numBodies() const;
+    DyBody* body(int index);
+    int bodyIndex(const std::string& name) const;
+
+    bool addController(int bodyIndex, const std::string& moduleFilename, const std::string& options = std::string());
+
+    //! The controller is deleted by the simulator
+    void addController(int bodyIndex, SimpleController* controller, const std::string& options = std::string());
+    int numControllers() const;
+
+    //! The motions are not recorded when the rate is zero.
+    void setRecordingFrameRate(double rate);
+    void setAllLinkPositionRecordingEnabled(bool on);
+    BodyMotion& motion(int bodyIndex);
+
+    /**
+       Each motion is saved as "<body name>.seq" in the directory.
+       A number is appended to the name when the bodies have the same name.
+    */
+    bool saveMotions(const std::string& directory);
+
+    bool initialize();
+
+    //! This returns false when the simulation is finished.
+    bool step();
+
+    //! This returns the number of the simulated frames.
+    int run(int maxNumFrames = -1);
+
+    double currentTime() const;
+    int currentFrame() const;
+
+private:
+    BatchSimulatorImpl* impl;
+
+    BatchSimulator(const BatchSimulator&) = delete;
+    BatchSimulator& operator=(const BatchSimulator&) = delete;
+};
+
+}
+
+#endif
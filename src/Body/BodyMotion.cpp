@@ -8,6 +8,7 @@
 #include "Link.h"
 #include "ZMPSeq.h"
 #include <cnoid/Vector3Seq>
+#include <cnoid/MultiVector3Seq>
 #include <cnoid/YAMLReader>
 #include <cnoid/YAMLWriter>
 #include <boost/format.hpp>
@@ -286,6 +287,7 @@ bool BodyMotion::load(const std::string& filename, std::ostream& os)
 {
     YAMLReader reader;
     reader.expectRegularMultiListing();
+    reader.packNumberListings("frames");
     bool result = false;
 
     try {
@@ -471,3 +473,90 @@ bool BodyMotion::save(const std::string& filename, double version, std::ostream&
 
     return writeSeq(writer);
 }
+
+
+bool BodyMotion::loadBinaryFormat(const std::string& filename, std::ostream& os)
+{
+    BinarySeqReader reader;
+    if(!reader.open(filename, os)){
+        return false;
+    }
+    if(reader.type() != seqType() || reader.contentName() != seqContentName()){
+        os << format(_("\"%1%\" is not a body motion file.")) % filename << endl;
+        return false;
+    }
+
+    setDimension(0, 1, 1);
+
+    bool loaded = false;
+
+    for(int i=0; i < reader.numSeqs(); ++i){
+        const string& type = reader.seqType(i);
+        const string& content = reader.seqContentName(i);
+        if(type == "MultiSE3Seq" && content == "LinkPosition"){
+            loaded = reader.readSeq(i, linkPosSeq_.get());
+        } else if(type == "MultiValueSeq" && content == "JointDisplacement"){
+            loaded = reader.readSeq(i, jointPosSeq_.get());
+        } else if(type == "Vector3Seq"){
+            if(content == ZMPSeq::key()){
+                loaded = reader.readSeq(i, getOrCreateExtraSeq<ZMPSeq>(content).get());
+            } else {
+                loaded = reader.readSeq(i, getOrCreateExtraSeq<Vector3Seq>(content).get());
+            }
+        } else if(type == "MultiValueSeq"){
+            loaded = reader.readSeq(i, getOrCreateExtraSeq<MultiValueSeq>(content).get());
+        } else if(type == "MultiSE3Seq"){
+            loaded = reader.readSeq(i, getOrCreateExtraSeq<MultiSE3Seq>(content).get());
+        } else if(type == "MultiVector3Seq"){
+            loaded = reader.readSeq(i, getOrCreateExtraSeq<MultiVector3Seq>(content).get());
+        } else {
+            os << (format(_("Unknown content \"%1%\" of type \"%2%\".")) % content % type) << endl;
+            continue;
+        }
+        if(!loaded){
+            break;
+        }
+    }
+
+    if(!loaded){
+        setDimension(0, 1, 1);
+    }
+
+    return loaded;
+}
+
+
+bool BodyMotion::saveAsBinaryFormat
+(const std::string& filename, std::ostream& os, BinarySeqWriter::ElementType elementType, BinarySeqWriter::Layout layout)
+{
+    BinarySeqWriter writer;
+    writer.setElementType(elementType);
+    writer.setLayout(layout);
+
+    if(!writer.open(filename, seqType(), seqContentName(), os)){
+        return false;
+    }
+    if(linkPosSeq_->numFrames() > 0){
+        if(!writer.writeSeq(linkPosSeq_.get())){
+            return false;
+        }
+    }
+    if(jointPosSeq_->numFrames() > 0){
+        if(!writer.writeSeq(jointPosSeq_.get())){
+            return false;
+        }
+    }
+    for(ExtraSeqMap::iterator p = extraSeqs.begin(); p != extraSeqs.end(); ++p){
+        AbstractSeq* seq = p->second.get();
+        if(BinarySeqWriter::isSupportedSeq(seq)){
+            if(!writer.writeSeq(seq)){
+                return false;
+            }
+        } else {
+            os << format(_("The extra seq \"%1%\" is not saved because its type \"%2%\" is not supported by the binary format."))
+                % p->first % seq->seqType() << endl;
+        }
+    }
+
+    return writer.close();
+}
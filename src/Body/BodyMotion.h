@@ -8,6 +8,7 @@
 
 #include <cnoid/MultiValueSeq>
 #include <cnoid/MultiSE3Seq>
+#include <cnoid/BinarySeqFile>
 #include <cnoid/Signal>
 #include <cnoid/NullOut>
 #include <map>
@@ -99,6 +100,16 @@ public:
     bool save(const std::string& filename, std::ostream& os = nullout());
     bool save(const std::string& filename, double version, std::ostream& os = nullout());
 
+    /**
+       The binary format stores the link positions, the joint displacements and the extra seqs
+       supported by BinarySeqWriter as the seqs of a binary seq file.
+    */
+    bool loadBinaryFormat(const std::string& filename, std::ostream& os = nullout());
+    bool saveAsBinaryFormat(
+        const std::string& filename, std::ostream& os = nullout(),
+        BinarySeqWriter::ElementType elementType = BinarySeqWriter::FLOAT64,
+        BinarySeqWriter::Layout layout = BinarySeqWriter::FRAME_MAJOR);
+
     typedef std::map<std::string, AbstractSeqPtr> ExtraSeqMap;
     typedef ExtraSeqMap::const_iterator ConstSeqIterator;
         
@@ -0,0 +1,283 @@
+/**
+   \file
+   \brief Implementations of the CompiledKinematics class
+*/
+
+#include "CompiledKinematics.h"
+#include "Body.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+/*
+  Revolute joints whose axes are the unit vectors of the local frame are classified
+  so that their rotations are calculated only by mixing two columns of the parent rotation.
+  The sign of the axis is stored in the corresponding element of the axis vector.
+*/
+enum JointKind {
+    FIXED,
+    REVOLUTE_X,
+    REVOLUTE_Y,
+    REVOLUTE_Z,
+    REVOLUTE,
+    PRISMATIC
+};
+
+int getUnitAxisIndex(const Vector3& a)
+{
+    for(int i=0; i < 3; ++i){
+        if(fabs(a[i]) == 1.0 && a[(i+1) % 3] == 0.0 && a[(i+2) % 3] == 0.0){
+            return i;
+        }
+    }
+    return -1;
+}
+
+}
+
+
+CompiledKinematics::CompiledKinematics()
+{
+    body_ = 0;
+    numJoints_ = 0;
+}
+
+
+CompiledKinematics::CompiledKinematics(Body* body)
+{
+    compile(body);
+}
+
+
+void CompiledKinematics::compile(Body* body)
+{
+    body_ = body;
+
+    const int n = body->numLinks();
+    numJoints_ = body->numJoints();
+
+    parents.resize(n);
+    jointIds.resize(n);
+    jointIdToLinkIndex.assign(numJoints_, -1);
+    jointKinds.resize(n);
+    axes.resize(n);
+    offsets.resize(n);
+    q_.resize(n);
+    dq_.resize(n);
+    R_.resize(n);
+    p_.resize(n);
+    v_.resize(n);
+    w_.resize(n);
+
+    for(int i=0; i < n; ++i){
+        Link* link = body->link(i);
+        Link* parent = link->parent();
+        parents[i] = parent ? parent->index() : -1;
+        const int id = link->jointId();
+        jointIds[i] = id;
+        if(id >= 0 && id < numJoints_){
+            jointIdToLinkIndex[id] = i;
+        }
+        axes[i] = link->a();
+        offsets[i] = link->b();
+
+        if(!parent){
+            jointKinds[i] = FIXED;
+        } else if(link->isRevoluteJoint()){
+            int axisIndex = getUnitAxisIndex(link->a());
+            jointKinds[i] = (axisIndex >= 0) ? (REVOLUTE_X + axisIndex) : REVOLUTE;
+        } else if(link->isPrismaticJoint()){
+            jointKinds[i] = PRISMATIC;
+        } else {
+            jointKinds[i] = FIXED;
+        }
+    }
+
+    readStateFromBody();
+}
+
+
+void CompiledKinematics::setJointPositions(const VectorXd& q)
+{
+    for(int i=0; i < numJoints_; ++i){
+        const int index = jointIdToLinkIndex[i];
+        if(index >= 0){
+            q_[index] = q[i];
+        }
+    }
+}
+
+
+void CompiledKinematics::setJointVelocities(const VectorXd& dq)
+{
+    for(int i=0; i < numJoints_; ++i){
+        const int index = jointIdToLinkIndex[i];
+        if(index >= 0){
+            dq_[index] = dq[i];
+        }
+    }
+}
+
+
+void CompiledKinematics::readStateFromBody()
+{
+    const int n = numLinks();
+    for(int i=0; i < n; ++i){
+        Link* link = body_->link(i);
+        q_[i] = link->q();
+        dq_[i] = link->dq();
+    }
+    if(n > 0){
+        Link* root = body_->rootLink();
+        R_[0] = root->R();
+        p_[0] = root->p();
+        v_[0] = root->v();
+        w_[0] = root->w();
+    }
+}
+
+
+void CompiledKinematics::writeStateToBody(bool doWriteVelocities) const
+{
+    const int n = numLinks();
+    for(int i=0; i < n; ++i){
+        Link* link = body_->link(i);
+        link->q() = q_[i];
+        link->R() = R_[i];
+        link->p() = p_[i];
+        if(doWriteVelocities){
+            link->dq() = dq_[i];
+            link->v() = v_[i];
+            link->w() = w_[i];
+        }
+    }
+}
+
+
+void CompiledKinematics::calcForwardKinematics(bool calcVelocity)
+{
+    const int n = numLinks();
+    Vector3 arm;
+    Vector3 sw;
+
+    for(int i=1; i < n; ++i){
+
+        const int parent = parents[i];
+        const Matrix3& Rp = R_[parent];
+        Matrix3& R = R_[i];
+        const int kind = jointKinds[i];
+
+        if(kind == PRISMATIC){
+            arm.noalias() = Rp * (offsets[i] + q_[i] * axes[i]);
+        } else {
+            arm.noalias() = Rp * offsets[i];
+        }
+        p_[i] = p_[parent] + arm;
+
+        /*
+          The diagonal element of the rotation axis is calculated as (1 - c) + c, which is not
+          always exactly one, so that the result is the same as the one given by AngleAxis.
+        */
+        switch(kind){
+
+        case REVOLUTE_X:
+        {
+            const double theta = axes[i].x() * q_[i];
+            const double c = cos(theta);
+            const double s = sin(theta);
+            R.col(0) = ((1.0 - c) + c) * Rp.col(0);
+            R.col(1) = c * Rp.col(1) + s * Rp.col(2);
+            R.col(2) = c * Rp.col(2) - s * Rp.col(1);
+            sw = axes[i].x() * Rp.col(0);
+            break;
+        }
+        case REVOLUTE_Y:
+        {
+            const double theta = axes[i].y() * q_[i];
+            const double c = cos(theta);
+            const double s = sin(theta);
+            R.col(0) = c * Rp.col(0) - s * Rp.col(2);
+            R.col(1) = ((1.0 - c) + c) * Rp.col(1);
+            R.col(2) = c * Rp.col(2) + s * Rp.col(0);
+            sw = axes[i].y() * Rp.col(1);
+            break;
+        }
+        case REVOLUTE_Z:
+        {
+            const double theta = axes[i].z() * q_[i];
+            const double c = cos(theta);
+            const double s = sin(theta);
+            R.col(0) = c * Rp.col(0) + s * Rp.col(1);
+            R.col(1) = c * Rp.col(1) - s * Rp.col(0);
+            R.col(2) = ((1.0 - c) + c) * Rp.col(2);
+            sw = axes[i].z() * Rp.col(2);
+            break;
+        }
+        case REVOLUTE:
+            R.noalias() = Rp * AngleAxisd(q_[i], axes[i]).toRotationMatrix();
+            sw.noalias() = Rp * axes[i];
+            break;
+
+        default:
+            R = Rp;
+            break;
+        }
+
+        if(calcVelocity){
+            const Vector3& wp = w_[parent];
+            if(kind == PRISMATIC){
+                w_[i] = wp;
+                v_[i].noalias() = v_[parent] + (Rp * axes[i]) * dq_[i];
+            } else {
+                if(kind == FIXED){
+                    w_[i] = wp;
+                } else {
+                    w_[i].noalias() = wp + sw * dq_[i];
+                }
+                v_[i].noalias() = v_[parent] + wp.cross(arm);
+            }
+        }
+    }
+}
+
+
+void CompiledKinematics::calcJacobian(int linkIndex, MatrixXd& out_J) const
+{
+    calcJacobian(linkIndex, Vector3::Zero(), out_J);
+}
+
+
+void CompiledKinematics::calcJacobian(int linkIndex, const Vector3& localPosition, MatrixXd& out_J) const
+{
+    out_J.setZero(6, numJoints_);
+
+    const Vector3 target = p_[linkIndex] + R_[linkIndex] * localPosition;
+
+    // The root link does not have a joint column
+    for(int i = linkIndex; i > 0; i = parents[i]){
+        const int id = jointIds[i];
+        if(id < 0 || id >= numJoints_){
+            continue;
+        }
+        auto Ji = out_J.col(id);
+        const Matrix3& R = R_[i];
+        const int kind = jointKinds[i];
+
+        if(kind == PRISMATIC){
+            Ji.head<3>().noalias() = R * axes[i];
+
+        } else if(kind != FIXED){
+            Vector3 omega;
+            if(kind == REVOLUTE){
+                omega.noalias() = R * axes[i];
+            } else {
+                const int axisIndex = kind - REVOLUTE_X;
+                omega = axes[i][axisIndex] * R.col(axisIndex);
+            }
+            Ji.head<3>() = omega.cross(target - p_[i]);
+            Ji.tail<3>() = omega;
+        }
+    }
+}
@@ -0,0 +1,101 @@
+/**
+   \file
+   \brief The header file of the CompiledKinematics class
+*/
+
+#ifndef CNOID_BODY_COMPILED_KINEMATICS_H
+#define CNOID_BODY_COMPILED_KINEMATICS_H
+
+#include <cnoid/EigenTypes>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+
+/**
+   This class keeps the kinematic structure and the kinematic state of a body in flat arrays
+   that are indexed by the link index. The link index order is a topological order of the
+   link tree, so the forward kinematics and the Jacobians are calculated by sweeping the
+   arrays without accessing the Link objects. The results are written back to the Link
+   objects only when writeStateToBody() is called.
+
+   \note compile() must be called again when the link tree of the body is modified.
+*/
+class CNOID_EXPORT CompiledKinematics
+{
+public:
+    CompiledKinematics();
+    CompiledKinematics(Body* body);
+
+    void compile(Body* body);
+
+    Body* body() const { return body_; }
+    int numLinks() const { return static_cast<int>(parents.size()); }
+    int numJoints() const { return numJoints_; }
+
+    //! The parent link index of the root link is minus one.
+    int parentIndex(int linkIndex) const { return parents[linkIndex]; }
+    int jointId(int linkIndex) const { return jointIds[linkIndex]; }
+
+    double& q(int linkIndex) { return q_[linkIndex]; }
+    double q(int linkIndex) const { return q_[linkIndex]; }
+    double& dq(int linkIndex) { return dq_[linkIndex]; }
+    double dq(int linkIndex) const { return dq_[linkIndex]; }
+
+    //! The size of the vector must be numJoints().
+    void setJointPositions(const VectorXd& q);
+    void setJointVelocities(const VectorXd& dq);
+
+    /**
+       The values of the root link are the inputs of the forward kinematics,
+       and the values of the other links are its outputs.
+    */
+    Matrix3& R(int linkIndex) { return R_[linkIndex]; }
+    const Matrix3& R(int linkIndex) const { return R_[linkIndex]; }
+    Vector3& p(int linkIndex) { return p_[linkIndex]; }
+    const Vector3& p(int linkIndex) const { return p_[linkIndex]; }
+    Vector3& v(int linkIndex) { return v_[linkIndex]; }
+    const Vector3& v(int linkIndex) const { return v_[linkIndex]; }
+    Vector3& w(int linkIndex) { return w_[linkIndex]; }
+    const Vector3& w(int linkIndex) const { return w_[linkIndex]; }
+
+    //! This reads the joint positions and velocities and the root link state from the body
+    void readStateFromBody();
+
+    //! This writes the joint positions and the link positions to the body
+    void writeStateToBody(bool doWriteVelocities = false) const;
+
+    void calcForwardKinematics(bool calcVelocity = false);
+
+    /**
+       This calculates the 6 x numJoints() Jacobian matrix of the link origin.
+       The rows are the linear and angular velocities in the world frame, and
+       the columns of the joints that do not move the link are zero.
+    */
+    void calcJacobian(int linkIndex, MatrixXd& out_J) const;
+
+    //! The linear velocity rows are those of the point given in the link local frame.
+    void calcJacobian(int linkIndex, const Vector3& localPosition, MatrixXd& out_J) const;
+
+private:
+    Body* body_;
+    int numJoints_;
+    std::vector<int> parents;
+    std::vector<int> jointIds;
+    std::vector<int> jointIdToLinkIndex;
+    std::vector<char> jointKinds;
+    std::vector<Vector3> axes;
+    std::vector<Vector3> offsets;
+    std::vector<double> q_;
+    std::vector<double> dq_;
+    std::vector<Matrix3> R_;
+    std::vector<Vector3> p_;
+    std::vector<Vector3> v_;
+    std::vector<Vector3> w_;
+};
+
+}
+
+#endif
@@ -19,9 +19,12 @@
 #include <cnoid/EigenUtil>
 #include <cnoid/AISTCollisionDetector>
 #include <cnoid/TimeMeasure>
+#include <cnoid/TraceProfiler>
+#include <cnoid/ThreadPool>
 #include <boost/format.hpp>
 #include <boost/random.hpp>
 #include <unordered_map>
+#include <algorithm>
 #include <limits>
 #include <fstream>
 #include <iomanip>
@@ -161,7 +164,6 @@ public:
         DyBodyPtr body;
         bool isStatic;
         bool hasConstrainedLinks;
-        bool isTestForceBeingApplied;
         LinkDataArray linksData;
 
         Vector3 dpf;
@@ -268,37 +270,167 @@ public:
     int globalNumContactNormalVectors;
     int globalNumFrictionVectors;
 
-    int prevGlobalNumConstraintVectors;
-    int prevGlobalNumFrictionVectors;
-
     bool areThereImpacts;
     int numUnconverged;
 
     typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> MatrixX;
     typedef VectorXd VectorX;
-        
-    // Mlcp * solution + b   _|_  solution
 
-    MatrixX Mlcp;
+    /**
+       A set of the constrained link pairs which is solved independently of the other sets.
+       The link pairs in an island are connected by the non-static bodies they share.
+       The constraint indices prefixed with "global" are the indices in the island.
+    */
+    class ConstraintIsland
+    {
+    public:
+        ConstraintForceSolverImpl* cfs;
+        ofstream& os;
+
+        std::vector<LinkPair*> constrainedLinkPairs;
+        std::vector<BodyData*> constrainedBodiesData; // non-static bodies only
+
+        int globalNumConstraintVectors;
+        int globalNumContactNormalVectors;
+        int globalNumFrictionVectors;
+
+        int prevGlobalNumConstraintVectors;
+        int prevGlobalNumFrictionVectors;
+
+        bool isConverged;
+
+        // Mlcp * solution + b   _|_  solution
+
+        MatrixX Mlcp;
 
-    // constant acceleration term when no external force is applied
-    VectorX an0;
-    VectorX at0;
+        // constant acceleration term when no external force is applied
+        VectorX an0;
+        VectorX at0;
 
-    // constant vector of LCP
-    VectorX b;
+        // constant vector of LCP
+        VectorX b;
 
-    // contact force solution: normal forces at contact points
-    VectorX solution;
+        // contact force solution: normal forces at contact points
+        VectorX solution;
+
+        // for special version of gauss sidel iterative solver
+        std::vector<int> frictionIndexToContactIndex;
+        VectorX contactIndexToMu;
+        VectorX mcpHi;
+
+        // indices of the link pair bodies in constrainedBodiesData (-1 for a static body)
+        std::vector<int> linkPairToBodySlots;
+
+        /*
+          The accelerations caused by a test force are calculated in a workspace instead of
+          LinkData and BodyData so that the columns of the acceleration matrix can be
+          calculated concurrently. Each thread has its own workspace.
+        */
+        struct TestForceLinkData {
+            Vector3 dvo;
+            Vector3 dw;
+            double uu;
+        };
+        struct TestForceBodyData {
+            std::vector<TestForceLinkData> linksData;
+            Vector3 dpf;
+            Vector3 dptau;
+            bool isTestForceBeingApplied;
+        };
+        struct TestForceWorkspace {
+            std::vector<TestForceBodyData> bodiesData; // same order as constrainedBodiesData
+        };
+        std::vector<TestForceWorkspace> testForceWorkspaces;
+
+        struct TestForceConstraint {
+            int linkPairIndex;
+            ConstraintPoint* constraint;
+        };
+        std::vector<TestForceConstraint> testForceConstraintsABM;
+        std::vector<TestForceConstraint> testForceConstraintsCBM;
+
+        /*
+          Block-sparse row structure of Mlcp for the sparse Gauss-Seidel solver.
+          The rows of a link pair only have non-zero elements in the columns of the link pairs
+          sharing a non-static body with it, and the columns of each link pair are stored as a
+          contiguous range in the normal block and in the friction block of Mlcp.
+        */
+        struct ColumnRange {
+            int begin;
+            int size;
+        };
+        bool isSparseRowStructureEnabled;
+        std::vector<ColumnRange> columnRanges;
+        std::vector<int> linkPairToColumnRangeOffset; // numLinkPairs + 1 elements
+        std::vector<int> rowToLinkPairIndex;
+        std::vector<std::vector<int>> bodySlotToLinkPairs;
+        std::vector<int> couplingLinkPairs;
+        std::vector<int> couplingMarks;
+
+        ConstraintIsland(ConstraintForceSolverImpl* cfs);
+        void clear();
+        void addLinkPair(LinkPair* linkPair);
+        void solve(ThreadPool* threadPool);
+        void initMatrices();
+        void updateBodySlots();
+        void setAccelCalcSkipInformation();
+        void setDefaultAccelerationVector();
+        void setAccelerationMatrix(ThreadPool* threadPool);
+        void initTestForceWorkspace(TestForceWorkspace& workspace);
+        void calcAccelerationMatrixColumns(
+            TestForceWorkspace& workspace, const TestForceConstraint& testForceConstraint);
+        void applyTestForce(
+            TestForceWorkspace& workspace, int linkPairIndex, const ConstraintPoint& constraint, int k, const Vector3& f);
+        void calcABMForceElementsWithTestForce(
+            TestForceBodyData& testForceBodyData, BodyData& bodyData, DyLink* linkToApplyForce,
+            const Vector3& f, const Vector3& tau);
+        void calcAccelsABMWithTestForce(TestForceBodyData& testForceBodyData, BodyData& bodyData, int constraintIndex);
+        void extractRelAccelsOfConstraintPoints(
+            TestForceWorkspace& workspace,
+            Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, int testForceIndex, int constraintIndex);
+        void extractRelAccelsFromLinkPairCase1(
+            TestForceWorkspace& workspace, Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
+            int linkPairIndex, int testForceIndex, int constraintIndex);
+        void extractRelAccelsFromLinkPairCase2(
+            TestForceWorkspace& workspace, Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
+            int linkPairIndex, int iTestForce, int iDefault, int testForceIndex, int constraintIndex);
+        void extractRelAccelsFromLinkPairCase3(
+            Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
+            LinkPair& linkPair, int testForceIndex, int constraintIndex);
+        void copySymmetricElementsOfAccelerationMatrix(
+            Eigen::Block<MatrixX>& Knn, Eigen::Block<MatrixX>& Ktn, Eigen::Block<MatrixX>& Knt, Eigen::Block<MatrixX>& Ktt);
+        void clearSingularPointConstraintsOfClosedLoopConnections();
+        void setConstantVectorAndMuBlock();
+        void addConstraintForceToLinks();
+        void addConstraintForceToLink(LinkPair* linkPair, int ipair);
+        void buildSparseRowStructure();
+        double calcRowProduct(const MatrixX& M, const VectorX& x, int row, int size) const;
+        void solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b, VectorX& x);
+        void solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const VectorX& b, VectorX& x);
+        void solveMCPByProjectedGaussSeidelInitial(
+            const MatrixX& M, const VectorX& b, VectorX& x, const int numIteration);
+        void checkLCPResult(MatrixX& M, VectorX& b, VectorX& x);
+        void checkMCPResult(MatrixX& M, VectorX& b, VectorX& x);
+
+#ifdef USE_PIVOTING_LCP
+        bool callPathLCPSolver(MatrixX& Mlcp, VectorX& b, VectorX& solution);
+#endif
+    };
+    typedef std::shared_ptr<ConstraintIsland> ConstraintIslandPtr;
+
+    vector<ConstraintIslandPtr> islands;
+    int numIslands;
+    bool isIslandDecompositionEnabled;
+    bool isSparseGaussSeidelEnabled;
+    vector<int> islandRoots;
+    vector<int> rootToIslandIndexMap;
+
+    int numThreads;
+    std::unique_ptr<ThreadPool> threadPool;
 
     // random number generator
     boost::variate_generator<boost::mt19937, boost::uniform_real<> > randomAngle;
 
-    // for special version of gauss sidel iterative solver
-    std::vector<int> frictionIndexToContactIndex;
-    VectorX contactIndexToMu;
-    VectorX mcpHi;
-
     int  maxNumGaussSeidelIteration;
     int  numGaussSeidelInitialIteration;
     double gaussSeidelErrorCriterion;
@@ -330,42 +462,14 @@ public:
     void set2dConstraintPoints(const Constrain2dLinkPairPtr& linkPair);
     void putContactPoints();
     void solveImpactConstraints();
-    void initMatrices();
-    void setAccelCalcSkipInformation();
-    void setDefaultAccelerationVector();
-    void setAccelerationMatrix();
+    int findIslandRoot(int bodyIndex);
+    void extractIslands();
+    ConstraintIsland* getOrCreateIsland(int index);
     void initABMForceElementsWithNoExtForce(BodyData& bodyData);
-    void calcABMForceElementsWithTestForce(
-        BodyData& bodyData, DyLink* linkToApplyForce, const Vector3& f, const Vector3& tau);
     void calcAccelsABM(BodyData& bodyData, int constraintIndex);
     void calcAccelsMM(BodyData& bodyData, int constraintIndex);
-    void extractRelAccelsOfConstraintPoints(
-        Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, int testForceIndex, int constraintIndex);
-    void extractRelAccelsFromLinkPairCase1(
-        Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
-        LinkPair& linkPair, int testForceIndex, int constraintIndex);
-    void extractRelAccelsFromLinkPairCase2(
-        Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
-        LinkPair& linkPair, int iTestForce, int iDefault, int testForceIndex, int constraintIndex);
-    void extractRelAccelsFromLinkPairCase3(
-        Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
-        LinkPair& linkPair, int testForceIndex, int constraintIndex);
-    void copySymmetricElementsOfAccelerationMatrix(
-        Eigen::Block<MatrixX>& Knn, Eigen::Block<MatrixX>& Ktn, Eigen::Block<MatrixX>& Knt, Eigen::Block<MatrixX>& Ktt);
-    void clearSingularPointConstraintsOfClosedLoopConnections();
-    void setConstantVectorAndMuBlock();
-    void addConstraintForceToLinks();
-    void addConstraintForceToLink(LinkPair* linkPair, int ipair);
-    void solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b, VectorX& x);
-    void solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const VectorX& b, VectorX& x);
-    void solveMCPByProjectedGaussSeidelInitial(
-        const MatrixX& M, const VectorX& b, VectorX& x, const int numIteration);
-    void checkLCPResult(MatrixX& M, VectorX& b, VectorX& x);
-    void checkMCPResult(MatrixX& M, VectorX& b, VectorX& x);
 
 #ifdef USE_PIVOTING_LCP
-    bool callPathLCPSolver(MatrixX& Mlcp, VectorX& b, VectorX& solution);
-
     // for PATH solver
     std::vector<double> lb;
     std::vector<double> ub;
@@ -449,6 +553,11 @@ CFSImpl::ConstraintForceSolverImpl(WorldBase& world) :
     isConstraintForceOutputMode = false;
     isSelfCollisionDetectionEnabled.clear();
     is2Dmode = false;
+
+    numIslands = 0;
+    isIslandDecompositionEnabled = false;
+    isSparseGaussSeidelEnabled = false;
+    numThreads = 1;
 }
 
 
@@ -466,7 +575,6 @@ void CFSImpl::initBody(const DyBodyPtr& body, BodyData& bodyData)
     bodyData.body = body;
     bodyData.linksData.resize(body->numLinks());
     bodyData.hasConstrainedLinks = false;
-    bodyData.isTestForceBeingApplied = false;
     bodyData.isStatic = body->isStaticModel();
 
     LinkDataArray& linksData = bodyData.linksData;
@@ -671,10 +779,18 @@ void CFSImpl::initialize(void)
 
     bodyCollisionDetector.makeReady();
 
-    prevGlobalNumConstraintVectors = 0;
-    prevGlobalNumFrictionVectors = 0;
+    islands.clear();
+    numIslands = 0;
     numUnconverged = 0;
 
+    if(numThreads > 1){
+        if(!threadPool || threadPool->size() != numThreads){
+            threadPool.reset(new ThreadPool(numThreads));
+        }
+    } else {
+        threadPool.reset();
+    }
+
     randomAngle.engine().seed();
 }
 
@@ -737,6 +853,8 @@ inline void CFSImpl::clearExternalForces()
 
 void CFSImpl::solve()
 {
+    CNOID_TRACE_ZONE("Constraint force solver");
+    
     if(CFS_DEBUG){
         os << "Time: " << world.currentTime() << std::endl;
     }
@@ -775,62 +893,239 @@ void CFSImpl::solve()
         }
         if(CFS_DEBUG_VERBOSE) putContactPoints();
 
-        const bool constraintsSizeChanged = ((globalNumFrictionVectors   != prevGlobalNumFrictionVectors) ||
-                                             (globalNumConstraintVectors != prevGlobalNumConstraintVectors));
-
-        if(constraintsSizeChanged){
-            initMatrices();
-        }
-
         if(areThereImpacts){
             solveImpactConstraints();
         }
 
-        if(SKIP_REDUNDANT_ACCEL_CALC){
-            setAccelCalcSkipInformation();
+        extractIslands();
+
+        if(numIslands == 1 || !threadPool){
+            // The columns of the acceleration matrix of each island are calculated in parallel
+            for(int i=0; i < numIslands; ++i){
+                islands[i]->solve(threadPool.get());
+            }
+        } else {
+            const int numTasks = std::min(numIslands, threadPool->size());
+            for(int i=0; i < numTasks; ++i){
+                threadPool->start([this, i, numTasks](){
+                        for(int j=i; j < numIslands; j += numTasks){
+                            islands[j]->solve(nullptr);
+                        }
+                    });
+            }
+            threadPool->wait();
         }
 
-        setDefaultAccelerationVector();
-        setAccelerationMatrix();
+        // The forces are applied sequentially because the static bodies are shared by the islands
+        for(int i=0; i < numIslands; ++i){
+            ConstraintIsland* island = islands[i].get();
+            if(!island->isConverged){
+                ++numUnconverged;
+                if(CFS_DEBUG)
+                    os << "LCP didn't converge" << numUnconverged << std::endl;
+            } else {
+                if(CFS_DEBUG)
+                    os << "LCP converged" << std::endl;
+                island->addConstraintForceToLinks();
+            }
+        }
+    } else {
+        numIslands = 0;
+    }
 
-        clearSingularPointConstraintsOfClosedLoopConnections();
-		
-        setConstantVectorAndMuBlock();
+    // The islands which are not used in this step must not reuse the previous solutions
+    for(size_t i=numIslands; i < islands.size(); ++i){
+        islands[i]->prevGlobalNumConstraintVectors = 0;
+        islands[i]->prevGlobalNumFrictionVectors = 0;
+    }
+}
+
+
+int CFSImpl::findIslandRoot(int bodyIndex)
+{
+    while(islandRoots[bodyIndex] != bodyIndex){
+        islandRoots[bodyIndex] = islandRoots[islandRoots[bodyIndex]];
+        bodyIndex = islandRoots[bodyIndex];
+    }
+    return bodyIndex;
+}
+
+
+/**
+   The connected components of the non-static bodies linked by the constrained link pairs
+   are extracted as the islands. The static bodies do not connect the islands because
+   their accelerations are not affected by the constraint forces. When the decomposition
+   is disabled, all the link pairs are put into a single island.
+*/
+void CFSImpl::extractIslands()
+{
+    numIslands = 0;
 
-        if(CFS_DEBUG_VERBOSE){
-            debugPutVector(an0, "an0");
-            debugPutVector(at0, "at0");
-            debugPutMatrix(Mlcp, "Mlcp");
-            debugPutVector(b.head(globalNumConstraintVectors), "b1");
-            debugPutVector(b.segment(globalNumConstraintVectors, globalNumFrictionVectors), "b2");
+    if(!isIslandDecompositionEnabled){
+        ConstraintIsland* island = getOrCreateIsland(0);
+        for(auto& linkPair : constrainedLinkPairs){
+            island->addLinkPair(linkPair);
         }
+        numIslands = 1;
 
-        bool isConverged;
-#ifdef USE_PIVOTING_LCP
-        isConverged = callPathLCPSolver(Mlcp, b, solution);
-#else
-        if(!USE_PREVIOUS_LCP_SOLUTION || constraintsSizeChanged){
-            solution.setZero();
+    } else {
+        const int numBodies = bodiesData.size();
+        islandRoots.resize(numBodies);
+        for(int i=0; i < numBodies; ++i){
+            islandRoots[i] = i;
+        }
+        for(auto& linkPair : constrainedLinkPairs){
+            int roots[2];
+            for(int i=0; i < 2; ++i){
+                const int bodyIndex = linkPair->bodyIndex[i];
+                if(bodyIndex >= 0 && !linkPair->bodyData[i]->isStatic){
+                    roots[i] = findIslandRoot(bodyIndex);
+                } else {
+                    roots[i] = -1;
+                }
+            }
+            if(roots[0] >= 0 && roots[1] >= 0 && roots[0] != roots[1]){
+                islandRoots[roots[1]] = roots[0];
+            }
         }
-        solveMCPByProjectedGaussSeidel(Mlcp, b, solution);
-        isConverged = true;
-#endif
 
-        if(!isConverged){
-            ++numUnconverged;
-            if(CFS_DEBUG)
-                os << "LCP didn't converge" << numUnconverged << std::endl;
-        } else {
-            if(CFS_DEBUG)
-                os << "LCP converged" << std::endl;
-            if(CFS_DEBUG_LCPCHECK){
-                // checkLCPResult(Mlcp, b, solution);
-                checkMCPResult(Mlcp, b, solution);
+        rootToIslandIndexMap.assign(numBodies, -1);
+        for(auto& linkPair : constrainedLinkPairs){
+            int root = -1;
+            for(int i=0; i < 2; ++i){
+                const int bodyIndex = linkPair->bodyIndex[i];
+                if(bodyIndex >= 0 && !linkPair->bodyData[i]->isStatic){
+                    root = findIslandRoot(bodyIndex);
+                    break;
+                }
+            }
+            if(root < 0){
+                // The pair only consists of static bodies
+                root = (linkPair->bodyIndex[1] >= 0) ? linkPair->bodyIndex[1] : linkPair->bodyIndex[0];
+            }
+            int& islandIndex = rootToIslandIndexMap[root];
+            if(islandIndex < 0){
+                islandIndex = numIslands++;
+                getOrCreateIsland(islandIndex);
             }
+            islands[islandIndex]->addLinkPair(linkPair);
+        }
+    }
 
-            addConstraintForceToLinks();
+    for(int i=0; i < numIslands; ++i){
+        auto& bodiesData = islands[i]->constrainedBodiesData;
+        std::sort(bodiesData.begin(), bodiesData.end());
+        bodiesData.erase(std::unique(bodiesData.begin(), bodiesData.end()), bodiesData.end());
+    }
+}
+
+
+CFSImpl::ConstraintIsland* CFSImpl::getOrCreateIsland(int index)
+{
+    if(index >= static_cast<int>(islands.size())){
+        islands.push_back(std::make_shared<ConstraintIsland>(this));
+    }
+    ConstraintIsland* island = islands[index].get();
+    island->clear();
+    return island;
+}
+
+
+CFSImpl::ConstraintIsland::ConstraintIsland(ConstraintForceSolverImpl* cfs)
+    : cfs(cfs),
+      os(cfs->os)
+{
+    prevGlobalNumConstraintVectors = 0;
+    prevGlobalNumFrictionVectors = 0;
+    isConverged = false;
+    isSparseRowStructureEnabled = false;
+    clear();
+}
+
+
+void CFSImpl::ConstraintIsland::clear()
+{
+    constrainedLinkPairs.clear();
+    constrainedBodiesData.clear();
+    globalNumConstraintVectors = 0;
+    globalNumContactNormalVectors = 0;
+    globalNumFrictionVectors = 0;
+}
+
+
+/**
+   The constraint indices of the link pair are renumbered in the island. The contact
+   constraints precede the other constraints in the island because the link pairs are
+   added in the order of CFSImpl::constrainedLinkPairs.
+*/
+void CFSImpl::ConstraintIsland::addLinkPair(LinkPair* linkPair)
+{
+    for(auto& constraint : linkPair->constraintPoints){
+        constraint.globalIndex = globalNumConstraintVectors++;
+        if(!linkPair->isNonContactConstraint){
+            ++globalNumContactNormalVectors;
+            constraint.globalFrictionIndex = globalNumFrictionVectors;
+            globalNumFrictionVectors += constraint.numFrictionVectors;
+        }
+    }
+    for(int i=0; i < 2; ++i){
+        BodyData* bodyData = linkPair->bodyData[i];
+        if(!bodyData->isStatic){
+            constrainedBodiesData.push_back(bodyData);
         }
     }
+    constrainedLinkPairs.push_back(linkPair);
+}
+
+
+void CFSImpl::ConstraintIsland::solve(ThreadPool* threadPool)
+{
+    const bool constraintsSizeChanged = ((globalNumFrictionVectors   != prevGlobalNumFrictionVectors) ||
+                                         (globalNumConstraintVectors != prevGlobalNumConstraintVectors));
+
+    if(constraintsSizeChanged){
+        initMatrices();
+    }
+
+    updateBodySlots();
+
+    if(SKIP_REDUNDANT_ACCEL_CALC){
+        setAccelCalcSkipInformation();
+    }
+
+    setDefaultAccelerationVector();
+    setAccelerationMatrix(threadPool);
+
+    clearSingularPointConstraintsOfClosedLoopConnections();
+		
+    setConstantVectorAndMuBlock();
+
+    if(CFS_DEBUG_VERBOSE){
+        cfs->debugPutVector(an0, "an0");
+        cfs->debugPutVector(at0, "at0");
+        cfs->debugPutMatrix(Mlcp, "Mlcp");
+        cfs->debugPutVector(b.head(globalNumConstraintVectors), "b1");
+        cfs->debugPutVector(b.segment(globalNumConstraintVectors, globalNumFrictionVectors), "b2");
+    }
+
+#ifdef USE_PIVOTING_LCP
+    isConverged = callPathLCPSolver(Mlcp, b, solution);
+#else
+    if(!USE_PREVIOUS_LCP_SOLUTION || constraintsSizeChanged){
+        solution.setZero();
+    }
+    isSparseRowStructureEnabled = cfs->isSparseGaussSeidelEnabled;
+    if(isSparseRowStructureEnabled){
+        buildSparseRowStructure();
+    }
+    solveMCPByProjectedGaussSeidel(Mlcp, b, solution);
+    isConverged = true;
+#endif
+
+    if(isConverged && CFS_DEBUG_LCPCHECK){
+        // checkLCPResult(Mlcp, b, solution);
+        checkMCPResult(Mlcp, b, solution);
+    }
 
     prevGlobalNumConstraintVectors = globalNumConstraintVectors;
     prevGlobalNumFrictionVectors = globalNumFrictionVectors;
@@ -843,9 +1138,12 @@ void CFSImpl::setConstraintPoints()
     timer.begin();
 #endif
 
-    bodyCollisionDetector.detectCollisions(
-        [&](const CollisionPair& collisionPair){
-            extractConstraintPoints(collisionPair); });
+    {
+        CNOID_TRACE_ZONE("Collision detection");
+        bodyCollisionDetector.detectCollisions(
+            [&](const CollisionPair& collisionPair){
+                extractConstraintPoints(collisionPair); });
+    }
 
 #ifdef ENABLE_SIMULATION_PROFILING
         collisionTime = timer.measure();
@@ -1190,7 +1488,7 @@ void CFSImpl::solveImpactConstraints()
 }
 
 
-void CFSImpl::initMatrices()
+void CFSImpl::ConstraintIsland::initMatrices()
 {
     const int n = globalNumConstraintVectors;
     const int m = globalNumFrictionVectors;
@@ -1220,16 +1518,32 @@ void CFSImpl::initMatrices()
 }
 
 
-void CFSImpl::setAccelCalcSkipInformation()
+void CFSImpl::ConstraintIsland::updateBodySlots()
 {
-    // clear skip check numbers
-    for(size_t i=0; i < bodiesData.size(); ++i){
-        BodyData& bodyData = bodiesData[i];
-        if(bodyData.hasConstrainedLinks){
-            LinkDataArray& linksData = bodyData.linksData;
-            for(size_t j=0; j < linksData.size(); ++j){
-                linksData[j].numberToCheckAccelCalcSkip = numeric_limits<int>::max();
+    const int numLinkPairs = constrainedLinkPairs.size();
+    linkPairToBodySlots.resize(numLinkPairs * 2);
+    for(int i=0; i < numLinkPairs; ++i){
+        LinkPair* linkPair = constrainedLinkPairs[i];
+        for(int j=0; j < 2; ++j){
+            int slot = -1;
+            BodyData* bodyData = linkPair->bodyData[j];
+            if(!bodyData->isStatic){
+                auto p = std::lower_bound(constrainedBodiesData.begin(), constrainedBodiesData.end(), bodyData);
+                slot = p - constrainedBodiesData.begin();
             }
+            linkPairToBodySlots[i * 2 + j] = slot;
+        }
+    }
+}
+
+
+void CFSImpl::ConstraintIsland::setAccelCalcSkipInformation()
+{
+    // clear skip check numbers
+    for(auto& bodyData : constrainedBodiesData){
+        LinkDataArray& linksData = bodyData->linksData;
+        for(size_t j=0; j < linksData.size(); ++j){
+            linksData[j].numberToCheckAccelCalcSkip = numeric_limits<int>::max();
         }
     }
 
@@ -1239,6 +1553,10 @@ void CFSImpl::setAccelCalcSkipInformation()
         LinkPair* linkPair = constrainedLinkPairs[i];
         int constraintIndex = linkPair->constraintPoints.front().globalIndex;
         for(int j=0; j < 2; ++j){
+            if(linkPair->bodyData[j]->isStatic){
+                // The skip check numbers of static bodies are not used
+                continue;
+            }
             LinkDataArray& linksData = linkPair->bodyData[j]->linksData;
             int linkIndex = linkPair->link[j]->index();
             while(linkIndex >= 0){
@@ -1254,22 +1572,19 @@ void CFSImpl::setAccelCalcSkipInformation()
 }
 
 
-void CFSImpl::setDefaultAccelerationVector()
+void CFSImpl::ConstraintIsland::setDefaultAccelerationVector()
 {
     // calculate accelerations with no constraint force
-    for(size_t i=0; i < bodiesData.size(); ++i){
-        BodyData& bodyData = bodiesData[i];
-        if(bodyData.hasConstrainedLinks && ! bodyData.isStatic){
-
-            if(bodyData.forwardDynamicsCBM){
-                bodyData.forwardDynamicsCBM->sumExternalForces();
-                bodyData.forwardDynamicsCBM->solveUnknownAccels();
-                calcAccelsMM(bodyData, numeric_limits<int>::max());
+    for(auto& pBodyData : constrainedBodiesData){
+        BodyData& bodyData = *pBodyData;
+        if(bodyData.forwardDynamicsCBM){
+            bodyData.forwardDynamicsCBM->sumExternalForces();
+            bodyData.forwardDynamicsCBM->solveUnknownAccels();
+            cfs->calcAccelsMM(bodyData, numeric_limits<int>::max());
 
-            } else {
-                initABMForceElementsWithNoExtForce(bodyData);
-                calcAccelsABM(bodyData, numeric_limits<int>::max());
-            }
+        } else {
+            cfs->initABMForceElementsWithNoExtForce(bodyData);
+            cfs->calcAccelsABM(bodyData, numeric_limits<int>::max());
         }
     }
 
@@ -1305,7 +1620,7 @@ void CFSImpl::setDefaultAccelerationVector()
 }
 
 
-void CFSImpl::setAccelerationMatrix()
+void CFSImpl::ConstraintIsland::setAccelerationMatrix(ThreadPool* threadPool)
 {
     const int n = globalNumConstraintVectors;
     const int m = globalNumFrictionVectors;
@@ -1315,71 +1630,60 @@ void CFSImpl::setAccelerationMatrix()
     Eigen::Block<MatrixX> Knt = Mlcp.block(n, 0, m, n);
     Eigen::Block<MatrixX> Ktt = Mlcp.block(n, n, m, m);
 
+    /*
+      The test forces applied to the bodies using ForwardDynamicsCBM are calculated by
+      the shared ForwardDynamicsCBM objects, so the columns of those bodies are calculated
+      sequentially after the other columns are calculated in parallel.
+    */
+    testForceConstraintsABM.clear();
+    testForceConstraintsCBM.clear();
     for(size_t i=0; i < constrainedLinkPairs.size(); ++i){
-
         LinkPair& linkPair = *constrainedLinkPairs[i];
-        int numConstraintsInPair = linkPair.constraintPoints.size();
-
-        for(int j=0; j < numConstraintsInPair; ++j){
+        const bool usesCBM = linkPair.bodyData[0]->forwardDynamicsCBM || linkPair.bodyData[1]->forwardDynamicsCBM;
+        auto& testForceConstraints = usesCBM ? testForceConstraintsCBM : testForceConstraintsABM;
+        for(auto& constraint : linkPair.constraintPoints){
+            testForceConstraints.push_back({ static_cast<int>(i), &constraint });
+        }
+    }
 
-            ConstraintPoint& constraint = linkPair.constraintPoints[j];
-            int constraintIndex = constraint.globalIndex;
+    const int numConstraints = testForceConstraintsABM.size();
+    int numTasks = 1;
+    if(threadPool){
+        numTasks = std::max(1, std::min(threadPool->size(), numConstraints));
+    }
+    if(static_cast<int>(testForceWorkspaces.size()) < numTasks){
+        testForceWorkspaces.resize(numTasks);
+    }
+    for(int i=0; i < numTasks; ++i){
+        initTestForceWorkspace(testForceWorkspaces[i]);
+    }
 
-            // apply test normal force
-            for(int k=0; k < 2; ++k){
-                BodyData& bodyData = *linkPair.bodyData[k];
-                if(!bodyData.isStatic){
-
-                    bodyData.isTestForceBeingApplied = true;
-                    const Vector3& f = constraint.normalTowardInside[k];
-
-                    if(bodyData.forwardDynamicsCBM){
-                        //! \todo This code does not work correctly when the links are in the same body. Fix it.
-                        Vector3 arm = constraint.point - bodyData.body->rootLink()->p();
-                        Vector3 tau = arm.cross(f);
-                        Vector3 tauext = constraint.point.cross(f);
-                        bodyData.forwardDynamicsCBM->solveUnknownAccels(linkPair.link[k], f, tauext, f, tau);
-                        calcAccelsMM(bodyData, constraintIndex);
-                    } else {
-                        Vector3 tau = constraint.point.cross(f);
-                        calcABMForceElementsWithTestForce(bodyData, linkPair.link[k], f, tau);
-                        if(!linkPair.isSameBodyPair || (k > 0)){
-                            calcAccelsABM(bodyData, constraintIndex);
-                        }
-                    }
-                }
-            }
-            extractRelAccelsOfConstraintPoints(Knn, Knt, constraintIndex, constraintIndex);
-
-            // apply test friction force
-            for(int l=0; l < constraint.numFrictionVectors; ++l){
-                for(int k=0; k < 2; ++k){
-                    BodyData& bodyData = *linkPair.bodyData[k];
-                    if(!bodyData.isStatic){
-                        const Vector3& f = constraint.frictionVector[l][k];
-
-                        if(bodyData.forwardDynamicsCBM){
-                            //! \todo This code does not work correctly when the links are in the same body. Fix it.
-                            Vector3 arm = constraint.point - bodyData.body->rootLink()->p();
-                            Vector3 tau = arm.cross(f);
-                            Vector3 tauext = constraint.point.cross(f);
-                            bodyData.forwardDynamicsCBM->solveUnknownAccels(linkPair.link[k], f, tauext, f, tau);
-                            calcAccelsMM(bodyData, constraintIndex);
-                        } else {
-                            Vector3 tau = constraint.point.cross(f);
-                            calcABMForceElementsWithTestForce(bodyData, linkPair.link[k], f, tau);
-                            if(!linkPair.isSameBodyPair || (k > 0)){
-                                calcAccelsABM(bodyData, constraintIndex);
-                            }
-                        }
-                    }
+    if(numTasks == 1){
+        for(auto& testForceConstraint : testForceConstraintsABM){
+            calcAccelerationMatrixColumns(testForceWorkspaces[0], testForceConstraint);
+        }
+    } else {
+        // Each task calculates a contiguous range of the columns
+        for(int i=0; i < numTasks; ++i){
+            auto task = [this, i, numTasks, numConstraints](){
+                TestForceWorkspace& workspace = testForceWorkspaces[i];
+                const int begin = numConstraints * i / numTasks;
+                const int end = numConstraints * (i + 1) / numTasks;
+                for(int j=begin; j < end; ++j){
+                    calcAccelerationMatrixColumns(workspace, testForceConstraintsABM[j]);
                 }
-                extractRelAccelsOfConstraintPoints(Ktn, Ktt, constraint.globalFrictionIndex + l, constraintIndex);
+            };
+            if(i < numTasks - 1){
+                threadPool->start(task);
+            } else {
+                task();
             }
-
-            linkPair.bodyData[0]->isTestForceBeingApplied = false;
-            linkPair.bodyData[1]->isTestForceBeingApplied = false;
         }
+        threadPool->wait();
+    }
+
+    for(auto& testForceConstraint : testForceConstraintsCBM){
+        calcAccelerationMatrixColumns(testForceWorkspaces[0], testForceConstraint);
     }
 
     if(ASSUME_SYMMETRIC_MATRIX){
@@ -1388,6 +1692,105 @@ void CFSImpl::setAccelerationMatrix()
 }
 
 
+void CFSImpl::ConstraintIsland::initTestForceWorkspace(TestForceWorkspace& workspace)
+{
+    const int numBodies = constrainedBodiesData.size();
+    workspace.bodiesData.resize(numBodies);
+    for(int i=0; i < numBodies; ++i){
+        const LinkDataArray& linksData = constrainedBodiesData[i]->linksData;
+        TestForceBodyData& testForceBodyData = workspace.bodiesData[i];
+        const int numLinks = linksData.size();
+        testForceBodyData.linksData.resize(numLinks);
+        for(int j=0; j < numLinks; ++j){
+            testForceBodyData.linksData[j].uu = linksData[j].uu0;
+        }
+        testForceBodyData.dpf.setZero();
+        testForceBodyData.dptau.setZero();
+        testForceBodyData.isTestForceBeingApplied = false;
+    }
+}
+
+
+/**
+   This function calculates the columns of the acceleration matrix corresponding to the normal
+   and friction vectors of a constraint point. Only the workspace and the columns are written,
+   so the function can be executed concurrently for different constraint points if they
+   are not of the bodies using ForwardDynamicsCBM.
+*/
+void CFSImpl::ConstraintIsland::calcAccelerationMatrixColumns
+(TestForceWorkspace& workspace, const TestForceConstraint& testForceConstraint)
+{
+    const int n = globalNumConstraintVectors;
+    const int m = globalNumFrictionVectors;
+
+    Eigen::Block<MatrixX> Knn = Mlcp.block(0, 0, n, n);
+    Eigen::Block<MatrixX> Ktn = Mlcp.block(0, n, n, m);
+    Eigen::Block<MatrixX> Knt = Mlcp.block(n, 0, m, n);
+    Eigen::Block<MatrixX> Ktt = Mlcp.block(n, n, m, m);
+
+    const int linkPairIndex = testForceConstraint.linkPairIndex;
+    const ConstraintPoint& constraint = *testForceConstraint.constraint;
+    const int constraintIndex = constraint.globalIndex;
+
+    // apply test normal force
+    for(int k=0; k < 2; ++k){
+        applyTestForce(workspace, linkPairIndex, constraint, k, constraint.normalTowardInside[k]);
+    }
+    extractRelAccelsOfConstraintPoints(workspace, Knn, Knt, constraintIndex, constraintIndex);
+
+    // apply test friction force
+    for(int l=0; l < constraint.numFrictionVectors; ++l){
+        for(int k=0; k < 2; ++k){
+            applyTestForce(workspace, linkPairIndex, constraint, k, constraint.frictionVector[l][k]);
+        }
+        extractRelAccelsOfConstraintPoints(workspace, Ktn, Ktt, constraint.globalFrictionIndex + l, constraintIndex);
+    }
+
+    for(int k=0; k < 2; ++k){
+        const int slot = linkPairToBodySlots[linkPairIndex * 2 + k];
+        if(slot >= 0){
+            workspace.bodiesData[slot].isTestForceBeingApplied = false;
+        }
+    }
+}
+
+
+void CFSImpl::ConstraintIsland::applyTestForce
+(TestForceWorkspace& workspace, int linkPairIndex, const ConstraintPoint& constraint, int k, const Vector3& f)
+{
+    const int slot = linkPairToBodySlots[linkPairIndex * 2 + k];
+    if(slot < 0){
+        return;
+    }
+    LinkPair& linkPair = *constrainedLinkPairs[linkPairIndex];
+    BodyData& bodyData = *linkPair.bodyData[k];
+    TestForceBodyData& testForceBodyData = workspace.bodiesData[slot];
+    const int constraintIndex = constraint.globalIndex;
+
+    testForceBodyData.isTestForceBeingApplied = true;
+
+    if(bodyData.forwardDynamicsCBM){
+        //! \todo This code does not work correctly when the links are in the same body. Fix it.
+        Vector3 arm = constraint.point - bodyData.body->rootLink()->p();
+        Vector3 tau = arm.cross(f);
+        Vector3 tauext = constraint.point.cross(f);
+        bodyData.forwardDynamicsCBM->solveUnknownAccels(linkPair.link[k], f, tauext, f, tau);
+        cfs->calcAccelsMM(bodyData, constraintIndex);
+        const int numLinks = bodyData.linksData.size();
+        for(int i=0; i < numLinks; ++i){
+            testForceBodyData.linksData[i].dvo = bodyData.linksData[i].dvo;
+            testForceBodyData.linksData[i].dw = bodyData.linksData[i].dw;
+        }
+    } else {
+        Vector3 tau = constraint.point.cross(f);
+        calcABMForceElementsWithTestForce(testForceBodyData, bodyData, linkPair.link[k], f, tau);
+        if(!linkPair.isSameBodyPair || (k > 0)){
+            calcAccelsABMWithTestForce(testForceBodyData, bodyData, constraintIndex);
+        }
+    }
+}
+
+
 void CFSImpl::initABMForceElementsWithNoExtForce(BodyData& bodyData)
 {
     bodyData.dpf.setZero();
@@ -1432,10 +1835,10 @@ void CFSImpl::initABMForceElementsWithNoExtForce(BodyData& bodyData)
 }
 
 
-void CFSImpl::calcABMForceElementsWithTestForce
-(BodyData& bodyData, DyLink* linkToApplyForce, const Vector3& f, const Vector3& tau)
+void CFSImpl::ConstraintIsland::calcABMForceElementsWithTestForce
+(TestForceBodyData& testForceBodyData, BodyData& bodyData, DyLink* linkToApplyForce, const Vector3& f, const Vector3& tau)
 {
-    std::vector<LinkData>& linksData = bodyData.linksData;
+    std::vector<TestForceLinkData>& linksData = testForceBodyData.linksData;
 
     Vector3 dpf   = -f;
     Vector3 dptau = -tau;
@@ -1443,7 +1846,7 @@ void CFSImpl::calcABMForceElementsWithTestForce
     DyLink* link = linkToApplyForce;
     while(link->parent()){
         if(!link->isFixedJoint()){
-            LinkData& data = linksData[link->index()];
+            TestForceLinkData& data = linksData[link->index()];
             double duu = -(link->sv().dot(dpf) + link->sw().dot(dptau));
             data.uu += duu;
             double duudd = duu / link->dd();
@@ -1453,8 +1856,8 @@ void CFSImpl::calcABMForceElementsWithTestForce
         link = link->parent();
     }
 
-    bodyData.dpf   += dpf;
-    bodyData.dptau += dptau;
+    testForceBodyData.dpf   += dpf;
+    testForceBodyData.dptau += dptau;
 }
 
 
@@ -1517,6 +1920,72 @@ void CFSImpl::calcAccelsABM(BodyData& bodyData, int constraintIndex)
 }
 
 
+/**
+   The same calculation as calcAccelsABM except that the link accelerations are written
+   to the workspace of the test force.
+*/
+void CFSImpl::ConstraintIsland::calcAccelsABMWithTestForce
+(TestForceBodyData& testForceBodyData, BodyData& bodyData, int constraintIndex)
+{
+    const std::vector<LinkData>& linksData = bodyData.linksData;
+    std::vector<TestForceLinkData>& testForceLinksData = testForceBodyData.linksData;
+    const LinkData& rootData = linksData[0];
+    TestForceLinkData& testForceRootData = testForceLinksData[0];
+    DyLink* rootLink = rootData.link;
+
+    if(rootLink->isFreeJoint()){
+
+        Eigen::Matrix<double, 6, 6> M;
+        M << rootLink->Ivv(), rootLink->Iwv().transpose(),
+            rootLink->Iwv(), rootLink->Iww();
+
+        Eigen::Matrix<double, 6, 1> f;
+        f << (rootData.pf0   + testForceBodyData.dpf),
+            (rootData.ptau0 + testForceBodyData.dptau);
+        f *= -1.0;
+
+        Eigen::Matrix<double, 6, 1> a(M.colPivHouseholderQr().solve(f));
+
+        testForceRootData.dvo = a.head<3>();
+        testForceRootData.dw  = a.tail<3>();
+
+    } else {
+        testForceRootData.dw .setZero();
+        testForceRootData.dvo.setZero();
+    }
+
+    // reset
+    testForceBodyData.dpf  .setZero();
+    testForceBodyData.dptau.setZero();
+
+    int skipCheckNumber = ASSUME_SYMMETRIC_MATRIX ? constraintIndex : (numeric_limits<int>::max() - 1);
+    int n = linksData.size();
+    for(int linkIndex = 1; linkIndex < n; ++linkIndex){
+
+        const LinkData& linkData = linksData[linkIndex];
+
+        if(!SKIP_REDUNDANT_ACCEL_CALC || linkData.numberToCheckAccelCalcSkip <= skipCheckNumber){
+
+            DyLink* link = linkData.link;
+            TestForceLinkData& testForceLinkData = testForceLinksData[linkIndex];
+            const TestForceLinkData& parentData = testForceLinksData[linkData.parentIndex];
+
+            if(!link->isFixedJoint()){
+                double ddq = (testForceLinkData.uu - (link->hhv().dot(parentData.dvo) + link->hhw().dot(parentData.dw))) / link->dd();
+                testForceLinkData.dvo = parentData.dvo + link->cv() + link->sv() * ddq;
+                testForceLinkData.dw  = parentData.dw  + link->cw() + link->sw() * ddq;
+            }else{
+                testForceLinkData.dvo = parentData.dvo;
+                testForceLinkData.dw  = parentData.dw;
+            }
+
+            // reset
+            testForceLinkData.uu = linkData.uu0;
+        }
+    }
+}
+
+
 void CFSImpl::calcAccelsMM(BodyData& bodyData, int constraintIndex)
 {
     std::vector<LinkData>& linksData = bodyData.linksData;
@@ -1549,40 +2018,41 @@ void CFSImpl::calcAccelsMM(BodyData& bodyData, int constraintIndex)
 }
 
 
-void CFSImpl::extractRelAccelsOfConstraintPoints
-(Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, int testForceIndex, int constraintIndex)
+void CFSImpl::ConstraintIsland::extractRelAccelsOfConstraintPoints
+(TestForceWorkspace& workspace, Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, int testForceIndex, int constraintIndex)
 {
     int maxConstraintIndexToExtract = ASSUME_SYMMETRIC_MATRIX ? constraintIndex : globalNumConstraintVectors;
 
+    const int numLinkPairs = constrainedLinkPairs.size();
+    for(int i=0; i < numLinkPairs; ++i){
 
-    for(size_t i=0; i < constrainedLinkPairs.size(); ++i){
-
-        LinkPair& linkPair = *constrainedLinkPairs[i];
-
-        BodyData& bodyData0 = *linkPair.bodyData[0];
-        BodyData& bodyData1 = *linkPair.bodyData[1];
+        const int slot0 = linkPairToBodySlots[i * 2];
+        const int slot1 = linkPairToBodySlots[i * 2 + 1];
+        const bool isTestForceBeingApplied0 = (slot0 >= 0) && workspace.bodiesData[slot0].isTestForceBeingApplied;
+        const bool isTestForceBeingApplied1 = (slot1 >= 0) && workspace.bodiesData[slot1].isTestForceBeingApplied;
 
-        if(bodyData0.isTestForceBeingApplied){
-            if(bodyData1.isTestForceBeingApplied){
-                extractRelAccelsFromLinkPairCase1(Kxn, Kxt, linkPair, testForceIndex, maxConstraintIndexToExtract);
+        if(isTestForceBeingApplied0){
+            if(isTestForceBeingApplied1){
+                extractRelAccelsFromLinkPairCase1(workspace, Kxn, Kxt, i, testForceIndex, maxConstraintIndexToExtract);
             } else {
-                extractRelAccelsFromLinkPairCase2(Kxn, Kxt, linkPair, 0, 1, testForceIndex, maxConstraintIndexToExtract);
+                extractRelAccelsFromLinkPairCase2(workspace, Kxn, Kxt, i, 0, 1, testForceIndex, maxConstraintIndexToExtract);
             }
         } else {
-            if(bodyData1.isTestForceBeingApplied){
-                extractRelAccelsFromLinkPairCase2(Kxn, Kxt, linkPair, 1, 0, testForceIndex, maxConstraintIndexToExtract);
+            if(isTestForceBeingApplied1){
+                extractRelAccelsFromLinkPairCase2(workspace, Kxn, Kxt, i, 1, 0, testForceIndex, maxConstraintIndexToExtract);
             } else {
-                extractRelAccelsFromLinkPairCase3(Kxn, Kxt, linkPair, testForceIndex, maxConstraintIndexToExtract);
+                extractRelAccelsFromLinkPairCase3(Kxn, Kxt, *constrainedLinkPairs[i], testForceIndex, maxConstraintIndexToExtract);
             }
         }
     }
 }
 
 
-void CFSImpl::extractRelAccelsFromLinkPairCase1
-(Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
- LinkPair& linkPair, int testForceIndex, int maxConstraintIndexToExtract)
+void CFSImpl::ConstraintIsland::extractRelAccelsFromLinkPairCase1
+(TestForceWorkspace& workspace, Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
+ int linkPairIndex, int testForceIndex, int maxConstraintIndexToExtract)
 {
+    LinkPair& linkPair = *constrainedLinkPairs[linkPairIndex];
     ConstraintPointArray& constraintPoints = linkPair.constraintPoints;
 
     for(size_t i=0; i < constraintPoints.size(); ++i){
@@ -1596,8 +2066,10 @@ void CFSImpl::extractRelAccelsFromLinkPairCase1
 
         DyLink* link0 = linkPair.link[0];
         DyLink* link1 = linkPair.link[1];
-        LinkData* linkData0 = linkPair.linkData[0];
-        LinkData* linkData1 = linkPair.linkData[1];
+        const TestForceLinkData* linkData0 =
+            &workspace.bodiesData[linkPairToBodySlots[linkPairIndex * 2]].linksData[link0->index()];
+        const TestForceLinkData* linkData1 =
+            &workspace.bodiesData[linkPairToBodySlots[linkPairIndex * 2 + 1]].linksData[link1->index()];
 
         //! \todo Can the follwoing equations be simplified ?
         Vector3 dv0 =
@@ -1620,10 +2092,11 @@ void CFSImpl::extractRelAccelsFromLinkPairCase1
 }
 
 
-void CFSImpl::extractRelAccelsFromLinkPairCase2
-(Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
- LinkPair& linkPair, int iTestForce, int iDefault, int testForceIndex, int maxConstraintIndexToExtract)
+void CFSImpl::ConstraintIsland::extractRelAccelsFromLinkPairCase2
+(TestForceWorkspace& workspace, Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt,
+ int linkPairIndex, int iTestForce, int iDefault, int testForceIndex, int maxConstraintIndexToExtract)
 {
+    LinkPair& linkPair = *constrainedLinkPairs[linkPairIndex];
     ConstraintPointArray& constraintPoints = linkPair.constraintPoints;
 
     for(size_t i=0; i < constraintPoints.size(); ++i){
@@ -1636,7 +2109,8 @@ void CFSImpl::extractRelAccelsFromLinkPairCase2
         }
 
         DyLink* link = linkPair.link[iTestForce];
-        LinkData* linkData = linkPair.linkData[iTestForce];
+        const TestForceLinkData* linkData =
+            &workspace.bodiesData[linkPairToBodySlots[linkPairIndex * 2 + iTestForce]].linksData[link->index()];
 
         Vector3 dv(linkData->dvo - constraint.point.cross(linkData->dw) + link->w().cross(link->vo() + link->w().cross(constraint.point)));
 
@@ -1657,7 +2131,7 @@ void CFSImpl::extractRelAccelsFromLinkPairCase2
 }
 
 
-void CFSImpl::extractRelAccelsFromLinkPairCase3
+void CFSImpl::ConstraintIsland::extractRelAccelsFromLinkPairCase3
 (Eigen::Block<MatrixX>& Kxn, Eigen::Block<MatrixX>& Kxt, LinkPair& linkPair, int testForceIndex, int maxConstraintIndexToExtract)
 {
     ConstraintPointArray& constraintPoints = linkPair.constraintPoints;
@@ -1680,7 +2154,7 @@ void CFSImpl::extractRelAccelsFromLinkPairCase3
 }
 
 
-void CFSImpl::copySymmetricElementsOfAccelerationMatrix
+void CFSImpl::ConstraintIsland::copySymmetricElementsOfAccelerationMatrix
 (Eigen::Block<MatrixX>& Knn, Eigen::Block<MatrixX>& Ktn, Eigen::Block<MatrixX>& Knt, Eigen::Block<MatrixX>& Ktt)
 {
     for(size_t linkPairIndex=0; linkPairIndex < constrainedLinkPairs.size(); ++linkPairIndex){
@@ -1717,7 +2191,7 @@ void CFSImpl::copySymmetricElementsOfAccelerationMatrix
 }
 
 
-void CFSImpl::clearSingularPointConstraintsOfClosedLoopConnections()
+void CFSImpl::ConstraintIsland::clearSingularPointConstraintsOfClosedLoopConnections()
 {
     for(int i = 0; i < Mlcp.rows(); ++i){
         if(Mlcp(i, i) < 1.0e-4){
@@ -1730,9 +2204,9 @@ void CFSImpl::clearSingularPointConstraintsOfClosedLoopConnections()
 }
 
 
-void CFSImpl::setConstantVectorAndMuBlock()
+void CFSImpl::ConstraintIsland::setConstantVectorAndMuBlock()
 {
-    double dtinv = 1.0 / world.timeStep();
+    double dtinv = 1.0 / cfs->world.timeStep();
     const int block2 = globalNumConstraintVectors;
     const int block3 = globalNumConstraintVectors + globalNumFrictionVectors;
 
@@ -1766,11 +2240,11 @@ void CFSImpl::setConstantVectorAndMuBlock()
                 // contact constraint
                 if(ENABLE_CONTACT_DEPTH_CORRECTION){
                     double velOffset;
-                    const double depth = constraint.depth - contactCorrectionDepth;
+                    const double depth = constraint.depth - cfs->contactCorrectionDepth;
                     if(depth <= 0.0){
-                        velOffset = contactCorrectionVelocityRatio * depth;
+                        velOffset = cfs->contactCorrectionVelocityRatio * depth;
                     } else {
-                        velOffset = contactCorrectionVelocityRatio * (-1.0 / (depth + 1.0) + 1.0);
+                        velOffset = cfs->contactCorrectionVelocityRatio * (-1.0 / (depth + 1.0) + 1.0);
                     }
                     b(globalIndex) = an0(globalIndex) + (constraint.normalProjectionOfRelVelocityOn0 - velOffset) * dtinv;
                 } else {
@@ -1806,7 +2280,7 @@ void CFSImpl::setConstantVectorAndMuBlock()
 }
 
 
-void CFSImpl::addConstraintForceToLinks()
+void CFSImpl::ConstraintIsland::addConstraintForceToLinks()
 {
     int n = constrainedLinkPairs.size();
     for(int i=0; i < n; ++i){
@@ -1820,7 +2294,7 @@ void CFSImpl::addConstraintForceToLinks()
 }
 
 
-void CFSImpl::addConstraintForceToLink(LinkPair* linkPair, int ipair)
+void CFSImpl::ConstraintIsland::addConstraintForceToLink(LinkPair* linkPair, int ipair)
 {
     Vector3 f_total   = Vector3::Zero();
     Vector3 tau_total = Vector3::Zero();
@@ -1843,7 +2317,7 @@ void CFSImpl::addConstraintForceToLink(LinkPair* linkPair, int ipair)
         f_total   += f;
         tau_total += constraint.point.cross(f);
 
-        if(isConstraintForceOutputMode){
+        if(cfs->isConstraintForceOutputMode){
             link->constraintForces().push_back(DyLink::ConstraintForce(constraint.point, f));
         }
     }
@@ -1859,15 +2333,122 @@ void CFSImpl::addConstraintForceToLink(LinkPair* linkPair, int ipair)
 
 
 
-void CFSImpl::solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b, VectorX& x)
+/**
+   The rows of a link pair are coupled with the link pairs sharing a non-static body because
+   a test force applied to a body only accelerates the links of the body. This structure is
+   determined by the constrained link pairs, so it is built once per step and used by all the
+   Gauss-Seidel iterations.
+*/
+void CFSImpl::ConstraintIsland::buildSparseRowStructure()
+{
+    const int n = globalNumConstraintVectors;
+    const int numLinkPairs = constrainedLinkPairs.size();
+
+    bodySlotToLinkPairs.resize(constrainedBodiesData.size());
+    for(auto& linkPairs : bodySlotToLinkPairs){
+        linkPairs.clear();
+    }
+    rowToLinkPairIndex.resize(Mlcp.rows());
+
+    for(int i=0; i < numLinkPairs; ++i){
+        LinkPair* linkPair = constrainedLinkPairs[i];
+        for(int j=0; j < 2; ++j){
+            int slot = linkPairToBodySlots[i * 2 + j];
+            if(slot >= 0 && (j == 0 || slot != linkPairToBodySlots[i * 2])){
+                bodySlotToLinkPairs[slot].push_back(i);
+            }
+        }
+        for(auto& constraint : linkPair->constraintPoints){
+            rowToLinkPairIndex[constraint.globalIndex] = i;
+            for(int k=0; k < constraint.numFrictionVectors; ++k){
+                rowToLinkPairIndex[n + constraint.globalFrictionIndex + k] = i;
+            }
+        }
+    }
+
+    columnRanges.clear();
+    linkPairToColumnRangeOffset.resize(numLinkPairs + 1);
+    couplingMarks.assign(numLinkPairs, -1);
+
+    for(int i=0; i < numLinkPairs; ++i){
+        couplingLinkPairs.clear();
+        for(int j=0; j < 2; ++j){
+            int slot = linkPairToBodySlots[i * 2 + j];
+            if(slot >= 0){
+                for(auto& k : bodySlotToLinkPairs[slot]){
+                    if(couplingMarks[k] != i){
+                        couplingMarks[k] = i;
+                        couplingLinkPairs.push_back(k);
+                    }
+                }
+            }
+        }
+        // The constraint indices increase with the link pair index
+        std::sort(couplingLinkPairs.begin(), couplingLinkPairs.end());
+
+        linkPairToColumnRangeOffset[i] = columnRanges.size();
+        
+        for(int block=0; block < 2; ++block){
+            int lastEnd = -1;
+            for(auto& k : couplingLinkPairs){
+                ConstraintPointArray& constraintPoints = constrainedLinkPairs[k]->constraintPoints;
+                int begin, size;
+                if(block == 0){
+                    begin = constraintPoints.front().globalIndex;
+                    size = constraintPoints.size();
+                } else {
+                    if(constrainedLinkPairs[k]->isNonContactConstraint){
+                        continue;
+                    }
+                    begin = n + constraintPoints.front().globalFrictionIndex;
+                    size = 0;
+                    for(auto& constraint : constraintPoints){
+                        size += constraint.numFrictionVectors;
+                    }
+                }
+                if(size > 0){
+                    if(begin == lastEnd){
+                        columnRanges.back().size += size;
+                    } else {
+                        columnRanges.push_back({ begin, size });
+                    }
+                    lastEnd = begin + size;
+                }
+            }
+        }
+    }
+    linkPairToColumnRangeOffset[numLinkPairs] = columnRanges.size();
+}
+
+
+inline double CFSImpl::ConstraintIsland::calcRowProduct(const MatrixX& M, const VectorX& x, int row, int size) const
+{
+    double sum = 0.0;
+    if(isSparseRowStructureEnabled){
+        const int linkPairIndex = rowToLinkPairIndex[row];
+        const int end = linkPairToColumnRangeOffset[linkPairIndex + 1];
+        for(int i = linkPairToColumnRangeOffset[linkPairIndex]; i < end; ++i){
+            const ColumnRange& range = columnRanges[i];
+            sum += M.row(row).segment(range.begin, range.size).dot(x.segment(range.begin, range.size));
+        }
+    } else {
+        for(int k=0; k < size; ++k){
+            sum += M(row, k) * x(k);
+        }
+    }
+    return sum;
+}
+
+
+void CFSImpl::ConstraintIsland::solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b, VectorX& x)
 {
     static const int loopBlockSize = DEFAULT_NUM_GAUSS_SEIDEL_ITERATION_BLOCK;
 
-    if(numGaussSeidelInitialIteration > 0){
-        solveMCPByProjectedGaussSeidelInitial(M, b, x, numGaussSeidelInitialIteration);
+    if(cfs->numGaussSeidelInitialIteration > 0){
+        solveMCPByProjectedGaussSeidelInitial(M, b, x, cfs->numGaussSeidelInitialIteration);
     }
 
-    int numBlockLoops = maxNumGaussSeidelIteration / loopBlockSize;
+    int numBlockLoops = cfs->maxNumGaussSeidelIteration / loopBlockSize;
     if(numBlockLoops==0){
         numBlockLoops = 1;
     }
@@ -1909,7 +2490,7 @@ void CFSImpl::solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b,
             }
         }
 
-        if(error < gaussSeidelErrorCriterion){
+        if(error < cfs->gaussSeidelErrorCriterion){
             if(CFS_MCP_DEBUG_SHOW_ITERATION_STOP){
                 os << "stopped at " << (i * loopBlockSize) << ", error = " << error << endl;
             }
@@ -1924,17 +2505,17 @@ void CFSImpl::solveMCPByProjectedGaussSeidel(const MatrixX& M, const VectorX& b,
         }
         
         int n = loopBlockSize * i;
-        numGaussSeidelTotalLoops += n;
-        numGaussSeidelTotalCalls++;
-        numGaussSeidelTotalLoopsMax = std::max(numGaussSeidelTotalLoopsMax, n);
-        os << ", avarage = " << (numGaussSeidelTotalLoops / numGaussSeidelTotalCalls);
-        os << ", max = " << numGaussSeidelTotalLoopsMax;
+        cfs->numGaussSeidelTotalLoops += n;
+        cfs->numGaussSeidelTotalCalls++;
+        cfs->numGaussSeidelTotalLoopsMax = std::max(cfs->numGaussSeidelTotalLoopsMax, n);
+        os << ", avarage = " << (cfs->numGaussSeidelTotalLoops / cfs->numGaussSeidelTotalCalls);
+        os << ", max = " << cfs->numGaussSeidelTotalLoopsMax;
         os << endl;
     }
 }
 
 
-void CFSImpl::solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const VectorX& b, VectorX& x)
+void CFSImpl::ConstraintIsland::solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const VectorX& b, VectorX& x)
 {
     const int size = globalNumConstraintVectors + globalNumFrictionVectors;
 
@@ -1944,10 +2525,7 @@ void CFSImpl::solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const Vec
         if(M(j,j) == numeric_limits<double>::max()){
             xx=0.0;
         } else {
-            double sum = -M(j, j) * x(j);
-            for(int k=0; k < size; ++k){
-                sum += M(j, k) * x(k);
-            }
+            double sum = -M(j, j) * x(j) + calcRowProduct(M, x, j, size);
             xx = (-b(j) - sum) / M(j, j);
         }
         if(xx < 0.0){
@@ -1963,10 +2541,7 @@ void CFSImpl::solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const Vec
         if(M(j,j) == numeric_limits<double>::max()){
             x(j)=0.0;
         } else {
-            double sum = -M(j, j) * x(j);
-            for(int k=0; k < size; ++k){
-                sum += M(j, k) * x(k);
-            }
+            double sum = -M(j, j) * x(j) + calcRowProduct(M, x, j, size);
             x(j) = (-b(j) - sum) / M(j, j);
         }
     }
@@ -1981,10 +2556,7 @@ void CFSImpl::solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const Vec
             if(M(j,j) == numeric_limits<double>::max()) {
                 fx0 = 0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = -M(j, j) * x(j) + calcRowProduct(M, x, j, size);
                 fx0 = (-b(j) - sum) / M(j, j);
             }
             double& fx = x(j);
@@ -1995,10 +2567,7 @@ void CFSImpl::solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const Vec
             if(M(j,j) == numeric_limits<double>::max()) {
                 fy0=0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = -M(j, j) * x(j) + calcRowProduct(M, x, j, size);
                 fy0 = (-b(j) - sum) / M(j, j);
             }
             double& fy = x(j);
@@ -2026,10 +2595,7 @@ void CFSImpl::solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const Vec
             if(M(j,j) == numeric_limits<double>::max()) {
                 xx=0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = -M(j, j) * x(j) + calcRowProduct(M, x, j, size);
                 xx = (-b(j) - sum) / M(j, j);
             }
             
@@ -2049,7 +2615,7 @@ void CFSImpl::solveMCPByProjectedGaussSeidelMainStep(const MatrixX& M, const Vec
 }
 
 
-void CFSImpl::solveMCPByProjectedGaussSeidelInitial
+void CFSImpl::ConstraintIsland::solveMCPByProjectedGaussSeidelInitial
 (const MatrixX& M, const VectorX& b, VectorX& x, const int numIteration)
 {
     const int size = globalNumConstraintVectors + globalNumFrictionVectors;
@@ -2065,10 +2631,7 @@ void CFSImpl::solveMCPByProjectedGaussSeidelInitial
             if(M(j,j)==numeric_limits<double>::max()){
                 xx=0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = -M(j, j) * x(j) + calcRowProduct(M, x, j, size);
                 xx = (-b(j) - sum) / M(j, j);
             }
             if(xx < 0.0){
@@ -2085,10 +2648,7 @@ void CFSImpl::solveMCPByProjectedGaussSeidelInitial
             if(M(j,j)==numeric_limits<double>::max()){
                 x(j) = 0.0;
             } else {
-                double sum = -M(j, j) * x(j);
-                for(int k=0; k < size; ++k){
-                    sum += M(j, k) * x(k);
-                }
+                double sum = -M(j, j) * x(j) + calcRowProduct(M, x, j, size);
                 x(j) = r * (-b(j) - sum) / M(j, j);
             }
             r += rstep;
@@ -2103,10 +2663,7 @@ void CFSImpl::solveMCPByProjectedGaussSeidelInitial
                 if(M(j,j)==numeric_limits<double>::max())
                     fx0 = 0.0;
                 else{
-                    double sum = -M(j, j) * x(j);
-                    for(int k=0; k < size; ++k){
-                        sum += M(j, k) * x(k);
-                    }
+                    double sum = -M(j, j) * x(j) + calcRowProduct(M, x, j, size);
                     fx0 = (-b(j) - sum) / M(j, j);
                 }
                 double& fx = x(j);
@@ -2117,10 +2674,7 @@ void CFSImpl::solveMCPByProjectedGaussSeidelInitial
                 if(M(j,j)==numeric_limits<double>::max())
                     fy0 = 0.0;
                 else{
-                    double sum = -M(j, j) * x(j);
-                    for(int k=0; k < size; ++k){
-                        sum += M(j, k) * x(k);
-                    }
+                    double sum = -M(j, j) * x(j) + calcRowProduct(M, x, j, size);
                     fy0 = (-b(j) - sum) / M(j, j);
                 }
                 double& fy = x(j);
@@ -2149,10 +2703,7 @@ void CFSImpl::solveMCPByProjectedGaussSeidelInitial
                 if(M(j,j)==numeric_limits<double>::max())
                     xx = 0.0;
                 else{
-                    double sum = -M(j, j) * x(j);
-                    for(int k=0; k < size; ++k){
-                        sum += M(j, k) * x(k);
-                    }
+                    double sum = -M(j, j) * x(j) + calcRowProduct(M, x, j, size);
                     xx = (-b(j) - sum) / M(j, j);
                 }
 
@@ -2175,7 +2726,7 @@ void CFSImpl::solveMCPByProjectedGaussSeidelInitial
 }
 
 
-void CFSImpl::checkLCPResult(MatrixX& M, VectorX& b, VectorX& x)
+void CFSImpl::ConstraintIsland::checkLCPResult(MatrixX& M, VectorX& b, VectorX& x)
 {
     os << "check LCP result\n";
     os << "-------------------------------\n";
@@ -2205,7 +2756,7 @@ void CFSImpl::checkLCPResult(MatrixX& M, VectorX& b, VectorX& x)
 }
 
 
-void CFSImpl::checkMCPResult(MatrixX& M, VectorX& b, VectorX& x)
+void CFSImpl::ConstraintIsland::checkMCPResult(MatrixX& M, VectorX& b, VectorX& x)
 {
     os << "check MCP result\n";
     os << "-------------------------------\n";
@@ -2255,7 +2806,7 @@ void CFSImpl::checkMCPResult(MatrixX& M, VectorX& b, VectorX& x)
 
 
 #ifdef USE_PIVOTING_LCP
-bool CFSImpl::callPathLCPSolver(MatrixX& Mlcp, VectorX& b, VectorX& solution)
+bool CFSImpl::ConstraintIsland::callPathLCPSolver(MatrixX& Mlcp, VectorX& b, VectorX& solution)
 {
     int size = solution.size();
     int square = size * size;
@@ -2467,6 +3018,55 @@ void ConstraintForceSolver::set2Dmode(bool on)
 }
 
 
+/**
+   When this is enabled, the constrained link pairs are divided into the islands which do not
+   share any non-static body, and the LCP of each island is solved separately.
+*/
+void ConstraintForceSolver::setIslandDecompositionEnabled(bool on)
+{
+    impl->isIslandDecompositionEnabled = on;
+}
+
+
+bool ConstraintForceSolver::isIslandDecompositionEnabled() const
+{
+    return impl->isIslandDecompositionEnabled;
+}
+
+
+/**
+   When this is enabled, the Gauss-Seidel iterations only visit the blocks of the matrix
+   coupling the link pairs which share a non-static body instead of the whole rows.
+*/
+void ConstraintForceSolver::setSparseGaussSeidelEnabled(bool on)
+{
+    impl->isSparseGaussSeidelEnabled = on;
+}
+
+
+bool ConstraintForceSolver::isSparseGaussSeidelEnabled() const
+{
+    return impl->isSparseGaussSeidelEnabled;
+}
+
+
+/**
+   When the number of threads is more than one, the islands are solved in parallel, and
+   the columns of the acceleration matrix are calculated in parallel when there is only
+   one island. This takes effect when initialize() is called.
+*/
+void ConstraintForceSolver::setNumThreads(int n)
+{
+    impl->numThreads = std::max(n, 1);
+}
+
+
+int ConstraintForceSolver::numThreads() const
+{
+    return impl->numThreads;
+}
+
+
 void ConstraintForceSolver::initialize(void)
 {
     impl->initialize();
@@ -59,6 +59,13 @@ public:
     void set2Dmode(bool on);
     void enableConstraintForceOutput(bool on);
 
+    void setIslandDecompositionEnabled(bool on);
+    bool isIslandDecompositionEnabled() const;
+    void setSparseGaussSeidelEnabled(bool on);
+    bool isSparseGaussSeidelEnabled() const;
+    void setNumThreads(int n);
+    int numThreads() const;
+
     void initialize(void);
     void solve();
     void clearExternalForces();
@@ -7,6 +7,7 @@
 #include "DyBody.h"
 #include "LinkTraverse.h"
 #include <cnoid/EigenUtil>
+#include <cnoid/TraceProfiler>
 
 using namespace std;
 using namespace cnoid;
@@ -65,6 +66,8 @@ inline void ForwardDynamicsABM::calcABMLastHalf()
 
 void ForwardDynamicsABM::calcNextState()
 {
+    CNOID_TRACE_ZONE("Forward dynamics");
+    
     switch(integrationMode){
 
     case EULER_METHOD:
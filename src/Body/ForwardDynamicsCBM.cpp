@@ -6,7 +6,9 @@
 #include "ForwardDynamicsCBM.h"
 #include "DyBody.h"
 #include "LinkTraverse.h"
+#include "MassMatrix.h"
 #include <cnoid/EigenUtil>
+#include <cnoid/TraceProfiler>
 #include <iostream>
 
 using namespace std;
@@ -115,6 +117,8 @@ void ForwardDynamicsCBM::initialize()
     ddqorg.resize(numLinks);
     uorg.  resize(numLinks);
 
+    initializeMassMatrixDofs();
+
     calcPositionAndVelocityFK();
 
     if(!isNoUnknownAccelMode){
@@ -169,6 +173,8 @@ inline void ForwardDynamicsCBM::calcAccelFKandForceSensorValues()
 
 void ForwardDynamicsCBM::calcNextState()
 {
+    CNOID_TRACE_ZONE("Forward dynamics");
+    
     if(isNoUnknownAccelMode && !sensorHelper.isActive()){
 
         calcPositionAndVelocityFK();
@@ -446,9 +452,65 @@ COMMON_CALCS_FOR_ALL_JOINT_TYPES:
 
 
 /**
-   calculate the mass matrix using the unit vector method
-   \todo replace the unit vector method here with
-   a more efficient method that only requires O(n) computation time
+   The DOFs of the joint-space inertia matrix are ordered as the unknown root DOFs,
+   the torque mode joints, the given root DOFs and the high-gain mode joints.
+   The parents of the DOFs in M11 are also set up for the LTDL factorization, which is only
+   available when the parent DOFs precede their child DOFs.
+*/
+void ForwardDynamicsCBM::initializeMassMatrixDofs()
+{
+    const int numLinks = body->numLinks();
+    const int n = unknown_rootDof + torqueModeJoints.size();
+    const int m = highGainModeJoints.size();
+
+    dofIndices.assign(numLinks, -1);
+    if(unknown_rootDof){
+        dofIndices[0] = 0;
+    } else if(given_rootDof){
+        dofIndices[0] = n;
+    }
+    for(size_t i=0; i < torqueModeJoints.size(); ++i){
+        dofIndices[torqueModeJoints[i]->index()] = i + unknown_rootDof;
+    }
+    for(size_t i=0; i < highGainModeJoints.size(); ++i){
+        dofIndices[highGainModeJoints[i]->index()] = i + n + given_rootDof;
+    }
+    M.resize(n + given_rootDof + m, n + given_rootDof + m);
+
+    ltdlParents.resize(n);
+    isLTDLAvailable = true;
+    for(int i=0; i < unknown_rootDof; ++i){
+        ltdlParents[i] = i - 1;
+    }
+    for(size_t i=0; i < torqueModeJoints.size(); ++i){
+        const int index = i + unknown_rootDof;
+        int parentIndex = -1;
+        for(DyLink* link = torqueModeJoints[i]->parent(); link; link = link->parent()){
+            if(link->parent()){
+                const int dofIndex = dofIndices[link->index()];
+                if(dofIndex >= 0 && dofIndex < n){
+                    parentIndex = dofIndex;
+                    break;
+                }
+            } else if(unknown_rootDof){
+                parentIndex = unknown_rootDof - 1;
+            }
+        }
+        if(parentIndex >= index){
+            isLTDLAvailable = false;
+        }
+        ltdlParents[index] = parentIndex;
+    }
+
+    L11.resize(n, n);
+    a1.resize(n);
+    isM11Factorized = false;
+}
+
+
+/**
+   The joint-space inertia matrix is calculated by the composite rigid body algorithm,
+   and b1 is calculated by an inverse dynamics calculation with zero accelerations.
 */
 void ForwardDynamicsCBM::calcMassMatrix()
 {
@@ -471,61 +533,6 @@ void ForwardDynamicsCBM::calcMassMatrix()
 	
     setColumnOfMassMatrix(b1, 0);
 
-    if(unknown_rootDof){
-        for(int i=0; i < 3; ++i){
-            root->dvo()[i] += 1.0;
-            setColumnOfMassMatrix(M11, i);
-            root->dvo()[i] -= 1.0;
-        }
-        for(int i=0; i < 3; ++i){
-            root->dw()[i] = 1.0;
-            Vector3 dw_x_p = root->dw().cross(root->p());
-            root->dvo() -= dw_x_p;
-            setColumnOfMassMatrix(M11, i + 3);
-            root->dvo() += dw_x_p;
-            root->dw()[i] = 0.0;
-        }
-    }
-    if(given_rootDof){
-        for(int i=0; i < 3; ++i){
-            root->dvo()[i] += 1.0;
-            setColumnOfMassMatrix(M12, i);
-            root->dvo()[i] -= 1.0;
-        }
-        for(int i=0; i < 3; ++i){
-            root->dw()[i] = 1.0;
-            Vector3 dw_x_p = root->dw().cross(root->p());
-            root->dvo() -= dw_x_p;
-            setColumnOfMassMatrix(M12, i + 3);
-            root->dvo() += dw_x_p;
-            root->dw()[i] = 0.0;
-        }
-    }
-
-    for(size_t i=0; i < torqueModeJoints.size(); ++i){
-        DyLink* link = torqueModeJoints[i];
-        link->ddq() = 1.0;
-        int j = i + unknown_rootDof;
-        setColumnOfMassMatrix(M11, j);
-        M11(j, j) += link->Jm2(); // motor inertia
-        link->ddq() = 0.0;
-    }
-    for(size_t i=0; i < highGainModeJoints.size(); ++i){
-        DyLink* link = highGainModeJoints[i];
-        link->ddq() = 1.0;
-        int j = i + given_rootDof;
-        setColumnOfMassMatrix(M12, j);
-        link->ddq() = 0.0;
-    }
-
-    // subtract the constant term
-    for(int i=0; i < M11.cols(); ++i){
-        M11.col(i) -= b1;
-    }
-    for(int i=0; i < M12.cols(); ++i){
-        M12.col(i) -= b1;
-    }
-
     for(int i=1; i < numLinks; ++i){
         DyLink* link = body->link(i);
         link->ddq() = ddqorg[i];
@@ -534,7 +541,12 @@ void ForwardDynamicsCBM::calcMassMatrix()
     root->dvo() = dvoorg;
     root->dw()  = dworg;
 
+    calcJointSpaceInertiaMatrix(body, dofIndices, M);
+    M11 = M.topLeftCorner(M11.rows(), M11.cols());
+    M12 = M.topRightCorner(M12.rows(), M12.cols());
+
     accelSolverInitialized = false;
+    isM11Factorized = false;
 }
 
 
@@ -721,7 +733,8 @@ void ForwardDynamicsCBM::solveUnknownAccels(const Vector3& fext, const Vector3&
     c1 -= d1;
     c1 -= b1.col(0);
 
-    const VectorXd a(M11.colPivHouseholderQr().solve(c1));
+    solveM11(c1, a1);
+    const VectorXd& a = a1;
     
     if(unknown_rootDof){
         DyLink* root = body->rootLink();
@@ -737,6 +750,72 @@ void ForwardDynamicsCBM::solveUnknownAccels(const Vector3& fext, const Vector3&
 }
 
 
+/**
+   M11 is factorized as L^T D L in the order of the DOFs, which does not cause any fill-in
+   because the non-zero elements of M11 are only in the rows and columns of the ancestor DOFs.
+   This is the LTDL factorization in Featherstone's "Rigid Body Dynamics Algorithms".
+*/
+void ForwardDynamicsCBM::factorizeM11()
+{
+    isM11Factorized = true;
+    isLTDLFactorized = false;
+    
+    if(!isLTDLAvailable){
+        return;
+    }
+    
+    L11 = M11;
+    const int n = L11.rows();
+    const double minPivot = 1.0e-12 * L11.diagonal().cwiseAbs().maxCoeff();
+
+    for(int k = n - 1; k >= 0; --k){
+        const double d = L11(k, k);
+        if(!(d > minPivot)){
+            // The matrix is not positive definite. Solve it by QR decomposition.
+            return;
+        }
+        for(int i = ltdlParents[k]; i >= 0; i = ltdlParents[i]){
+            const double a = L11(k, i) / d;
+            for(int j = i; j >= 0; j = ltdlParents[j]){
+                L11(i, j) -= a * L11(k, j);
+            }
+            L11(k, i) = a;
+        }
+    }
+
+    isLTDLFactorized = true;
+}
+
+
+void ForwardDynamicsCBM::solveM11(const VectorXd& c, VectorXd& out_a)
+{
+    if(!isM11Factorized){
+        factorizeM11();
+    }
+
+    if(!isLTDLFactorized){
+        out_a = M11.colPivHouseholderQr().solve(c);
+        return;
+    }
+
+    const int n = L11.rows();
+    out_a = c;
+    for(int i = n - 1; i >= 0; --i){
+        for(int j = ltdlParents[i]; j >= 0; j = ltdlParents[j]){
+            out_a(j) -= L11(i, j) * out_a(i);
+        }
+    }
+    for(int i=0; i < n; ++i){
+        out_a(i) /= L11(i, i);
+    }
+    for(int i=0; i < n; ++i){
+        for(int j = ltdlParents[i]; j >= 0; j = ltdlParents[j]){
+            out_a(i) -= L11(i, j) * out_a(j);
+        }
+    }
+}
+
+
 void ForwardDynamicsCBM::calcAccelFKandForceSensorValues(DyLink* link, Vector3& out_f, Vector3& out_tau)
 {
     const DyLink* parent = link->parent();
@@ -79,6 +79,21 @@ private:
 
     bool isNoUnknownAccelMode;
 
+    // The joint-space inertia matrix of all the DOFs. M11 and M12 are its blocks.
+    MatrixXd M;
+    std::vector<int> dofIndices;
+
+    /*
+      LTDL factorization of M11. ltdlParents[i] is the nearest ancestor DOF of DOF i in M11,
+      or -1. The lower triangle of L11 contains L and the diagonal contains D.
+    */
+    MatrixXd L11;
+    std::vector<int> ltdlParents;
+    bool isLTDLAvailable;
+    bool isM11Factorized;
+    bool isLTDLFactorized;
+    VectorXd a1;
+
     VectorXd qGiven;
     VectorXd dqGiven;
     VectorXd ddqGiven;
@@ -102,7 +117,7 @@ private:
 
     Vector3 root_w_x_v;
 
-    // buffers for the unit vector method
+    // buffers for calculating b1
     VectorXd ddqorg;
     VectorXd uorg;
     Vector3 dvoorg;
@@ -144,8 +159,11 @@ private:
     void integrateRungeKuttaOneStep(double r, double dt);
     void preserveHighGainModeJointState();
     void calcPositionAndVelocityFK();
+    void initializeMassMatrixDofs();
     void calcMassMatrix();
     void setColumnOfMassMatrix(MatrixXd& M, int column);
+    void factorizeM11();
+    void solveM11(const VectorXd& c, VectorXd& out_a);
     void calcInverseDynamics(DyLink* link, Vector3& out_f, Vector3& out_tau);
     void calcd1(DyLink* link, Vector3& out_f, Vector3& out_tau);
     inline void calcAccelFKandForceSensorValues();
@@ -4,27 +4,35 @@
 
 #include "MassMatrix.h"
 #include "Link.h"
-#include "InverseDynamics.h"
+#include <cnoid/EigenUtil>
 
 using namespace cnoid;
 
 namespace {
 
-void setColumnOfMassMatrix(Body* body, MatrixXd& out_M, int column)
+typedef Eigen::Matrix<double, 6, 6> Matrix6;
+
+/**
+   The columns of S are the motion subspace of the link in the coordinates (dvo, dw).
+   For the root link, dv, which is the acceleration of the root link origin, is used instead of dvo.
+*/
+int getMotionSubspace(const Link* link, Matrix6& S)
 {
-    Link* rootLink = body->rootLink();
-    Vector6 f = calcInverseDynamics(rootLink);
-        
-    if(!rootLink->isFixedJoint()){
-        f.tail<3>() -= rootLink->p().cross(f.head<3>());
-        out_M.block<6, 1>(0, column) = f;
-    }
-    const int n = body->numJoints();
-    for(int i = 0; i < n; ++i){
-        Link* joint = body->joint(i);
-        out_M(i + 6, column) = joint->u();
+    if(!link->parent()){
+        S.setIdentity();
+        S.topRightCorner<3, 3>() = hat(link->p());
+        return 6;
+    } else if(link->isRevoluteJoint()){
+        const Vector3 sw = link->R() * link->a();
+        S.col(0) << link->p().cross(sw), sw;
+        return 1;
+    } else if(link->isPrismaticJoint()){
+        S.col(0) << link->R() * link->d(), Vector3::Zero();
+        return 1;
     }
+    return 0;
 }
+
 }
 
 
@@ -32,80 +40,106 @@ namespace cnoid {
 
 
 /**
-   calculate the mass matrix using the unit vector method
-   \todo replace the unit vector method here with a more efficient method
-       
-   The motion equation (dv != dvo)
-   |       |   | dv   |   |    |   | fext      |
-   | out_M | * | dw   | + | b1 | = | tauext    |
-   |       |   |ddq   |   |    |   | u         |
+   Calculate the joint-space inertia matrix by the composite rigid body algorithm.
+   The spatial inertias and the joint axes are expressed in the world frame around the origin,
+   so the composite inertia of a subtree is the sum of the inertias of its links and the force
+   to accelerate the subtree with a joint does not have to be transformed on the way to the root.
+   The elements of joints which are not in an ancestor-descendant relation are zero.
 */
-void calcMassMatrix(Body* body, const Vector3& g, Eigen::MatrixXd& out_M)
+void calcJointSpaceInertiaMatrix(Body* body, const std::vector<int>& dofIndices, MatrixXd& out_M)
 {
-    const int nj = body->numJoints();
-    Link* rootLink = body->rootLink();
-    const int totaldof = rootLink->isFixedJoint() ? nj : nj + 6;
-
-    out_M.resize(totaldof, totaldof);
-        
-    // preserve and clear the joint accelerations
-    VectorXd ddqorg(nj);
-    VectorXd uorg(nj);
-    for(int i = 0; i < nj; ++i){
-        Link* joint = body->joint(i);
-        ddqorg[i] = joint->ddq();
-        uorg  [i] = joint->u();
-        joint->ddq() = 0.0;
+    const LinkTraverse& traverse = body->linkTraverse();
+    const int numLinks = traverse.numLinks();
+
+    std::vector<Matrix6, Eigen::aligned_allocator<Matrix6>> Ic(numLinks);
+
+    for(int i=0; i < numLinks; ++i){
+        const Link* link = traverse[i];
+        const Vector3 wc = link->R() * link->c() + link->p();
+        const Matrix3 Iw = link->R() * link->I() * link->R().transpose();
+        const Matrix3 c_hat = hat(wc);
+        const Matrix3 Iwv = link->m() * c_hat;
+        Matrix6& I = Ic[link->index()];
+        I.topLeftCorner<3, 3>() = link->m() * Matrix3::Identity();
+        I.topRightCorner<3, 3>() = Iwv.transpose();
+        I.bottomLeftCorner<3, 3>() = Iwv;
+        I.bottomRightCorner<3, 3>().noalias() = link->m() * c_hat * c_hat.transpose() + Iw;
     }
 
-    // preserve and clear the root link acceleration
-    const Vector3 dvorg = rootLink->dv();
-    const Vector3 dworg  = rootLink->dw();
+    // backward pass
+    for(int i = numLinks - 1; i > 0; --i){
+        const Link* link = traverse[i];
+        if(link->parent()){
+            Ic[link->parent()->index()] += Ic[link->index()];
+        }
+    }
 
-    //const Vector3 root_w_x_v = rootLink->w().cross(rootLink->vo() + rootLink->w().cross(rootLink->p()));
+    out_M.setZero();
 
-    rootLink->dv() = g;
-    rootLink->dw().setZero();
-	
-    MatrixXd b1(totaldof, 1);
-        
-    setColumnOfMassMatrix(body, b1, 0);
+    Matrix6 S, Sa, F;
+    
+    for(int i=0; i < numLinks; ++i){
+        const Link* link = traverse[i];
+        const int index = dofIndices[link->index()];
+        if(index < 0){
+            continue;
+        }
+        const int dof = getMotionSubspace(link, S);
+        if(dof == 0){
+            continue;
+        }
 
-    if(!rootLink->isFixedJoint()){
-        for(int i=0; i < 3; ++i){
-            rootLink->dv()[i] += 1.0;
-            setColumnOfMassMatrix(body, out_M, i);
-            rootLink->dv()[i] -= 0.0;
+        F.leftCols(dof).noalias() = Ic[link->index()] * S.leftCols(dof);
+        out_M.block(index, index, dof, dof).noalias() = S.leftCols(dof).transpose() * F.leftCols(dof);
+        if(link->parent()){
+            out_M(index, index) += link->Jm2(); // motor inertia
         }
-        for(int i=0; i < 3; ++i){
-            rootLink->dw()[i] = 1.0;
-            setColumnOfMassMatrix(body, out_M, i + 3);
-            rootLink->dw()[i] = 0.0;
+
+        for(const Link* ancestor = link->parent(); ancestor; ancestor = ancestor->parent()){
+            const int ancestorIndex = dofIndices[ancestor->index()];
+            if(ancestorIndex >= 0){
+                const int ancestorDof = getMotionSubspace(ancestor, Sa);
+                if(ancestorDof > 0){
+                    out_M.block(ancestorIndex, index, ancestorDof, dof).noalias() =
+                        Sa.leftCols(ancestorDof).transpose() * F.leftCols(dof);
+                    out_M.block(index, ancestorIndex, dof, ancestorDof) =
+                        out_M.block(ancestorIndex, index, ancestorDof, dof).transpose();
+                }
+            }
         }
     }
+}
 
-    for(int i = 0; i < nj; ++i){
-        Link* joint = body->joint(i);
-        joint->ddq() = 1.0;
-        int j = i + 6;
-        setColumnOfMassMatrix(body, out_M, j);
-        out_M(j, j) += joint->Jm2(); // motor inertia
-        joint->ddq() = 0.0;
-    }
 
-    // subtract the constant term
-    for(int i = 0; i < out_M.cols(); ++i){
-        out_M.col(i) -= b1;
-    }
+/**
+   calculate the mass matrix by the composite rigid body algorithm.
+   The gravity does not affect the matrix.
+       
+   The motion equation (dv != dvo)
+   |       |   | dv   |   |    |   | fext      |
+   | out_M | * | dw   | + | b1 | = | tauext    |
+   |       |   |ddq   |   |    |   | u         |
+*/
+void calcMassMatrix(Body* body, const Vector3& /* g */, Eigen::MatrixXd& out_M)
+{
+    const int nj = body->numJoints();
+    Link* rootLink = body->rootLink();
+    const int rootDof = rootLink->isFixedJoint() ? 0 : 6;
+    const int totaldof = nj + rootDof;
 
-    // recover state
+    std::vector<int> dofIndices(body->numLinks(), -1);
+    if(rootDof){
+        dofIndices[rootLink->index()] = 0;
+    }
     for(int i = 0; i < nj; ++i){
         Link* joint = body->joint(i);
-        joint->ddq()  = ddqorg[i];
-        joint->u()    = uorg  [i];
+        if(joint->parent()){
+            dofIndices[joint->index()] = i + rootDof;
+        }
     }
-    rootLink->dv() = dvorg;
-    rootLink->dw() = dworg;
+
+    out_M.resize(totaldof, totaldof);
+    calcJointSpaceInertiaMatrix(body, dofIndices, out_M);
 }
 
 
@@ -123,4 +157,3 @@ void calcMassMatrix(Body* body, MatrixXd& out_M)
 }
 
 }
-
@@ -10,6 +10,16 @@
 
 namespace cnoid {
 
+/**
+   This function calculates the joint-space inertia matrix of the links by the composite rigid
+   body algorithm. The link positions must be updated in advance.
+   \param dofIndices The row and column of the joint of each link in out_M, or -1 to exclude the joint.
+   The element of the root link is the first row of the six root DOFs (dv, dw), where dv is the
+   acceleration of the root link origin.
+   \param out_M The matrix must be resized by the caller.
+*/
+CNOID_EXPORT void calcJointSpaceInertiaMatrix(Body* body, const std::vector<int>& dofIndices, MatrixXd& out_M);
+
 CNOID_EXPORT void calcMassMatrix(Body* body, const Vector3& g, MatrixXd& out_M);
 CNOID_EXPORT void calcMassMatrix(Body* body, MatrixXd& out_M);
 
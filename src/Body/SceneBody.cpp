@@ -130,6 +130,7 @@ public:
     SgGroupPtr sceneLinkGroup;
     std::vector<SceneDevicePtr> sceneDevices;
     std::function<SceneLink*(Link*)> sceneLinkFactory;
+    SgUpdateTransaction linkPositionUpdate;
 
     SceneBodyImpl(SceneBody* self, std::function<SceneLink*(Link*)> sceneLinkFactory);
     void cloneShape(SgCloneMap& cloneMap);
@@ -399,13 +400,22 @@ void SceneBody::updateLinkPositions()
 
 
 void SceneBody::updateLinkPositions(SgUpdate& update)
+{
+    auto& transaction = impl->linkPositionUpdate;
+    transaction.setAction(update.action());
+    updateLinkPositions(transaction);
+    transaction.commit();
+}
+
+
+void SceneBody::updateLinkPositions(SgUpdateTransaction& transaction)
 {
     const int n = sceneLinks_.size();
     for(int i=0; i < n; ++i){
         SceneLinkPtr& sLink = sceneLinks_[i];
         sLink->setRotation(sLink->link()->attitude());
         sLink->setTranslation(sLink->link()->translation());
-        sLink->notifyUpdate(update);
+        transaction.add(sLink);
     }
 }
 
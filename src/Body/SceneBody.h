@@ -72,6 +72,12 @@ public:
     void updateLinkPositions();
     void updateLinkPositions(SgUpdate& update);
 
+    /**
+       The scene links are added to the transaction instead of being notified one by one.
+       The updates are notified when the transaction is committed.
+    */
+    void updateLinkPositions(SgUpdateTransaction& transaction);
+
     SceneDevice* getSceneDevice(Device* device);
     void setSceneDeviceUpdateConnection(bool on);
     void updateSceneDevices(double time);
@@ -6,6 +6,7 @@
 #include "ZMPSeq.h"
 #include "BodyMotion.h"
 #include <cnoid/YAMLWriter>
+#include <cnoid/ValueTree>
 
 using namespace std;
 using namespace cnoid;
@@ -91,6 +92,21 @@ bool ZMPSeq::doWriteSeq(YAMLWriter& writer)
 }
 
 
+void ZMPSeq::writeBinarySeqAttributes(Mapping& attributes) const
+{
+    if(isRootRelative_){
+        attributes.write("isRootRelative", true);
+    }
+}
+
+
+void ZMPSeq::readBinarySeqAttributes(const Mapping& attributes)
+{
+    isRootRelative_ = false;
+    attributes.read("isRootRelative", isRootRelative_);
+}
+
+
 bool ZMPSeq::doReadSeq(const Mapping* archive, std::ostream& os)
 {
     if(Vector3Seq::doReadSeq(archive, os)){
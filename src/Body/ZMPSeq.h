@@ -27,6 +27,9 @@ public:
     bool isRootRelative() const { return isRootRelative_; }
     void setRootRelative(bool on);
 
+    virtual void writeBinarySeqAttributes(Mapping& attributes) const override;
+    virtual void readBinarySeqAttributes(const Mapping& attributes) override;
+
 protected:
     virtual bool doReadSeq(const Mapping* archive, std::ostream& os) override;
     virtual bool doWriteSeq(YAMLWriter& writer) override;
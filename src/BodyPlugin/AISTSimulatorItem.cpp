@@ -20,11 +20,13 @@
 #include <cnoid/DyBody>
 #include <cnoid/ForwardDynamicsCBM>
 #include <cnoid/ConstraintForceSolver>
+#include <cnoid/AISTCollisionDetector>
 #include <cnoid/LeggedBodyHelper>
 #include <cnoid/FloatingNumberString>
 #include <cnoid/EigenUtil>
 #include <cnoid/MessageView>
 #include <cnoid/IdPair>
+#include <cnoid/FileUtil>
 #include <boost/lexical_cast.hpp>
 #include <mutex>
 #include <iomanip>
@@ -45,6 +47,28 @@ const bool TRACE_FUNCTIONS = false;
 const bool ENABLE_DEBUG_OUTPUT = false;
 const double DEFAULT_GRAVITY_ACCELERATION = 9.80665;
 
+string getCollisionModelCacheDirectory()
+{
+    boost::filesystem::path path;
+#ifdef WIN32
+    const char* appdata = getenv("LOCALAPPDATA");
+    if(appdata){
+        path = boost::filesystem::path(appdata) / "Choreonoid" / "cache";
+    }
+#else
+    const char* cache = getenv("XDG_CACHE_HOME");
+    if(cache && cache[0]){
+        path = boost::filesystem::path(cache) / "choreonoid";
+    } else if(const char* home = getenv("HOME")){
+        path = boost::filesystem::path(home) / ".cache" / "choreonoid";
+    }
+#endif
+    if(path.empty()){
+        return string();
+    }
+    return getNativePathString(path / "coldet");
+}
+
 class AISTSimBody : public SimulationBody
 {
 public:
@@ -102,6 +126,11 @@ public:
     bool is2Dmode;
     bool isKinematicWalkingEnabled;
     bool isOldAccelSensorMode;
+    bool isCollisionBroadphaseEnabled;
+    bool isCollisionModelCacheEnabled;
+    bool isContactIslandDecompositionEnabled;
+    bool isSparseGaussSeidelEnabled;
+    int numSolverThreads;
 
     typedef std::map<Body*, int> BodyIndexMap;
     BodyIndexMap bodyIndexMap;
@@ -177,6 +206,11 @@ AISTSimulatorItemImpl::AISTSimulatorItemImpl(AISTSimulatorItem* self)
     isKinematicWalkingEnabled = false;
     is2Dmode = false;
     isOldAccelSensorMode = false;
+    isCollisionBroadphaseEnabled = false;
+    isCollisionModelCacheEnabled = false;
+    isContactIslandDecompositionEnabled = cfs.isIslandDecompositionEnabled();
+    isSparseGaussSeidelEnabled = cfs.isSparseGaussSeidelEnabled();
+    numSolverThreads = cfs.numThreads();
 }
 
 
@@ -206,6 +240,11 @@ AISTSimulatorItemImpl::AISTSimulatorItemImpl(AISTSimulatorItem* self, const AIST
     isKinematicWalkingEnabled = org.isKinematicWalkingEnabled;
     is2Dmode = org.is2Dmode;
     isOldAccelSensorMode = org.isOldAccelSensorMode;
+    isCollisionBroadphaseEnabled = org.isCollisionBroadphaseEnabled;
+    isCollisionModelCacheEnabled = org.isCollisionModelCacheEnabled;
+    isContactIslandDecompositionEnabled = org.isContactIslandDecompositionEnabled;
+    isSparseGaussSeidelEnabled = org.isSparseGaussSeidelEnabled;
+    numSolverThreads = org.numSolverThreads;
 }
 
 
@@ -340,6 +379,40 @@ void AISTSimulatorItem::setConstraintForceOutputEnabled(bool on)
 }
 
 
+void AISTSimulatorItem::setCollisionBroadphaseEnabled(bool on)
+{
+    impl->isCollisionBroadphaseEnabled = on;
+}
+
+
+/**
+   The AABB trees of the collision models are saved in the cache directory of the user
+   and are reused when the simulation of the same meshes is started again.
+*/
+void AISTSimulatorItem::setCollisionModelCacheEnabled(bool on)
+{
+    impl->isCollisionModelCacheEnabled = on;
+}
+
+
+void AISTSimulatorItem::setContactIslandDecompositionEnabled(bool on)
+{
+    impl->isContactIslandDecompositionEnabled = on;
+}
+
+
+void AISTSimulatorItem::setSparseGaussSeidelEnabled(bool on)
+{
+    impl->isSparseGaussSeidelEnabled = on;
+}
+
+
+void AISTSimulatorItem::setNumSolverThreads(int n)
+{
+    impl->numSolverThreads = std::max(n, 1);
+}
+
+
 Item* AISTSimulatorItem::doDuplicate() const
 {
     return new AISTSimulatorItem(*this);
@@ -426,7 +499,18 @@ bool AISTSimulatorItemImpl::initializeSimulation(const std::vector<SimulationBod
     cfs.setContactCullingDistance(contactCullingDistance.value());
     cfs.setContactCullingDepth(contactCullingDepth.value());
     cfs.setCoefficientOfRestitution(epsilon);
-    cfs.setCollisionDetector(self->getOrCreateCollisionDetector());
+    cfs.setIslandDecompositionEnabled(isContactIslandDecompositionEnabled);
+    cfs.setSparseGaussSeidelEnabled(isSparseGaussSeidelEnabled);
+    cfs.setNumThreads(numSolverThreads);
+
+    CollisionDetector* collisionDetector = self->getOrCreateCollisionDetector();
+    auto aistCollisionDetector = dynamic_cast<AISTCollisionDetector*>(collisionDetector);
+    if(aistCollisionDetector){
+        aistCollisionDetector->setBroadphaseEnabled(isCollisionBroadphaseEnabled);
+        aistCollisionDetector->setModelCacheDirectory(
+            isCollisionModelCacheEnabled ? getCollisionModelCacheDirectory() : string());
+    }
+    cfs.setCollisionDetector(collisionDetector);
 
     if(is2Dmode){
         cfs.set2Dmode(true);
@@ -434,6 +518,13 @@ bool AISTSimulatorItemImpl::initializeSimulation(const std::vector<SimulationBod
 
     world.initialize();
 
+    if(aistCollisionDetector && !aistCollisionDetector->modelCacheDirectory().empty()){
+        mvout() << (format(_("Collision models of %1%: %2% loaded from the cache, %3% built and cached."))
+                    % self->name()
+                    % aistCollisionDetector->numModelCacheHits()
+                    % aistCollisionDetector->numModelCacheMisses()) << endl;
+    }
+
     return true;
 }
 
@@ -677,6 +768,14 @@ void AISTSimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(isKinematicWalkingEnabled));
     putProperty(_("2D mode"), is2Dmode, changeProperty(is2Dmode));
     putProperty(_("Old accel sensor mode"), isOldAccelSensorMode, changeProperty(isOldAccelSensorMode));
+    putProperty(_("Collision broadphase"), isCollisionBroadphaseEnabled,
+                changeProperty(isCollisionBroadphaseEnabled));
+    putProperty(_("Collision model cache"), isCollisionModelCacheEnabled,
+                changeProperty(isCollisionModelCacheEnabled));
+    putProperty(_("Contact islands"), isContactIslandDecompositionEnabled,
+                changeProperty(isContactIslandDecompositionEnabled));
+    putProperty(_("Sparse Gauss-Seidel"), isSparseGaussSeidelEnabled, changeProperty(isSparseGaussSeidelEnabled));
+    putProperty.min(1)(_("Num solver threads"), numSolverThreads, changeProperty(numSolverThreads));
 }
 
 
@@ -703,6 +802,11 @@ bool AISTSimulatorItemImpl::store(Archive& archive)
     archive.write("kinematicWalking", isKinematicWalkingEnabled);
     archive.write("2Dmode", is2Dmode);
     archive.write("oldAccelSensorMode", isOldAccelSensorMode);
+    archive.write("collisionBroadphase", isCollisionBroadphaseEnabled);
+    archive.write("collisionModelCache", isCollisionModelCacheEnabled);
+    archive.write("contactIslands", isContactIslandDecompositionEnabled);
+    archive.write("sparseGaussSeidel", isSparseGaussSeidelEnabled);
+    archive.write("numSolverThreads", numSolverThreads);
     return true;
 }
 
@@ -737,6 +841,11 @@ bool AISTSimulatorItemImpl::restore(const Archive& archive)
     archive.read("kinematicWalking", isKinematicWalkingEnabled);
     archive.read("2Dmode", is2Dmode);
     archive.read("oldAccelSensorMode", isOldAccelSensorMode);
+    archive.read("collisionBroadphase", isCollisionBroadphaseEnabled);
+    archive.read("collisionModelCache", isCollisionModelCacheEnabled);
+    archive.read("contactIslands", isContactIslandDecompositionEnabled);
+    archive.read("sparseGaussSeidel", isSparseGaussSeidelEnabled);
+    archive.read("numSolverThreads", numSolverThreads);
     return true;
 }
 
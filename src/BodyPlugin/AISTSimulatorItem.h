@@ -46,6 +46,11 @@ public:
     void set2Dmode(bool on);
     void setKinematicWalkingEnabled(bool on);
     void setConstraintForceOutputEnabled(bool on);
+    void setCollisionBroadphaseEnabled(bool on);
+    void setCollisionModelCacheEnabled(bool on);
+    void setContactIslandDecompositionEnabled(bool on);
+    void setSparseGaussSeidelEnabled(bool on);
+    void setNumSolverThreads(int n);
 
     void addExtraJoint(ExtraJoint& extrajoint);
     void clearExtraJoint();
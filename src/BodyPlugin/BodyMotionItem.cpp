@@ -139,6 +139,16 @@ void BodyMotionItem::initializeClass(ExtensionManager* ext)
             return item->motion()->save(filename, 1.0, os);
         });
 
+    im.addLoaderAndSaver<BodyMotionItem>(
+        _("Body Motion (binary)"), "BODY-MOTION-BINARY", "bseq",
+        [](BodyMotionItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return item->motion()->loadBinaryFormat(filename, os);
+        },
+        [](BodyMotionItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return item->motion()->saveAsBinaryFormat(filename, os);
+        },
+        ItemManager::PRIORITY_OPTIONAL);
+
     initialized = true;
 }
 
@@ -5,6 +5,7 @@
 
 #include "ControllerItem.h"
 #include <cnoid/Archive>
+#include <algorithm>
 #include "gettext.h"
 
 using namespace std;
@@ -14,6 +15,10 @@ using namespace cnoid;
 ControllerItem::ControllerItem()
 {
     isNoDelayMode_ = true;
+    isSequentialControlMode_ = false;
+    isAsynchronousControlMode_ = false;
+    controlPeriod_ = 1;
+    controlPhase_ = 0;
 }
 
 
@@ -21,6 +26,10 @@ ControllerItem::ControllerItem(const ControllerItem& org)
     : Item(org)
 {
     isNoDelayMode_ = org.isNoDelayMode_;
+    isSequentialControlMode_ = org.isSequentialControlMode_;
+    isAsynchronousControlMode_ = org.isAsynchronousControlMode_;
+    controlPeriod_ = org.controlPeriod_;
+    controlPhase_ = org.controlPhase_;
 }
 
 
@@ -37,6 +46,18 @@ bool ControllerItem::setNoDelayMode(bool on)
 }
 
 
+void ControllerItem::setControlPeriod(int period)
+{
+    controlPeriod_ = std::max(period, 1);
+}
+
+
+void ControllerItem::setControlPhase(int phase)
+{
+    controlPhase_ = std::max(phase, 0);
+}
+
+
 bool ControllerItem::isActive() const
 {
     return simulatorItem_ ? simulatorItem_->isRunning() : false;
@@ -88,6 +109,10 @@ SignalProxy<void(const std::string& message)> ControllerItem::sigMessage()
 void ControllerItem::doPutProperties(PutPropertyFunction& putProperty)
 {
     putProperty(_("No delay mode"), isNoDelayMode_, changeProperty(isNoDelayMode_));
+    putProperty(_("Sequential control"), isSequentialControlMode_, changeProperty(isSequentialControlMode_));
+    putProperty.min(1)(_("Control period"), controlPeriod_, changeProperty(controlPeriod_));
+    putProperty.min(0)(_("Control phase"), controlPhase_, changeProperty(controlPhase_));
+    putProperty(_("Asynchronous control"), isAsynchronousControlMode_, changeProperty(isAsynchronousControlMode_));
     putProperty(_("Controller options"), optionString_, changeProperty(optionString_));
 }
 
@@ -95,6 +120,10 @@ void ControllerItem::doPutProperties(PutPropertyFunction& putProperty)
 bool ControllerItem::store(Archive& archive)
 {
     archive.write("isNoDelayMode", isNoDelayMode_);
+    archive.write("isSequentialControlMode", isSequentialControlMode_);
+    archive.write("controlPeriod", controlPeriod_);
+    archive.write("controlPhase", controlPhase_);
+    archive.write("isAsynchronousControlMode", isAsynchronousControlMode_);
     archive.write("controllerOptions", optionString_, DOUBLE_QUOTED);
     return true;
 }
@@ -106,6 +135,16 @@ bool ControllerItem::restore(const Archive& archive)
         // For the backward compatibility
         archive.read("isImmediateMode", isNoDelayMode_); 
     }
+    archive.read("isSequentialControlMode", isSequentialControlMode_);
+    int period;
+    if(archive.read("controlPeriod", period)){
+        setControlPeriod(period);
+    }
+    int phase;
+    if(archive.read("controlPhase", phase)){
+        setControlPhase(phase);
+    }
+    archive.read("isAsynchronousControlMode", isAsynchronousControlMode_);
     archive.read("controllerOptions", optionString_);
     return true;
 }
@@ -30,6 +30,35 @@ public:
     bool isNoDelayMode() const { return isNoDelayMode_; }
     bool setNoDelayMode(bool on);
     
+    /**
+       The control functions of the controllers in the sequential control mode are not called in
+       parallel with each other, and they are called in the order of the controllers. This mode
+       should be enabled for a controller which is not reentrant or depends on the results of
+       other controllers.
+    */
+    bool isSequentialControlMode() const { return isSequentialControlMode_; }
+    void setSequentialControlMode(bool on) { isSequentialControlMode_ = on; }
+
+    /**
+       The controller is executed on every "period" frames of the world time step, starting from
+       the frame specified by the phase offset. The time step given to the controller is the
+       period multiplied by the world time step.
+    */
+    int controlPeriod() const { return controlPeriod_; }
+    void setControlPeriod(int period);
+    int controlPhase() const { return controlPhase_; }
+    void setControlPhase(int phase);
+
+    /**
+       The control function of a controller in the asynchronous control mode is executed in its own
+       thread over the frames of its control period. The input function is called on a frame of the
+       execution, and the output function is called on the next frame of the execution after the
+       control function finishes. The outputs are always applied with the delay of one period
+       regardless of the time taken by the control function.
+    */
+    bool isAsynchronousControlMode() const { return isAsynchronousControlMode_; }
+    void setAsynchronousControlMode(bool on) { isAsynchronousControlMode_ = on; }
+
     const std::string& optionString() const { return optionString_; }
 
     /**
@@ -95,6 +124,10 @@ protected:
 private:
     SimulatorItemPtr simulatorItem_;
     bool isNoDelayMode_;
+    bool isSequentialControlMode_;
+    bool isAsynchronousControlMode_;
+    int controlPeriod_;
+    int controlPhase_;
     std::string message_;
     Signal<void(const std::string& message)> sigMessage_;
     std::string optionString_;
@@ -148,6 +148,7 @@ public:
     BodyItemPtr bodyItem;
 
     SgUpdate modified;
+    SgUpdateTransaction kinematicStateUpdate;
 
     ConnectionSet connections;
     Connection connectionToSigCollisionsUpdated;
@@ -428,14 +429,17 @@ void EditableSceneBodyImpl::onKinematicStateChanged()
 {
     if(isCmVisible){
         cmMarker->setTranslation(bodyItem->centerOfMass());
+        kinematicStateUpdate.add(cmMarker);
     }
     if(isPpcomVisible){
     	Vector3 com = bodyItem->centerOfMass();
     	com(2) = 0.0;
     	ppcomMarker->setTranslation(com);
+        kinematicStateUpdate.add(ppcomMarker);
     }
     if(isZmpVisible){
         zmpMarker->setTranslation(bodyItem->zmp());
+        kinematicStateUpdate.add(zmpMarker);
     }
 
     if(activeSimulatorItem){
@@ -447,7 +451,9 @@ void EditableSceneBodyImpl::onKinematicStateChanged()
         }
     }
 
-    self->updateLinkPositions(modified);
+    // The links and markers are notified as a single update of the body
+    self->updateLinkPositions(kinematicStateUpdate);
+    kinematicStateUpdate.commit();
 }
 
 
@@ -6,6 +6,7 @@
 #include "GLVisionSimulatorItem.h"
 #include "SimulatorItem.h"
 #include "WorldItem.h"
+#include "NameListUtil.h"
 #include <cnoid/ItemManager>
 #include <cnoid/MessageView>
 #include <cnoid/Archive>
@@ -21,10 +22,10 @@
 #include <cnoid/SceneCameras>
 #include <cnoid/SceneLights>
 #include <cnoid/EigenUtil>
+#include <cnoid/ThreadPool>
+#include <cnoid/TraceProfiler>
 #include <QThread>
 #include <QApplication>
-#include <boost/tokenizer.hpp>
-#include <boost/algorithm/string.hpp>
 #include <mutex>
 #include <condition_variable>
 #include <queue>
@@ -46,6 +47,23 @@ static const bool DEBUG_MESSAGE = false;
 #include <QGLPixelBuffer>
 #endif
 
+#if USE_QT5_OPENGL && QT_VERSION >= QT_VERSION_CHECK(5, 6, 0)
+#include <QOpenGLExtraFunctions>
+#define USE_PBO_READBACK 1
+#else
+#define USE_PBO_READBACK 0
+#endif
+
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_MAP_READ_BIT
+#define GL_MAP_READ_BIT 0x0001
+#endif
+
 #include "gettext.h"
 
 using namespace std;
@@ -69,38 +87,6 @@ inline double myNearByInt(double x)
 #endif
 }
 
-string getNameListString(const vector<string>& names)
-{
-    string nameList;
-    if(!names.empty()){
-        size_t n = names.size() - 1;
-        for(size_t i=0; i < n; ++i){
-            nameList += names[i];
-            nameList += ", ";
-        }
-        nameList += names.back();
-    }
-    return nameList;
-}
-
-bool updateNames(const string& nameListString, string& newNameListString, vector<string>& names)
-{
-    using boost::tokenizer;
-    using boost::char_separator;
-    
-    names.clear();
-    char_separator<char> sep(",");
-    tokenizer<char_separator<char>> tok(nameListString, sep);
-    for(tokenizer<char_separator<char>>::iterator p = tok.begin(); p != tok.end(); ++p){
-        string name = boost::trim_copy(*p);
-        if(!name.empty()){
-            names.push_back(name);
-        }
-    }
-    newNameListString = nameListString;
-    return true;
-}
-
 class QThreadEx : public QThread
 {
     std::function<void()> function;
@@ -159,6 +145,37 @@ public:
 
     bool hasUpdatedData;
     double depthError;
+    double onsetTime; // The onset time of the frame being rendered
+    double dataOnsetTime; // The onset time of the frame stored in the tmp data buffers
+
+    bool needsColorPixels;
+    bool needsDepthPixels;
+    vector<unsigned char> colorBuf;
+    vector<float> depthBuf;
+
+    /*
+      Pixel buffer objects for the pipelined readback. The pixels of a frame are read
+      into a slot asynchronously and they are mapped when the slot is used again, so the
+      data is delivered (number of slots - 1) frames late.
+    */
+    struct ReadbackSlot {
+        GLuint colorBuffer;
+        GLuint depthBuffer;
+        double onsetTime;
+        bool isPending;
+    };
+    vector<ReadbackSlot> readbackSlots;
+    int currentReadbackSlot;
+    ReadbackSlot* mappedReadbackSlot;
+#if USE_PBO_READBACK
+    QOpenGLExtraFunctions* glFunctions;
+#endif
+
+    struct PointChunk {
+        vector<Vector3f> points;
+        vector<unsigned char> colors;
+    };
+    vector<PointChunk> pointChunks;
     
 #if USE_QT5_OPENGL
     QOpenGLContext* glContext;
@@ -182,6 +199,8 @@ public:
     bool initialize(SensorScenePtr scene, int bodyIndex);
     SgCamera* initializeCamera(int bodyIndex);
     void initializeGL(SgCamera* sceneCamera);
+    bool initializeReadbackBuffers(int numSlots);
+    void clearReadbackBuffers();
     void startRenderingThread();
     void moveRenderingBufferToThread(QThread& thread);
     void moveRenderingBufferToMainThread();
@@ -191,9 +210,14 @@ public:
     void render(SensorScreenRenderer*& currentGLContextScreen);
     void finalizeRendering();
     void storeResultToTmpDataBuffer();
-    bool getCameraImage(Image& image);
-    bool getRangeCameraData(Image& image, vector<Vector3f>& points);
-    bool getRangeSensorData(vector<double>& rangeData);
+    bool readPixels(const unsigned char*& colorData, const float*& depthData);
+    void releasePixels();
+    int numConversionChunks() const;
+    void runConversionChunks(int numChunks, const std::function<void(int index)>& convert);
+    bool getCameraImage(const unsigned char* colorData, Image& image);
+    bool getRangeCameraData(const unsigned char* colorData, const float* depthData, Image& image, vector<Vector3f>& points);
+    void convertDepthRowsToPoints(const unsigned char* colorData, const float* depthData, int yTop, int yBottom, PointChunk& chunk);
+    bool getRangeSensorData(const float* depthData, vector<double>& rangeData);
 };
 typedef ref_ptr<SensorScreenRenderer> SensorScreenRendererPtr;
 
@@ -256,6 +280,7 @@ public:
     bool isVisionDataRecordingEnabled;
     bool isBestEffortMode;
     bool isQueueRenderingTerminationRequested;
+    std::unique_ptr<ThreadPool> conversionThreadPool;
 
     // for the single vision simulator thread rendering
     QThreadEx queueThread;
@@ -277,6 +302,8 @@ public:
     bool areAdditionalLightsEnabled;
     double maxFrameRate;
     double maxLatency;
+    int readbackLatency;
+    int numConversionThreads;
     SgCloneMap cloneMap;
         
     GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self);
@@ -326,6 +353,8 @@ GLVisionSimulatorItemImpl::GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self
     simulatorItem = 0;
     maxFrameRate = 1000.0;
     maxLatency = 1.0;
+    readbackLatency = 0;
+    numConversionThreads = 1;
     rangeSensorPrecisionRatio = 2.0;
     depthError = 0.0;
 
@@ -371,6 +400,8 @@ GLVisionSimulatorItemImpl::GLVisionSimulatorItemImpl(GLVisionSimulatorItem* self
     areAdditionalLightsEnabled = org.areAdditionalLightsEnabled;
     maxFrameRate = org.maxFrameRate;
     maxLatency = org.maxLatency;
+    readbackLatency = org.readbackLatency;
+    numConversionThreads = org.numConversionThreads;
 }
 
 
@@ -418,6 +449,18 @@ void GLVisionSimulatorItem::setMaxLatency(double latency)
 }
 
 
+void GLVisionSimulatorItem::setReadbackLatency(int frames)
+{
+    impl->setProperty(impl->readbackLatency, std::max(frames, 0));
+}
+
+
+void GLVisionSimulatorItem::setNumConversionThreads(int n)
+{
+    impl->setProperty(impl->numConversionThreads, std::max(n, 1));
+}
+
+
 void GLVisionSimulatorItem::setVisionDataRecordingEnabled(bool on)
 {
     impl->setProperty(impl->isVisionDataRecordingEnabled, on);
@@ -511,6 +554,12 @@ bool GLVisionSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorIte
     isBestEffortMode = isBestEffortModeProperty;
     renderersInRendering.clear();
 
+    if(numConversionThreads > 1){
+        conversionThreadPool.reset(new ThreadPool(numConversionThreads));
+    } else {
+        conversionThreadPool.reset();
+    }
+
     cloneMap.clear();
 
     /*
@@ -767,6 +816,13 @@ SensorScreenRenderer::SensorScreenRenderer(GLVisionSimulatorItemImpl* simImpl, D
     rangeCameraForRendering = dynamic_cast<RangeCamera*>(screenDevice);
     rangeSensorForRendering = dynamic_cast<RangeSensor*>(screenDevice);
 
+    needsColorPixels = cameraForRendering && cameraForRendering->imageType() == Camera::COLOR_IMAGE;
+    needsDepthPixels = rangeCameraForRendering || rangeSensorForRendering;
+    onsetTime = 0.0;
+    dataOnsetTime = 0.0;
+    currentReadbackSlot = 0;
+    mappedReadbackSlot = nullptr;
+
 #if USE_QT5_OPENGL
     glContext = 0;
     offscreenSurface = 0;
@@ -920,10 +976,85 @@ void SensorScreenRenderer::initializeGL(SgCamera* sceneCamera)
         renderer->enableAdditionalLights(simImpl->areAdditionalLightsEnabled);
     }
 
+    // The rows of the RGB pixels are read without padding
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    if(simImpl->readbackLatency > 0){
+        if(!initializeReadbackBuffers(simImpl->readbackLatency + 1)){
+            simImpl->os <<
+                (boost::format(_("%1%: Pipelined readback is not available for \"%2%\" because the OpenGL context "
+                                 "does not support pixel buffer objects. The pixels are read synchronously."))
+                 % simImpl->self->name() % (camera ? camera->name() : rangeSensor->name())) << endl;
+        }
+    }
+    if(readbackSlots.empty()){
+        if(needsColorPixels){
+            colorBuf.resize(pixelWidth * pixelHeight * 3);
+        }
+        if(needsDepthPixels){
+            depthBuf.resize(pixelWidth * pixelHeight);
+        }
+    }
+
     doneGLContextCurrent();
 }
 
 
+bool SensorScreenRenderer::initializeReadbackBuffers(int numSlots)
+{
+#if !USE_PBO_READBACK
+    return false;
+#else
+    const QSurfaceFormat format = glContext->format();
+    if(format.majorVersion() < 3 &&
+       !(glContext->hasExtension("GL_ARB_pixel_buffer_object") &&
+         glContext->hasExtension("GL_ARB_map_buffer_range"))){
+        return false;
+    }
+    glFunctions = glContext->extraFunctions();
+
+    readbackSlots.resize(numSlots);
+    for(auto& slot : readbackSlots){
+        slot.colorBuffer = 0;
+        slot.depthBuffer = 0;
+        slot.onsetTime = 0.0;
+        slot.isPending = false;
+        if(needsColorPixels){
+            glFunctions->glGenBuffers(1, &slot.colorBuffer);
+            glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.colorBuffer);
+            glFunctions->glBufferData(GL_PIXEL_PACK_BUFFER, pixelWidth * pixelHeight * 3, nullptr, GL_STREAM_READ);
+        }
+        if(needsDepthPixels){
+            glFunctions->glGenBuffers(1, &slot.depthBuffer);
+            glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.depthBuffer);
+            glFunctions->glBufferData(GL_PIXEL_PACK_BUFFER, pixelWidth * pixelHeight * sizeof(float), nullptr, GL_STREAM_READ);
+        }
+    }
+    glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    currentReadbackSlot = 0;
+    mappedReadbackSlot = nullptr;
+    return true;
+#endif
+}
+
+
+void SensorScreenRenderer::clearReadbackBuffers()
+{
+#if USE_PBO_READBACK
+    releasePixels();
+    for(auto& slot : readbackSlots){
+        if(slot.colorBuffer){
+            glFunctions->glDeleteBuffers(1, &slot.colorBuffer);
+        }
+        if(slot.depthBuffer){
+            glFunctions->glDeleteBuffers(1, &slot.depthBuffer);
+        }
+    }
+#endif
+    readbackSlots.clear();
+}
+
+
 // For SENSOR_THREAD_MODE
 void SensorRenderer::startSharedRenderingThread()
 {
@@ -1087,6 +1218,9 @@ void SensorRenderer::updateSensorScene(bool updateSensorForRenderingThread)
     }
     if(updateSensorForRenderingThread){
         deviceForRendering->copyStateFrom(*device);
+        for(auto& screen : screens){
+            screen->onsetTime = onsetTime;
+        }
     }
 }
     
@@ -1168,6 +1302,8 @@ void SensorRenderer::render(SensorScreenRenderer*& currentGLContextScreen, bool
 
 void SensorScreenRenderer::render(SensorScreenRenderer*& currentGLContextScreen)
 {
+    CNOID_TRACE_ZONE("Sensor rendering");
+    
     if(this != currentGLContextScreen){
         makeGLContextCurrent();
         currentGLContextScreen = this;
@@ -1195,19 +1331,140 @@ void SensorScreenRenderer::finalizeRendering()
 
 void SensorScreenRenderer::storeResultToTmpDataBuffer()
 {
+    const unsigned char* colorData = nullptr;
+    const float* depthData = nullptr;
+    if(!readPixels(colorData, depthData)){
+        // The readback pipeline has not been filled yet
+        hasUpdatedData = false;
+        return;
+    }
+    
     if(cameraForRendering){
         if(!tmpImage){
             tmpImage = std::make_shared<Image>();
         }
         if(rangeCameraForRendering){
             tmpPoints = std::make_shared<vector<Vector3f>>();
-            hasUpdatedData = getRangeCameraData(*tmpImage, *tmpPoints);
+            hasUpdatedData = getRangeCameraData(colorData, depthData, *tmpImage, *tmpPoints);
         } else {
-            hasUpdatedData = getCameraImage(*tmpImage);
+            hasUpdatedData = getCameraImage(colorData, *tmpImage);
         }
     } else if(rangeSensorForRendering){
         tmpRangeData =  std::make_shared<vector<double>>();
-        hasUpdatedData = getRangeSensorData(*tmpRangeData);
+        hasUpdatedData = getRangeSensorData(depthData, *tmpRangeData);
+    }
+
+    releasePixels();
+}
+
+
+bool SensorScreenRenderer::readPixels(const unsigned char*& colorData, const float*& depthData)
+{
+    if(readbackSlots.empty()){
+        if(needsColorPixels){
+            glReadPixels(0, 0, pixelWidth, pixelHeight, GL_RGB, GL_UNSIGNED_BYTE, &colorBuf[0]);
+            colorData = &colorBuf[0];
+        }
+        if(needsDepthPixels){
+            glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, &depthBuf[0]);
+            depthData = &depthBuf[0];
+        }
+        dataOnsetTime = onsetTime;
+        return true;
+    }
+
+#if !USE_PBO_READBACK
+    return false;
+#else
+    // Start the transfer of the current frame. This does not wait for the rendering.
+    auto& slot = readbackSlots[currentReadbackSlot];
+    if(slot.colorBuffer){
+        glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.colorBuffer);
+        glReadPixels(0, 0, pixelWidth, pixelHeight, GL_RGB, GL_UNSIGNED_BYTE, 0);
+    }
+    if(slot.depthBuffer){
+        glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.depthBuffer);
+        glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+    }
+    slot.onsetTime = onsetTime;
+    slot.isPending = true;
+
+    currentReadbackSlot = (currentReadbackSlot + 1) % readbackSlots.size();
+
+    // The next slot has the oldest frame, whose transfer has been done while rendering the later frames
+    auto& oldest = readbackSlots[currentReadbackSlot];
+    if(!oldest.isPending){
+        glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return false;
+    }
+    if(oldest.colorBuffer){
+        glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, oldest.colorBuffer);
+        colorData = static_cast<const unsigned char*>(
+            glFunctions->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pixelWidth * pixelHeight * 3, GL_MAP_READ_BIT));
+    }
+    if(oldest.depthBuffer){
+        glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, oldest.depthBuffer);
+        depthData = static_cast<const float*>(
+            glFunctions->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pixelWidth * pixelHeight * sizeof(float), GL_MAP_READ_BIT));
+    }
+    glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    oldest.isPending = false;
+    mappedReadbackSlot = &oldest;
+    dataOnsetTime = oldest.onsetTime;
+
+    if((oldest.colorBuffer && !colorData) || (oldest.depthBuffer && !depthData)){
+        releasePixels();
+        return false;
+    }
+    return true;
+#endif
+}
+
+
+void SensorScreenRenderer::releasePixels()
+{
+#if USE_PBO_READBACK
+    if(mappedReadbackSlot){
+        if(mappedReadbackSlot->colorBuffer){
+            glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, mappedReadbackSlot->colorBuffer);
+            glFunctions->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        if(mappedReadbackSlot->depthBuffer){
+            glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, mappedReadbackSlot->depthBuffer);
+            glFunctions->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glFunctions->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        mappedReadbackSlot = nullptr;
+    }
+#endif
+}
+
+
+int SensorScreenRenderer::numConversionChunks() const
+{
+    auto pool = simImpl->conversionThreadPool.get();
+    return pool ? pool->size() : 1;
+}
+
+
+/**
+   The chunks except the first one are converted by the worker threads of the conversion
+   thread pool, and the first one is converted by the calling rendering thread.
+*/
+void SensorScreenRenderer::runConversionChunks(int numChunks, const std::function<void(int index)>& convert)
+{
+    auto pool = simImpl->conversionThreadPool.get();
+    if(!pool || numChunks <= 1){
+        for(int i=0; i < numChunks; ++i){
+            convert(i);
+        }
+    } else {
+        for(int i=1; i < numChunks; ++i){
+            pool->start([&convert, i](){ convert(i); });
+        }
+        convert(0);
+        pool->wait();
     }
 }
 
@@ -1312,13 +1569,16 @@ bool SensorRenderer::waitForRenderingToFinish(std::unique_lock<std::mutex>& lock
 
 void SensorRenderer::copyVisionData()
 {
+    CNOID_TRACE_ZONE("Sensor data conversion");
+    
     bool hasUpdatedData = true;
     for(auto& screen : screens){
         hasUpdatedData = hasUpdatedData && screen->hasUpdatedData;
     }
 
     if(hasUpdatedData){
-        double delay = simImpl->currentTime - onsetTime;
+        double dataOnsetTime = screens.empty() ? onsetTime : screens[0]->dataOnsetTime;
+        double delay = simImpl->currentTime - dataOnsetTime;
         if(camera){
             auto& screen = screens[0];
             if(!screen->tmpImage->empty()){
@@ -1375,52 +1635,71 @@ void SensorRenderer::copyVisionData()
 }
 
 
-bool SensorScreenRenderer::getCameraImage(Image& image)
+bool SensorScreenRenderer::getCameraImage(const unsigned char* colorData, Image& image)
 {
-    if(cameraForRendering->imageType() != Camera::COLOR_IMAGE){
+    if(!colorData){
         return false;
     }
     image.setSize(pixelWidth, pixelHeight, 3);
-    glReadPixels(0, 0, pixelWidth, pixelHeight, GL_RGB, GL_UNSIGNED_BYTE, image.pixels());
-    image.applyVerticalFlip();
+
+    // Copy the rows in the reverse order to flip the image vertically
+    const int rowSize = pixelWidth * 3;
+    unsigned char* pixels = image.pixels();
+    for(int y=0; y < pixelHeight; ++y){
+        std::copy(colorData + (pixelHeight - 1 - y) * rowSize, colorData + (pixelHeight - y) * rowSize, pixels + y * rowSize);
+    }
     return true;
 }
 
 
-bool SensorScreenRenderer::getRangeCameraData(Image& image, vector<Vector3f>& points)
+bool SensorScreenRenderer::getRangeCameraData
+(const unsigned char* colorData, const float* depthData, Image& image, vector<Vector3f>& points)
 {
-#ifndef _WIN32
-    unsigned char* colorBuf = 0;
-#else
-    vector<unsigned char> colorBuf;
-#endif
+    const int numChunks = std::min(numConversionChunks(), pixelHeight);
+    if(pointChunks.size() < static_cast<size_t>(numChunks)){
+        pointChunks.resize(numChunks);
+    }
 
-    unsigned char* pixels = 0;
+    // The rows are converted from the top, which is the last row of the pixel data
+    runConversionChunks(
+        numChunks,
+        [&](int index){
+            const int yTop = pixelHeight - 1 - (pixelHeight * index / numChunks);
+            const int yBottom = pixelHeight - (pixelHeight * (index + 1) / numChunks);
+            convertDepthRowsToPoints(colorData, depthData, yTop, yBottom, pointChunks[index]);
+        });
 
-    const bool extractColors = (cameraForRendering->imageType() == Camera::COLOR_IMAGE);
-    if(extractColors){
-#ifndef _WIN32
-        colorBuf = (unsigned char*)alloca(pixelWidth * pixelHeight * 3 * sizeof(unsigned char));
-        glReadPixels(0, 0, pixelWidth, pixelHeight, GL_RGB, GL_UNSIGNED_BYTE, colorBuf);
-#else
-        colorBuf.resize(pixelWidth * pixelHeight * 3 * sizeof(unsigned char));
-        glReadPixels(0, 0, pixelWidth, pixelHeight, GL_RGB, GL_UNSIGNED_BYTE, &colorBuf[0]);
-#endif
+    size_t numPoints = 0;
+    for(int i=0; i < numChunks; ++i){
+        numPoints += pointChunks[i].points.size();
+    }
+    points.clear();
+    points.reserve(numPoints);
+    for(int i=0; i < numChunks; ++i){
+        auto& chunkPoints = pointChunks[i].points;
+        points.insert(points.end(), chunkPoints.begin(), chunkPoints.end());
+    }
+
+    if(colorData){
         if(rangeCameraForRendering->isOrganized()){
             image.setSize(pixelWidth, pixelHeight, 3);
         } else {
-            image.setSize(pixelWidth * pixelHeight, 1, 3);
+            image.setSize(numPoints, 1, 3);
+        }
+        unsigned char* pixels = image.pixels();
+        for(int i=0; i < numChunks; ++i){
+            auto& colors = pointChunks[i].colors;
+            pixels = std::copy(colors.begin(), colors.end(), pixels);
         }
-        pixels = image.pixels();
     }
 
-#ifndef _WIN32
-    float* depthBuf = (float*)alloca(pixelWidth * pixelHeight * sizeof(float));
-    glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, depthBuf);
-#else
-    vector<float> depthBuf(pixelWidth * pixelHeight * sizeof(float));
-    glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, &depthBuf[0]);
-#endif
+    return true;
+}
+
+
+void SensorScreenRenderer::convertDepthRowsToPoints
+(const unsigned char* colorData, const float* depthData, int yTop, int yBottom, PointChunk& chunk)
+{
     const Matrix4f Pinv = renderer->projectionMatrix().inverse().cast<float>();
     const float fw = pixelWidth;
     const float fh = pixelHeight;
@@ -1429,21 +1708,23 @@ bool SensorScreenRenderer::getRangeCameraData(Image& image, vector<Vector3f>& po
     const bool isOrganized = rangeCameraForRendering->isOrganized();
     Vector4f n;
     n[3] = 1.0f;
+    auto& points = chunk.points;
+    auto& colors = chunk.colors;
     points.clear();
-    points.reserve(pixelWidth * pixelHeight);
-    unsigned char* colorSrc = 0;
+    points.reserve(pixelWidth * (yTop - yBottom + 1));
+    colors.clear();
+    if(colorData){
+        colors.reserve(pixelWidth * (yTop - yBottom + 1) * 3);
+    }
+    const unsigned char* colorSrc = 0;
     
-    for(int y = pixelHeight - 1; y >= 0; --y){
+    for(int y = yTop; y >= yBottom; --y){
         int srcpos = y * pixelWidth;
-        if(extractColors){
-#ifndef _WIN32
-            colorSrc = colorBuf + y * pixelWidth * 3;
-#else
-            colorSrc = &colorBuf[0] + y *pixelWidth * 3;
-#endif
+        if(colorData){
+            colorSrc = colorData + y * pixelWidth * 3;
         }
         for(int x=0; x < pixelWidth; ++x){
-            const float z = depthBuf[srcpos + x];
+            const float z = depthData[srcpos + x];
             if(z > 0.0f && z < 1.0f){
                 n.x() = 2.0f * x / fw - 1.0f;
                 n.y() = 2.0f * y / fh - 1.0f;
@@ -1451,11 +1732,8 @@ bool SensorScreenRenderer::getRangeCameraData(Image& image, vector<Vector3f>& po
                 const Vector4f o = Pinv * n;
                 const float& w = o[3];
                 points.push_back(Vector3f(o[0] / w, o[1] / w, o[2] / w));
-                if(pixels){
-                    pixels[0] = colorSrc[0];
-                    pixels[1] = colorSrc[1];
-                    pixels[2] = colorSrc[2];
-                    pixels += 3;
+                if(colorData){
+                    colors.insert(colors.end(), colorSrc, colorSrc + 3);
                 }
             } else if(isOrganized){
                 points.push_back(Vector3f());
@@ -1475,26 +1753,17 @@ bool SensorScreenRenderer::getRangeCameraData(Image& image, vector<Vector3f>& po
                 } else {
                     p.y() = (y - cy) * numeric_limits<float>::infinity();
                 }
-                if(pixels){
-                    pixels[0] = colorSrc[0];
-                    pixels[1] = colorSrc[1];
-                    pixels[2] = colorSrc[2];
-                    pixels += 3;
+                if(colorData){
+                    colors.insert(colors.end(), colorSrc, colorSrc + 3);
                 }
             }
             colorSrc += 3;
         }
     }
-
-    if(extractColors && !rangeCameraForRendering->isOrganized()){
-        image.setSize((pixels - image.pixels()) / 3, 1, 3);
-    }
-
-    return true;
 }
 
 
-bool SensorScreenRenderer::getRangeSensorData(vector<double>& rangeData)
+bool SensorScreenRenderer::getRangeSensorData(const float* depthData, vector<double>& rangeData)
 {
     const double yawRange = rangeSensorForRendering->yawRange();
     const double yawStep = rangeSensorForRendering->yawStep();
@@ -1510,99 +1779,88 @@ bool SensorScreenRenderer::getRangeSensorData(vector<double>& rangeData)
     const double Pinv_33 = Pinv(3, 3);
     const double fw = pixelWidth;
     const double fh = pixelHeight;
-    const int wh = pixelWidth * pixelHeight;
-
-#ifndef _WIN32
-    float* depthBuf;
-    if(wh > 1e6){
-        depthBuf = (float*)malloc(pixelWidth * pixelHeight * sizeof(float));
-    }else{
-        depthBuf = (float*)alloca(pixelWidth * pixelHeight * sizeof(float));
-    }
-    glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, depthBuf);
-#else
-    vector<float> depthBuf(pixelWidth * pixelHeight * sizeof(float));
-    glReadPixels(0, 0, pixelWidth, pixelHeight, GL_DEPTH_COMPONENT, GL_FLOAT, &depthBuf[0]);
-#endif
-
-    rangeData.reserve(numUniqueYawSamples * numPitchSamples);
-
-    for(int pitch=0; pitch < numPitchSamples; ++pitch){
-        const double pitchAngle = pitch * pitchStep - pitchRange / 2.0;
-        const double cosPitchAngle = cos(pitchAngle);
-
-        for(int yaw=0; yaw < numUniqueYawSamples; ++yaw){
-            const double yawAngle = yaw * yawStep - yawRange / 2.0;
 
-            int py;
-            if(pitchRange == 0.0){
-                py = 0;
-            } else {
-                const double r = (tan(pitchAngle)/cos(yawAngle) + maxTanPitchAngle) / (maxTanPitchAngle * 2.0);
-                py = myNearByInt(r * (fh - 1.0));
-            }
-            const int srcpos = py * pixelWidth;
-
-            int px;
-            if(yawRange == 0.0){
-                px = 0;
-            } else {
-                const double r = (maxTanYawAngle - tan(yawAngle)) / (maxTanYawAngle * 2.0);
-                px = myNearByInt(r * (fw - 1.0));
-            }
-            //! \todo add the option to do the interpolation between the adjacent two pixel depths
-            const float depth = depthBuf[srcpos + px];
-            if(depth > 0.0f && depth < 1.0f){
-                const double z0 = 2.0 * depth - 1.0;
-                const double w = Pinv_32 * z0 + Pinv_33;
-                const double z = -1.0 / w + depthError;
-                rangeData.push_back(fabs((z / cosPitchAngle) / cos(yawAngle)));
-
-                if(DEBUG_MESSAGE){
-                    const Matrix4 Pinv = renderer->projectionMatrix().inverse();
-                    const float fw = pixelWidth;
-                    const float fh = pixelHeight;
-                    const int cx = pixelWidth / 2;
-                    const int cy = pixelHeight / 2;
-                    Vector4 n;
-                    n[3] = 1.0f;
-                    n.x() = 2.0 * px / fw - 1.0;
-                    n.y() = 2.0 * py / fh - 1.0;
-                    n.z() = 2.0 * depth - 1.0f;
-                    const Vector4 o = Pinv * n;
-                    const double& ww = o[3];
-                    double x_ = o[0] / ww;
-                    double y_ = o[1] / ww;
-                    double z_ = o[2] / ww;
-                    double distance_ = sqrt(x_*x_ + y_*y_ + z_*z_);
-                    double pitchAngle_ = asin( y_ / distance_);
-                    double yawAngle_ = -asin( x_ / sqrt(x_*x_ + z_*z_) );
-
-                    cout << "pixelX= " << px << "  pixelY= " << py << endl;
-                    cout << "pitch= " << degree(pitchAngle_)  << " yaw= " << degree(yawAngle_) << endl;
-                    cout << "pitch= " << degree(pitchAngle)  << " yaw= " << degree(yawAngle) << endl;
-                    cout << "x= " << x_ << " "
-                         << "y= " << y_ << " "
-                         << "z= " << z_ << endl;
-                    double distance = fabs((z / cosPitchAngle) / cos(yawAngle));
-                    double x = distance *  cosPitchAngle * sin(-yawAngle);
-                    double y  = distance * sin(pitchAngle);
-                    cout << "x= " << x << " "
-                         << "y= " << y << " "
-                         << "z= " << z  << endl;
-                    cout << endl;
+    rangeData.resize(numUniqueYawSamples * numPitchSamples);
+
+    const int numChunks = std::min(numConversionChunks(), numPitchSamples);
+    runConversionChunks(
+        numChunks,
+        [&](int index){
+            const int pitchBegin = numPitchSamples * index / numChunks;
+            const int pitchEnd = numPitchSamples * (index + 1) / numChunks;
+
+            for(int pitch=pitchBegin; pitch < pitchEnd; ++pitch){
+                const double pitchAngle = pitch * pitchStep - pitchRange / 2.0;
+                const double cosPitchAngle = cos(pitchAngle);
+                double* dest = &rangeData[pitch * numUniqueYawSamples];
+
+                for(int yaw=0; yaw < numUniqueYawSamples; ++yaw){
+                    const double yawAngle = yaw * yawStep - yawRange / 2.0;
+
+                    int py;
+                    if(pitchRange == 0.0){
+                        py = 0;
+                    } else {
+                        const double r = (tan(pitchAngle)/cos(yawAngle) + maxTanPitchAngle) / (maxTanPitchAngle * 2.0);
+                        py = myNearByInt(r * (fh - 1.0));
+                    }
+                    const int srcpos = py * pixelWidth;
+
+                    int px;
+                    if(yawRange == 0.0){
+                        px = 0;
+                    } else {
+                        const double r = (maxTanYawAngle - tan(yawAngle)) / (maxTanYawAngle * 2.0);
+                        px = myNearByInt(r * (fw - 1.0));
+                    }
+                    //! \todo add the option to do the interpolation between the adjacent two pixel depths
+                    const float depth = depthData[srcpos + px];
+                    if(depth > 0.0f && depth < 1.0f){
+                        const double z0 = 2.0 * depth - 1.0;
+                        const double w = Pinv_32 * z0 + Pinv_33;
+                        const double z = -1.0 / w + depthError;
+                        dest[yaw] = fabs((z / cosPitchAngle) / cos(yawAngle));
+
+                        if(DEBUG_MESSAGE){
+                            const Matrix4 Pinv = renderer->projectionMatrix().inverse();
+                            const float fw = pixelWidth;
+                            const float fh = pixelHeight;
+                            const int cx = pixelWidth / 2;
+                            const int cy = pixelHeight / 2;
+                            Vector4 n;
+                            n[3] = 1.0f;
+                            n.x() = 2.0 * px / fw - 1.0;
+                            n.y() = 2.0 * py / fh - 1.0;
+                            n.z() = 2.0 * depth - 1.0f;
+                            const Vector4 o = Pinv * n;
+                            const double& ww = o[3];
+                            double x_ = o[0] / ww;
+                            double y_ = o[1] / ww;
+                            double z_ = o[2] / ww;
+                            double distance_ = sqrt(x_*x_ + y_*y_ + z_*z_);
+                            double pitchAngle_ = asin( y_ / distance_);
+                            double yawAngle_ = -asin( x_ / sqrt(x_*x_ + z_*z_) );
+
+                            cout << "pixelX= " << px << "  pixelY= " << py << endl;
+                            cout << "pitch= " << degree(pitchAngle_)  << " yaw= " << degree(yawAngle_) << endl;
+                            cout << "pitch= " << degree(pitchAngle)  << " yaw= " << degree(yawAngle) << endl;
+                            cout << "x= " << x_ << " "
+                                 << "y= " << y_ << " "
+                                 << "z= " << z_ << endl;
+                            double distance = fabs((z / cosPitchAngle) / cos(yawAngle));
+                            double x = distance *  cosPitchAngle * sin(-yawAngle);
+                            double y  = distance * sin(pitchAngle);
+                            cout << "x= " << x << " "
+                                 << "y= " << y << " "
+                                 << "z= " << z  << endl;
+                            cout << endl;
+                        }
+                    } else {
+                        dest[yaw] = std::numeric_limits<double>::infinity();
+                    }
                 }
-            } else {
-                rangeData.push_back(std::numeric_limits<double>::infinity());
             }
-        }
-    }
-
-#ifndef _WIN32
-    if(wh > 1e6){
-        free(depthBuf);
-    }
-#endif
+        });
 
     return true;
 }
@@ -1629,6 +1887,7 @@ void GLVisionSimulatorItemImpl::finalizeSimulation()
     }
         
     sensorRenderers.clear();
+    conversionThreadPool.reset();
 }
 
 
@@ -1659,6 +1918,7 @@ SensorScreenRenderer::~SensorScreenRenderer()
 #if USE_QT5_OPENGL
     if(glContext){
         makeGLContextCurrent();
+        clearReadbackBuffers();
         frameBuffer->release();
         delete frameBuffer;
         delete glContext;
@@ -1691,7 +1951,9 @@ void GLVisionSimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty
                 [&](const string& names){ return updateNames(names, sensorNameListString, sensorNames); });
     putProperty(_("Max frame rate"), maxFrameRate, changeProperty(maxFrameRate));
     putProperty(_("Max latency [s]"), maxLatency, changeProperty(maxLatency));
-    putProperty(_("Record vision data"), isVisionDataRecordingEnabled, changeProperty(isVisionDataRecordingEnabled));
+    putProperty.min(0).max(3)(_("Readback latency [frames]"), readbackLatency, changeProperty(readbackLatency));
+    putProperty.reset().min(1).max(64)(_("Conversion threads"), numConversionThreads, changeProperty(numConversionThreads));
+    putProperty.reset()(_("Record vision data"), isVisionDataRecordingEnabled, changeProperty(isVisionDataRecordingEnabled));
     putProperty(_("Thread mode"), threadMode, [&](int index){ return threadMode.select(index); });
     putProperty(_("Best effort"), isBestEffortModeProperty, changeProperty(isBestEffortModeProperty));
     putProperty(_("All scene objects"), shootAllSceneObjects, changeProperty(shootAllSceneObjects));
@@ -1716,6 +1978,8 @@ bool GLVisionSimulatorItemImpl::store(Archive& archive)
     writeElements(archive, "targetSensors", sensorNames, true);
     archive.write("maxFrameRate", maxFrameRate);
     archive.write("maxLatency", maxLatency);
+    archive.write("readbackLatency", readbackLatency);
+    archive.write("conversionThreads", numConversionThreads);
     archive.write("recordVisionData", isVisionDataRecordingEnabled);
     archive.write("threadMode", threadMode.selectedSymbol());
     archive.write("bestEffort", isBestEffortModeProperty);
@@ -1744,6 +2008,8 @@ bool GLVisionSimulatorItemImpl::restore(const Archive& archive)
 
     archive.read("maxFrameRate", maxFrameRate);
     archive.read("maxLatency", maxLatency);
+    archive.read("readbackLatency", readbackLatency);
+    archive.read("conversionThreads", numConversionThreads);
     archive.read("recordVisionData", isVisionDataRecordingEnabled);
     archive.read("bestEffort", isBestEffortModeProperty);
     archive.read("allSceneObjects", shootAllSceneObjects);
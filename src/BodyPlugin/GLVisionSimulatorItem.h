@@ -28,6 +28,13 @@ public:
     void setTargetSensors(const std::string& sensorNames);
     void setMaxFrameRate(double rate);
     void setMaxLatency(double latency);
+
+    /**
+       The pixels are read back through pixel buffer objects when the latency is greater
+       than zero, and the data of a frame is delivered the given number of frames later.
+    */
+    void setReadbackLatency(int frames);
+    void setNumConversionThreads(int n);
     void setVisionDataRecordingEnabled(bool on);
     void setThreadMode(int mode);
     void setBestEffortMode(bool on);
@@ -0,0 +1,22 @@
+/**
+   \file
+*/
+
+#ifndef CNOID_BODY_PLUGIN_NAME_LIST_UTIL_H
+#define CNOID_BODY_PLUGIN_NAME_LIST_UTIL_H
+
+#include <string>
+#include <vector>
+
+namespace cnoid {
+
+/**
+   These functions convert the names specified by the "Target bodies" and "Target sensors"
+   properties of the sensor simulator items from / to a comma-separated string.
+*/
+std::string getNameListString(const std::vector<std::string>& names);
+bool updateNames(const std::string& nameListString, std::string& newNameListString, std::vector<std::string>& names);
+
+}
+
+#endif
@@ -0,0 +1,590 @@
+/*!
+  @file
+*/
+
+#include "RaycastRangeSensorSimulatorItem.h"
+#include "SimulatorItem.h"
+#include "NameListUtil.h"
+#include <cnoid/ItemManager>
+#include <cnoid/MessageView>
+#include <cnoid/Archive>
+#include <cnoid/ValueTreeUtil>
+#include <cnoid/Body>
+#include <cnoid/RangeSensor>
+#include <cnoid/ColdetModel>
+#include <cnoid/MeshExtractor>
+#include <cnoid/SceneDrawables>
+#include <cnoid/ThreadPool>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <set>
+#include <thread>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+
+namespace {
+
+struct LinkModel
+{
+    Link* link;
+    ColdetModelPtr model;
+    Vector3 bboxMin; // in the link frame
+    Vector3 bboxMax;
+};
+
+class RangeSensorRaycaster : public Referenced
+{
+public:
+    SimulationBody* simBody;
+    RangeSensorPtr rangeSensor;
+    double cycleTime;
+    double elapsedTime;
+    int numYawSamples;
+    int numPitchSamples;
+    vector<Vector3> localDirections;
+};
+typedef ref_ptr<RangeSensorRaycaster> RangeSensorRaycasterPtr;
+
+/**
+   Buffers used by a thread to test a ray against the bounding boxes of all the models.
+*/
+struct RaycastWorkspace
+{
+    Eigen::ArrayXd tNear;
+    Eigen::ArrayXd tFar;
+    vector<pair<double, int>> candidates;
+};
+
+}
+
+namespace cnoid {
+
+class RaycastRangeSensorSimulatorItemImpl
+{
+public:
+    RaycastRangeSensorSimulatorItem* self;
+    ostream& os;
+    SimulatorItem* simulatorItem;
+    double worldTimeStep;
+    vector<RangeSensorRaycasterPtr> raycasters;
+    vector<LinkModel> linkModels;
+    MeshExtractor meshExtractor;
+
+    // The world bounding boxes of the link models in the SoA layout for the vectorized slab test
+    Eigen::ArrayXd bboxMinX, bboxMinY, bboxMinZ;
+    Eigen::ArrayXd bboxMaxX, bboxMaxY, bboxMaxZ;
+
+    unique_ptr<ThreadPool> threadPool;
+    vector<RaycastWorkspace> workspaces;
+
+    long numCastRays;
+    double raycastTime;
+
+    vector<string> bodyNames;
+    string bodyNameListString;
+    vector<string> sensorNames;
+    string sensorNameListString;
+    double maxFrameRate;
+    int numThreads;
+    bool isRangeDataRecordingEnabled;
+
+    RaycastRangeSensorSimulatorItemImpl(RaycastRangeSensorSimulatorItem* self);
+    RaycastRangeSensorSimulatorItemImpl(RaycastRangeSensorSimulatorItem* self, const RaycastRangeSensorSimulatorItemImpl& org);
+    bool initializeSimulation(SimulatorItem* simulatorItem);
+    void addLinkModel(Link* link);
+    void addMesh(ColdetModel* model, LinkModel& linkModel);
+    void onPreDynamics();
+    void updateWorldBoundingBoxes();
+    void castRays(RangeSensorRaycaster* raycaster);
+    double castRay(const Vector3& origin, const Vector3& dir, double maxDistance, RaycastWorkspace& workspace);
+    void finalizeSimulation();
+    void doPutProperties(PutPropertyFunction& putProperty);
+    bool store(Archive& archive);
+    bool restore(const Archive& archive);
+
+    template<typename Type> void setProperty(Type& variable, const Type& value){
+        if(value != variable){
+            variable = value;
+            self->notifyUpdate();
+        }
+    }
+};
+
+}
+
+
+void RaycastRangeSensorSimulatorItem::initializeClass(ExtensionManager* ext)
+{
+    ext->itemManager().registerClass<RaycastRangeSensorSimulatorItem>(N_("RaycastRangeSensorSimulatorItem"));
+    ext->itemManager().addCreationPanel<RaycastRangeSensorSimulatorItem>();
+}
+
+
+RaycastRangeSensorSimulatorItem::RaycastRangeSensorSimulatorItem()
+{
+    impl = new RaycastRangeSensorSimulatorItemImpl(this);
+    setName("RaycastRangeSensorSimulator");
+}
+
+
+RaycastRangeSensorSimulatorItemImpl::RaycastRangeSensorSimulatorItemImpl(RaycastRangeSensorSimulatorItem* self)
+    : self(self),
+      os(MessageView::instance()->cout())
+{
+    simulatorItem = 0;
+    numCastRays = 0;
+    raycastTime = 0.0;
+    maxFrameRate = 1000.0;
+    numThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    isRangeDataRecordingEnabled = false;
+}
+
+
+RaycastRangeSensorSimulatorItem::RaycastRangeSensorSimulatorItem(const RaycastRangeSensorSimulatorItem& org)
+    : SubSimulatorItem(org)
+{
+    impl = new RaycastRangeSensorSimulatorItemImpl(this, *org.impl);
+}
+
+
+RaycastRangeSensorSimulatorItemImpl::RaycastRangeSensorSimulatorItemImpl
+(RaycastRangeSensorSimulatorItem* self, const RaycastRangeSensorSimulatorItemImpl& org)
+    : self(self),
+      os(MessageView::instance()->cout()),
+      bodyNames(org.bodyNames),
+      sensorNames(org.sensorNames)
+{
+    simulatorItem = 0;
+    numCastRays = 0;
+    raycastTime = 0.0;
+    bodyNameListString = getNameListString(bodyNames);
+    sensorNameListString = getNameListString(sensorNames);
+    maxFrameRate = org.maxFrameRate;
+    numThreads = org.numThreads;
+    isRangeDataRecordingEnabled = org.isRangeDataRecordingEnabled;
+}
+
+
+Item* RaycastRangeSensorSimulatorItem::doDuplicate() const
+{
+    return new RaycastRangeSensorSimulatorItem(*this);
+}
+
+
+RaycastRangeSensorSimulatorItem::~RaycastRangeSensorSimulatorItem()
+{
+    delete impl;
+}
+
+
+void RaycastRangeSensorSimulatorItem::setTargetBodies(const std::string& names)
+{
+    updateNames(names, impl->bodyNameListString, impl->bodyNames);
+    notifyUpdate();
+}
+
+
+void RaycastRangeSensorSimulatorItem::setTargetSensors(const std::string& names)
+{
+    updateNames(names, impl->sensorNameListString, impl->sensorNames);
+    notifyUpdate();
+}
+
+
+void RaycastRangeSensorSimulatorItem::setMaxFrameRate(double rate)
+{
+    impl->setProperty(impl->maxFrameRate, rate);
+}
+
+
+void RaycastRangeSensorSimulatorItem::setNumThreads(int n)
+{
+    impl->setProperty(impl->numThreads, std::max(n, 1));
+}
+
+
+void RaycastRangeSensorSimulatorItem::setRangeDataRecordingEnabled(bool on)
+{
+    impl->setProperty(impl->isRangeDataRecordingEnabled, on);
+}
+
+
+long RaycastRangeSensorSimulatorItem::numCastRays() const
+{
+    return impl->numCastRays;
+}
+
+
+double RaycastRangeSensorSimulatorItem::raysPerSecond() const
+{
+    if(impl->raycastTime > 0.0){
+        return impl->numCastRays / impl->raycastTime;
+    }
+    return 0.0;
+}
+
+
+bool RaycastRangeSensorSimulatorItem::initializeSimulation(SimulatorItem* simulatorItem)
+{
+    return impl->initializeSimulation(simulatorItem);
+}
+
+
+bool RaycastRangeSensorSimulatorItemImpl::initializeSimulation(SimulatorItem* simulatorItem)
+{
+    this->simulatorItem = simulatorItem;
+    worldTimeStep = simulatorItem->worldTimeStep();
+    raycasters.clear();
+    linkModels.clear();
+    numCastRays = 0;
+    raycastTime = 0.0;
+
+    std::set<string> bodyNameSet(bodyNames.begin(), bodyNames.end());
+    std::set<string> sensorNameSet(sensorNames.begin(), sensorNames.end());
+
+    const vector<SimulationBody*>& simBodies = simulatorItem->simulationBodies();
+    for(auto& simBody : simBodies){
+        Body* body = simBody->body();
+        if(!bodyNameSet.empty() && bodyNameSet.find(body->name()) == bodyNameSet.end()){
+            continue;
+        }
+        for(auto& rangeSensor : body->devices<RangeSensor>()){
+            if(!sensorNameSet.empty() && sensorNameSet.find(rangeSensor->name()) == sensorNameSet.end()){
+                continue;
+            }
+            os << (format(_("%1% detected range sensor \"%2%\" of %3% as a target."))
+                   % self->name() % rangeSensor->name() % body->name()) << endl;
+
+            RangeSensorRaycasterPtr raycaster = new RangeSensorRaycaster;
+            raycaster->simBody = simBody;
+            raycaster->rangeSensor = rangeSensor;
+            double frameRate = std::max(0.1, std::min(rangeSensor->scanRate(), maxFrameRate));
+            raycaster->cycleTime = 1.0 / frameRate;
+            raycaster->elapsedTime = raycaster->cycleTime + 1.0e-6;
+            if(isRangeDataRecordingEnabled){
+                rangeSensor->setRangeDataStateClonable(true);
+            }
+
+            // The directions in the sensor frame, which are the same as the GL rendering
+            const int numYawSamples = rangeSensor->numYawSamples();
+            const int numPitchSamples = rangeSensor->numPitchSamples();
+            raycaster->numYawSamples = numYawSamples;
+            raycaster->numPitchSamples = numPitchSamples;
+            raycaster->localDirections.resize(numYawSamples * numPitchSamples);
+            for(int pitch=0; pitch < numPitchSamples; ++pitch){
+                const double pitchAngle = pitch * rangeSensor->pitchStep() - rangeSensor->pitchRange() / 2.0;
+                const double cosPitchAngle = cos(pitchAngle);
+                for(int yaw=0; yaw < numYawSamples; ++yaw){
+                    const double yawAngle = yaw * rangeSensor->yawStep() - rangeSensor->yawRange() / 2.0;
+                    raycaster->localDirections[pitch * numYawSamples + yaw] =
+                        Vector3(cosPitchAngle * sin(-yawAngle), sin(pitchAngle), -cosPitchAngle * cos(yawAngle));
+                }
+            }
+            raycasters.push_back(raycaster);
+        }
+    }
+
+    if(raycasters.empty()){
+        os << (format(_("%1% has no target sensors")) % self->name()) << endl;
+        return false;
+    }
+
+    for(auto& simBody : simBodies){
+        Body* body = simBody->body();
+        for(int i=0; i < body->numLinks(); ++i){
+            addLinkModel(body->link(i));
+        }
+    }
+    const int numModels = linkModels.size();
+    bboxMinX.resize(numModels);
+    bboxMinY.resize(numModels);
+    bboxMinZ.resize(numModels);
+    bboxMaxX.resize(numModels);
+    bboxMaxY.resize(numModels);
+    bboxMaxZ.resize(numModels);
+
+    if(numThreads > 1){
+        threadPool.reset(new ThreadPool(numThreads));
+    } else {
+        threadPool.reset();
+    }
+    workspaces.resize(numThreads);
+    for(auto& workspace : workspaces){
+        workspace.tNear.resize(numModels);
+        workspace.tFar.resize(numModels);
+        workspace.candidates.reserve(numModels);
+    }
+
+    simulatorItem->addPreDynamicsFunction([&](){ onPreDynamics(); });
+
+    return true;
+}
+
+
+void RaycastRangeSensorSimulatorItemImpl::addLinkModel(Link* link)
+{
+    SgNode* shape = link->collisionShape();
+    if(!shape){
+        return;
+    }
+    LinkModel linkModel;
+    linkModel.link = link;
+    linkModel.bboxMin.setConstant(std::numeric_limits<double>::max());
+    linkModel.bboxMax.setConstant(-std::numeric_limits<double>::max());
+    ColdetModelPtr model = new ColdetModel;
+    if(meshExtractor.extract(shape, [&](){ addMesh(model, linkModel); })){
+        model->setName(link->name());
+        model->build();
+        if(model->isValid()){
+            linkModel.model = model;
+            linkModels.push_back(linkModel);
+        }
+    }
+}
+
+
+void RaycastRangeSensorSimulatorItemImpl::addMesh(ColdetModel* model, LinkModel& linkModel)
+{
+    SgMesh* mesh = meshExtractor.currentMesh();
+    const Affine3& T = meshExtractor.currentTransform();
+
+    const int vertexIndexTop = model->getNumVertices();
+
+    const SgVertexArray& vertices = *mesh->vertices();
+    const int numVertices = vertices.size();
+    for(int i=0; i < numVertices; ++i){
+        const Vector3 v = T * vertices[i].cast<Affine3::Scalar>();
+        model->addVertex(v.x(), v.y(), v.z());
+        linkModel.bboxMin = linkModel.bboxMin.cwiseMin(v);
+        linkModel.bboxMax = linkModel.bboxMax.cwiseMax(v);
+    }
+
+    const int numTriangles = mesh->numTriangles();
+    for(int i=0; i < numTriangles; ++i){
+        SgMesh::TriangleRef tri = mesh->triangle(i);
+        model->addTriangle(vertexIndexTop + tri[0], vertexIndexTop + tri[1], vertexIndexTop + tri[2]);
+    }
+}
+
+
+void RaycastRangeSensorSimulatorItemImpl::onPreDynamics()
+{
+    bool isWorldUpdated = false;
+
+    for(auto& raycaster : raycasters){
+        if(raycaster->elapsedTime >= raycaster->cycleTime){
+            if(!isWorldUpdated){
+                updateWorldBoundingBoxes();
+                isWorldUpdated = true;
+            }
+            castRays(raycaster);
+            raycaster->elapsedTime -= raycaster->cycleTime;
+        }
+        raycaster->elapsedTime += worldTimeStep;
+    }
+}
+
+
+void RaycastRangeSensorSimulatorItemImpl::updateWorldBoundingBoxes()
+{
+    const int n = linkModels.size();
+    for(int i=0; i < n; ++i){
+        auto& linkModel = linkModels[i];
+        const Position& T = linkModel.link->T();
+        linkModel.model->setPosition(T);
+        const Vector3 c = T * (0.5 * (linkModel.bboxMin + linkModel.bboxMax));
+        const Vector3 h = T.linear().cwiseAbs() * (0.5 * (linkModel.bboxMax - linkModel.bboxMin));
+        bboxMinX[i] = c.x() - h.x();
+        bboxMinY[i] = c.y() - h.y();
+        bboxMinZ[i] = c.z() - h.z();
+        bboxMaxX[i] = c.x() + h.x();
+        bboxMaxY[i] = c.y() + h.y();
+        bboxMaxZ[i] = c.z() + h.z();
+    }
+}
+
+
+void RaycastRangeSensorSimulatorItemImpl::castRays(RangeSensorRaycaster* raycaster)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    RangeSensor* rangeSensor = raycaster->rangeSensor;
+    const Position T = rangeSensor->link()->T() * rangeSensor->T_local();
+    const Matrix3 R = T.linear();
+    const Vector3 p = T.translation();
+    const double minDistance = rangeSensor->minDistance();
+    const double maxDistance = rangeSensor->maxDistance();
+    const int numPitchSamples = raycaster->numPitchSamples;
+    const int numYawSamples = raycaster->numYawSamples;
+
+    auto rangeData = std::make_shared<RangeSensor::RangeData>(raycaster->localDirections.size());
+
+    // The rays of a pitch row range are cast by each thread
+    auto castRayRows = [&](int index, int numChunks){
+        auto& workspace = workspaces[index];
+        const int pitchBegin = numPitchSamples * index / numChunks;
+        const int pitchEnd = numPitchSamples * (index + 1) / numChunks;
+        for(int i = pitchBegin * numYawSamples; i < pitchEnd * numYawSamples; ++i){
+            const Vector3 dir = R * raycaster->localDirections[i];
+            const double d = castRay(p + minDistance * dir, dir, maxDistance - minDistance, workspace);
+            if(d < maxDistance - minDistance){
+                (*rangeData)[i] = minDistance + d;
+            } else {
+                (*rangeData)[i] = std::numeric_limits<double>::infinity();
+            }
+        }
+    };
+
+    const int numChunks = std::max(1, std::min(static_cast<int>(workspaces.size()), numPitchSamples));
+    if(!threadPool || numChunks == 1){
+        for(int i=0; i < numChunks; ++i){
+            castRayRows(i, numChunks);
+        }
+    } else {
+        for(int i=1; i < numChunks; ++i){
+            threadPool->start([&castRayRows, i, numChunks](){ castRayRows(i, numChunks); });
+        }
+        castRayRows(0, numChunks);
+        threadPool->wait();
+    }
+
+    rangeSensor->setRangeData(rangeData);
+    rangeSensor->setDelay(0.0);
+    if(isRangeDataRecordingEnabled){
+        rangeSensor->notifyStateChange();
+    } else {
+        raycaster->simBody->notifyUnrecordedDeviceStateChange(rangeSensor);
+    }
+
+    numCastRays += raycaster->localDirections.size();
+    raycastTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+
+/**
+   The ray is tested against the world bounding boxes of all the models at once by the slab
+   method, which is evaluated by Eigen's vectorized array expressions. The models whose
+   boxes are hit are then tested with their AABB trees from the nearest one.
+*/
+double RaycastRangeSensorSimulatorItemImpl::castRay
+(const Vector3& origin, const Vector3& dir, double maxDistance, RaycastWorkspace& workspace)
+{
+    const double ox = origin.x();
+    const double oy = origin.y();
+    const double oz = origin.z();
+    const double tiny = 1.0e-30;
+    const double idx = 1.0 / (fabs(dir.x()) > tiny ? dir.x() : tiny);
+    const double idy = 1.0 / (fabs(dir.y()) > tiny ? dir.y() : tiny);
+    const double idz = 1.0 / (fabs(dir.z()) > tiny ? dir.z() : tiny);
+
+    auto& tNear = workspace.tNear;
+    auto& tFar = workspace.tFar;
+    tNear = ((bboxMinX - ox) * idx).min((bboxMaxX - ox) * idx)
+        .max(((bboxMinY - oy) * idy).min((bboxMaxY - oy) * idy))
+        .max(((bboxMinZ - oz) * idz).min((bboxMaxZ - oz) * idz));
+    tFar = ((bboxMinX - ox) * idx).max((bboxMaxX - ox) * idx)
+        .min(((bboxMinY - oy) * idy).max((bboxMaxY - oy) * idy))
+        .min(((bboxMinZ - oz) * idz).max((bboxMaxZ - oz) * idz));
+
+    auto& candidates = workspace.candidates;
+    candidates.clear();
+    const int n = tNear.size();
+    for(int i=0; i < n; ++i){
+        if(tNear[i] <= tFar[i] && tFar[i] >= 0.0 && tNear[i] < maxDistance){
+            candidates.push_back(make_pair(tNear[i], i));
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    double distance = maxDistance;
+    for(auto& candidate : candidates){
+        if(candidate.first >= distance){
+            break;
+        }
+        const double d = linkModels[candidate.second].model->computeDistanceWithRay(origin, dir, distance);
+        if(d < distance){
+            distance = d;
+        }
+    }
+    return distance;
+}
+
+
+void RaycastRangeSensorSimulatorItem::finalizeSimulation()
+{
+    impl->finalizeSimulation();
+}
+
+
+void RaycastRangeSensorSimulatorItemImpl::finalizeSimulation()
+{
+    if(numCastRays > 0){
+        os << (format(_("%1% cast %2% rays in %3$.3f s (%4$.0f rays/s)."))
+               % self->name() % numCastRays % raycastTime % self->raysPerSecond()) << endl;
+    }
+    raycasters.clear();
+    linkModels.clear();
+    threadPool.reset();
+    workspaces.clear();
+}
+
+
+void RaycastRangeSensorSimulatorItem::doPutProperties(PutPropertyFunction& putProperty)
+{
+    SubSimulatorItem::doPutProperties(putProperty);
+    impl->doPutProperties(putProperty);
+}
+
+
+void RaycastRangeSensorSimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
+{
+    putProperty(_("Target bodies"), bodyNameListString,
+                [&](const string& names){ return updateNames(names, bodyNameListString, bodyNames); });
+    putProperty(_("Target sensors"), sensorNameListString,
+                [&](const string& names){ return updateNames(names, sensorNameListString, sensorNames); });
+    putProperty(_("Max frame rate"), maxFrameRate, changeProperty(maxFrameRate));
+    putProperty.min(1)(_("Num threads"), numThreads, changeProperty(numThreads));
+    putProperty.reset()(_("Record range data"), isRangeDataRecordingEnabled, changeProperty(isRangeDataRecordingEnabled));
+}
+
+
+bool RaycastRangeSensorSimulatorItem::store(Archive& archive)
+{
+    SubSimulatorItem::store(archive);
+    return impl->store(archive);
+}
+
+
+bool RaycastRangeSensorSimulatorItemImpl::store(Archive& archive)
+{
+    writeElements(archive, "targetBodies", bodyNames, true);
+    writeElements(archive, "targetSensors", sensorNames, true);
+    archive.write("maxFrameRate", maxFrameRate);
+    archive.write("numThreads", numThreads);
+    archive.write("recordRangeData", isRangeDataRecordingEnabled);
+    return true;
+}
+
+
+bool RaycastRangeSensorSimulatorItem::restore(const Archive& archive)
+{
+    SubSimulatorItem::restore(archive);
+    return impl->restore(archive);
+}
+
+
+bool RaycastRangeSensorSimulatorItemImpl::restore(const Archive& archive)
+{
+    readElements(archive, "targetBodies", bodyNames);
+    bodyNameListString = getNameListString(bodyNames);
+    readElements(archive, "targetSensors", sensorNames);
+    sensorNameListString = getNameListString(sensorNames);
+    archive.read("maxFrameRate", maxFrameRate);
+    archive.read("numThreads", numThreads);
+    archive.read("recordRangeData", isRangeDataRecordingEnabled);
+    return true;
+}
@@ -0,0 +1,55 @@
+/*!
+  @file
+*/
+
+#ifndef CNOID_BODY_PLUGIN_RAYCAST_RANGE_SENSOR_SIMULATOR_ITEM_H
+#define CNOID_BODY_PLUGIN_RAYCAST_RANGE_SENSOR_SIMULATOR_ITEM_H
+
+#include "SubSimulatorItem.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class RaycastRangeSensorSimulatorItemImpl;
+
+/**
+   This item simulates range sensors by casting a ray for each sample against the collision
+   shapes of the bodies. It does not require OpenGL, and the range data has the same layout
+   as the one produced by GLVisionSimulatorItem.
+*/
+class CNOID_EXPORT RaycastRangeSensorSimulatorItem : public SubSimulatorItem
+{
+public:
+    static void initializeClass(ExtensionManager* ext);
+
+    RaycastRangeSensorSimulatorItem();
+    RaycastRangeSensorSimulatorItem(const RaycastRangeSensorSimulatorItem& org);
+    ~RaycastRangeSensorSimulatorItem();
+
+    void setTargetBodies(const std::string& bodyNames);
+    void setTargetSensors(const std::string& sensorNames);
+    void setMaxFrameRate(double rate);
+    void setNumThreads(int n);
+    void setRangeDataRecordingEnabled(bool on);
+
+    long numCastRays() const;
+    double raysPerSecond() const;
+
+    virtual bool initializeSimulation(SimulatorItem* simulatorItem);
+    virtual void finalizeSimulation();
+
+protected:
+    virtual Item* doDuplicate() const;
+    virtual void doPutProperties(PutPropertyFunction& putProperty);
+    virtual bool store(Archive& archive);
+    virtual bool restore(const Archive& archive);
+
+private:
+    RaycastRangeSensorSimulatorItemImpl* impl;
+};
+
+typedef ref_ptr<RaycastRangeSensorSimulatorItem> RaycastRangeSensorSimulatorItemPtr;
+
+}
+
+#endif
@@ -41,6 +41,9 @@ struct SharedInfo : public Referenced
     ScopedConnectionSet inputDeviceStateConnections;
     boost::dynamic_bitset<> inputEnabledDeviceFlag;
     boost::dynamic_bitset<> inputDeviceStateChangeFlag;
+
+    // The child controllers are executed with the control period of the top controller
+    int controlPeriod;
 };
 
 typedef ref_ptr<SharedInfo> SharedInfoPtr;
@@ -319,7 +322,9 @@ void SimpleControllerItemImpl::updateInputEnabledDevices()
 
 bool SimpleControllerItem::initialize(ControllerIO* io)
 {
-    if(impl->initialize(io, new SharedInfo)){
+    SharedInfo* info = new SharedInfo;
+    info->controlPeriod = controlPeriod();
+    if(impl->initialize(io, info)){
         impl->updateInputEnabledDevices();
         return true;
     }
@@ -501,13 +506,13 @@ Body* SimpleControllerItemImpl::body()
 
 double SimpleControllerItem::timeStep() const
 {
-    return impl->io ? impl->io->timeStep() : 0.0;
+    return impl->io ? impl->timeStep() : 0.0;
 }
 
 
 double SimpleControllerItemImpl::timeStep() const
 {
-    return io->timeStep();
+    return io->timeStep() * sharedInfo->controlPeriod;
 }
 
 
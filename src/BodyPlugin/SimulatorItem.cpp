@@ -30,12 +30,13 @@
 #include <cnoid/FloatingNumberString>
 #include <cnoid/Sleep>
 #include <cnoid/SceneGraph>
+#include <cnoid/ThreadPool>
+#include <cnoid/TimeMeasure>
+#include <cnoid/TraceProfiler>
 #include <QThread>
 #include <QMutex>
 #include <boost/dynamic_bitset.hpp>
-#include <thread>
 #include <mutex>
-#include <condition_variable>
 #include <set>
 
 #ifdef ENABLE_SIMULATION_PROFILING
@@ -205,13 +206,60 @@ public:
     ItemList<SubSimulatorItem> subSimulatorItems;
 
     vector<ControllerItem*> activeControllers;
-    std::thread controlThread;
-    std::condition_variable controlCondition;
-    std::mutex controlMutex;
-    bool isExitingControlLoopRequested;
-    bool isControlRequested;
-    bool isControlFinished;
-    bool isControlToBeContinued;
+
+    /*
+      The control functions of the controllers in a group are called in order in a task of the
+      controller threads. The controllers of a body are put into a group, and the controllers
+      of the bodies with a controller in the sequential control mode are put into one group.
+    */
+    struct ControllerGroup
+    {
+        vector<int> controllerIndices;
+    };
+    vector<ControllerGroup> controllerGroups;
+    std::unique_ptr<ThreadPool> controllerThreadPool;
+    int numControllerThreads;
+
+    struct ControllerTime
+    {
+        ControllerItem* controller;
+        string name;
+        TimeMeasure timeMeasure;
+        double maxTime;
+        int numCalls;
+    };
+    vector<ControllerTime> controllerTimes;
+    vector<int> activeControllerTimeIndices;
+
+    bool isProfilingEnabled;
+    string profilingTraceFile;
+
+    /*
+      The controllers with a control period longer than one frame or a phase offset are only
+      executed on the frames of their ticks, which are updated when hasMultiRateControllers is true.
+      The result of the control function is kept until the next tick.
+    */
+    struct ControllerSchedule
+    {
+        int period;
+        int phase;
+        bool isTicked;
+        bool doContinue;
+    };
+    vector<ControllerSchedule> controllerSchedules;
+    bool hasMultiRateControllers;
+
+    // The controllers in the asynchronous control mode are executed in their own threads
+    struct AsyncControl
+    {
+        ControllerItem* controller;
+        int controllerIndex;
+        std::unique_ptr<ThreadPool> thread;
+        bool isRunning;
+        bool doContinue;
+    };
+    vector<AsyncControl> asyncControls;
+    
     bool doCheckContinue;
 
     CollisionDetectorPtr collisionDetector;
@@ -306,7 +354,12 @@ public:
     void onSimulationLoopStarted();
     void updateSimBodyLists();
     bool stepSimulationMain();
-    void concurrentControlLoop();
+    bool control(int controllerIndex);
+    void startControl();
+    bool waitForControl();
+    void updateControllerTicks();
+    void handOffAsynchronousControl();
+    void waitForAsynchronousControl();
     void flushResults();
     void stopSimulation(bool doSync);
     void pauseSimulation();
@@ -1118,6 +1171,9 @@ SimulatorItemImpl::SimulatorItemImpl(SimulatorItem* self)
     timeRangeMode.select(SimulatorItem::TR_UNLIMITED);
     specifiedTimeLength = 180.0; // 3 min.
     useControllerThreadsProperty = true;
+    numControllerThreads = 1;
+    hasMultiRateControllers = false;
+    isProfilingEnabled = false;
     isAllLinkPositionOutputMode = false;
     isDeviceStateOutputEnabled = true;
     recordCollisionData = false;
@@ -1148,6 +1204,9 @@ SimulatorItemImpl::SimulatorItemImpl(SimulatorItem* self, const SimulatorItemImp
     recordingMode = org.recordingMode;
     timeRangeMode = org.timeRangeMode;
     useControllerThreadsProperty = org.useControllerThreadsProperty;
+    numControllerThreads = org.numControllerThreads;
+    isProfilingEnabled = org.isProfilingEnabled;
+    profilingTraceFile = org.profilingTraceFile;
     recordCollisionData = org.recordCollisionData;
 }
     
@@ -1237,6 +1296,50 @@ void SimulatorItem::setRealtimeSyncMode(bool on)
 }
 
 
+/**
+   The control functions of the controllers of different bodies are called in parallel when
+   the number is more than one. The input and output functions are always called in the
+   simulation thread.
+*/
+void SimulatorItem::setNumControllerThreads(int n)
+{
+    impl->numControllerThreads = std::max(n, 1);
+}
+
+
+int SimulatorItem::numControllerThreads() const
+{
+    return impl->numControllerThreads;
+}
+
+
+/**
+   The execution times of the simulation phases are recorded with TraceProfiler while the
+   profiling is enabled. The summary is shown in the message view when the simulation finishes.
+   The profiling can be switched during the simulation.
+*/
+void SimulatorItem::setProfilingEnabled(bool on)
+{
+    impl->isProfilingEnabled = on;
+    if(impl->isDoingSimulationLoop){
+        TraceProfiler::setEnabled(on);
+    }
+}
+
+
+bool SimulatorItem::isProfilingEnabled() const
+{
+    return impl->isProfilingEnabled;
+}
+
+
+//! The records of the profiling are exported to the file in the Chrome trace event format if it is specified.
+void SimulatorItem::setProfilingTraceFile(const std::string& filename)
+{
+    impl->profilingTraceFile = filename;
+}
+
+
 void SimulatorItem::setDeviceStateOutputEnabled(bool on)
 {
     impl->isDeviceStateOutputEnabled = on;
@@ -1619,18 +1722,21 @@ bool SimulatorItemImpl::startSimulation(bool doReset)
             }
         }
 
+        controllerTimes.clear();
+        asyncControls.clear();
         updateSimBodyLists();
 
         doCheckContinue = timeRangeMode.is(SimulatorItem::TR_ACTIVE_CONTROL) && !activeControllers.empty();
             
         useControllerThreads = useControllerThreadsProperty;
-        if(useControllerThreads){
-            isExitingControlLoopRequested = false;
-            isControlRequested = false;
-            isControlFinished = false;
-            controlThread = std::thread(std::bind(&SimulatorItemImpl::concurrentControlLoop, this));
+        if(useControllerThreads || numControllerThreads > 1){
+            controllerThreadPool.reset(new ThreadPool(numControllerThreads));
         }
 
+        TraceProfiler::clear();
+        TraceProfiler::setThreadName("Main");
+        TraceProfiler::setEnabled(isProfilingEnabled);
+
         aboutToQuitConnection.disconnect();
         aboutToQuitConnection = cnoid::sigAboutToQuit().connect(std::bind(&SimulatorItemImpl::stopSimulation, this, true));
 
@@ -1766,6 +1872,8 @@ SimulationBody* SimulatorItem::findSimulationBody(const std::string& name)
 // Simulation loop
 void SimulatorItemImpl::run()
 {
+    TraceProfiler::setThreadName("Simulation");
+    
     self->initializeSimulationThread();
 
     double elapsedTime = 0.0;
@@ -1774,6 +1882,7 @@ void SimulatorItemImpl::run()
 
 #ifdef ENABLE_SIMULATION_PROFILING
     QElapsedTimer oneStepTimer;
+    vector<double> profilingTimes;
 #endif
 
     int frame = 0;
@@ -1809,7 +1918,7 @@ void SimulatorItemImpl::run()
                 }
 #ifdef ENABLE_SIMULATION_PROFILING
                 double oneStepTime = oneStepTimer.nsecsElapsed();
-                vector<double> profilingTimes;
+                profilingTimes.clear();
                 self->getProfilingTimes(profilingTimes);
                 Deque2D<double>::Row buf = simProfilingBuf.append();
                 int i=0;
@@ -1868,7 +1977,7 @@ void SimulatorItemImpl::run()
                 }
 #ifdef ENABLE_SIMULATION_PROFILING
                 double oneStepTime = oneStepTimer.nsecsElapsed();
-                vector<double> profilingTimes;
+                profilingTimes.clear();
                 self->getProfilingTimes(profilingTimes);
                 Deque2D<double>::Row buf = simProfilingBuf.append();
                 int i=0;
@@ -1897,14 +2006,9 @@ void SimulatorItemImpl::run()
 
     isDoingSimulationLoop = false;
 
-    if(useControllerThreads){
-        {
-            std::lock_guard<std::mutex> lock(controlMutex);
-            isExitingControlLoopRequested = true;
-        }
-        controlCondition.notify_all();
-        controlThread.join();
-    }
+    controllerThreadPool.reset();
+    waitForAsynchronousControl();
+    asyncControls.clear();
 
     if(!isWaitingForSimulationToStop){
         callLater(std::bind(&SimulatorItemImpl::onSimulationLoopStopped, this));
@@ -1916,8 +2020,19 @@ void SimulatorItemImpl::run()
 
 void SimulatorItemImpl::updateSimBodyLists()
 {
+    // The running control functions refer to the indices of the active controllers
+    waitForAsynchronousControl();
+    for(auto& async : asyncControls){
+        async.controllerIndex = -1;
+    }
+    
     activeSimBodies.clear();
     activeControllers.clear();
+    activeControllerTimeIndices.clear();
+    controllerGroups.clear();
+    controllerSchedules.clear();
+    hasMultiRateControllers = false;
+    int sequentialGroupIndex = -1;
     hasActiveFreeBodies = false;
     
     for(size_t i=0; i < allSimBodies.size(); ++i){
@@ -1930,17 +2045,203 @@ void SimulatorItemImpl::updateSimBodyLists()
                 hasActiveFreeBodies = true;
             }
         }
+        if(controllers.empty()){
+            continue;
+        }
+
+        bool isSequential = false;
+        for(size_t j=0; j < controllers.size(); ++j){
+            if(controllers[j]->isSequentialControlMode()){
+                isSequential = true;
+                break;
+            }
+        }
+        int groupIndex = -1;
+        
         for(size_t j=0; j < controllers.size(); ++j){
-            activeControllers.push_back(controllers[j]);
-       }
+            ControllerItem* controller = controllers[j];
+            const int controllerIndex = activeControllers.size();
+            activeControllers.push_back(controller);
+
+            ControllerSchedule schedule;
+            schedule.period = controller->controlPeriod();
+            schedule.phase = controller->controlPhase() % schedule.period;
+            schedule.isTicked = true;
+            schedule.doContinue = true;
+
+            if(controller->isAsynchronousControlMode()){
+                schedule.isTicked = false;
+                size_t asyncIndex = 0;
+                while(asyncIndex < asyncControls.size() && asyncControls[asyncIndex].controller != controller){
+                    ++asyncIndex;
+                }
+                if(asyncIndex == asyncControls.size()){
+                    asyncControls.push_back(AsyncControl());
+                    AsyncControl& async = asyncControls.back();
+                    async.controller = controller;
+                    async.thread.reset(new ThreadPool(1));
+                    async.isRunning = false;
+                    async.doContinue = true;
+                }
+                asyncControls[asyncIndex].controllerIndex = controllerIndex;
+                hasMultiRateControllers = true;
+
+            } else {
+                if(groupIndex < 0){
+                    if(!isSequential){
+                        groupIndex = controllerGroups.size();
+                        controllerGroups.push_back(ControllerGroup());
+                    } else {
+                        if(sequentialGroupIndex < 0){
+                            sequentialGroupIndex = controllerGroups.size();
+                            controllerGroups.push_back(ControllerGroup());
+                        }
+                        groupIndex = sequentialGroupIndex;
+                    }
+                }
+                controllerGroups[groupIndex].controllerIndices.push_back(controllerIndex);
+                if(schedule.period > 1 || schedule.phase > 0){
+                    hasMultiRateControllers = true;
+                }
+            }
+            controllerSchedules.push_back(schedule);
+
+            int timeIndex = 0;
+            while(timeIndex < static_cast<int>(controllerTimes.size()) &&
+                  controllerTimes[timeIndex].controller != controller){
+                ++timeIndex;
+            }
+            if(timeIndex == static_cast<int>(controllerTimes.size())){
+                controllerTimes.push_back(ControllerTime());
+                ControllerTime& time = controllerTimes.back();
+                time.controller = controller;
+                time.name = controller->name();
+                time.maxTime = 0.0;
+                time.numCalls = 0;
+            }
+            activeControllerTimeIndices.push_back(timeIndex);
+        }
     }
 
     needToUpdateSimBodyLists = false;
 }
 
 
+bool SimulatorItemImpl::control(int controllerIndex)
+{
+    CNOID_TRACE_ZONE("Controller control");
+    ControllerTime& time = controllerTimes[activeControllerTimeIndices[controllerIndex]];
+    time.timeMeasure.begin();
+    bool doContinue = activeControllers[controllerIndex]->control();
+    time.timeMeasure.end();
+    const double t = time.timeMeasure.time();
+    if(t > time.maxTime){
+        time.maxTime = t;
+    }
+    ++time.numCalls;
+    return doContinue;
+}
+
+
+void SimulatorItemImpl::startControl()
+{
+    for(auto& group : controllerGroups){
+        controllerThreadPool->start(
+            [this, &group](){
+                for(auto& index : group.controllerIndices){
+                    ControllerSchedule& schedule = controllerSchedules[index];
+                    if(schedule.isTicked){
+                        schedule.doContinue = control(index);
+                    }
+                }
+            });
+    }
+}
+
+
+bool SimulatorItemImpl::waitForControl()
+{
+    {
+        CNOID_TRACE_ZONE("Controller wait");
+        controllerThreadPool->wait();
+    }
+    
+    bool doContinue = false;
+    for(auto& schedule : controllerSchedules){
+        doContinue |= schedule.doContinue;
+    }
+#ifdef ENABLE_SIMULATION_PROFILING
+    for(size_t i=0; i < activeControllerTimeIndices.size(); ++i){
+        if(controllerSchedules[i].isTicked){
+            controllerTime += controllerTimes[activeControllerTimeIndices[i]].timeMeasure.time() * 1.0e9;
+        }
+    }
+#endif
+    return doContinue;
+}
+
+
+void SimulatorItemImpl::updateControllerTicks()
+{
+    const int frame = currentFrame - 1;
+    for(auto& schedule : controllerSchedules){
+        schedule.isTicked = (frame >= schedule.phase && (frame - schedule.phase) % schedule.period == 0);
+    }
+    for(auto& async : asyncControls){
+        if(async.controllerIndex >= 0){
+            controllerSchedules[async.controllerIndex].isTicked = false;
+        }
+    }
+}
+
+
+/**
+   The outputs of the asynchronous control functions started on the previous ticks are applied
+   and the next control functions are started on the ticks of the controllers. The simulation
+   waits for a control function which has not finished at the next tick, so the results do not
+   depend on the execution time of the control function.
+*/
+void SimulatorItemImpl::handOffAsynchronousControl()
+{
+    const int frame = currentFrame - 1;
+    for(auto& async : asyncControls){
+        const int index = async.controllerIndex;
+        if(index < 0){
+            continue;
+        }
+        ControllerSchedule& schedule = controllerSchedules[index];
+        if(frame < schedule.phase || (frame - schedule.phase) % schedule.period != 0){
+            continue;
+        }
+        ControllerItem* controller = async.controller;
+        if(async.isRunning){
+            async.thread->wait();
+            async.isRunning = false;
+            schedule.doContinue = async.doContinue;
+            controller->output();
+        }
+        controller->input();
+        async.isRunning = true;
+        AsyncControl* pAsync = &async;
+        async.thread->start([this, pAsync, index](){ pAsync->doContinue = control(index); });
+    }
+}
+
+
+void SimulatorItemImpl::waitForAsynchronousControl()
+{
+    for(auto& async : asyncControls){
+        if(async.isRunning){
+            async.thread->wait();
+        }
+    }
+}
+
+
 bool SimulatorItemImpl::stepSimulationMain()
 {
+    CNOID_TRACE_ZONE("Simulation step");
+    
     currentFrame++;
 
     if(needToUpdateSimBodyLists){
@@ -1949,42 +2250,87 @@ bool SimulatorItemImpl::stepSimulationMain()
     
     bool doContinue = !doCheckContinue;
 
+    if(hasMultiRateControllers){
+        updateControllerTicks();
+    }
+
     preDynamicsFunctions.call();
 
+    if(!asyncControls.empty()){
+        handOffAsynchronousControl();
+    }
+
     if(useControllerThreads){
 #ifdef ENABLE_SIMULATION_PROFILING
         controllerTime = 0.0;
+        timer.start();
 #endif
-        if(activeControllers.empty()){
-            isControlFinished = true;
-        } else {
+        {
+            CNOID_TRACE_ZONE("Controller input");
+            for(size_t i=0; i < activeControllers.size(); ++i){
+                if(controllerSchedules[i].isTicked){
+                    activeControllers[i]->input();
+                }
+            }
+        }
 #ifdef ENABLE_SIMULATION_PROFILING
-            timer.start();
+        controllerTime += timer.nsecsElapsed();
 #endif
+        startControl();
+
+    } else if(controllerThreadPool){
+#ifdef ENABLE_SIMULATION_PROFILING
+        controllerTime = 0.0;
+        timer.start();
+#endif
+        {
+            CNOID_TRACE_ZONE("Controller input");
             for(size_t i=0; i < activeControllers.size(); ++i){
-                activeControllers[i]->input();
+                if(controllerSchedules[i].isTicked){
+                    activeControllers[i]->input();
+                }
             }
+        }
 #ifdef ENABLE_SIMULATION_PROFILING
-            controllerTime += timer.nsecsElapsed();
+        controllerTime += timer.nsecsElapsed();
 #endif
-            {
-                std::lock_guard<std::mutex> lock(controlMutex);                
-                isControlRequested = true;
+        startControl();
+        doContinue |= waitForControl();
+#ifdef ENABLE_SIMULATION_PROFILING
+        timer.start();
+#endif
+        {
+            CNOID_TRACE_ZONE("Controller output");
+            for(size_t i=0; i < activeControllers.size(); ++i){
+                ControllerItem* controller = activeControllers[i];
+                if(controllerSchedules[i].isTicked && controller->isNoDelayMode()){
+                    controller->output();
+                }
             }
-            controlCondition.notify_all();
         }
+#ifdef ENABLE_SIMULATION_PROFILING
+        controllerTime += timer.nsecsElapsed();
+#endif
     } else {
 #ifdef ENABLE_SIMULATION_PROFILING
         controllerTime = 0.0;
         timer.start();
 #endif
         for(size_t i=0; i < activeControllers.size(); ++i){
-            ControllerItem* controller = activeControllers[i];
-            controller->input();
-            doContinue |= controller->control();
-            if(controller->isImmediateMode()){
-                controller->output();
+            ControllerSchedule& schedule = controllerSchedules[i];
+            if(schedule.isTicked){
+                ControllerItem* controller = activeControllers[i];
+                {
+                    CNOID_TRACE_ZONE("Controller input");
+                    controller->input();
+                }
+                schedule.doContinue = control(i);
+                if(controller->isImmediateMode()){
+                    CNOID_TRACE_ZONE("Controller output");
+                    controller->output();
+                }
             }
+            doContinue |= schedule.doContinue;
         }
 #ifdef ENABLE_SIMULATION_PROFILING
         controllerTime += timer.nsecsElapsed();
@@ -1993,27 +2339,26 @@ bool SimulatorItemImpl::stepSimulationMain()
 
     midDynamicsFunctions.call();
 
-    self->stepSimulation(activeSimBodies);
+    {
+        CNOID_TRACE_ZONE("Dynamics");
+        self->stepSimulation(activeSimBodies);
+    }
 
     CollisionLinkPairListPtr collisionPairs;
     if(isRecordingEnabled && recordCollisionData){
+        CNOID_TRACE_ZONE("Collision data extraction");
         collisionPairs = self->getCollisions();
     }
 
     if(useControllerThreads){
-        {
-            std::unique_lock<std::mutex> lock(controlMutex);
-            while(!isControlFinished){
-                controlCondition.wait(lock);
-            }
-        }
-        isControlFinished = false;
-        doContinue |= isControlToBeContinued;
+        doContinue |= waitForControl();
     }
 
     postDynamicsFunctions.call();
 
     {
+        CNOID_TRACE_ZONE("Result buffering");
+        
         resultBufMutex.lock();
 
         ++numBufferedFrames;
@@ -2026,12 +2371,23 @@ bool SimulatorItemImpl::stepSimulationMain()
         resultBufMutex.unlock();
     }
 
+    if(worldLogFileItem){
+        // The simulation waits here rather than in flushResults so that the GUI thread is not blocked
+        CNOID_TRACE_ZONE("Log output waiting");
+        worldLogFileItem->waitForOutputQueueSpace();
+    }
+
     if(useControllerThreads){
 #ifdef ENABLE_SIMULATION_PROFILING
         timer.start();
 #endif
-        for(size_t i=0; i < activeControllers.size(); ++i){
-            activeControllers[i]->output();
+        {
+            CNOID_TRACE_ZONE("Controller output");
+            for(size_t i=0; i < activeControllers.size(); ++i){
+                if(controllerSchedules[i].isTicked){
+                    activeControllers[i]->output();
+                }
+            }
         }
 #ifdef ENABLE_SIMULATION_PROFILING
         controllerTime += timer.nsecsElapsed();
@@ -2040,65 +2396,28 @@ bool SimulatorItemImpl::stepSimulationMain()
 #ifdef ENABLE_SIMULATION_PROFILING
         timer.start();
 #endif
-        for(size_t i=0; i < activeControllers.size(); ++i){
-            ControllerItem* controller = activeControllers[i];
-            if(!controller->isImmediateMode()){
-                controller->output(); 
-            }
-        }
-#ifdef ENABLE_SIMULATION_PROFILING
-        controllerTime += timer.nsecsElapsed();
-#endif
-    }
-
-    return doContinue;
-}
-
-
-void SimulatorItemImpl::concurrentControlLoop()
-{
-    while(true){
         {
-            std::unique_lock<std::mutex> lock(controlMutex);
-            while(true){
-                if(isExitingControlLoopRequested){
-                    goto exitConcurrentControlLoop;
-                }
-                if(isControlRequested){
-                    isControlRequested = false;
-                    isControlToBeContinued = false;
-                    break;
+            CNOID_TRACE_ZONE("Controller output");
+            for(size_t i=0; i < activeControllers.size(); ++i){
+                ControllerItem* controller = activeControllers[i];
+                if(controllerSchedules[i].isTicked && !controller->isImmediateMode()){
+                    controller->output(); 
                 }
-                controlCondition.wait(lock);
             }
         }
-
-        bool doContinue = false;
-#ifdef ENABLE_SIMULATION_PROFILING
-        timer.start();
-#endif
-        for(size_t i=0; i < activeControllers.size(); ++i){
-            doContinue |= activeControllers[i]->control();
-        }
 #ifdef ENABLE_SIMULATION_PROFILING
         controllerTime += timer.nsecsElapsed();
 #endif
-        
-        {
-            std::lock_guard<std::mutex> lock(controlMutex);
-            isControlFinished = true;
-            isControlToBeContinued = doContinue;
-        }
-        controlCondition.notify_all();
     }
-    
-exitConcurrentControlLoop:
-    return;
+
+    return doContinue;
 }
 
 
 void SimulatorItemImpl::flushResults()
 {
+    CNOID_TRACE_ZONE("Result flushing");
+    
     resultBufMutex.lock();
 
     if(worldLogFileItem){
@@ -2115,6 +2434,7 @@ void SimulatorItemImpl::flushResults()
                     nextLogTime = ++nextLogFrame * logTimeStep;
                 }
             }
+            worldLogFileItem->flushOutput();
         }
     }
     
@@ -2248,6 +2568,10 @@ void SimulatorItemImpl::onSimulationLoopStopped()
 
     flushResults();
 
+    if(worldLogFileItem){
+        worldLogFileItem->finishOutput();
+    }
+
     if(isRecordingEnabled){
         timeBar->stopFillLevelUpdate(fillLevelId);
     }
@@ -2260,6 +2584,28 @@ void SimulatorItemImpl::onSimulationLoopStopped()
     mv->putln(format(_("Computation time is %1% [s], computation time / simulation time = %2%."))
               % actualSimulationTime % (actualSimulationTime / finishTime));
 
+    if(isProfilingEnabled){
+        TraceProfiler::setEnabled(false);
+        mv->putln(_("Profiling results:"));
+        TraceProfiler::putSummary(mv->cout());
+        if(!profilingTraceFile.empty()){
+            if(TraceProfiler::exportChromeTrace(profilingTraceFile, mv->cout())){
+                mv->putln(format(_("The profiling trace has been exported to \"%1%\".")) % profilingTraceFile);
+            }
+        }
+    }
+
+    if(!controllerTimes.empty()){
+        mv->putln(_("Computation time of the controllers:"));
+        for(auto& time : controllerTimes){
+            if(time.numCalls > 0){
+                mv->putln(format(_("  %1%: %2% [s] in total, %3% [ms] on average, %4% [ms] at the maximum"))
+                          % time.name % time.timeMeasure.totalTime()
+                          % (time.timeMeasure.totalTime() / time.numCalls * 1000.0) % (time.maxTime * 1000.0));
+            }
+        }
+    }
+
 }
 
 
@@ -2544,6 +2890,11 @@ void SimulatorItemImpl::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(recordCollisionData));
     putProperty(_("Controller Threads"), useControllerThreadsProperty,
                 changeProperty(useControllerThreadsProperty));
+    putProperty.min(1)(_("Num controller threads"), numControllerThreads,
+                       changeProperty(numControllerThreads));
+    putProperty(_("Profiling"), isProfilingEnabled,
+                [&](bool on){ self->setProfilingEnabled(on); return true; });
+    putProperty(_("Profiling trace file"), profilingTraceFile, changeProperty(profilingTraceFile));
     putProperty(_("Controller options"), controllerOptionString_,
                 changeProperty(controllerOptionString_));
 }
@@ -2569,6 +2920,11 @@ bool SimulatorItemImpl::store(Archive& archive)
     archive.write("allLinkPositionOutputMode", isAllLinkPositionOutputMode);
     archive.write("deviceStateOutput", isDeviceStateOutputEnabled);
     archive.write("controllerThreads", useControllerThreadsProperty);
+    archive.write("numControllerThreads", numControllerThreads);
+    archive.write("profiling", isProfilingEnabled);
+    if(!profilingTraceFile.empty()){
+        archive.writeRelocatablePath("profilingTraceFile", profilingTraceFile);
+    }
     archive.write("recordCollisionData", recordCollisionData);
     archive.write("controllerOptions", controllerOptionString_, DOUBLE_QUOTED);
 
@@ -2646,6 +3002,9 @@ bool SimulatorItemImpl::restore(const Archive& archive)
     archive.read("deviceStateOutput", isDeviceStateOutputEnabled);
     archive.read("recordCollisionData", recordCollisionData);
     archive.read("controllerThreads", useControllerThreadsProperty);
+    archive.read("numControllerThreads", numControllerThreads);
+    archive.read("profiling", isProfilingEnabled);
+    archive.readRelocatablePath("profilingTraceFile", profilingTraceFile);
     archive.read("controllerOptions", controllerOptionString_);
 
     archive.addPostProcess(
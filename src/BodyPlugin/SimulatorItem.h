@@ -124,6 +124,11 @@ public:
     void setTimeRangeMode(int selection);
     void setRealtimeSyncMode(bool on);
     void setDeviceStateOutputEnabled(bool on);
+    void setNumControllerThreads(int n);
+    int numControllerThreads() const;
+    void setProfilingEnabled(bool on);
+    bool isProfilingEnabled() const;
+    void setProfilingTraceFile(const std::string& filename);
 
     bool isRecordingEnabled() const;
     bool isDeviceStateOutputEnabled() const;
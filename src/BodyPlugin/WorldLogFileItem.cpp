@@ -11,8 +11,23 @@
 #include <cnoid/FileUtil>
 #include <cnoid/Archive>
 #include <QDateTime>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/copy.hpp>
 #include <fstream>
 #include <stack>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 
 #include <iostream>
 
@@ -38,25 +53,168 @@ enum DataTypeID {
     DEVICE_STATES
 };
 
+/*
+  A compressed log file begins with this value instead of the top header size.
+  In the compressed format, the frame chain consists of frame blocks. The time of a
+  block is the time of its first frame, and the block data is the following:
+
+  int: size of the raw frame data
+  octet: BlockCodecID
+  (compressed) frame data: sequence of {float time, int data size, frame data}
+
+  The first frame of a block is a keyframe. The link and joint positions are quantized
+  and encoded as the differences from the previous frame in the block, and the seek
+  positions of the device states are the offsets in the raw frame data of the block.
+*/
+static const int compressedLogFormatMarker = -2;
+
+enum BlockCodecID {
+    NO_CODEC,
+    ZLIB_CODEC
+};
+
 struct NotEnoughDataException { };
 
+/**
+   Memory mapping of a log file for reading the data without copying it.
+   The mapping is extended when the file grows while it is being recorded.
+   The previous mappings are kept until releaseRetiredMappings() is called
+   because the read buffers may still refer to them.
+*/
+class LogFileMapping
+{
+public:
+    boost::iostreams::mapped_file_source file;
+    vector<boost::iostreams::mapped_file_source> retiredFiles;
+    string filename;
+
+    bool open(const string& fname){
+        close();
+        filename = fname;
+        return map();
+    }
+
+    bool map(){
+        try {
+            file.open(filename);
+        } catch(const std::exception&){
+            // The stream is used instead
+        }
+        return file.is_open();
+    }
+
+    void close(){
+        if(file.is_open()){
+            file.close();
+        }
+        retiredFiles.clear();
+    }
+
+    void releaseRetiredMappings(){
+        retiredFiles.clear();
+    }
+
+    bool isOpen() const {
+        return file.is_open();
+    }
+
+    const char* data() const {
+        return file.data();
+    }
+
+    size_t size() const {
+        return file.size();
+    }
+
+    bool remapIfGrown(size_t requiredSize){
+        boost::system::error_code ec;
+        size_t fileSize = filesystem::file_size(filename, ec);
+        if(ec || fileSize <= file.size() || fileSize < requiredSize){
+            return false;
+        }
+        boost::iostreams::mapped_file_source newFile;
+        try {
+            newFile.open(filename);
+        } catch(const std::exception&){
+            return false;
+        }
+        retiredFiles.push_back(file);
+        file = newFile;
+        return true;
+    }
+};
+
+
 class ReadBuf
 {
 public:
     vector<char> data;
     ifstream& ifs;
+    LogFileMapping* mapping;
+    size_t mappedOffset;
+    const char* top;
+    int bufSize;
     int pos;
 
-    ReadBuf(ifstream& ifs)
-        : ifs(ifs) {
+    bool isFixed;
+
+    ReadBuf(ifstream& ifs, LogFileMapping* mapping = nullptr)
+        : ifs(ifs),
+          mapping(mapping) {
+        mappedOffset = 0;
+        top = nullptr;
+        bufSize = 0;
+        pos = 0;
+        isFixed = false;
+    }
+
+    /**
+       The buffer reads the given data which has already been loaded instead of the file.
+    */
+    void setFixedData(const char* data, int size){
+        this->data.clear();
+        top = data;
+        bufSize = size;
         pos = 0;
+        isFixed = true;
+    }
+
+    bool isMapped() const {
+        return mapping && mapping->isOpen();
+    }
+
+    /**
+       The following reading starts from the position of the file.
+       The file stream is not used when the file is memory-mapped.
+    */
+    void seekFile(int filePos){
+        if(isMapped()){
+            mappedOffset = filePos;
+        } else {
+            ifs.seekg(filePos);
+        }
     }
 
     bool checkSize(int size){
+        if(pos + size <= bufSize){
+            return true;
+        }
+        return extend(size);
+    }
+
+    bool extend(int size){
+        if(isFixed){
+            return false;
+        }
+        if(isMapped()){
+            return extendMappedData(size);
+        }
         int left = data.size() - pos;
         if(left < size){
             int len = size - left;
             data.resize(data.size() + len);
+            top = &data.front();
+            bufSize = data.size();
             ifs.read(&data[pos], len);
             if(!ifs.fail()){
                 return true;
@@ -68,6 +226,20 @@ public:
         return true;
     }
 
+    bool extendMappedData(int size){
+        size_t requiredSize = mappedOffset + pos + size;
+        if(requiredSize > mapping->size()){
+            if(!mapping->remapIfGrown(requiredSize)){
+                return false;
+            }
+        }
+        top = mapping->data() + mappedOffset;
+        if(bufSize < pos + size){
+            bufSize = pos + size;
+        }
+        return true;
+    }
+
     void ensureSize(int size){
         if(!checkSize(size)){
             throw NotEnoughDataException();
@@ -84,62 +256,64 @@ public:
         return pos + size;
     }
 
-    char* buf() {
-        return &data.front();
+    const char* buf() {
+        return top;
     }
 
     void clear(){
         data.clear();
+        top = nullptr;
+        bufSize = 0;
         pos = 0;
     }
 
     int size() const {
-        return data.size();
+        return bufSize;
     }
 
-    char* current() {
-        return &data[pos];
+    const char* current() {
+        return top + pos;
     }
 
-    char* end() {
-        return &data.front() + data.size();
+    const char* end() {
+        return top + bufSize;
     }
 
     bool isEnd() {
-        return (pos >= static_cast<int>(data.size()));
+        return (pos >= bufSize);
     }
 
     void seek(int pos = 0) { this->pos = pos; }
 
     char readID(){
         ensureSize(1);
-        return data[pos++];
+        return top[pos++];
     }
 
     bool readBool(){
         ensureSize(1);
-        return data[pos++];
+        return top[pos++];
     }
 
     char readOctet(){
         ensureSize(1);
-        return data[pos++];
+        return top[pos++];
     }
 
     short readShort(){
         ensureSize(2);
-        unsigned char low = data[pos++];
-        unsigned char high = data[pos++];
+        unsigned char low = top[pos++];
+        unsigned char high = top[pos++];
         short value = low + (high << 8);
         return value;
     }
 
     int readInt(){
         ensureSize(4);
-        unsigned char d0 = data[pos++];
-        unsigned char d1 = data[pos++];
-        unsigned char d2 = data[pos++];
-        unsigned char d3 = data[pos++];
+        unsigned char d0 = top[pos++];
+        unsigned char d1 = top[pos++];
+        unsigned char d2 = top[pos++];
+        unsigned char d3 = top[pos++];
         int value = d0 + (d1 << 8) + (d2 << 16) + (d3 << 24);
         return value;
     }
@@ -148,13 +322,36 @@ public:
         return readInt();
     }
 
+    uint64_t readVarUInt(){
+        uint64_t value = 0;
+        int shift = 0;
+        while(true){
+            ensureSize(1);
+            unsigned char byte = top[pos++];
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if(!(byte & 0x80)){
+                break;
+            }
+            shift += 7;
+            if(shift > 63){
+                throw NotEnoughDataException();
+            }
+        }
+        return value;
+    }
+
+    int64_t readVarInt(){
+        uint64_t value = readVarUInt();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
     float readFloat(){
         ensureSize(sizeof(float));
         float value;
         char* p = (char*)&value;
         const int n = sizeof(float);
         for(int i=0; i < n; ++i){
-            p[i] = data[pos++];
+            p[i] = top[pos++];
         }
         return value;
     }
@@ -180,7 +377,7 @@ public:
         std::string str;
         str.reserve(size);
         for(int i=0; i < size; ++i){
-            str.append(1, data[pos++]);
+            str.append(1, top[pos++]);
         }
         return str;
     }
@@ -211,9 +408,19 @@ public:
         return seekOffset + data.size();
     }
 
+    void reset(){
+        data.clear();
+        seekOffset = 0;
+    }
+
+    /**
+       The data is discarded as the one which has been passed to the file.
+       The seek offset counts the passed data because the data may be written
+       by the background writer and ofs.tellp() cannot be used.
+    */
     void clear(){
+        seekOffset += data.size();
         data.clear();
-        seekOffset = ofs.tellp();
     }
 
     int size() const {
@@ -268,6 +475,19 @@ public:
     void writeSeekOffset(int pos, int offset){
         writeInt(pos, offset);
     }
+
+    void writeVarUInt(uint64_t value){
+        while(value >= 0x80){
+            data.push_back((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        data.push_back(value);
+    }
+
+    //! The value is zigzag-encoded so that small negative values are also short
+    void writeVarInt(int64_t value){
+        writeVarUInt((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
     
     void writeFloat(float value){
         char* p = (char*)&value;
@@ -300,9 +520,355 @@ public:
 };
 
 
+/**
+   The raw frame data is appended to the output data.
+   @return false if the data cannot be compressed
+*/
+bool compressFrameBlock(const vector<char>& raw, vector<char>& out)
+{
+    try {
+        boost::iostreams::filtering_ostream os;
+        os.push(boost::iostreams::zlib_compressor(
+                    boost::iostreams::zlib_params(boost::iostreams::zlib::best_speed)));
+        os.push(boost::iostreams::back_inserter(out));
+        os.write(raw.data(), raw.size());
+        os.reset();
+    } catch(const std::exception&){
+        return false;
+    }
+    return true;
+}
+
+
+bool decompressFrameBlock(int codec, const char* data, int size, int rawSize, vector<char>& out)
+{
+    out.clear();
+    if(codec == NO_CODEC){
+        if(size < rawSize){
+            return false;
+        }
+        out.assign(data, data + rawSize);
+        return true;
+    } else if(codec == ZLIB_CODEC){
+        out.reserve(rawSize);
+        try {
+            boost::iostreams::filtering_istream is;
+            is.push(boost::iostreams::zlib_decompressor());
+            is.push(boost::iostreams::array_source(data, size));
+            boost::iostreams::copy(is, boost::iostreams::back_inserter(out));
+        } catch(const std::exception&){
+            return false;
+        }
+        return (static_cast<int>(out.size()) == rawSize);
+    }
+    return false;
+}
+
+
+struct QuantizedBodyState
+{
+    vector<int64_t> linkValues;
+    vector<int64_t> jointValues;
+};
+
+
+static const size_t logOutputChunkSize = 1024 * 1024;
+static const int numLogOutputChunks = 8;
+
+struct FrameIndexEntry
+{
+    float time;
+    int pos;
+};
+
+/**
+   The writer thread which outputs the serialized frames to the file.
+   The chunks of the frame data are preallocated, and the filled chunks are passed
+   from the single producer to the writer through the bounded queue. A chunk is written
+   to the file at once and is returned to the producer as a free chunk.
+
+   The frame index entries of the frames in a chunk are passed with the chunk and they are
+   added to the frame index after the chunk is written so that the index only refers to
+   the frames in the file.
+*/
+class AsyncLogWriter
+{
+public:
+    struct Chunk
+    {
+        vector<char> data;
+        vector<FrameIndexEntry> frames;
+    };
+    
+    ofstream& ofs;
+    vector<FrameIndexEntry>& frameIndex;
+    std::mutex& frameIndexMutex;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<Chunk> queue;
+    vector<vector<char>> freeChunks;
+    int numAllocatedChunks;
+    bool isWriting;
+    bool isStopping;
+    std::atomic<int> queueDepth;
+    std::atomic<long long> numWrittenBytes;
+    std::chrono::steady_clock::time_point startTime;
+    std::atomic<double> elapsedTime;
+
+    AsyncLogWriter(ofstream& ofs, vector<FrameIndexEntry>& frameIndex, std::mutex& frameIndexMutex)
+        : ofs(ofs),
+          frameIndex(frameIndex),
+          frameIndexMutex(frameIndexMutex) {
+        numAllocatedChunks = numLogOutputChunks - 1;
+        freeChunks.resize(numAllocatedChunks);
+        for(auto& chunk : freeChunks){
+            chunk.reserve(logOutputChunkSize * 2);
+        }
+        isWriting = false;
+        isStopping = false;
+        queueDepth = 0;
+        numWrittenBytes = 0;
+        elapsedTime = 0.0;
+        startTime = std::chrono::steady_clock::now();
+        thread = std::thread([this](){ run(); });
+    }
+
+    ~AsyncLogWriter(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            isStopping = true;
+        }
+        condition.notify_all();
+        thread.join();
+        ofs.flush();
+    }
+
+    /**
+       The data and the frame index entries are swapped with a free chunk.
+       When there is no free chunk, a new chunk is allocated if doGrow is true.
+       The producer is never blocked here because it is the GUI thread.
+       @return false if there is no free chunk and doGrow is false.
+    */
+    bool push(vector<char>& data, vector<FrameIndexEntry>& frames, bool doGrow){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(freeChunks.empty()){
+                if(!doGrow){
+                    return false;
+                }
+                freeChunks.emplace_back();
+                ++numAllocatedChunks;
+            }
+            queue.push_back(Chunk());
+            Chunk& chunk = queue.back();
+            chunk.data = std::move(data);
+            chunk.frames.swap(frames);
+            data = std::move(freeChunks.back());
+            freeChunks.pop_back();
+            queueDepth = queue.size();
+        }
+        frames.clear();
+        condition.notify_all();
+        return true;
+    }
+
+    /**
+       This function is called by the thread producing the frames, which is the simulation
+       thread, to wait until the queue has room for the chunks of the preallocated size.
+    */
+    void waitForQueueSpace(){
+        std::unique_lock<std::mutex> lock(mutex);
+        while(static_cast<int>(queue.size()) >= numLogOutputChunks - 1 && !isStopping){
+            condition.wait(lock);
+        }
+    }
+
+    bool isIdle(){
+        std::lock_guard<std::mutex> lock(mutex);
+        return queue.empty() && !isWriting;
+    }
+
+    void waitForCompletion(){
+        std::unique_lock<std::mutex> lock(mutex);
+        while(!queue.empty() || isWriting){
+            condition.wait(lock);
+        }
+    }
+
+    double bytesPerSecond() const {
+        double t = elapsedTime;
+        if(t <= 0.0){
+            t = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        }
+        return (t > 0.0) ? (numWrittenBytes / t) : 0.0;
+    }
+
+private:
+    void run(){
+        while(true){
+            Chunk chunk;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while(queue.empty() && !isStopping){
+                    condition.wait(lock);
+                }
+                if(queue.empty()){
+                    break;
+                }
+                chunk = std::move(queue.front());
+                queue.pop_front();
+                isWriting = true;
+            }
+
+            // A chunk always ends at a frame boundary, and flushing it here keeps
+            // the frames in the file complete for the playback during the simulation
+            ofs.write(chunk.data.data(), chunk.data.size());
+            ofs.flush();
+            numWrittenBytes += chunk.data.size();
+
+            if(!chunk.frames.empty()){
+                std::lock_guard<std::mutex> lock(frameIndexMutex);
+                frameIndex.insert(frameIndex.end(), chunk.frames.begin(), chunk.frames.end());
+            }
+            
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                // The chunks allocated when the queue was full are released here
+                if(numAllocatedChunks > numLogOutputChunks - 1){
+                    --numAllocatedChunks;
+                } else {
+                    chunk.data.clear();
+                    freeChunks.push_back(std::move(chunk.data));
+                }
+                queueDepth = queue.size();
+                isWriting = false;
+            }
+            condition.notify_all();
+        }
+        elapsedTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    }
+};
+
+
+/*
+  The frame index of a log file is saved in the sidecar file "<log file>.index" so that
+  it does not have to be built by scanning the frame headers when the log is opened again.
+  The index file consists of the following data:
+  magic (8 bytes), version (int32), position of the first frame (int32),
+  end position of the last frame (int64), number of the entries (int64), entries.
+  The end position must be equal to the size of the log file. Otherwise the index is
+  regarded as stale and the index is built again.
+*/
+static const char frameIndexFileMagic[] = { 'C', 'N', 'O', 'I', 'D', 'W', 'L', 'I' };
+static const int32_t frameIndexFileVersion = 1;
+
+string getFrameIndexFilename(const string& logFilename)
+{
+    return logFilename + ".index";
+}
+
+template<class T> bool readValue(istream& is, T& value)
+{
+    is.read(reinterpret_cast<char*>(&value), sizeof(value));
+    return !is.fail();
+}
+
+template<class T> void writeValue(ostream& os, const T& value)
+{
+    os.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+/**
+   The index is written into a temporary file which is renamed to the index file
+   so that a partially written index is never read.
+*/
+bool saveFrameIndexFile(const string& logFilename, const vector<FrameIndexEntry>& entries, int64_t endPos)
+{
+    if(entries.empty()){
+        return false;
+    }
+    const string filename = getFrameIndexFilename(logFilename);
+    const string tmpFilename = filename + ".tmp";
+    {
+        ofstream os(tmpFilename.c_str(), ios::out | ios::binary | ios::trunc);
+        if(!os.is_open()){
+            return false;
+        }
+        os.write(frameIndexFileMagic, sizeof(frameIndexFileMagic));
+        writeValue(os, frameIndexFileVersion);
+        writeValue(os, static_cast<int32_t>(entries.front().pos));
+        writeValue(os, endPos);
+        writeValue(os, static_cast<int64_t>(entries.size()));
+        os.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(FrameIndexEntry));
+        if(os.fail()){
+            os.close();
+            filesystem::remove(tmpFilename);
+            return false;
+        }
+    }
+    boost::system::error_code ec;
+    filesystem::rename(tmpFilename, filename, ec);
+    if(ec){
+        filesystem::remove(tmpFilename, ec);
+        return false;
+    }
+    return true;
+}
+
+bool loadFrameIndexFile(const string& logFilename, int firstFramePos, vector<FrameIndexEntry>& entries)
+{
+    boost::system::error_code ec;
+    const uintmax_t logFileSize = filesystem::file_size(logFilename, ec);
+    if(ec){
+        return false;
+    }
+    ifstream is(getFrameIndexFilename(logFilename).c_str(), ios::in | ios::binary);
+    if(!is.is_open()){
+        return false;
+    }
+    char magic[sizeof(frameIndexFileMagic)];
+    int32_t version;
+    int32_t firstPos;
+    int64_t endPos;
+    int64_t numEntries;
+    is.read(magic, sizeof(magic));
+    if(is.fail() || !std::equal(magic, magic + sizeof(magic), frameIndexFileMagic) ||
+       !readValue(is, version) || version != frameIndexFileVersion ||
+       !readValue(is, firstPos) || firstPos != firstFramePos ||
+       !readValue(is, endPos) || endPos < 0 || static_cast<uintmax_t>(endPos) != logFileSize ||
+       !readValue(is, numEntries) || numEntries <= 0 || numEntries > (endPos - firstPos) / frameHeaderSize){
+        return false;
+    }
+    entries.resize(numEntries);
+    is.read(reinterpret_cast<char*>(entries.data()), numEntries * sizeof(FrameIndexEntry));
+    if(is.fail()){
+        return false;
+    }
+    for(int64_t i=0; i < numEntries; ++i){
+        const int pos = entries[i].pos;
+        if((i == 0) ? (pos != firstPos) : (pos <= entries[i-1].pos || pos > endPos - frameHeaderSize)){
+            return false;
+        }
+    }
+
+    // The last frame of the index must be the one which ends at the end of the log file
+    ifstream logStream(logFilename.c_str(), ios::in | ios::binary);
+    ReadBuf buf(logStream);
+    logStream.seekg(entries.back().pos);
+    if(!buf.checkSize(frameHeaderSize)){
+        return false;
+    }
+    buf.readSeekOffset(); // offset to the prev frame
+    const float time = buf.readFloat();
+    const int dataSize = buf.readSeekOffset();
+    return (time == entries.back().time) && (entries.back().pos + frameHeaderSize + dataSize == endPos);
+}
+
+
 class DeviceInfo {
 public:
-    size_t lastStateSeekPos;
+    int64_t lastStateSeekPos;
     vector<double> lastState;
     bool isConsistent;
     DeviceInfo() {
@@ -393,9 +959,30 @@ public:
     ofstream ofs;
     WriteBuf writeBuf;
     int lastOutputFramePos;
+    int prevOutputFramePos;
     double recordingFrameRate;
     stack<int> sizeHeaderStack;
 
+    // for the asynchronous output
+    bool isAsyncOutputEnabled;
+    Selection fullOutputQueuePolicy;
+    std::unique_ptr<AsyncLogWriter> asyncWriter;
+    vector<FrameIndexEntry> pendingFrameIndexEntries;
+    int numDroppedFrames;
+
+    // for the compressed format output
+    Selection logFormat;
+    double compressionTolerance;
+    int keyframeInterval;
+    bool isCompressedOutput;
+    float outputQuantizationStep;
+    WriteBuf blockBuf;
+    WriteBuf* frameBuf;
+    int numBlockFrames;
+    float blockStartTime;
+    int outputBodyIndex;
+    vector<QuantizedBodyState> outputQuantizedStates;
+
     // for device state recording and playback
     struct DeviceStateCache : public Referenced {
         DeviceStatePtr state;
@@ -412,6 +999,7 @@ public:
     vector<double> doubleWriteBuf;
 
     ifstream ifs;
+    LogFileMapping mapping;
     ReadBuf readBuf;
     ReadBuf readBuf2;
     int currentReadFramePos;
@@ -420,6 +1008,38 @@ public:
     double currentReadFrameTime;
     bool isCurrentFrameDataLoaded;
     bool isOverRange;
+
+    // for the compressed format input
+    bool isCompressedLog;
+    float inputQuantizationStep;
+    vector<char> blockData;
+    struct BlockFrame {
+        float time;
+        int dataPos;
+        int dataSize;
+    };
+    vector<BlockFrame> blockFrames;
+    ReadBuf blockReadBuf;
+    ReadBuf blockReadBuf2;
+    ReadBuf* frameReadBuf;
+    int decodedBlockPos;
+    int decodedFrameIndex;
+    int inputBodyIndex;
+    vector<QuantizedBodyState> inputQuantizedStates;
+
+    /*
+      The index of the frame headers for the random access.
+      The index is updated in recording a log and is saved in the sidecar file when the
+      recording is finished. When an existing log file is opened, the index is loaded from
+      the sidecar file, or is built by a background thread if the file is missing or stale.
+    */
+    vector<FrameIndexEntry> frameIndex;
+    string frameIndexFilename;
+    bool isFrameIndexReady;
+    std::mutex frameIndexMutex;
+    std::thread frameIndexBuilderThread;
+    std::atomic<bool> isFrameIndexBuildCanceled;
+    float lastOutputFrameTime;
         
     vector<BodyInfoPtr> bodyInfos;
     ScopedConnection worldSubTreeChangedConnection;
@@ -428,16 +1048,23 @@ public:
     WorldLogFileItemImpl(WorldLogFileItem* self);
     WorldLogFileItemImpl(WorldLogFileItem* self, WorldLogFileItemImpl& org);
     ~WorldLogFileItemImpl();
+    void initialize();
     bool setLogFileName(const std::string& name);
     string getActualFilename();
     void updateBodyInfos();
     void onWorldSubTreeChanged();
     bool readTopHeader();
     bool readFrameHeader(int pos);
+    void resetFrameIndex();
+    void startFrameIndexBuild(const string& fname, int firstFramePos);
+    void buildFrameIndex(const string& fname, int firstFramePos);
+    int findFramePosInIndex(double time);
     bool seek(double time);
     bool recallStateAtTime(double time);
     bool loadCurrentFrameData();
-    void readBodyStatees();
+    bool loadCurrentBlockFrame(double time);
+    void decodeBlockFrame(const BlockFrame& frame);
+    void decodeBodyState(ReadBuf& buf, int bodyIndex);
     void readBodyState(BodyInfo* bodyInfo);
     int readLinkPositions(Body* body);
     int readJointPositions(Body* body);
@@ -445,12 +1072,24 @@ public:
     void readDeviceState(DeviceInfo& devInfo, Device* device, ReadBuf& buf, int size);
     void readLastDeviceState(DeviceInfo& devInfo, Device* device);
     void clearOutput();
+    void beginHeaderOutput();
     void reserveSizeHeader();
     void fixSizeHeader();
     void endHeaderOutput();
     void beginFrameOutput(double time);
+    void beginBodyStateOutput();
+    void outputLinkPositions(SE3* positions, int size);
+    void outputJointPositions(double* values, int size);
+    void outputQuantizedValue(double value, int64_t& lastValue);
     void outputDeviceState(DeviceState* state);
+    void endFrameOutput();
+    void outputFrameBlock(bool doGrowQueue);
+    bool commitOutputFrames(int numFrames, bool doGrowQueue);
+    void dropCurrentFrame(int numFrames);
     void exchangeDeviceStateCacheArrays();
+    bool passOutputDataToWriter(bool doGrowQueue);
+    void flushOutput();
+    void finishOutput();
 };
 
 }
@@ -477,12 +1116,27 @@ WorldLogFileItem::WorldLogFileItem()
 WorldLogFileItemImpl::WorldLogFileItemImpl(WorldLogFileItem* self)
     : self(self),
       writeBuf(ofs),
-      readBuf(ifs),
-      readBuf2(ifs)
+      fullOutputQueuePolicy(WorldLogFileItem::N_FULL_OUTPUT_QUEUE_POLICIES, CNOID_GETTEXT_DOMAIN_NAME),
+      logFormat(WorldLogFileItem::N_LOG_FORMATS, CNOID_GETTEXT_DOMAIN_NAME),
+      blockBuf(ofs),
+      readBuf(ifs, &mapping),
+      readBuf2(ifs, &mapping),
+      blockReadBuf(ifs),
+      blockReadBuf2(ifs)
 {
+    fullOutputQueuePolicy.setSymbol(WorldLogFileItem::BLOCK_OUTPUT, N_("Block"));
+    fullOutputQueuePolicy.setSymbol(WorldLogFileItem::DROP_FRAMES, N_("Drop frames"));
+    fullOutputQueuePolicy.select(WorldLogFileItem::BLOCK_OUTPUT);
+    isAsyncOutputEnabled = true;
+    numDroppedFrames = 0;
+    logFormat.setSymbol(WorldLogFileItem::RAW_FORMAT, N_("Raw"));
+    logFormat.setSymbol(WorldLogFileItem::COMPRESSED_FORMAT, N_("Compressed"));
+    logFormat.select(WorldLogFileItem::RAW_FORMAT);
+    compressionTolerance = 1.0e-5;
+    keyframeInterval = 100;
     isTimeStampSuffixEnabled = false;
     recordingFrameRate = 0.0;
-    isBodyInfoUpdateNeeded = true;
+    initialize();
 }
 
 
@@ -496,13 +1150,37 @@ WorldLogFileItem::WorldLogFileItem(const WorldLogFileItem& org)
 WorldLogFileItemImpl::WorldLogFileItemImpl(WorldLogFileItem* self, WorldLogFileItemImpl& org)
     : self(self),
       writeBuf(ofs),
-      readBuf(ifs),
-      readBuf2(ifs)
+      fullOutputQueuePolicy(org.fullOutputQueuePolicy),
+      logFormat(org.logFormat),
+      blockBuf(ofs),
+      readBuf(ifs, &mapping),
+      readBuf2(ifs, &mapping),
+      blockReadBuf(ifs),
+      blockReadBuf2(ifs)
 {
+    isAsyncOutputEnabled = org.isAsyncOutputEnabled;
+    numDroppedFrames = 0;
+    compressionTolerance = org.compressionTolerance;
+    keyframeInterval = org.keyframeInterval;
     filename = org.filename;
     isTimeStampSuffixEnabled = org.isTimeStampSuffixEnabled;
     recordingFrameRate = org.recordingFrameRate;
+    initialize();
+}
+
+
+void WorldLogFileItemImpl::initialize()
+{
     isBodyInfoUpdateNeeded = true;
+    isFrameIndexReady = false;
+    isFrameIndexBuildCanceled = false;
+    isCompressedOutput = false;
+    frameBuf = &writeBuf;
+    numBlockFrames = 0;
+    isCompressedLog = false;
+    frameReadBuf = &readBuf;
+    decodedBlockPos = -1;
+    decodedFrameIndex = -1;
 }
 
 
@@ -514,7 +1192,8 @@ WorldLogFileItem::~WorldLogFileItem()
 
 WorldLogFileItemImpl::~WorldLogFileItemImpl()
 {
-
+    finishOutput();
+    resetFrameIndex();
 }
 
 
@@ -637,19 +1316,45 @@ bool WorldLogFileItemImpl::readTopHeader()
     if(ifs.is_open()){
         ifs.close();
     }
+    mapping.close();
     string fname = getActualFilename();
+    bool doBuildFrameIndex = false;
+    if(fname != frameIndexFilename){
+        resetFrameIndex();
+        doBuildFrameIndex = true;
+    }
     if(filesystem::exists(fname)){
         ifs.open(fname.c_str(), ios::in | ios::binary);
         if(ifs.is_open()){
+            mapping.open(fname);
+            readBuf.seekFile(0);
             readBuf.clear();
+            isCompressedLog = false;
+            decodedBlockPos = -1;
             try {
                 int headerSize = readBuf.readSeekOffset();
+                if(headerSize == compressedLogFormatMarker){
+                    isCompressedLog = true;
+                    headerSize = readBuf.readSeekOffset();
+                }
                 if(readBuf.checkSize(headerSize)){
+                    if(isCompressedLog){
+                        inputQuantizationStep = readBuf.readFloat();
+                    }
                     while(!readBuf.isEnd()){
                         bodyNames.push_back(readBuf.readString());
                     }
                     currentReadFramePos = readBuf.pos;
                     result = readFrameHeader(readBuf.pos);
+                    if(result && doBuildFrameIndex){
+                        if(loadFrameIndexFile(fname, currentReadFramePos, frameIndex)){
+                            frameIndexFilename = fname;
+                            isFrameIndexReady = true;
+                        } else {
+                            frameIndex.clear();
+                            startFrameIndexBuild(fname, currentReadFramePos);
+                        }
+                    }
                 }
             } catch(NotEnoughDataException& ex){
                 bodyNames.clear();
@@ -671,7 +1376,7 @@ bool WorldLogFileItemImpl::readFrameHeader(int pos)
         return false;
     }
 
-    ifs.seekg(pos);
+    readBuf.seekFile(pos);
 
     if(ifs.eof()){
         ifs.seekg(currentReadFramePos);
@@ -693,10 +1398,116 @@ bool WorldLogFileItemImpl::readFrameHeader(int pos)
 }
         
         
+void WorldLogFileItemImpl::resetFrameIndex()
+{
+    if(frameIndexBuilderThread.joinable()){
+        isFrameIndexBuildCanceled = true;
+        frameIndexBuilderThread.join();
+    }
+    isFrameIndexBuildCanceled = false;
+    frameIndex.clear();
+    isFrameIndexReady = false;
+    frameIndexFilename.clear();
+}
+
+
+void WorldLogFileItemImpl::startFrameIndexBuild(const string& fname, int firstFramePos)
+{
+    frameIndexFilename = fname;
+    frameIndexBuilderThread =
+        std::thread([this, fname, firstFramePos](){ buildFrameIndex(fname, firstFramePos); });
+}
+
+
+/**
+   This function is executed in the background thread. The frame headers are read with
+   another file stream so that the playback with the main stream is not disturbed.
+*/
+void WorldLogFileItemImpl::buildFrameIndex(const string& fname, int firstFramePos)
+{
+    ifstream is(fname.c_str(), ios::in | ios::binary);
+    if(!is.is_open()){
+        return;
+    }
+    ReadBuf buf(is);
+    vector<FrameIndexEntry> entries;
+    int pos = firstFramePos;
+
+    while(!isFrameIndexBuildCanceled){
+        is.seekg(pos);
+        buf.clear();
+        if(!buf.checkSize(frameHeaderSize)){
+            break;
+        }
+        buf.readSeekOffset(); // offset to the prev frame
+        FrameIndexEntry entry;
+        entry.time = buf.readFloat();
+        entry.pos = pos;
+        int dataSize = buf.readSeekOffset();
+        if(dataSize < 0){
+            break;
+        }
+        entries.push_back(entry);
+        pos += frameHeaderSize + dataSize;
+    }
+
+    if(!isFrameIndexBuildCanceled){
+        // The index is saved for the next opening. It is regarded as stale if the frames
+        // do not end at the end of the file, for example when the file is being recorded.
+        saveFrameIndexFile(fname, entries, pos);
+
+        std::lock_guard<std::mutex> lock(frameIndexMutex);
+        frameIndex.swap(entries);
+        isFrameIndexReady = true;
+    }
+}
+
+
+/**
+   @return The file position of the frame to recall at the time, or -1 if the index is not available.
+   The frame is the same as the one found by tracing the frame chain.
+*/
+int WorldLogFileItemImpl::findFramePosInIndex(double time)
+{
+    std::lock_guard<std::mutex> lock(frameIndexMutex);
+
+    if(!isFrameIndexReady || frameIndex.empty()){
+        return -1;
+    }
+    auto p = std::lower_bound(
+        frameIndex.begin(), frameIndex.end(), time,
+        [](const FrameIndexEntry& entry, double t){ return entry.time < t; });
+
+    if(p == frameIndex.end()){
+        isOverRange = true;
+        return frameIndex.back().pos;
+    }
+    if(p->time == time){
+        return p->pos;
+    }
+    if(p == frameIndex.begin()){
+        isOverRange = true;
+        return p->pos;
+    }
+    return (p - 1)->pos;
+}
+
+
 bool WorldLogFileItemImpl::seek(double time)
 {
     isOverRange = false;
 
+    int pos = findFramePosInIndex(time);
+    if(pos >= 0){
+        if(!ifs.is_open()){
+            readTopHeader();
+        }
+        if(readFrameHeader(pos)){
+            return true;
+        }
+        isOverRange = false;
+    }
+
     if(!readFrameHeader(currentReadFramePos)){
         readTopHeader();
     }
@@ -738,7 +1549,7 @@ bool WorldLogFileItemImpl::seek(double time)
 
 bool WorldLogFileItemImpl::loadCurrentFrameData()
 {
-    ifs.seekg(currentReadFramePos + frameHeaderSize);
+    readBuf.seekFile(currentReadFramePos + frameHeaderSize);
     readBuf.clear();
     isCurrentFrameDataLoaded = readBuf.checkSize(currentReadFrameDataSize);
     return isCurrentFrameDataLoaded;
@@ -757,6 +1568,9 @@ bool WorldLogFileItem::recallStateAtTime(double time)
 
 bool WorldLogFileItemImpl::recallStateAtTime(double time)
 {
+    // No read buffer refers to the previous frame data here
+    mapping.releaseRetiredMappings();
+
     if(!seek(time)){
         return false;
     }
@@ -766,15 +1580,24 @@ bool WorldLogFileItemImpl::recallStateAtTime(double time)
             return false;
         }
     }
-    readBuf.seek(0);
-
+    if(isCompressedLog){
+        if(!loadCurrentBlockFrame(time)){
+            return false;
+        }
+        frameReadBuf = &blockReadBuf;
+    } else {
+        readBuf.seek(0);
+        frameReadBuf = &readBuf;
+    }
+    ReadBuf& buf = *frameReadBuf;
+
     if(isBodyInfoUpdateNeeded){
         updateBodyInfos();
     }
     
     int bodyIndex = 0;
-    while(!readBuf.isEnd()){
-        int dataTypeID = readBuf.readID();
+    while(!buf.isEnd()){
+        int dataTypeID = buf.readID();
         switch(dataTypeID){
         case BODY_STATE:
         {
@@ -783,16 +1606,17 @@ bool WorldLogFileItemImpl::recallStateAtTime(double time)
                 bodyInfo = bodyInfos[bodyIndex];
             }
             if(bodyInfo){
+                inputBodyIndex = bodyIndex;
                 readBodyState(bodyInfo);
             } else {
-                readBuf.seekToNextBlock();
+                buf.seekToNextBlock();
             }
             ++bodyIndex;
             break;
         }
 
         default:
-            readBuf.seekToNextBlock();
+            buf.seekToNextBlock();
         }
     }
 
@@ -800,15 +1624,132 @@ bool WorldLogFileItemImpl::recallStateAtTime(double time)
 }
 
 
+/**
+   The frame of the time in the current block is decoded into blockReadBuf.
+   The quantized positions are decoded from the keyframe or from the last decoded
+   frame so that the sequential playback only decodes each frame once.
+*/
+bool WorldLogFileItemImpl::loadCurrentBlockFrame(double time)
+{
+    if(decodedBlockPos != currentReadFramePos){
+        decodedBlockPos = -1;
+        blockFrames.clear();
+        try {
+            readBuf.seek(0);
+            int rawSize = readBuf.readInt();
+            int codec = readBuf.readOctet();
+            if(!decompressFrameBlock(
+                   codec, readBuf.current(), readBuf.size() - readBuf.pos, rawSize, blockData)){
+                return false;
+            }
+            blockReadBuf2.setFixedData(blockData.data(), blockData.size());
+            while(!blockReadBuf2.isEnd()){
+                BlockFrame frame;
+                frame.time = blockReadBuf2.readFloat();
+                frame.dataSize = blockReadBuf2.readSeekOffset();
+                frame.dataPos = blockReadBuf2.pos;
+                blockFrames.push_back(frame);
+                blockReadBuf2.seek(frame.dataPos + frame.dataSize);
+            }
+        } catch(NotEnoughDataException& ex){
+            return false;
+        }
+        if(blockFrames.empty()){
+            return false;
+        }
+        decodedBlockPos = currentReadFramePos;
+        decodedFrameIndex = -1;
+    }
+
+    auto p = std::upper_bound(
+        blockFrames.begin(), blockFrames.end(), time,
+        [](double t, const BlockFrame& frame){ return t < frame.time; });
+    int frameIndex = (p == blockFrames.begin()) ? 0 : (p - blockFrames.begin() - 1);
+
+    // The over-range state given by seek() is only about the block time
+    if(isOverRange && time >= blockFrames.front().time){
+        isOverRange = (time > blockFrames.back().time);
+    }
+
+    if(frameIndex < decodedFrameIndex){
+        decodedFrameIndex = -1;
+    }
+    if(decodedFrameIndex < 0){
+        inputQuantizedStates.clear();
+    }
+    try {
+        while(decodedFrameIndex < frameIndex){
+            decodeBlockFrame(blockFrames[decodedFrameIndex + 1]);
+            ++decodedFrameIndex;
+        }
+    } catch(NotEnoughDataException& ex){
+        decodedBlockPos = -1;
+        return false;
+    }
+
+    const BlockFrame& frame = blockFrames[frameIndex];
+    blockReadBuf.setFixedData(blockData.data() + frame.dataPos, frame.dataSize);
+    
+    return true;
+}
+
+
+void WorldLogFileItemImpl::decodeBlockFrame(const BlockFrame& frame)
+{
+    ReadBuf& buf = blockReadBuf;
+    buf.setFixedData(blockData.data() + frame.dataPos, frame.dataSize);
+    int bodyIndex = 0;
+    while(!buf.isEnd()){
+        int dataTypeID = buf.readID();
+        if(dataTypeID == BODY_STATE){
+            decodeBodyState(buf, bodyIndex++);
+        } else {
+            buf.seekToNextBlock();
+        }
+    }
+}
+
+
+void WorldLogFileItemImpl::decodeBodyState(ReadBuf& buf, int bodyIndex)
+{
+    if(bodyIndex >= static_cast<int>(inputQuantizedStates.size())){
+        inputQuantizedStates.resize(bodyIndex + 1);
+    }
+    QuantizedBodyState& state = inputQuantizedStates[bodyIndex];
+    
+    int endPos = buf.readNextBlockPos();
+    while(buf.pos < endPos){
+        int dataType = buf.readID();
+        if(dataType == LINK_POSITIONS || dataType == JOINT_POSITIONS){
+            int blockEndPos = buf.readNextBlockPos();
+            int size = buf.readShort();
+            vector<int64_t>& values =
+                (dataType == LINK_POSITIONS) ? state.linkValues : state.jointValues;
+            if(dataType == LINK_POSITIONS){
+                size *= 7;
+            }
+            values.resize(size, 0);
+            for(int i=0; i < size; ++i){
+                values[i] += buf.readVarInt();
+            }
+            buf.seek(blockEndPos);
+        } else {
+            buf.seekToNextBlock();
+        }
+    }
+}
+
+
 void WorldLogFileItemImpl::readBodyState(BodyInfo* bodyInfo)
 {
-    int endPos = readBuf.readNextBlockPos();
+    ReadBuf& buf = *frameReadBuf;
+    int endPos = buf.readNextBlockPos();
     bool updated = false;
     bool doForwardKinematics = true;
     int numLinks;
     
-    while(readBuf.pos < endPos){
-        int dataType = readBuf.readID();
+    while(buf.pos < endPos){
+        int dataType = buf.readID();
         switch(dataType){
         case LINK_POSITIONS:
             numLinks = readLinkPositions(bodyInfo->body);
@@ -832,7 +1773,7 @@ void WorldLogFileItemImpl::readBodyState(BodyInfo* bodyInfo)
             readDeviceStates(bodyInfo);
             break;
         default:
-            readBuf.seekToNextBlock();
+            buf.seekToNextBlock();
             break;
         }
     }
@@ -844,54 +1785,80 @@ void WorldLogFileItemImpl::readBodyState(BodyInfo* bodyInfo)
 
 int WorldLogFileItemImpl::readLinkPositions(Body* body)
 {
-    int endPos = readBuf.readNextBlockPos();
-    int size = readBuf.readShort();
+    ReadBuf& buf = *frameReadBuf;
+    int endPos = buf.readNextBlockPos();
+    int size = buf.readShort();
     int n = std::min(size, body->numLinks());
-    for(int i=0; i < n; ++i){
-        SE3 position = readBuf.readSE3();
-        Link* link = body->link(i);
-        link->p() = position.translation();
-        link->R() = position.rotation().toRotationMatrix();
+    if(!isCompressedLog){
+        for(int i=0; i < n; ++i){
+            SE3 position = buf.readSE3();
+            Link* link = body->link(i);
+            link->p() = position.translation();
+            link->R() = position.rotation().toRotationMatrix();
+        }
+    } else {
+        // The values have been decoded by decodeBodyState()
+        const vector<int64_t>& values = inputQuantizedStates[inputBodyIndex].linkValues;
+        n = std::min(n, static_cast<int>(values.size() / 7));
+        const double step = inputQuantizationStep;
+        const int64_t* v = values.data();
+        for(int i=0; i < n; ++i){
+            Link* link = body->link(i);
+            link->p() = Vector3(v[0] * step, v[1] * step, v[2] * step);
+            Quat q(v[3] * step, v[4] * step, v[5] * step, v[6] * step);
+            link->R() = q.normalized().toRotationMatrix();
+            v += 7;
+        }
     }
-    readBuf.seek(endPos);
+    buf.seek(endPos);
     return n;
 }
 
 
 int WorldLogFileItemImpl::readJointPositions(Body* body)
 {
-    int endPos = readBuf.readNextBlockPos();
-    int size = readBuf.readShort();
+    ReadBuf& buf = *frameReadBuf;
+    int endPos = buf.readNextBlockPos();
+    int size = buf.readShort();
     int n = std::min(size, body->numAllJoints());
-    for(int i=0; i < n; ++i){
-        body->joint(i)->q() = readBuf.readFloat();
+    if(!isCompressedLog){
+        for(int i=0; i < n; ++i){
+            body->joint(i)->q() = buf.readFloat();
+        }
+    } else {
+        const vector<int64_t>& values = inputQuantizedStates[inputBodyIndex].jointValues;
+        n = std::min(n, static_cast<int>(values.size()));
+        for(int i=0; i < n; ++i){
+            body->joint(i)->q() = values[i] * inputQuantizationStep;
+        }
     }
-    readBuf.seek(endPos);
+    buf.seek(endPos);
     return n;
 }
 
 
 void WorldLogFileItemImpl::readDeviceStates(BodyInfo* bodyInfo)
 {
-    const int endPos = readBuf.readNextBlockPos();
+    ReadBuf& buf = *frameReadBuf;
+    const int endPos = buf.readNextBlockPos();
     Body* body = bodyInfo->body;
     const int numDevices = body->numDevices();
     int deviceIndex = 0;
-    while(readBuf.pos < endPos && deviceIndex < numDevices){
+    while(buf.pos < endPos && deviceIndex < numDevices){
         DeviceInfo& devInfo = bodyInfo->deviceInfo(deviceIndex);
         Device* device = bodyInfo->body->device(deviceIndex);
-        const int header = readBuf.readOctet();
+        const int header = buf.readOctet();
         if(header < 0){
             readLastDeviceState(devInfo, device);
         } else {
             const int size = header;
-            int nextPos = readBuf.pos + sizeof(float) * size;
-            readDeviceState(devInfo, device, readBuf, size);
-            readBuf.seek(nextPos);
+            int nextPos = buf.pos + sizeof(float) * size;
+            readDeviceState(devInfo, device, buf, size);
+            buf.seek(nextPos);
         }
         ++deviceIndex;
     }
-    readBuf.seek(endPos);
+    buf.seek(endPos);
 }
 
 
@@ -913,15 +1880,27 @@ void WorldLogFileItemImpl::readDeviceState(DeviceInfo& devInfo, Device* device,
 
 void WorldLogFileItemImpl::readLastDeviceState(DeviceInfo& devInfo, Device* device)
 {
-    size_t pos = readBuf.readSeekOffset();
+    int64_t pos = frameReadBuf->readSeekOffset();
+    if(isCompressedLog){
+        // The offset in the block is combined with the block position to identify the state
+        pos += static_cast<int64_t>(decodedBlockPos) << 32;
+    }
     if(pos == devInfo.lastStateSeekPos){
         if(!devInfo.isConsistent){
             device->readState(&devInfo.lastState.front());
             device->notifyStateChange();
             devInfo.isConsistent = true;
         }
+    } else if(isCompressedLog){
+        devInfo.lastStateSeekPos = pos;
+        blockReadBuf2.setFixedData(blockData.data(), blockData.size());
+        blockReadBuf2.seek(pos & 0xffffffff);
+        int size = blockReadBuf2.readOctet();
+        if(size > 0){
+            readDeviceState(devInfo, device, blockReadBuf2, size);
+        }
     } else {
-        ifs.seekg(pos);
+        readBuf2.seekFile(pos);
         devInfo.lastStateSeekPos = pos;
         readBuf2.clear();
         int size = readBuf2.readOctet();
@@ -952,19 +1931,41 @@ void WorldLogFileItem::clearOutput()
 
 void WorldLogFileItemImpl::clearOutput()
 {
+    finishOutput();
+    
     bodyNames.clear();
 
     if(ifs.is_open()){
         ifs.close();
     }
+    mapping.close();
     if(ofs.is_open()){
         ofs.close();
     }
     recordingStartTime = QDateTime::currentDateTime();
+
+    resetFrameIndex();
+    frameIndexFilename = getActualFilename();
+    isFrameIndexReady = true;
     
-    ofs.open(getActualFilename().c_str(), ios::out | ios::binary | ios::trunc);
-    writeBuf.clear();
+    ofs.open(frameIndexFilename.c_str(), ios::out | ios::binary | ios::trunc);
+    boost::system::error_code ec;
+    filesystem::remove(getFrameIndexFilename(frameIndexFilename), ec);
+    writeBuf.reset();
     lastOutputFramePos = 0;
+    prevOutputFramePos = 0;
+    numDroppedFrames = 0;
+
+    isCompressedOutput = logFormat.is(WorldLogFileItem::COMPRESSED_FORMAT);
+    outputQuantizationStep = 2.0 * compressionTolerance;
+    frameBuf = &writeBuf;
+    numBlockFrames = 0;
+
+    if(isAsyncOutputEnabled){
+        writeBuf.data.reserve(logOutputChunkSize * 2);
+        pendingFrameIndexEntries.clear();
+        asyncWriter.reset(new AsyncLogWriter(ofs, frameIndex, frameIndexMutex));
+    }
 
     currentDeviceStateCacheArrayIndex = 0;
     exchangeDeviceStateCacheArrays();
@@ -973,15 +1974,15 @@ void WorldLogFileItemImpl::clearOutput()
 
 void WorldLogFileItemImpl::reserveSizeHeader()
 {
-    sizeHeaderStack.push(writeBuf.size());
-    writeBuf.writeSeekOffset(0);
+    sizeHeaderStack.push(frameBuf->size());
+    frameBuf->writeSeekOffset(0);
 }
 
 
 void WorldLogFileItemImpl::fixSizeHeader()
 {
     if(!sizeHeaderStack.empty()){
-        writeBuf.writeSeekOffset(sizeHeaderStack.top(), writeBuf.size() - (sizeHeaderStack.top() + sizeof(int)));
+        frameBuf->writeSeekOffset(sizeHeaderStack.top(), frameBuf->size() - (sizeHeaderStack.top() + sizeof(int)));
         sizeHeaderStack.pop();
     }
 }
@@ -989,8 +1990,21 @@ void WorldLogFileItemImpl::fixSizeHeader()
 
 void WorldLogFileItem::beginHeaderOutput()
 {
-    impl->writeBuf.clear();
-    impl->reserveSizeHeader();
+    impl->beginHeaderOutput();
+}
+
+
+void WorldLogFileItemImpl::beginHeaderOutput()
+{
+    frameBuf = &writeBuf;
+    writeBuf.clear();
+    if(isCompressedOutput){
+        writeBuf.writeInt(compressedLogFormatMarker);
+        reserveSizeHeader();
+        writeBuf.writeFloat(outputQuantizationStep);
+    } else {
+        reserveSizeHeader();
+    }
 }
 
 
@@ -1012,7 +2026,13 @@ void WorldLogFileItem::endHeaderOutput()
 void WorldLogFileItemImpl::endHeaderOutput()
 {
     fixSizeHeader();
-    writeBuf.flush();
+    if(asyncWriter){
+        // The header is written before any frame so that it can be read during the recording
+        passOutputDataToWriter(true);
+        asyncWriter->waitForCompletion();
+    } else {
+        writeBuf.flush();
+    }
 }
 
 
@@ -1036,55 +2056,129 @@ void WorldLogFileItem::beginFrameOutput(double time)
 
 void WorldLogFileItemImpl::beginFrameOutput(double time)
 {
-    size_t pos = writeBuf.seekPos();
-    
-    if(lastOutputFramePos){
-        writeBuf.writeSeekOffset(pos - lastOutputFramePos);
+    if(isCompressedOutput){
+        if(numBlockFrames == 0){
+            // keyframe
+            blockStartTime = time;
+            blockBuf.reset();
+            outputQuantizedStates.clear();
+            deviceStateCacheArrays[0].clear();
+            deviceStateCacheArrays[1].clear();
+            numDeviceStateCaches = 0;
+        }
+        frameBuf = &blockBuf;
+        
     } else {
-        writeBuf.writeSeekOffset(0);
+        size_t pos = writeBuf.seekPos();
+    
+        if(lastOutputFramePos){
+            writeBuf.writeSeekOffset(pos - lastOutputFramePos);
+        } else {
+            writeBuf.writeSeekOffset(0);
+        }
+        prevOutputFramePos = lastOutputFramePos;
+        lastOutputFramePos = pos;
+        lastOutputFrameTime = time;
     }
-    lastOutputFramePos = pos;
     
     deviceIndex = 0;
-    writeBuf.writeFloat(time);
+    outputBodyIndex = -1;
+    frameBuf->writeFloat(time);
     reserveSizeHeader(); // area for the frame data size
 }
 
 
 void WorldLogFileItem::beginBodyStateOutput()
 {
-    impl->writeBuf.writeID(BODY_STATE);
-    impl->reserveSizeHeader();
+    impl->beginBodyStateOutput();
+}
+
+
+void WorldLogFileItemImpl::beginBodyStateOutput()
+{
+    frameBuf->writeID(BODY_STATE);
+    reserveSizeHeader();
+
+    ++outputBodyIndex;
+    if(isCompressedOutput && outputBodyIndex >= static_cast<int>(outputQuantizedStates.size())){
+        outputQuantizedStates.resize(outputBodyIndex + 1);
+    }
 }
 
 
 void WorldLogFileItem::outputLinkPositions(SE3* positions, int size)
 {
-    impl->writeBuf.writeID(LINK_POSITIONS);
-    impl->reserveSizeHeader();
-    impl->writeBuf.writeShort(size);
-    for(int i=0; i < size; ++i){
-        impl->writeBuf.writeSE3(positions[i]);
+    impl->outputLinkPositions(positions, size);
+}
+
+
+void WorldLogFileItemImpl::outputLinkPositions(SE3* positions, int size)
+{
+    frameBuf->writeID(LINK_POSITIONS);
+    reserveSizeHeader();
+    frameBuf->writeShort(size);
+    if(!isCompressedOutput){
+        for(int i=0; i < size; ++i){
+            frameBuf->writeSE3(positions[i]);
+        }
+    } else {
+        vector<int64_t>& values = outputQuantizedStates[outputBodyIndex].linkValues;
+        values.resize(size * 7, 0);
+        int64_t* v = values.data();
+        for(int i=0; i < size; ++i){
+            const Vector3& p = positions[i].translation();
+            const Quat& q = positions[i].rotation();
+            outputQuantizedValue(p.x(), v[0]);
+            outputQuantizedValue(p.y(), v[1]);
+            outputQuantizedValue(p.z(), v[2]);
+            outputQuantizedValue(q.w(), v[3]);
+            outputQuantizedValue(q.x(), v[4]);
+            outputQuantizedValue(q.y(), v[5]);
+            outputQuantizedValue(q.z(), v[6]);
+            v += 7;
+        }
     }
-    impl->fixSizeHeader();
+    fixSizeHeader();
 }
 
 
 void WorldLogFileItem::outputJointPositions(double* values, int size)
 {
-    impl->writeBuf.writeID(JOINT_POSITIONS);
-    impl->reserveSizeHeader();
-    impl->writeBuf.writeShort(size);
-    for(int i=0; i < size; ++i){
-        impl->writeBuf.writeFloat(values[i]);
+    impl->outputJointPositions(values, size);
+}
+
+
+void WorldLogFileItemImpl::outputJointPositions(double* values, int size)
+{
+    frameBuf->writeID(JOINT_POSITIONS);
+    reserveSizeHeader();
+    frameBuf->writeShort(size);
+    if(!isCompressedOutput){
+        for(int i=0; i < size; ++i){
+            frameBuf->writeFloat(values[i]);
+        }
+    } else {
+        vector<int64_t>& lastValues = outputQuantizedStates[outputBodyIndex].jointValues;
+        lastValues.resize(size, 0);
+        for(int i=0; i < size; ++i){
+            outputQuantizedValue(values[i], lastValues[i]);
+        }
     }
-    impl->fixSizeHeader();
+    fixSizeHeader();
+}
+
+
+void WorldLogFileItemImpl::outputQuantizedValue(double value, int64_t& lastValue)
+{
+    int64_t q = std::llround(value / outputQuantizationStep);
+    frameBuf->writeVarInt(q - lastValue);
+    lastValue = q;
 }
 
 
 void WorldLogFileItem::beginDeviceStateOutput()
 {
-    impl->writeBuf.writeID(DEVICE_STATES);
+    impl->frameBuf->writeID(DEVICE_STATES);
     impl->reserveSizeHeader();
 }
 
@@ -1104,22 +2198,22 @@ void WorldLogFileItemImpl::outputDeviceState(DeviceState* state)
     } else {
         cache = (*pLastDeviceStateCacheArray)[deviceIndex];
         if(state == cache->state){
-            writeBuf.writeOctet(-1);
-            writeBuf.writeSeekOffset(cache->seekPos);
+            frameBuf->writeOctet(-1);
+            frameBuf->writeSeekOffset(cache->seekPos);
             goto endOutputDeviceState;
         }
     }
     cache->state = state;
-    cache->seekPos = writeBuf.seekPos();
+    cache->seekPos = frameBuf->seekPos();
     if(!state){
-        writeBuf.writeOctet(0);
+        frameBuf->writeOctet(0);
     } else {
         int size = state->stateSize();
-        writeBuf.writeOctet(size);
+        frameBuf->writeOctet(size);
         doubleWriteBuf.resize(size);
         state->writeState(&doubleWriteBuf.front());
         for(int i=0; i < size; ++i){
-            writeBuf.writeFloat(doubleWriteBuf[i]);
+            frameBuf->writeFloat(doubleWriteBuf[i]);
         }
     }
 endOutputDeviceState:
@@ -1143,9 +2237,270 @@ void WorldLogFileItem::endBodyStateOutput()
 
 void WorldLogFileItem::endFrameOutput()
 {
-    impl->fixSizeHeader();
-    impl->writeBuf.flush();
-    impl->exchangeDeviceStateCacheArrays();
+    impl->endFrameOutput();
+}
+
+
+void WorldLogFileItemImpl::endFrameOutput()
+{
+    fixSizeHeader();
+
+    /*
+      This function is called by the GUI thread, which must not wait for the writer.
+      In the blocking policy, the queue is extended here and the simulation thread is
+      blocked by waitForOutputQueueSpace() instead.
+    */
+    bool doGrowQueue = fullOutputQueuePolicy.is(WorldLogFileItem::BLOCK_OUTPUT);
+
+    if(isCompressedOutput){
+        exchangeDeviceStateCacheArrays();
+        if(++numBlockFrames >= keyframeInterval){
+            outputFrameBlock(doGrowQueue);
+        }
+    } else if(commitOutputFrames(1, doGrowQueue)){
+        exchangeDeviceStateCacheArrays();
+    }
+}
+
+
+/**
+   The frames buffered in blockBuf are compressed and output as a frame block.
+*/
+void WorldLogFileItemImpl::outputFrameBlock(bool doGrowQueue)
+{
+    frameBuf = &writeBuf;
+    
+    size_t pos = writeBuf.seekPos();
+    if(lastOutputFramePos){
+        writeBuf.writeSeekOffset(pos - lastOutputFramePos);
+    } else {
+        writeBuf.writeSeekOffset(0);
+    }
+    prevOutputFramePos = lastOutputFramePos;
+    lastOutputFramePos = pos;
+    lastOutputFrameTime = blockStartTime;
+    writeBuf.writeFloat(blockStartTime);
+    reserveSizeHeader();
+
+    const int rawSize = blockBuf.size();
+    writeBuf.writeInt(rawSize);
+    const int codecPos = writeBuf.size();
+    writeBuf.writeOctet(ZLIB_CODEC);
+    if(!compressFrameBlock(blockBuf.data, writeBuf.data) ||
+       static_cast<int>(writeBuf.size()) - (codecPos + 1) >= rawSize){
+        writeBuf.data.resize(codecPos);
+        writeBuf.writeOctet(NO_CODEC);
+        writeBuf.data.insert(writeBuf.data.end(), blockBuf.data.begin(), blockBuf.data.end());
+    }
+    fixSizeHeader();
+
+    int numFrames = numBlockFrames;
+    numBlockFrames = 0;
+    commitOutputFrames(numFrames, doGrowQueue);
+}
+
+
+/**
+   The frames output after the last commit are passed to the file or to the writer thread.
+   @return false if the frames are dropped because the output queue is full.
+*/
+bool WorldLogFileItemImpl::commitOutputFrames(int numFrames, bool doGrowQueue)
+{
+    if(!asyncWriter){
+        writeBuf.flush();
+        std::lock_guard<std::mutex> lock(frameIndexMutex);
+        frameIndex.push_back({ lastOutputFrameTime, lastOutputFramePos });
+        return true;
+    }
+
+    // The entry is added to the frame index by the writer after the frame is written
+    pendingFrameIndexEntries.push_back({ lastOutputFrameTime, lastOutputFramePos });
+    
+    if(writeBuf.data.size() >= logOutputChunkSize){
+        if(!passOutputDataToWriter(doGrowQueue)){
+            pendingFrameIndexEntries.pop_back();
+            dropCurrentFrame(numFrames);
+            return false;
+        }
+    }
+    return true;
+}
+
+
+/**
+   The current frame (or frame block) is removed from the output buffer when the output
+   queue is full. The device state caches are cleared because the frame may have updated them.
+*/
+void WorldLogFileItemImpl::dropCurrentFrame(int numFrames)
+{
+    writeBuf.data.resize(lastOutputFramePos - writeBuf.seekOffset);
+    lastOutputFramePos = prevOutputFramePos;
+    deviceStateCacheArrays[0].clear();
+    deviceStateCacheArrays[1].clear();
+    numDeviceStateCaches = 0;
+    numDroppedFrames += numFrames;
+}
+
+
+bool WorldLogFileItemImpl::passOutputDataToWriter(bool doGrowQueue)
+{
+    size_t size = writeBuf.data.size();
+    if(size == 0){
+        return true;
+    }
+    if(!asyncWriter->push(writeBuf.data, pendingFrameIndexEntries, doGrowQueue)){
+        return false;
+    }
+    writeBuf.seekOffset += size;
+    return true;
+}
+
+
+/**
+   The buffered frames are passed to the writer if the writer is idle.
+   Otherwise they are passed when a chunk is filled so that the file is written
+   with large blocks when the output does not catch up with the simulation.
+*/
+void WorldLogFileItem::flushOutput()
+{
+    impl->flushOutput();
+}
+
+
+void WorldLogFileItemImpl::flushOutput()
+{
+    if(asyncWriter && asyncWriter->isIdle()){
+        passOutputDataToWriter(false);
+    }
+}
+
+
+/**
+   This function is called by the thread producing the frames to wait while the output
+   queue is full in the blocking policy. It must not be called by the GUI thread, which
+   outputs the frames to the queue.
+*/
+void WorldLogFileItem::waitForOutputQueueSpace()
+{
+    if(impl->asyncWriter && impl->fullOutputQueuePolicy.is(WorldLogFileItem::BLOCK_OUTPUT)){
+        impl->asyncWriter->waitForQueueSpace();
+    }
+}
+
+
+/**
+   All the buffered frames are written to the file and the writer thread is finished.
+*/
+void WorldLogFileItem::finishOutput()
+{
+    impl->finishOutput();
+}
+
+
+void WorldLogFileItemImpl::finishOutput()
+{
+    if(isCompressedOutput && numBlockFrames > 0){
+        outputFrameBlock(true);
+    }
+    if(asyncWriter){
+        passOutputDataToWriter(true);
+        asyncWriter->waitForCompletion();
+        asyncWriter.reset();
+    }
+    if(ofs.is_open() && !frameIndexFilename.empty()){
+        ofs.flush();
+        boost::system::error_code ec;
+        const uintmax_t size = filesystem::file_size(frameIndexFilename, ec);
+        if(!ec){
+            std::lock_guard<std::mutex> lock(frameIndexMutex);
+            saveFrameIndexFile(frameIndexFilename, frameIndex, size);
+        }
+    }
+}
+
+
+void WorldLogFileItem::setAsyncOutputEnabled(bool on)
+{
+    impl->isAsyncOutputEnabled = on;
+}
+
+
+bool WorldLogFileItem::isAsyncOutputEnabled() const
+{
+    return impl->isAsyncOutputEnabled;
+}
+
+
+void WorldLogFileItem::setFullOutputQueuePolicy(int policy)
+{
+    impl->fullOutputQueuePolicy.select(policy);
+}
+
+
+int WorldLogFileItem::fullOutputQueuePolicy() const
+{
+    return impl->fullOutputQueuePolicy.which();
+}
+
+
+int WorldLogFileItem::outputQueueDepth() const
+{
+    return impl->asyncWriter ? impl->asyncWriter->queueDepth.load() : 0;
+}
+
+
+double WorldLogFileItem::outputBytesPerSecond() const
+{
+    return impl->asyncWriter ? impl->asyncWriter->bytesPerSecond() : 0.0;
+}
+
+
+int WorldLogFileItem::numDroppedFrames() const
+{
+    return impl->numDroppedFrames;
+}
+
+
+void WorldLogFileItem::setLogFormat(int format)
+{
+    impl->logFormat.select(format);
+}
+
+
+int WorldLogFileItem::logFormat() const
+{
+    return impl->logFormat.which();
+}
+
+
+/**
+   The maximum error of the link positions, the quaternion elements of the link
+   orientations and the joint positions recorded in the compressed format.
+*/
+void WorldLogFileItem::setCompressionTolerance(double tolerance)
+{
+    if(tolerance > 0.0){
+        impl->compressionTolerance = tolerance;
+    }
+}
+
+
+double WorldLogFileItem::compressionTolerance() const
+{
+    return impl->compressionTolerance;
+}
+
+
+//! The number of frames in a frame block, which begins with a keyframe, of the compressed format
+void WorldLogFileItem::setKeyframeInterval(int n)
+{
+    impl->keyframeInterval = std::max(1, n);
+}
+
+
+int WorldLogFileItem::keyframeInterval() const
+{
+    return impl->keyframeInterval;
 }
 
 
@@ -1154,6 +2509,7 @@ void WorldLogFileItemImpl::exchangeDeviceStateCacheArrays()
     int i = 1 - currentDeviceStateCacheArrayIndex;
     pCurrentDeviceStateCacheArray = &deviceStateCacheArrays[i];
     pLastDeviceStateCacheArray = &deviceStateCacheArrays[1-i];
+    pCurrentDeviceStateCacheArray->clear();
     numDeviceStateCaches = pLastDeviceStateCacheArray->size();
     currentDeviceStateCacheArrayIndex = i;
 }
@@ -1168,6 +2524,19 @@ void WorldLogFileItem::doPutProperties(PutPropertyFunction& putProperty)
                 changeProperty(impl->isTimeStampSuffixEnabled));
     putProperty(_("Recording frame rate"), impl->recordingFrameRate,
                 changeProperty(impl->recordingFrameRate));
+    putProperty(_("Async output"), impl->isAsyncOutputEnabled,
+                changeProperty(impl->isAsyncOutputEnabled));
+    putProperty(_("Full queue policy"), impl->fullOutputQueuePolicy,
+                [&](int index){ return impl->fullOutputQueuePolicy.selectIndex(index); });
+    putProperty(_("Output queue depth"), outputQueueDepth());
+    putProperty(_("Output rate [MB/s]"), outputBytesPerSecond() / (1024.0 * 1024.0));
+    putProperty(_("Dropped frames"), impl->numDroppedFrames);
+    putProperty(_("Log format"), impl->logFormat,
+                [&](int index){ return impl->logFormat.selectIndex(index); });
+    putProperty(_("Compression tolerance"), impl->compressionTolerance,
+                [&](double t){ setCompressionTolerance(t); return (t > 0.0); });
+    putProperty.min(1)(_("Keyframe interval"), impl->keyframeInterval,
+                       changeProperty(impl->keyframeInterval));
 }
 
 
@@ -1176,6 +2545,11 @@ bool WorldLogFileItem::store(Archive& archive)
     archive.write("filename", impl->filename);
     archive.write("timeStampSuffix", impl->isTimeStampSuffixEnabled);
     archive.write("recordingFrameRate", impl->recordingFrameRate);
+    archive.write("asyncOutput", impl->isAsyncOutputEnabled);
+    archive.write("fullOutputQueuePolicy", impl->fullOutputQueuePolicy.selectedSymbol(), DOUBLE_QUOTED);
+    archive.write("logFormat", impl->logFormat.selectedSymbol(), DOUBLE_QUOTED);
+    archive.write("compressionTolerance", impl->compressionTolerance);
+    archive.write("keyframeInterval", impl->keyframeInterval);
     return true;
 }
 
@@ -1185,6 +2559,22 @@ bool WorldLogFileItem::restore(const Archive& archive)
     string filename;
     archive.read("timeStampSuffix", impl->isTimeStampSuffixEnabled);
     archive.read("recordingFrameRate", impl->recordingFrameRate);
+    archive.read("asyncOutput", impl->isAsyncOutputEnabled);
+    string symbol;
+    if(archive.read("fullOutputQueuePolicy", symbol)){
+        impl->fullOutputQueuePolicy.select(symbol);
+    }
+    if(archive.read("logFormat", symbol)){
+        impl->logFormat.select(symbol);
+    }
+    double tolerance;
+    if(archive.read("compressionTolerance", tolerance)){
+        setCompressionTolerance(tolerance);
+    }
+    int interval;
+    if(archive.read("keyframeInterval", interval)){
+        setKeyframeInterval(interval);
+    }
     if(archive.read("filename", filename)){
         impl->setLogFileName(archive.expandPathVariables(filename));
     }
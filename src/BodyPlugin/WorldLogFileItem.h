@@ -25,6 +25,9 @@ public:
     WorldLogFileItem(const WorldLogFileItem& org);
     ~WorldLogFileItem();
 
+    enum FullOutputQueuePolicy { BLOCK_OUTPUT, DROP_FRAMES, N_FULL_OUTPUT_QUEUE_POLICIES };
+    enum LogFormat { RAW_FORMAT, COMPRESSED_FORMAT, N_LOG_FORMATS };
+
     bool setLogFileName(const std::string& filename);
     const std::string& logFileName() const;
 
@@ -43,6 +46,24 @@ public:
     void endDeviceStateOutput();
     void endBodyStateOutput();
     void endFrameOutput();
+    void flushOutput();
+    void waitForOutputQueueSpace();
+    void finishOutput();
+
+    void setAsyncOutputEnabled(bool on);
+    bool isAsyncOutputEnabled() const;
+    void setFullOutputQueuePolicy(int policy);
+    int fullOutputQueuePolicy() const;
+    int outputQueueDepth() const;
+    double outputBytesPerSecond() const;
+    int numDroppedFrames() const;
+
+    void setLogFormat(int format);
+    int logFormat() const;
+    void setCompressionTolerance(double tolerance);
+    double compressionTolerance() const;
+    void setKeyframeInterval(int n);
+    int keyframeInterval() const;
 
     int numBodies() const;
     const std::string& bodyName(int bodyIndex) const;
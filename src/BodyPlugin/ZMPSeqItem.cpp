@@ -8,6 +8,7 @@
 #include "BodyMotionItem.h"
 #include "BodyMotionEngine.h"
 #include <cnoid/ItemManager>
+#include <cnoid/BinarySeqFile>
 #include "gettext.h"
 
 using namespace std;
@@ -67,6 +68,16 @@ TimeSyncItemEngine* createZMPSeqEngine(BodyItem* bodyItem, AbstractSeqItem* seqI
 void ZMPSeqItem::initializeClass(ExtensionManager* ext)
 {
     ext->itemManager().registerClass<ZMPSeqItem>(N_("ZMPSeqItem"));
+
+    ext->itemManager().addLoaderAndSaver<ZMPSeqItem>(
+        _("Binary Format of a ZMP Sequence"), "BINARY-ZMP-SEQ", "bseq",
+        [](ZMPSeqItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return loadSeqFromBinaryFile(item->zmpseq().get(), filename, os);
+        },
+        [](ZMPSeqItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
+            return saveSeqAsBinaryFile(item->zmpseq().get(), filename, os);
+        },
+        ItemManager::PRIORITY_OPTIONAL);
     
     BodyMotionItem::addExtraSeqItemFactory(ZMPSeq::key(), createZMPSeqItem);
     BodyMotionEngine::addExtraSeqEngineFactory(ZMPSeq::key(), createZMPSeqEngine);
@@ -0,0 +1,145 @@
+/*
+  This file is part of Choreonoid, an extensible graphical robotics application suit.
+  Copyright (c) 2007-2014 National Institute of Advanced Industrial Science and Technology (AIST)
+  Released under the MIT license. See accompanying file 'LICENSE' for more information.
+*/
+
+#include <cnoid/BatchSimulator>
+#include <cnoid/ThreadPool>
+#include <cnoid/TimeMeasure>
+#include <cnoid/ConstraintForceSolver>
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/format.hpp>
+#include <iostream>
+#include <thread>
+#include <memory>
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+namespace po = boost::program_options;
+namespace filesystem = boost::filesystem;
+
+namespace {
+
+struct Run
+{
+    string name;
+    string project;
+    unique_ptr<BatchSimulator> simulator;
+    int numFrames;
+    double elapsedTime;
+};
+
+}
+
+int main(int argc, char *argv[])
+{
+    po::options_description options("Options");
+    options.add_options()
+        ("help,h", "show this help message")
+        ("project", po::value<vector<string>>(), "project files to simulate")
+        ("time,t", po::value<double>(), "time length of each simulation [s]")
+        ("steps,s", po::value<int>(), "number of the simulation steps")
+        ("log-dir,l", po::value<string>(), "directory where the body motions are saved")
+        ("log-rate", po::value<double>()->default_value(100.0), "frame rate of the saved body motions")
+        ("runs,n", po::value<int>()->default_value(1), "number of the simulations of each project")
+        ("threads,j", po::value<int>()->default_value(std::thread::hardware_concurrency()),
+         "number of the threads running the simulations");
+
+    po::positional_options_description positional;
+    positional.add("project", -1);
+
+    po::variables_map vm;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(options).positional(positional).run(), vm);
+        po::notify(vm);
+    } catch(const po::error& ex){
+        cerr << ex.what() << endl;
+        return 1;
+    }
+
+    if(vm.count("help") || !vm.count("project")){
+        cout << "Usage: choreonoid-batch [options] project.cnoid ...\n" << options << endl;
+        return vm.count("help") ? 0 : 1;
+    }
+
+    const vector<string>& projects = vm["project"].as<vector<string>>();
+    const int numRuns = std::max(1, vm["runs"].as<int>());
+    const bool doLog = vm.count("log-dir");
+
+    vector<Run> runs;
+
+    for(auto& project : projects){
+        string stem = filesystem::path(project).stem().string();
+        for(int i=0; i < numRuns; ++i){
+            Run run;
+            run.project = project;
+            run.name = (numRuns > 1) ? str(format("%1%-%2%") % stem % i) : stem;
+            run.simulator.reset(new BatchSimulator);
+            BatchSimulator& simulator = *run.simulator;
+            simulator.setMessageOutput(cerr);
+            if(!simulator.loadProject(project)){
+                cerr << format("%1% cannot be loaded.") % project << endl;
+                return 1;
+            }
+            if(vm.count("time")){
+                simulator.setTimeLength(vm["time"].as<double>());
+            } else if(vm.count("steps")){
+                simulator.setTimeLength(vm["steps"].as<int>() * simulator.timeStep());
+            }
+            if(simulator.timeLength() < 0.0 &&
+               !(simulator.isActiveControlPeriodOnly() && simulator.numControllers() > 0)){
+                cerr << format("The time length of %1% is not limited. Specify it with --time or --steps.")
+                    % project << endl;
+                return 1;
+            }
+            if(doLog){
+                simulator.setRecordingFrameRate(vm["log-rate"].as<double>());
+            }
+            // Each simulation is run in a single thread
+            simulator.constraintForceSolver().setNumThreads(1);
+            if(!simulator.initialize()){
+                cerr << format("%1% cannot be initialized.") % project << endl;
+                return 1;
+            }
+            runs.push_back(std::move(run));
+        }
+    }
+
+    const int numThreads = std::max(1, std::min(vm["threads"].as<int>(), static_cast<int>(runs.size())));
+    ThreadPool threadPool(numThreads);
+
+    TimeMeasure totalTime;
+    totalTime.begin();
+    for(auto& run : runs){
+        Run* pRun = &run;
+        threadPool.start(
+            [pRun](){
+                TimeMeasure time;
+                time.begin();
+                pRun->numFrames = pRun->simulator->run();
+                time.end();
+                pRun->elapsedTime = time.totalTime();
+            });
+    }
+    threadPool.wait();
+    totalTime.end();
+
+    int result = 0;
+    for(auto& run : runs){
+        BatchSimulator& simulator = *run.simulator;
+        cout << format("%1%: %2% steps, %3% s simulated in %4% s\n")
+            % run.name % run.numFrames % simulator.currentTime() % run.elapsedTime;
+        if(doLog){
+            filesystem::path dir = filesystem::path(vm["log-dir"].as<string>()) / run.name;
+            if(!simulator.saveMotions(dir.string())){
+                result = 1;
+            }
+        }
+    }
+    cout << format("%1% simulations in %2% threads: %3% s") % runs.size() % numThreads % totalTime.totalTime() << endl;
+
+    return result;
+}
@@ -0,0 +1,153 @@
+/*
+  This file is part of Choreonoid, an extensible graphical robotics application suit.
+  Copyright (c) 2007-2014 National Institute of Advanced Industrial Science and Technology (AIST)
+  Released under the MIT license. See accompanying file 'LICENSE' for more information.
+*/
+
+#include <cnoid/BodyMotion>
+#include <cnoid/ZMPSeq>
+#include <cnoid/MultiValueSeq>
+#include <cnoid/MultiSE3Seq>
+#include <cnoid/MultiVector3Seq>
+#include <cnoid/BinarySeqFile>
+#include <cnoid/YAMLReader>
+#include <cnoid/YAMLWriter>
+#include <boost/program_options.hpp>
+#include <boost/format.hpp>
+#include <iostream>
+#include <memory>
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+namespace po = boost::program_options;
+
+namespace {
+
+shared_ptr<AbstractSeq> createSeq(const string& type, const string& content)
+{
+    shared_ptr<AbstractSeq> seq;
+    if(type == "MultiValueSeq"){
+        seq = make_shared<MultiValueSeq>();
+    } else if(type == "MultiSE3Seq" || type == "MultiSe3Seq" || type == "MultiAffine3Seq"){
+        seq = make_shared<MultiSE3Seq>();
+    } else if(type == "Vector3Seq"){
+        if(content == ZMPSeq::key()){
+            seq = make_shared<ZMPSeq>();
+        } else {
+            seq = make_shared<Vector3Seq>();
+        }
+    } else if(type == "MultiVector3Seq"){
+        seq = make_shared<MultiVector3Seq>();
+    }
+    return seq;
+}
+
+
+bool convertBinaryToYAML(const string& input, const string& output)
+{
+    BinarySeqReader reader;
+    if(!reader.open(input, cerr)){
+        return false;
+    }
+    BodyMotion motion;
+    if(reader.type() == motion.seqType() && reader.contentName() == motion.seqContentName()){
+        reader.close();
+        return motion.loadBinaryFormat(input, cerr) && motion.save(output, cerr);
+    }
+    if(reader.numSeqs() != 1){
+        cerr << format("%1% does not contain a single seq.") % input << endl;
+        return false;
+    }
+    auto seq = createSeq(reader.seqType(0), reader.seqContentName(0));
+    if(!seq){
+        cerr << format("Seq type \"%1%\" is not supported.") % reader.seqType(0) << endl;
+        return false;
+    }
+    if(!reader.readSeq(0, seq.get())){
+        return false;
+    }
+    YAMLWriter writer(output);
+    writer.setMessageSink(cerr);
+    return seq->writeSeq(writer);
+}
+
+
+bool convertYAMLToBinary
+(const string& input, const string& output,
+ BinarySeqWriter::ElementType elementType, BinarySeqWriter::Layout layout)
+{
+    YAMLReader reader;
+    reader.expectRegularMultiListing();
+    reader.packNumberListings("frames");
+
+    try {
+        const Mapping* archive = reader.loadDocument(input)->toMapping();
+        const string type = archive->get("type", "");
+        const string content = archive->get("content", "");
+        
+        if(type == "CompositeSeq" || type == "BodyMotion"){
+            BodyMotion motion;
+            return motion.readSeq(archive, cerr) &&
+                motion.saveAsBinaryFormat(output, cerr, elementType, layout);
+        }
+        auto seq = createSeq(type, content);
+        if(!seq){
+            cerr << format("Seq type \"%1%\" is not supported.") % type << endl;
+            return false;
+        }
+        return seq->readSeq(archive, cerr) &&
+            saveSeqAsBinaryFile(seq.get(), output, cerr, elementType, layout);
+
+    } catch(const ValueNode::Exception& ex){
+        cerr << ex.message() << endl;
+    }
+    return false;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    po::options_description options("Options");
+    options.add_options()
+        ("help,h", "show this help message")
+        ("input", po::value<string>(), "seq file to convert")
+        ("output", po::value<string>(), "converted file")
+        ("float32", "store the values as float32 in the binary format")
+        ("part-major", "store the values of each part contiguously in the binary format");
+
+    po::positional_options_description positional;
+    positional.add("input", 1).add("output", 1);
+
+    po::variables_map vm;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(options).positional(positional).run(), vm);
+        po::notify(vm);
+    } catch(const po::error& ex){
+        cerr << ex.what() << endl;
+        return 1;
+    }
+
+    if(vm.count("help") || !vm.count("input") || !vm.count("output")){
+        cout << "Usage: choreonoid-seq-convert [options] input output\n"
+             << "A binary seq file is converted into a YAML seq file, and a YAML seq file is converted into a binary one.\n"
+             << options << endl;
+        return vm.count("help") ? 0 : 1;
+    }
+
+    const string input = vm["input"].as<string>();
+    const string output = vm["output"].as<string>();
+    bool result;
+
+    if(BinarySeqReader::checkFileFormat(input)){
+        result = convertBinaryToYAML(input, output);
+    } else {
+        result = convertYAMLToBinary(
+            input, output,
+            vm.count("float32") ? BinarySeqWriter::FLOAT32 : BinarySeqWriter::FLOAT64,
+            vm.count("part-major") ? BinarySeqWriter::PART_MAJOR : BinarySeqWriter::FRAME_MAJOR);
+    }
+
+    return result ? 0 : 1;
+}
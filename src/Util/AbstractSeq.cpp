@@ -138,6 +138,18 @@ bool AbstractSeq::writeSeq(YAMLWriter& writer)
 }
 
 
+void AbstractSeq::writeBinarySeqAttributes(Mapping& /* attributes */) const
+{
+
+}
+
+
+void AbstractSeq::readBinarySeqAttributes(const Mapping& /* attributes */)
+{
+
+}
+
+
 bool AbstractSeq::doWriteSeq(YAMLWriter& writer)
 {
     writer.putMessage(str(format(_("The function to write %1% is not implemented.\n")) % seqType()));
@@ -80,6 +80,13 @@ public:
     bool readSeq(const Mapping* archive, std::ostream& os = nullout());
     bool writeSeq(YAMLWriter& writer);
 
+    /**
+       These functions are called by BinarySeqWriter and BinarySeqReader to store the properties
+       which are not covered by the common header of a seq. Only the scalar values are stored.
+    */
+    virtual void writeBinarySeqAttributes(Mapping& attributes) const;
+    virtual void readBinarySeqAttributes(const Mapping& attributes);
+
     //! deprecated. Use the os parameter of readSeq to get messages in reading
     const std::string& seqMessage() const;
 
@@ -0,0 +1,846 @@
+/**
+   @file
+*/
+
+#include "BinarySeqFile.h"
+#include "MultiValueSeq.h"
+#include "MultiSE3Seq.h"
+#include "Vector3Seq.h"
+#include "MultiVector3Seq.h"
+#include "ValueTree.h"
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/format.hpp>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <climits>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+
+namespace {
+
+const char fileMagic[8] = { 'C', 'N', 'O', 'I', 'D', 'S', 'E', 'Q' };
+const uint32_t currentFormatVersion = 1;
+const uint32_t byteOrderMark = 0x01020304;
+
+enum SeqKind { UNSUPPORTED_SEQ, MULTI_VALUE_SEQ, MULTI_SE3_SEQ, VECTOR3_SEQ, MULTI_VECTOR3_SEQ };
+
+SeqKind getSeqKind(AbstractSeq* seq)
+{
+    if(dynamic_cast<MultiValueSeq*>(seq)){
+        return MULTI_VALUE_SEQ;
+    } else if(dynamic_cast<MultiSE3Seq*>(seq)){
+        return MULTI_SE3_SEQ;
+    } else if(dynamic_cast<Vector3Seq*>(seq)){
+        return VECTOR3_SEQ;
+    } else if(dynamic_cast<MultiVector3Seq*>(seq)){
+        return MULTI_VECTOR3_SEQ;
+    }
+    return UNSUPPORTED_SEQ;
+}
+
+int getNumElementsOfPart(SeqKind kind)
+{
+    switch(kind){
+    case MULTI_VALUE_SEQ: return 1;
+    case MULTI_SE3_SEQ: return 7;
+    case VECTOR3_SEQ: return 3;
+    case MULTI_VECTOR3_SEQ: return 3;
+    default: return 0;
+    }
+}
+
+void getSE3Values(const SE3& value, double* dest)
+{
+    const Vector3& p = value.translation();
+    const Quat& q = value.rotation();
+    dest[0] = p.x();
+    dest[1] = p.y();
+    dest[2] = p.z();
+    dest[3] = q.w();
+    dest[4] = q.x();
+    dest[5] = q.y();
+    dest[6] = q.z();
+}
+
+void setSE3Values(const double* src, SE3& value)
+{
+    value.translation() << src[0], src[1], src[2];
+    value.rotation() = Quat(src[3], src[4], src[5], src[6]);
+}
+
+struct SeqBlock
+{
+    string seqType;
+    string contentName;
+    double frameRate;
+    double offsetTime;
+    int64_t numFrames;
+    int32_t numParts;
+    int32_t numElements;
+    uint8_t elementType;
+    uint8_t layout;
+    vector<string> partLabels;
+    vector<pair<string, string>> attributes;
+    uint64_t dataOffset;
+    uint64_t dataSize;
+};
+
+/*
+  The reading position in the mapped region. The values are read with memcpy
+  because the values in the header are not aligned.
+*/
+struct Cursor
+{
+    const char* data;
+    size_t size;
+    size_t pos;
+
+    Cursor(const char* data, size_t size) : data(data), size(size), pos(0) { }
+
+    bool get(void* out, size_t n) {
+        if(size - pos < n){
+            return false;
+        }
+        memcpy(out, data + pos, n);
+        pos += n;
+        return true;
+    }
+    template<class T> bool get(T& out) {
+        return get(&out, sizeof(T));
+    }
+    bool getString(string& out) {
+        uint32_t n;
+        if(!get(n) || size - pos < n){
+            return false;
+        }
+        out.assign(data + pos, n);
+        pos += n;
+        return true;
+    }
+    bool align() {
+        const size_t aligned = (pos + 7) & ~static_cast<size_t>(7);
+        if(aligned > size){
+            return false;
+        }
+        pos = aligned;
+        return true;
+    }
+};
+
+}
+
+namespace cnoid {
+
+class BinarySeqWriterImpl
+{
+public:
+    ofstream ofs;
+    string filename;
+    ostream* os;
+    int elementType;
+    int layout;
+    uint64_t position;
+    vector<double> values;
+    vector<float> floatValues;
+
+    BinarySeqWriterImpl();
+    bool open(const string& filename, const string& type, const string& contentName, ostream& os);
+    bool writeSeq(AbstractSeq* seq);
+    bool close();
+
+    void put(const void* data, size_t size) {
+        ofs.write(static_cast<const char*>(data), size);
+        position += size;
+    }
+    template<class T> void putValue(T value) {
+        put(&value, sizeof(T));
+    }
+    void putString(const string& s) {
+        putValue<uint32_t>(s.size());
+        put(s.data(), s.size());
+    }
+    void align() {
+        static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        const size_t r = position % 8;
+        if(r > 0){
+            put(zeros, 8 - r);
+        }
+    }
+    void putBufferedValues(size_t n);
+    template<class Getter> void putFrames(int numFrames, int numParts, int numElements, Getter getValues);
+};
+
+
+class BinarySeqReaderImpl
+{
+public:
+    boost::iostreams::mapped_file_source file;
+    string filename;
+    ostream* os;
+    int formatVersion;
+    string type;
+    string contentName;
+    vector<SeqBlock> blocks;
+
+    BinarySeqReaderImpl();
+    bool open(const string& filename, ostream& os);
+    bool readHeaders();
+    bool readSeq(int index, AbstractSeq* seq);
+    template<typename ValueType, class Setter>
+    void getFrames(const SeqBlock& block, Setter setValues);
+    template<class Setter>
+    void getFrames(const SeqBlock& block, Setter setValues);
+};
+
+}
+
+
+BinarySeqWriter::BinarySeqWriter()
+{
+    impl = new BinarySeqWriterImpl;
+}
+
+
+BinarySeqWriterImpl::BinarySeqWriterImpl()
+{
+    os = &nullout();
+    elementType = BinarySeqWriter::FLOAT64;
+    layout = BinarySeqWriter::FRAME_MAJOR;
+    position = 0;
+}
+
+
+BinarySeqWriter::~BinarySeqWriter()
+{
+    delete impl;
+}
+
+
+void BinarySeqWriter::setElementType(ElementType type)
+{
+    impl->elementType = type;
+}
+
+
+void BinarySeqWriter::setLayout(Layout layout)
+{
+    impl->layout = layout;
+}
+
+
+bool BinarySeqWriter::open
+(const std::string& filename, const std::string& type, const std::string& contentName, std::ostream& os)
+{
+    return impl->open(filename, type, contentName, os);
+}
+
+
+bool BinarySeqWriterImpl::open(const string& filename, const string& type, const string& contentName, ostream& os)
+{
+    this->os = &os;
+    this->filename = filename;
+
+    if(ofs.is_open()){
+        ofs.close();
+    }
+    ofs.open(filename.c_str(), ios::out | ios::binary | ios::trunc);
+    if(!ofs){
+        os << format(_("\"%1%\" cannot be opened.")) % filename << endl;
+        return false;
+    }
+
+    position = 0;
+    put(fileMagic, sizeof(fileMagic));
+    putValue<uint32_t>(currentFormatVersion);
+    putValue<uint32_t>(byteOrderMark);
+    putString(type);
+    putString(contentName);
+    align();
+
+    return true;
+}
+
+
+bool BinarySeqWriter::isSupportedSeq(AbstractSeq* seq)
+{
+    return getSeqKind(seq) != UNSUPPORTED_SEQ;
+}
+
+
+bool BinarySeqWriter::writeSeq(AbstractSeq* seq)
+{
+    return impl->writeSeq(seq);
+}
+
+
+bool BinarySeqWriterImpl::writeSeq(AbstractSeq* seq)
+{
+    const SeqKind kind = getSeqKind(seq);
+    if(kind == UNSUPPORTED_SEQ){
+        (*os) << format(_("Seq type \"%1%\" cannot be written in the binary seq format.")) % seq->seqType() << endl;
+        return false;
+    }
+    if(!ofs.is_open()){
+        return false;
+    }
+
+    const int numFrames = seq->getNumFrames();
+    const int numElements = getNumElementsOfPart(kind);
+    auto multiSeq = dynamic_cast<AbstractMultiSeq*>(seq);
+    const int numParts = multiSeq ? multiSeq->getNumParts() : 1;
+
+    putString(seq->seqType());
+    putString(seq->seqContentName());
+    align();
+    putValue<double>(seq->getFrameRate());
+    putValue<double>(seq->getOffsetTime());
+    putValue<int64_t>(numFrames);
+    putValue<int32_t>(numParts);
+    putValue<int32_t>(numElements);
+    putValue<uint8_t>(elementType);
+    putValue<uint8_t>(layout);
+    putValue<uint16_t>(0);
+
+    vector<string> labels;
+    if(multiSeq){
+        bool hasLabels = false;
+        for(int i=0; i < numParts; ++i){
+            labels.push_back(multiSeq->partLabel(i));
+            if(!labels.back().empty()){
+                hasLabels = true;
+            }
+        }
+        if(!hasLabels){
+            labels.clear();
+        }
+    }
+    putValue<uint32_t>(labels.size());
+    for(auto& label : labels){
+        putString(label);
+    }
+
+    MappingPtr attributes = new Mapping;
+    seq->writeBinarySeqAttributes(*attributes);
+    vector<pair<string, string>> scalarAttributes;
+    for(auto& kv : *attributes){
+        if(kv.second->isScalar()){
+            scalarAttributes.push_back(make_pair(kv.first, kv.second->toString()));
+        }
+    }
+    putValue<uint32_t>(scalarAttributes.size());
+    for(auto& attribute : scalarAttributes){
+        putString(attribute.first);
+        putString(attribute.second);
+    }
+
+    align();
+    const size_t valueSize = (elementType == BinarySeqWriter::FLOAT64) ? sizeof(double) : sizeof(float);
+    putValue<uint64_t>(static_cast<uint64_t>(numFrames) * numParts * numElements * valueSize);
+
+    switch(kind){
+
+    case MULTI_VALUE_SEQ:
+    {
+        auto valueSeq = static_cast<MultiValueSeq*>(seq);
+        if(numParts > 0){
+            if(elementType == BinarySeqWriter::FLOAT64 && layout == BinarySeqWriter::FRAME_MAJOR){
+                for(int i=0; i < numFrames; ++i){
+                    put(valueSeq->frame(i).begin(), numParts * sizeof(double));
+                }
+            } else {
+                putFrames(numFrames, numParts, numElements,
+                          [&](int frame, int part, double* dest){ *dest = valueSeq->frame(frame)[part]; });
+            }
+        }
+        break;
+    }
+    case MULTI_SE3_SEQ:
+    {
+        auto se3Seq = static_cast<MultiSE3Seq*>(seq);
+        putFrames(numFrames, numParts, numElements,
+                  [&](int frame, int part, double* dest){ getSE3Values(se3Seq->frame(frame)[part], dest); });
+        break;
+    }
+    case VECTOR3_SEQ:
+    {
+        auto vector3Seq = static_cast<Vector3Seq*>(seq);
+        putFrames(numFrames, numParts, numElements,
+                  [&](int frame, int /* part */, double* dest){
+                      Eigen::Map<Vector3> v(dest);
+                      v = (*vector3Seq)[frame];
+                  });
+        break;
+    }
+    case MULTI_VECTOR3_SEQ:
+    {
+        auto vector3Seq = static_cast<MultiVector3Seq*>(seq);
+        putFrames(numFrames, numParts, numElements,
+                  [&](int frame, int part, double* dest){
+                      Eigen::Map<Vector3> v(dest);
+                      v = vector3Seq->frame(frame)[part];
+                  });
+        break;
+    }
+    default:
+        break;
+    }
+
+    align();
+
+    if(!ofs){
+        (*os) << format(_("Writing \"%1%\" failed.")) % filename << endl;
+        return false;
+    }
+    return true;
+}
+
+
+void BinarySeqWriterImpl::putBufferedValues(size_t n)
+{
+    if(elementType == BinarySeqWriter::FLOAT64){
+        put(values.data(), n * sizeof(double));
+    } else {
+        for(size_t i=0; i < n; ++i){
+            floatValues[i] = static_cast<float>(values[i]);
+        }
+        put(floatValues.data(), n * sizeof(float));
+    }
+}
+
+
+/*
+  The values are written through a small buffer so that the memory used in saving
+  does not depend on the size of the seq.
+*/
+template<class Getter>
+void BinarySeqWriterImpl::putFrames(int numFrames, int numParts, int numElements, Getter getValues)
+{
+    const size_t bufferSize = 4096;
+    values.resize(bufferSize);
+    if(elementType == BinarySeqWriter::FLOAT32){
+        floatValues.resize(bufferSize);
+    }
+    size_t n = 0;
+    auto putPartValues = [&](int frame, int part){
+        if(n + numElements > bufferSize){
+            putBufferedValues(n);
+            n = 0;
+        }
+        getValues(frame, part, &values[n]);
+        n += numElements;
+    };
+    if(layout == BinarySeqWriter::FRAME_MAJOR){
+        for(int i=0; i < numFrames; ++i){
+            for(int j=0; j < numParts; ++j){
+                putPartValues(i, j);
+            }
+        }
+    } else {
+        for(int j=0; j < numParts; ++j){
+            for(int i=0; i < numFrames; ++i){
+                putPartValues(i, j);
+            }
+        }
+    }
+    putBufferedValues(n);
+}
+
+
+bool BinarySeqWriter::close()
+{
+    return impl->close();
+}
+
+
+bool BinarySeqWriterImpl::close()
+{
+    if(!ofs.is_open()){
+        return false;
+    }
+    ofs.close();
+    if(!ofs){
+        (*os) << format(_("Writing \"%1%\" failed.")) % filename << endl;
+        return false;
+    }
+    return true;
+}
+
+
+BinarySeqReader::BinarySeqReader()
+{
+    impl = new BinarySeqReaderImpl;
+}
+
+
+BinarySeqReaderImpl::BinarySeqReaderImpl()
+{
+    os = &nullout();
+    formatVersion = 0;
+}
+
+
+BinarySeqReader::~BinarySeqReader()
+{
+    delete impl;
+}
+
+
+bool BinarySeqReader::checkFileFormat(const std::string& filename)
+{
+    ifstream ifs(filename.c_str(), ios::in | ios::binary);
+    char magic[sizeof(fileMagic)];
+    if(ifs.read(magic, sizeof(magic))){
+        return memcmp(magic, fileMagic, sizeof(fileMagic)) == 0;
+    }
+    return false;
+}
+
+
+bool BinarySeqReader::open(const std::string& filename, std::ostream& os)
+{
+    return impl->open(filename, os);
+}
+
+
+bool BinarySeqReaderImpl::open(const string& filename, ostream& os)
+{
+    this->os = &os;
+    this->filename = filename;
+
+    if(file.is_open()){
+        file.close();
+    }
+    blocks.clear();
+
+    try {
+        file.open(filename);
+    } catch(const std::exception& ex){
+        os << format(_("\"%1%\" cannot be opened.")) % filename << endl;
+        return false;
+    }
+
+    if(!readHeaders()){
+        file.close();
+        blocks.clear();
+        return false;
+    }
+    return true;
+}
+
+
+bool BinarySeqReaderImpl::readHeaders()
+{
+    Cursor cursor(file.data(), file.size());
+
+    char magic[sizeof(fileMagic)];
+    if(!cursor.get(magic, sizeof(magic)) || memcmp(magic, fileMagic, sizeof(fileMagic)) != 0){
+        (*os) << format(_("\"%1%\" is not a binary seq file.")) % filename << endl;
+        return false;
+    }
+    uint32_t version;
+    uint32_t bom;
+    if(!cursor.get(version) || !cursor.get(bom)){
+        (*os) << format(_("\"%1%\" is broken.")) % filename << endl;
+        return false;
+    }
+    if(version > currentFormatVersion){
+        (*os) << format(_("The binary seq format version %1% of \"%2%\" is not supported."))
+            % version % filename << endl;
+        return false;
+    }
+    if(bom != byteOrderMark){
+        (*os) << format(_("The byte order of \"%1%\" is not supported.")) % filename << endl;
+        return false;
+    }
+    formatVersion = version;
+
+    bool isValid = cursor.getString(type) && cursor.getString(contentName) && cursor.align();
+
+    while(isValid && cursor.pos < cursor.size){
+        SeqBlock block;
+        uint16_t reserved;
+        uint32_t numLabels;
+        uint32_t numAttributes;
+        isValid =
+            cursor.getString(block.seqType) &&
+            cursor.getString(block.contentName) &&
+            cursor.align() &&
+            cursor.get(block.frameRate) &&
+            cursor.get(block.offsetTime) &&
+            cursor.get(block.numFrames) &&
+            cursor.get(block.numParts) &&
+            cursor.get(block.numElements) &&
+            cursor.get(block.elementType) &&
+            cursor.get(block.layout) &&
+            cursor.get(reserved) &&
+            cursor.get(numLabels);
+        for(uint32_t i=0; isValid && i < numLabels; ++i){
+            string label;
+            isValid = cursor.getString(label);
+            block.partLabels.push_back(label);
+        }
+        isValid = isValid && cursor.get(numAttributes);
+        for(uint32_t i=0; isValid && i < numAttributes; ++i){
+            string key, value;
+            isValid = cursor.getString(key) && cursor.getString(value);
+            block.attributes.push_back(make_pair(key, value));
+        }
+        isValid = isValid && cursor.align() && cursor.get(block.dataSize);
+        if(isValid){
+            isValid =
+                block.numFrames >= 0 && block.numFrames <= INT_MAX &&
+                block.numParts >= 0 && block.numElements > 0 && block.numElements <= 7 &&
+                block.elementType <= BinarySeqWriter::FLOAT32 &&
+                block.layout <= BinarySeqWriter::PART_MAJOR;
+        }
+        if(isValid){
+            /*
+              Both of the numbers are less than 2^31, so their product does not overflow.
+              The product is limited so that the frames can be stored in a seq, and the
+              data size is compared with the remaining size before the multiplication
+              by the value size so that a broken header cannot make it overflow.
+            */
+            const uint64_t numValues = static_cast<uint64_t>(block.numFrames) * block.numParts;
+            const uint64_t valueSize =
+                block.numElements * ((block.elementType == BinarySeqWriter::FLOAT64) ? sizeof(double) : sizeof(float));
+            isValid =
+                numValues <= INT_MAX &&
+                numValues <= (cursor.size - cursor.pos) / valueSize &&
+                block.dataSize == numValues * valueSize;
+        }
+        if(isValid){
+            block.dataOffset = cursor.pos;
+            cursor.pos += block.dataSize;
+            isValid = cursor.align();
+            blocks.push_back(block);
+        }
+    }
+
+    if(!isValid){
+        (*os) << format(_("\"%1%\" is broken.")) % filename << endl;
+        return false;
+    }
+    return true;
+}
+
+
+void BinarySeqReader::close()
+{
+    if(impl->file.is_open()){
+        impl->file.close();
+    }
+    impl->blocks.clear();
+}
+
+
+int BinarySeqReader::formatVersion() const
+{
+    return impl->formatVersion;
+}
+
+
+const std::string& BinarySeqReader::type() const
+{
+    return impl->type;
+}
+
+
+const std::string& BinarySeqReader::contentName() const
+{
+    return impl->contentName;
+}
+
+
+int BinarySeqReader::numSeqs() const
+{
+    return impl->blocks.size();
+}
+
+
+const std::string& BinarySeqReader::seqType(int index) const
+{
+    return impl->blocks[index].seqType;
+}
+
+
+const std::string& BinarySeqReader::seqContentName(int index) const
+{
+    return impl->blocks[index].contentName;
+}
+
+
+int BinarySeqReader::seqNumFrames(int index) const
+{
+    return impl->blocks[index].numFrames;
+}
+
+
+int BinarySeqReader::seqNumParts(int index) const
+{
+    return impl->blocks[index].numParts;
+}
+
+
+const std::vector<std::string>& BinarySeqReader::seqPartLabels(int index) const
+{
+    return impl->blocks[index].partLabels;
+}
+
+
+bool BinarySeqReader::readSeq(int index, AbstractSeq* seq)
+{
+    return impl->readSeq(index, seq);
+}
+
+
+bool BinarySeqReaderImpl::readSeq(int index, AbstractSeq* seq)
+{
+    const SeqBlock& block = blocks[index];
+    const SeqKind kind = getSeqKind(seq);
+
+    if(block.seqType != seq->seqType() || block.numElements != getNumElementsOfPart(kind) ||
+       (kind == VECTOR3_SEQ && block.numParts != 1)){
+        (*os) << format(_("Seq type \"%1%\" cannot be loaded into %2%.")) % block.seqType % seq->seqType() << endl;
+        return false;
+    }
+
+    seq->setSeqContentName(block.contentName);
+    seq->setFrameRate(block.frameRate);
+    seq->setOffsetTime(block.offsetTime);
+    const int numFrames = block.numFrames;
+    const int numParts = block.numParts;
+
+    switch(kind){
+
+    case MULTI_VALUE_SEQ:
+    {
+        auto valueSeq = static_cast<MultiValueSeq*>(seq);
+        valueSeq->setDimension(numFrames, numParts);
+        if(numParts > 0){
+            if(block.elementType == BinarySeqWriter::FLOAT64 && block.layout == BinarySeqWriter::FRAME_MAJOR){
+                const char* src = file.data() + block.dataOffset;
+                const size_t frameSize = numParts * sizeof(double);
+                for(int i=0; i < numFrames; ++i){
+                    memcpy(valueSeq->frame(i).begin(), src, frameSize);
+                    src += frameSize;
+                }
+            } else {
+                getFrames(block, [&](int frame, int part, const double* src){ valueSeq->frame(frame)[part] = *src; });
+            }
+        }
+        break;
+    }
+    case MULTI_SE3_SEQ:
+    {
+        auto se3Seq = static_cast<MultiSE3Seq*>(seq);
+        se3Seq->setDimension(numFrames, numParts);
+        getFrames(block, [&](int frame, int part, const double* src){ setSE3Values(src, se3Seq->frame(frame)[part]); });
+        break;
+    }
+    case VECTOR3_SEQ:
+    {
+        auto vector3Seq = static_cast<Vector3Seq*>(seq);
+        vector3Seq->setNumFrames(numFrames);
+        getFrames(block, [&](int frame, int /* part */, const double* src){
+                (*vector3Seq)[frame] = Eigen::Map<const Vector3>(src); });
+        break;
+    }
+    case MULTI_VECTOR3_SEQ:
+    {
+        auto vector3Seq = static_cast<MultiVector3Seq*>(seq);
+        vector3Seq->setDimension(numFrames, numParts);
+        getFrames(block, [&](int frame, int part, const double* src){
+                vector3Seq->frame(frame)[part] = Eigen::Map<const Vector3>(src); });
+        break;
+    }
+    default:
+        break;
+    }
+
+    MappingPtr attributes = new Mapping;
+    for(auto& attribute : block.attributes){
+        attributes->write(attribute.first, attribute.second);
+    }
+    seq->readBinarySeqAttributes(*attributes);
+
+    return true;
+}
+
+
+template<typename ValueType, class Setter>
+void BinarySeqReaderImpl::getFrames(const SeqBlock& block, Setter setValues)
+{
+    const char* src = file.data() + block.dataOffset;
+    const int numElements = block.numElements;
+    const size_t partSize = numElements * sizeof(ValueType);
+    ValueType storedValues[7];
+    double values[7];
+
+    auto getPartValues = [&](int frame, int part){
+        memcpy(storedValues, src, partSize);
+        for(int k=0; k < numElements; ++k){
+            values[k] = storedValues[k];
+        }
+        setValues(frame, part, values);
+        src += partSize;
+    };
+
+    if(block.layout == BinarySeqWriter::FRAME_MAJOR){
+        for(int i=0; i < block.numFrames; ++i){
+            for(int j=0; j < block.numParts; ++j){
+                getPartValues(i, j);
+            }
+        }
+    } else {
+        for(int j=0; j < block.numParts; ++j){
+            for(int i=0; i < block.numFrames; ++i){
+                getPartValues(i, j);
+            }
+        }
+    }
+}
+
+
+template<class Setter>
+void BinarySeqReaderImpl::getFrames(const SeqBlock& block, Setter setValues)
+{
+    if(block.elementType == BinarySeqWriter::FLOAT64){
+        getFrames<double>(block, setValues);
+    } else {
+        getFrames<float>(block, setValues);
+    }
+}
+
+
+bool cnoid::loadSeqFromBinaryFile(AbstractSeq* seq, const std::string& filename, std::ostream& os)
+{
+    BinarySeqReader reader;
+    if(!reader.open(filename, os)){
+        return false;
+    }
+    for(int i=0; i < reader.numSeqs(); ++i){
+        if(reader.seqType(i) == seq->seqType()){
+            return reader.readSeq(i, seq);
+        }
+    }
+    os << format(_("\"%1%\" does not contain any %2%.")) % filename % seq->seqType() << endl;
+    return false;
+}
+
+
+bool cnoid::saveSeqAsBinaryFile
+(AbstractSeq* seq, const std::string& filename, std::ostream& os,
+ BinarySeqWriter::ElementType elementType, BinarySeqWriter::Layout layout)
+{
+    BinarySeqWriter writer;
+    writer.setElementType(elementType);
+    writer.setLayout(layout);
+    return
+        writer.open(filename, seq->seqType(), seq->seqContentName(), os) &&
+        writer.writeSeq(seq) &&
+        writer.close();
+}
@@ -0,0 +1,110 @@
+/**
+   @file
+*/
+
+#ifndef CNOID_UTIL_BINARY_SEQ_FILE_H
+#define CNOID_UTIL_BINARY_SEQ_FILE_H
+
+#include "AbstractSeq.h"
+#include "NullOut.h"
+#include <string>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class BinarySeqWriterImpl;
+class BinarySeqReaderImpl;
+
+/**
+   A binary seq file consists of a file header and the blocks of one or more seqs.
+   The block of a seq has a header containing the seq type, the content name, the frame rate,
+   the offset time, the part labels and the attributes given by AbstractSeq::writeBinarySeqAttributes,
+   and its frame data follows the header as an array of float64 or float32 values.
+   The values of each part are stored in the frame-major order or the part-major order.
+
+   The seqs of MultiValueSeq, MultiSE3Seq, Vector3Seq and MultiVector3Seq, including their
+   subclasses, are supported. An SE3 value is stored as the seven values of the translation and
+   the quaternion in the order of x, y, z, qw, qx, qy, qz.
+*/
+class CNOID_EXPORT BinarySeqWriter
+{
+public:
+    enum ElementType { FLOAT64 = 0, FLOAT32 = 1 };
+    enum Layout { FRAME_MAJOR = 0, PART_MAJOR = 1 };
+
+    BinarySeqWriter();
+    ~BinarySeqWriter();
+
+    //! The element type and the layout are applied to the seqs written after calling these functions.
+    void setElementType(ElementType type);
+    void setLayout(Layout layout);
+
+    /**
+       \param type The type of the whole data, which is the seq type for a file of a single seq
+       \param contentName The content name of the whole data
+    */
+    bool open(const std::string& filename, const std::string& type, const std::string& contentName,
+              std::ostream& os = nullout());
+
+    static bool isSupportedSeq(AbstractSeq* seq);
+
+    //! The frames are written to the file one by one without copying the whole data.
+    bool writeSeq(AbstractSeq* seq);
+
+    bool close();
+
+private:
+    BinarySeqWriterImpl* impl;
+
+    BinarySeqWriter(const BinarySeqWriter&) = delete;
+    BinarySeqWriter& operator=(const BinarySeqWriter&) = delete;
+};
+
+
+/**
+   This class reads a binary seq file through a memory mapping of the file.
+   The frame data is copied from the mapped region directly into the frames of a seq.
+*/
+class CNOID_EXPORT BinarySeqReader
+{
+public:
+    BinarySeqReader();
+    ~BinarySeqReader();
+
+    static bool checkFileFormat(const std::string& filename);
+
+    bool open(const std::string& filename, std::ostream& os = nullout());
+    void close();
+
+    int formatVersion() const;
+    const std::string& type() const;
+    const std::string& contentName() const;
+
+    int numSeqs() const;
+    const std::string& seqType(int index) const;
+    const std::string& seqContentName(int index) const;
+    int seqNumFrames(int index) const;
+    int seqNumParts(int index) const;
+    const std::vector<std::string>& seqPartLabels(int index) const;
+
+    //! The type of the seq must be the same as the seq type of the block.
+    bool readSeq(int index, AbstractSeq* seq);
+
+private:
+    BinarySeqReaderImpl* impl;
+
+    BinarySeqReader(const BinarySeqReader&) = delete;
+    BinarySeqReader& operator=(const BinarySeqReader&) = delete;
+};
+
+CNOID_EXPORT bool loadSeqFromBinaryFile(AbstractSeq* seq, const std::string& filename, std::ostream& os = nullout());
+
+CNOID_EXPORT bool saveSeqAsBinaryFile(
+    AbstractSeq* seq, const std::string& filename, std::ostream& os = nullout(),
+    BinarySeqWriter::ElementType elementType = BinarySeqWriter::FLOAT64,
+    BinarySeqWriter::Layout layout = BinarySeqWriter::FRAME_MAJOR);
+
+}
+
+#endif
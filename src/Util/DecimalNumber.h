@@ -0,0 +1,164 @@
+/**
+   @file
+   The conversion of the decimal numbers used by the readers and the writers of the text formats.
+   This header is not installed.
+*/
+
+#ifndef CNOID_UTIL_DECIMAL_NUMBER_H
+#define CNOID_UTIL_DECIMAL_NUMBER_H
+
+#include <cstdint>
+
+namespace cnoid {
+
+//! The powers of ten which are exactly represented by double
+const double exactPowersOf10[] = {
+    1.0e0, 1.0e1, 1.0e2, 1.0e3, 1.0e4, 1.0e5, 1.0e6, 1.0e7, 1.0e8, 1.0e9, 1.0e10,
+    1.0e11, 1.0e12, 1.0e13, 1.0e14, 1.0e15, 1.0e16, 1.0e17, 1.0e18, 1.0e19, 1.0e20,
+    1.0e21, 1.0e22 };
+
+const int maxExactPowerOf10 = 22;
+
+/**
+   The decimal number scanned from a string. The first 19 significant digits are kept in the
+   significand, and the exponent is adjusted for the digits of the integer part that are not kept.
+*/
+struct DecimalNumber
+{
+    uint64_t significand;
+    //! The number of the significant digits including the ones that are not kept
+    int numDigits;
+    int exponent;
+    bool isNegative;
+
+    /**
+       This function scans the sign, the digits, the fraction and the exponent from p, and moves p
+       to the character following the number. An exponent marker without digits is not scanned
+       as strtod does.
+       \return false when the number does not have any digit
+    */
+    bool scan(const char*& p, const char* end);
+
+    /**
+       The value is converted with one multiplication or division, which gives the correctly
+       rounded value, when the significand is less than 2^53 and the exponent is within the range
+       of the exactly represented powers of ten.
+       \return false when the number cannot be converted exactly
+    */
+    bool toExactDouble(double& out_value) const;
+
+    /**
+       The value may differ from the correctly rounded one by a few units in the last place of
+       double when the number cannot be converted exactly.
+       \return false when the exponent is out of the range of double
+    */
+    bool toApproximateDouble(double& out_value) const;
+};
+
+
+inline bool DecimalNumber::scan(const char*& p, const char* end)
+{
+    significand = 0;
+    numDigits = 0;
+    exponent = 0;
+    isNegative = false;
+
+    if(p < end && (*p == '-' || *p == '+')){
+        isNegative = (*p == '-');
+        ++p;
+    }
+    bool hasDigits = false;
+    while(p < end && *p >= '0' && *p <= '9'){
+        hasDigits = true;
+        if(numDigits < 19){
+            significand = significand * 10 + (*p - '0');
+        } else {
+            ++exponent;
+        }
+        if(numDigits > 0 || *p != '0'){
+            ++numDigits;
+        }
+        ++p;
+    }
+    if(p < end && *p == '.'){
+        ++p;
+        while(p < end && *p >= '0' && *p <= '9'){
+            hasDigits = true;
+            if(numDigits < 19){
+                significand = significand * 10 + (*p - '0');
+                --exponent;
+            }
+            if(numDigits > 0 || *p != '0'){
+                ++numDigits;
+            }
+            ++p;
+        }
+    }
+    if(hasDigits && p < end && (*p == 'e' || *p == 'E')){
+        const char* marker = p++;
+        bool isNegativeExponent = false;
+        if(p < end && (*p == '-' || *p == '+')){
+            isNegativeExponent = (*p == '-');
+            ++p;
+        }
+        if(p == end || *p < '0' || *p > '9'){
+            p = marker;
+        } else {
+            int e = 0;
+            while(p < end && *p >= '0' && *p <= '9'){
+                if(e < 10000){
+                    e = e * 10 + (*p - '0');
+                }
+                ++p;
+            }
+            exponent += isNegativeExponent ? -e : e;
+        }
+    }
+    return hasDigits;
+}
+
+
+inline bool DecimalNumber::toExactDouble(double& out_value) const
+{
+    if(numDigits > 19 || significand > (uint64_t(1) << 53) ||
+       exponent < -maxExactPowerOf10 || exponent > maxExactPowerOf10){
+        return false;
+    }
+    double value = static_cast<double>(significand);
+    if(exponent >= 0){
+        value *= exactPowersOf10[exponent];
+    } else {
+        value /= exactPowersOf10[-exponent];
+    }
+    out_value = isNegative ? -value : value;
+    return true;
+}
+
+
+inline bool DecimalNumber::toApproximateDouble(double& out_value) const
+{
+    if(exponent < -340 || exponent > 310){
+        return false;
+    }
+    double value = static_cast<double>(significand);
+    int e = exponent;
+    while(e > maxExactPowerOf10){
+        value *= exactPowersOf10[maxExactPowerOf10];
+        e -= maxExactPowerOf10;
+    }
+    while(e < -maxExactPowerOf10){
+        value /= exactPowersOf10[maxExactPowerOf10];
+        e += maxExactPowerOf10;
+    }
+    if(e >= 0){
+        value *= exactPowersOf10[e];
+    } else {
+        value /= exactPowersOf10[-e];
+    }
+    out_value = isNegative ? -value : value;
+    return true;
+}
+
+}
+
+#endif
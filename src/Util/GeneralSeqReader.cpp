@@ -44,3 +44,8 @@ std::string GeneralSeqReader::invalid_frame_size_message()
 {
     return _("Invalid frame size.");
 }
+
+std::string GeneralSeqReader::packed_frames_unsupported_message()
+{
+    return _("The packed frame data cannot be read into this seq type.");
+}
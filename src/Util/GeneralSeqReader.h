@@ -25,6 +25,7 @@ class GeneralSeqReader
     static std::string no_frame_data_message();
     static std::string invalid_num_parts_messaage();
     static std::string invalid_frame_size_message();
+    static std::string packed_frames_unsupported_message();
     
     std::ostream& os_;
     const Mapping* archive_;
@@ -69,11 +70,45 @@ private:
             archive->throwException(frames_key_not_found_message());
         }
         const Listing& frames = *framesNode->toListing();
-        if(frames.empty()){
+        if(auto packedFrames = dynamic_cast<const PackedNumberListing*>(&frames)){
+            packedFrames->checkValidity();
+            if(packedFrames->numElements() == 0){
+                frames.throwException(no_frame_data_message());
+            }
+        } else if(frames.empty()){
             frames.throwException(no_frame_data_message());
         }
         return frames;
     }
+
+    /*
+      The frames packed by YAMLReader::packNumberListings are read with this function.
+      Each frame is a flat array of the numbers of all the parts following the frame time,
+      and the numbers are given to setFrameValues with the index of the destination frame.
+    */
+    template<class SeqType, class SetFrameValues>
+    void readPackedFrames(
+        const PackedNumberListing& frames, SeqType* seq, int numValues, SetFrameValues setFrameValues)
+    {
+        const int numFrames = frames.numElements();
+        const int frameDataSize = hasFrameTime_ ? (numValues + 1) : numValues;
+        
+        for(int i=0; i < numFrames; ++i){
+            if(frames.elementSize(i) != frameDataSize){
+                frames.throwElementException(i, invalid_frame_size_message());
+            }
+            const double* src = frames.element(i);
+            if(!hasFrameTime_){
+                setFrameValues(i, src);
+            } else {
+                int frameIndex = seq->frameOfTime(src[0]);
+                if(frameIndex >= seq->numFrames()){
+                    seq->setNumFrames(frameIndex + 1, true);
+                }
+                setFrameValues(frameIndex, src + 1);
+            }
+        }
+    }
         
 public:        
     bool readHeaders(const Mapping* archive, AbstractSeq* seq)
@@ -138,9 +173,12 @@ public:
     >
     bool read(
         const Mapping* archive, SeqType* seq,
-        std::function<void(const Listing& srcNode, int topIndex, typename SeqType::value_type& seqValue)> readValue)
+        std::function<void(const Listing& srcNode, int topIndex, typename SeqType::value_type& seqValue)> readValue,
+        int packedValueSize = 0,
+        std::function<void(const double* src, typename SeqType::value_type& seqValue)> readPackedValue = nullptr)
     {
-        return readHeaders(archive, seq) && readFrames(archive, seq, readValue);
+        return readHeaders(archive, seq) &&
+            readFrames(archive, seq, readValue, packedValueSize, readPackedValue);
     }
 
     template<
@@ -151,9 +189,23 @@ public:
     >
     bool readFrames(
         const Mapping* archive, SeqType* seq,
-        std::function<void(const Listing& srcNode, int topIndex, typename SeqType::value_type& seqValue)> readValue)
+        std::function<void(const Listing& srcNode, int topIndex, typename SeqType::value_type& seqValue)> readValue,
+        int packedValueSize = 0,
+        std::function<void(const double* src, typename SeqType::value_type& seqValue)> readPackedValue = nullptr)
     {
         const Listing& frames = getFrames(archive);
+
+        if(auto packedFrames = dynamic_cast<const PackedNumberListing*>(&frames)){
+            if(!readPackedValue){
+                frames.throwException(packed_frames_unsupported_message());
+            }
+            seq->setNumFrames(hasFrameTime_ ? 0 : packedFrames->numElements());
+            readPackedFrames(
+                *packedFrames, seq, packedValueSize,
+                [&](int frameIndex, const double* src){ readPackedValue(src, (*seq)[frameIndex]); });
+            return true;
+        }
+        
         const int numFrames = frames.size();
         seq->setNumFrames(hasFrameTime_ ? 0 : numFrames);
 
@@ -182,9 +234,12 @@ public:
     >
     bool read(
         const Mapping* archive, SeqType* seq,
-        std::function<void(const ValueNode& srcNode, typename SeqType::value_type& seqValue)> readValue)
+        std::function<void(const ValueNode& srcNode, typename SeqType::value_type& seqValue)> readValue,
+        int packedValueSize = 0,
+        std::function<void(const double* src, typename SeqType::value_type& seqValue)> readPackedValue = nullptr)
     {
-        return readHeaders(archive, seq) && readFrames(archive, seq, readValue);
+        return readHeaders(archive, seq) &&
+            readFrames(archive, seq, readValue, packedValueSize, readPackedValue);
     }
 
     template<
@@ -193,7 +248,9 @@ public:
     >
     bool readFrames(
         const Mapping* archive, SeqType* seq,
-        std::function<void(const ValueNode& srcNode, typename SeqType::value_type& seqValue)> readValue)
+        std::function<void(const ValueNode& srcNode, typename SeqType::value_type& seqValue)> readValue,
+        int packedValueSize = 0,
+        std::function<void(const double* src, typename SeqType::value_type& seqValue)> readPackedValue = nullptr)
     {
         int frameDataSize = numParts_;
         if(hasFrameTime_){
@@ -201,6 +258,23 @@ public:
         }
 
         const Listing& frames = getFrames(archive);
+
+        if(auto packedFrames = dynamic_cast<const PackedNumberListing*>(&frames)){
+            if(!readPackedValue){
+                frames.throwException(packed_frames_unsupported_message());
+            }
+            seq->setDimension(hasFrameTime_ ? 0 : packedFrames->numElements(), numParts_);
+            readPackedFrames(
+                *packedFrames, seq, numParts_ * packedValueSize,
+                [&](int frameIndex, const double* src){
+                    auto seqFrame = seq->frame(frameIndex);
+                    for(int j=0; j < numParts_; ++j){
+                        readPackedValue(src + j * packedValueSize, seqFrame[j]);
+                    }
+                });
+            return true;
+        }
+        
         const int numFrames = frames.size();
 
         if(hasFrameTime_){
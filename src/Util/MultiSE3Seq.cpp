@@ -91,6 +91,10 @@ bool MultiSE3Seq::doReadSeq(const Mapping* archive, std::ostream& os)
                 }
                 value.translation() << v[0].toDouble(), v[1].toDouble(), v[2].toDouble();
                 value.rotation() = Quat(v[3].toDouble(), v[4].toDouble(), v[5].toDouble(), v[6].toDouble());
+            },
+            7, [](const double* src, SE3& value){
+                value.translation() << src[0], src[1], src[2];
+                value.rotation() = Quat(src[3], src[4], src[5], src[6]);
             });
 
     } else if(se3format == "XYZQXQYQZQW" && reader.formatVersion() < 2.0){
@@ -103,6 +107,10 @@ bool MultiSE3Seq::doReadSeq(const Mapping* archive, std::ostream& os)
                 }
                 value.translation() << v[0].toDouble(), v[1].toDouble(), v[2].toDouble();
                 value.rotation() = Quat(v[6].toDouble(), v[3].toDouble(), v[4].toDouble(), v[5].toDouble());
+            },
+            7, [](const double* src, SE3& value){
+                value.translation() << src[0], src[1], src[2];
+                value.rotation() = Quat(src[6], src[3], src[4], src[5]);
             });
 
     } else if(se3format == "XYZRPY"){
@@ -115,6 +123,10 @@ bool MultiSE3Seq::doReadSeq(const Mapping* archive, std::ostream& os)
                 }
                 value.translation() << v[0].toDouble(), v[1].toDouble(), v[2].toDouble();
                 value.rotation() = rotFromRpy(v[3].toDouble(), v[4].toDouble(), v[5].toDouble());
+            },
+            6, [](const double* src, SE3& value){
+                value.translation() << src[0], src[1], src[2];
+                value.rotation() = rotFromRpy(src[3], src[4], src[5]);
             });
 
     } else {
@@ -125,22 +137,18 @@ bool MultiSE3Seq::doReadSeq(const Mapping* archive, std::ostream& os)
 }
 
 
-static void writeSE3(YAMLWriter& writer, const SE3& value)
+static void copySE3Values(const SE3& value, double* dest)
 {
-    writer.startFlowStyleListing();
-
     const Vector3& p = value.translation();
-    writer.putScalar(p.x());
-    writer.putScalar(p.y());
-    writer.putScalar(p.z());
+    dest[0] = p.x();
+    dest[1] = p.y();
+    dest[2] = p.z();
 
     const Quat& q = value.rotation();
-    writer.putScalar(q.w());
-    writer.putScalar(q.x());
-    writer.putScalar(q.y());
-    writer.putScalar(q.z());
-
-    writer.endListing();
+    dest[3] = q.w();
+    dest[4] = q.x();
+    dest[5] = q.y();
+    dest[6] = q.z();
 }
     
 
@@ -165,13 +173,13 @@ bool MultiSE3Seq::doWriteSeq(YAMLWriter& writer)
     writer.startListing();
     const int m = numParts();
     const int n = numFrames();
+    vector<double> values(m * 7);
     for(int i=0; i < n; ++i){
         Frame f = frame(i);
-        writer.startFlowStyleListing();
         for(int j=0; j < m; ++j){
-            writeSE3(writer, f[j]);
+            copySE3Values(f[j], &values[j * 7]);
         }
-        writer.endListing();
+        writer.putFlowStyleListing(values.data(), values.size(), 7);
     }
     writer.endListing();
     
@@ -54,7 +54,8 @@ bool MultiValueSeq::doReadSeq(const Mapping* archive, std::ostream& os)
     GeneralSeqReader reader(os);
     return reader.read<MultiValueSeq>(
         archive, this,
-        [](const ValueNode& node, double& v){ v = node.toDouble(); });
+        [](const ValueNode& node, double& v){ v = node.toDouble(); },
+        1, [](const double* src, double& v){ v = *src; });
 }
     
 
@@ -69,12 +70,8 @@ bool MultiValueSeq::doWriteSeq(YAMLWriter& writer)
     const int n = numFrames();
     const int m = numParts();
     for(int i=0; i < n; ++i){
-        writer.startFlowStyleListing();
         Frame v = frame(i);
-        for(int j=0; j < m; ++j){
-            writer.putScalar(v[j]);
-        }
-        writer.endListing();
+        writer.putFlowStyleListing(v.begin(), m);
     }
     writer.endListing();
     return true;
@@ -70,7 +70,8 @@ bool MultiVector3Seq::doReadSeq(const Mapping* archive, std::ostream& os)
                 v.throwException(_("The number of elements specified as a 3D vector is invalid."));
             }
             value << v[0].toDouble(), v[1].toDouble(), v[2].toDouble();
-        });
+        },
+        3, [](const double* src, Vector3& value){ value << src[0], src[1], src[2]; });
 }
 
 
@@ -84,18 +85,16 @@ bool MultiVector3Seq::doWriteSeq(YAMLWriter& writer)
     writer.startListing();
     const int m = numParts();
     const int n = numFrames();
+    vector<double> values(m * 3);
     for(int i=0; i < n; ++i){
         Frame f = frame(i);
-        writer.startFlowStyleListing();
         for(int j=0; j < m; ++j){
-            writer.startFlowStyleListing();
             const Vector3& p = f[j];
-            writer.putScalar(p.x());
-            writer.putScalar(p.y());
-            writer.putScalar(p.z());
-            writer.endListing();
+            values[j * 3] = p.x();
+            values[j * 3 + 1] = p.y();
+            values[j * 3 + 2] = p.z();
         }
-        writer.endListing();
+        writer.putFlowStyleListing(values.data(), values.size(), 3);
     }
     writer.endListing();
     return true;
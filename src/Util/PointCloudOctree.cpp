@@ -0,0 +1,947 @@
+/*!
+  @file
+*/
+
+#include "PointCloudOctree.h"
+#include "PointSetUtil.h"
+#include "PolyhedralRegion.h"
+#include "Exception.h"
+#include <boost/format.hpp>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <limits>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+
+namespace {
+
+/*
+  The file consists of the header, the point data of the nodes and the node table.
+  The point data of a node is the array of the coordinates followed by the array of
+  the RGB values, and the space for the capacity of the node is kept for each array.
+*/
+const char fileMagic[8] = { 'C', 'N', 'O', 'C', 'T', 'R', 'E', 'E' };
+const uint32_t formatVersion = 1;
+const int nodeRecordSize = 68;
+const int numPointsFieldOffset = 52;
+const uint32_t HAS_COLORS = 1;
+
+const int samplingGridResolution = 128;
+const int maxDepth = 20;
+const int64_t maxNumInMemoryPoints = 10000000;
+const int maxPartitionDepth = 3;
+const int numPointsPerChunk = 1000000;
+
+typedef PointCloudOctree::Node Node;
+
+template<class T> void writeValue(ostream& os, const T& value)
+{
+    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<class T> void readValue(istream& is, T& value)
+{
+    is.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+void writeNodeRecord(ostream& os, const Node& node)
+{
+    for(int i=0; i < 3; ++i){
+        writeValue(os, node.min[i]);
+    }
+    writeValue(os, node.size);
+    writeValue<int32_t>(os, node.depth);
+    for(int i=0; i < 8; ++i){
+        writeValue<int32_t>(os, node.children[i]);
+    }
+    writeValue<int32_t>(os, node.numPoints);
+    writeValue<int32_t>(os, node.capacity);
+    writeValue(os, node.dataOffset);
+}
+
+void readNodeRecord(istream& is, Node& node)
+{
+    int32_t value;
+    for(int i=0; i < 3; ++i){
+        readValue(is, node.min[i]);
+    }
+    readValue(is, node.size);
+    readValue(is, value);
+    node.depth = value;
+    for(int i=0; i < 8; ++i){
+        readValue(is, value);
+        node.children[i] = value;
+    }
+    readValue(is, value);
+    node.numPoints = value;
+    readValue(is, value);
+    node.capacity = value;
+    readValue(is, node.dataOffset);
+}
+
+void writeHeader(ostream& os, uint32_t flags, int64_t numPoints, uint32_t numNodes, int64_t nodeTableOffset)
+{
+    os.write(fileMagic, sizeof(fileMagic));
+    writeValue(os, formatVersion);
+    writeValue(os, flags);
+    writeValue(os, numPoints);
+    writeValue(os, numNodes);
+    writeValue<uint32_t>(os, 0);
+    writeValue(os, nodeTableOffset);
+}
+
+struct BuildPoint
+{
+    Vector3f position;
+    uint8_t rgb[3];
+};
+
+uint8_t toColorElement(float value)
+{
+    return static_cast<uint8_t>(std::max(0.0f, std::min(255.0f, value * 255.0f + 0.5f)));
+}
+
+int getChildIndex(const Vector3f& min, float size, const Vector3f& p)
+{
+    const float h = size / 2.0f;
+    return ((p.x() >= min.x() + h) ? 1 : 0) | ((p.y() >= min.y() + h) ? 2 : 0) | ((p.z() >= min.z() + h) ? 4 : 0);
+}
+
+Vector3f getChildMin(const Vector3f& min, float size, int childIndex)
+{
+    const float h = size / 2.0f;
+    return Vector3f(
+        (childIndex & 1) ? min.x() + h : min.x(),
+        (childIndex & 2) ? min.y() + h : min.y(),
+        (childIndex & 4) ? min.z() + h : min.z());
+}
+
+Vector3f getCorner(const Node& node, int cornerIndex)
+{
+    return getChildMin(node.min, node.size * 2.0f, cornerIndex);
+}
+
+/**
+   The points are sampled so that a node has at most one point in each cell of the sampling grid.
+*/
+class PointSampler
+{
+public:
+    Vector3f min;
+    float scale;
+    int maxNumPoints;
+    vector<bool> occupiedCells;
+
+    PointSampler(const Vector3f& min, float size, int maxNumPoints)
+        : min(min), scale(samplingGridResolution / size), maxNumPoints(maxNumPoints) { }
+
+    bool sample(const Vector3f& p, vector<BuildPoint>& points){
+        if(static_cast<int>(points.size()) >= maxNumPoints){
+            return false;
+        }
+        if(occupiedCells.empty()){
+            occupiedCells.resize(samplingGridResolution * samplingGridResolution * samplingGridResolution);
+        }
+        int index = 0;
+        for(int i=2; i >= 0; --i){
+            const int c = std::max(0, std::min(samplingGridResolution - 1, static_cast<int>((p[i] - min[i]) * scale)));
+            index = index * samplingGridResolution + c;
+        }
+        if(occupiedCells[index]){
+            return false;
+        }
+        occupiedCells[index] = true;
+        return true;
+    }
+};
+
+/**
+   The node above the partition depth. The points of the node are sampled while the points are
+   read from the PCD file, and the points that are not sampled are passed to the child nodes.
+   The points of a node at the partition depth are stored in a temporary bucket file.
+*/
+struct UpperNode
+{
+    Vector3f min;
+    float size;
+    int depth;
+    vector<BuildPoint> points;
+    unique_ptr<PointSampler> sampler;
+    unique_ptr<UpperNode> children[8];
+    unique_ptr<ofstream> bucket;
+    string bucketFilename;
+    int64_t numBucketPoints;
+
+    UpperNode(const Vector3f& min, float size, int depth)
+        : min(min), size(size), depth(depth), numBucketPoints(0) { }
+};
+
+class OctreeBuilder
+{
+public:
+    ostream& os;
+    string filename;
+    int maxNumNodePoints;
+    int partitionDepth;
+    bool hasColors;
+    int numBuckets;
+    ofstream out;
+    vector<Node> nodes;
+    int64_t numPoints;
+    unique_ptr<UpperNode> root;
+
+    OctreeBuilder(const string& filename, int maxNumNodePoints, ostream& os)
+        : os(os), filename(filename), maxNumNodePoints(maxNumNodePoints) { }
+
+    bool build(const string& pcdFilename);
+    void insertPoint(const BuildPoint& point);
+    void spill(UpperNode* node, const BuildPoint& point);
+    int writeUpperNode(UpperNode* node);
+    int buildSubtree(const Vector3f& min, float size, int depth, vector<BuildPoint>& points);
+    int addNode(const Vector3f& min, float size, int depth, const vector<BuildPoint>& points);
+    void removeBucketFiles(UpperNode* node);
+};
+
+}
+
+namespace cnoid {
+
+class PointCloudOctreeImpl
+{
+public:
+    string filename;
+    fstream file;
+    vector<Node> nodes;
+    int64_t numPoints;
+    bool hasColors;
+    int64_t nodeTableOffset;
+    bool isWritable;
+
+    // The file is accessed by the thread loading the nodes as well as the main thread
+    std::mutex fileMutex;
+
+    PointCloudOctreeImpl();
+    bool open(const string& filename, ostream& os);
+    void close();
+    bool openForWriting(ostream& os);
+    bool readPoints(int nodeIndex, SgVertexArray& out_points, vector<uint8_t>* out_rgb);
+    void writePoints(int nodeIndex, const SgVertexArray& points, const vector<uint8_t>* rgb);
+    void writeNumPoints(int nodeIndex);
+    int64_t removeSubtreePoints(int nodeIndex, vector<int>& out_modifiedNodeIndices);
+};
+
+}
+
+
+bool PointCloudOctree::build
+(const std::string& pcdFilename, const std::string& octreeFilename, std::ostream& os, int maxNumNodePoints)
+{
+    OctreeBuilder builder(octreeFilename, std::max(1, maxNumNodePoints), os);
+    try {
+        return builder.build(pcdFilename);
+    } catch(const boost::exception& ex){
+        if(const std::string* message = boost::get_error_info<error_info_message>(ex)){
+            os << *message << endl;
+        }
+    }
+    builder.removeBucketFiles(builder.root.get());
+    return false;
+}
+
+
+bool OctreeBuilder::build(const string& pcdFilename)
+{
+    // The first pass gets the bounding box
+    Vector3f bbmin = Vector3f::Constant(std::numeric_limits<float>::max());
+    Vector3f bbmax = Vector3f::Constant(-std::numeric_limits<float>::max());
+    numPoints = 0;
+    hasColors = false;
+    readPCDInChunks(
+        pcdFilename, numPointsPerChunk,
+        [&](SgPointSet* chunk){
+            for(auto& p : *chunk->vertices()){
+                bbmin = bbmin.cwiseMin(p);
+                bbmax = bbmax.cwiseMax(p);
+            }
+            numPoints += chunk->vertices()->size();
+            hasColors = chunk->hasColors();
+        });
+
+    if(numPoints == 0){
+        os << format("\"%1%\" does not have any valid points.") % pcdFilename << endl;
+        return false;
+    }
+
+    float rootSize = (bbmax - bbmin).maxCoeff();
+    if(rootSize <= 0.0f){
+        rootSize = 1.0f;
+    }
+    // The points on the upper faces of the bounding box must be inside the root cell
+    rootSize *= 1.0001f;
+    root.reset(new UpperNode(bbmin, rootSize, 0));
+
+    partitionDepth = 0;
+    int64_t n = numPoints;
+    while(n > maxNumInMemoryPoints && partitionDepth < maxPartitionDepth){
+        n /= 8;
+        ++partitionDepth;
+    }
+    numBuckets = 0;
+
+    os << format("Building the octree of %1% points of \"%2%\".") % numPoints % pcdFilename << endl;
+
+    // The second pass distributes the points
+    readPCDInChunks(
+        pcdFilename, numPointsPerChunk,
+        [&](SgPointSet* chunk){
+            const SgVertexArray& vertices = *chunk->vertices();
+            const SgColorArray* colors = chunk->colors();
+            BuildPoint point;
+            point.rgb[0] = point.rgb[1] = point.rgb[2] = 255;
+            for(size_t i=0; i < vertices.size(); ++i){
+                point.position = vertices[i];
+                if(colors){
+                    const Vector3f& c = (*colors)[i];
+                    for(int j=0; j < 3; ++j){
+                        point.rgb[j] = toColorElement(c[j]);
+                    }
+                }
+                insertPoint(point);
+            }
+        });
+
+    out.open(filename.c_str(), ios::out | ios::binary | ios::trunc);
+    if(!out.is_open()){
+        os << format("\"%1%\" cannot be created.") % filename << endl;
+        removeBucketFiles(root.get());
+        return false;
+    }
+    writeHeader(out, 0, 0, 0, 0);
+
+    if(partitionDepth == 0){
+        vector<BuildPoint> points;
+        points.swap(root->points);
+        buildSubtree(root->min, root->size, 0, points);
+    } else {
+        writeUpperNode(root.get());
+    }
+
+    const int64_t nodeTableOffset = out.tellp();
+    for(auto& node : nodes){
+        writeNodeRecord(out, node);
+    }
+    out.seekp(0);
+    writeHeader(out, hasColors ? HAS_COLORS : 0, numPoints, nodes.size(), nodeTableOffset);
+    out.close();
+
+    if(out.fail()){
+        os << format("Writing \"%1%\" failed.") % filename << endl;
+        return false;
+    }
+    os << format("The octree has %1% nodes.") % nodes.size() << endl;
+    return true;
+}
+
+
+void OctreeBuilder::insertPoint(const BuildPoint& point)
+{
+    UpperNode* node = root.get();
+    while(true){
+        if(node->depth == partitionDepth){
+            spill(node, point);
+            break;
+        }
+        if(!node->sampler){
+            node->sampler.reset(new PointSampler(node->min, node->size, maxNumNodePoints));
+        }
+        if(node->sampler->sample(point.position, node->points)){
+            node->points.push_back(point);
+            break;
+        }
+        const int i = getChildIndex(node->min, node->size, point.position);
+        if(!node->children[i]){
+            node->children[i].reset(
+                new UpperNode(getChildMin(node->min, node->size, i), node->size / 2.0f, node->depth + 1));
+        }
+        node = node->children[i].get();
+    }
+}
+
+
+void OctreeBuilder::spill(UpperNode* node, const BuildPoint& point)
+{
+    if(partitionDepth == 0){
+        node->points.push_back(point);
+        return;
+    }
+    if(!node->bucket){
+        node->bucketFilename = str(format("%1%.bucket%2%") % filename % numBuckets++);
+        node->bucket.reset(new ofstream(node->bucketFilename.c_str(), ios::out | ios::binary | ios::trunc));
+        if(!node->bucket->is_open()){
+            throw exception_base() << error_info_message(
+                str(format("The temporary file \"%1%\" cannot be created.") % node->bucketFilename));
+        }
+    }
+    node->bucket->write(reinterpret_cast<const char*>(point.position.data()), sizeof(float) * 3);
+    node->bucket->write(reinterpret_cast<const char*>(point.rgb), 3);
+    ++node->numBucketPoints;
+}
+
+
+int OctreeBuilder::writeUpperNode(UpperNode* node)
+{
+    if(node->depth == partitionDepth){
+        vector<BuildPoint> points(node->numBucketPoints);
+        node->bucket->close();
+        ifstream bucket(node->bucketFilename.c_str(), ios::in | ios::binary);
+        for(auto& point : points){
+            bucket.read(reinterpret_cast<char*>(point.position.data()), sizeof(float) * 3);
+            bucket.read(reinterpret_cast<char*>(point.rgb), 3);
+        }
+        if(!bucket){
+            throw file_read_error() << error_info_message(
+                str(format("The temporary file \"%1%\" cannot be read.") % node->bucketFilename));
+        }
+        bucket.close();
+        std::remove(node->bucketFilename.c_str());
+        node->bucket.reset();
+        return buildSubtree(node->min, node->size, node->depth, points);
+    }
+
+    const int index = addNode(node->min, node->size, node->depth, node->points);
+    vector<BuildPoint>().swap(node->points);
+    node->sampler.reset();
+    for(int i=0; i < 8; ++i){
+        if(node->children[i]){
+            const int childIndex = writeUpperNode(node->children[i].get());
+            nodes[index].children[i] = childIndex;
+            node->children[i].reset();
+        }
+    }
+    return index;
+}
+
+
+int OctreeBuilder::buildSubtree(const Vector3f& min, float size, int depth, vector<BuildPoint>& points)
+{
+    if(static_cast<int>(points.size()) <= maxNumNodePoints || depth >= maxDepth){
+        return addNode(min, size, depth, points);
+    }
+
+    vector<BuildPoint> nodePoints;
+    vector<BuildPoint> childPoints[8];
+    {
+        PointSampler sampler(min, size, maxNumNodePoints);
+        for(auto& point : points){
+            if(sampler.sample(point.position, nodePoints)){
+                nodePoints.push_back(point);
+            } else {
+                childPoints[getChildIndex(min, size, point.position)].push_back(point);
+            }
+        }
+    }
+    vector<BuildPoint>().swap(points);
+
+    const int index = addNode(min, size, depth, nodePoints);
+    vector<BuildPoint>().swap(nodePoints);
+
+    for(int i=0; i < 8; ++i){
+        if(!childPoints[i].empty()){
+            const int childIndex = buildSubtree(getChildMin(min, size, i), size / 2.0f, depth + 1, childPoints[i]);
+            nodes[index].children[i] = childIndex;
+        }
+    }
+    return index;
+}
+
+
+int OctreeBuilder::addNode(const Vector3f& min, float size, int depth, const vector<BuildPoint>& points)
+{
+    const int index = nodes.size();
+    nodes.push_back(Node());
+    Node& node = nodes.back();
+    node.min = min;
+    node.size = size;
+    node.depth = depth;
+    std::fill(node.children, node.children + 8, -1);
+    node.numPoints = points.size();
+    node.capacity = points.size();
+    node.dataOffset = out.tellp();
+
+    for(auto& point : points){
+        out.write(reinterpret_cast<const char*>(point.position.data()), sizeof(float) * 3);
+    }
+    if(hasColors){
+        for(auto& point : points){
+            out.write(reinterpret_cast<const char*>(point.rgb), 3);
+        }
+    }
+    return index;
+}
+
+
+void OctreeBuilder::removeBucketFiles(UpperNode* node)
+{
+    if(node){
+        if(node->bucket){
+            node->bucket.reset();
+            std::remove(node->bucketFilename.c_str());
+        }
+        for(int i=0; i < 8; ++i){
+            removeBucketFiles(node->children[i].get());
+        }
+    }
+}
+
+
+PointCloudOctree::PointCloudOctree()
+{
+    impl = new PointCloudOctreeImpl;
+}
+
+
+PointCloudOctreeImpl::PointCloudOctreeImpl()
+{
+    numPoints = 0;
+    hasColors = false;
+    nodeTableOffset = 0;
+    isWritable = false;
+}
+
+
+PointCloudOctree::~PointCloudOctree()
+{
+    delete impl;
+}
+
+
+bool PointCloudOctree::open(const std::string& filename, std::ostream& os)
+{
+    std::lock_guard<std::mutex> lock(impl->fileMutex);
+    return impl->open(filename, os);
+}
+
+
+bool PointCloudOctreeImpl::open(const string& filename, ostream& os)
+{
+    close();
+
+    // The file is opened for writing when the points are removed so that the files on
+    // a read-only path can be viewed
+    file.open(filename.c_str(), ios::in | ios::binary);
+    if(!file.is_open()){
+        os << format("\"%1%\" cannot be opened.") % filename << endl;
+        return false;
+    }
+
+    char magic[8];
+    uint32_t version, flags, numNodes, reserved;
+    file.read(magic, sizeof(magic));
+    readValue(file, version);
+    readValue(file, flags);
+    readValue(file, numPoints);
+    readValue(file, numNodes);
+    readValue(file, reserved);
+    readValue(file, nodeTableOffset);
+
+    if(!file || memcmp(magic, fileMagic, sizeof(magic)) != 0){
+        os << format("\"%1%\" is not a point cloud octree file.") % filename << endl;
+        close();
+        return false;
+    }
+    if(version != formatVersion){
+        os << format("The version %1% of \"%2%\" is not supported.") % version % filename << endl;
+        close();
+        return false;
+    }
+    hasColors = flags & HAS_COLORS;
+
+    file.seekg(nodeTableOffset);
+    nodes.resize(numNodes);
+    for(auto& node : nodes){
+        readNodeRecord(file, node);
+    }
+    if(!file || nodes.empty()){
+        os << format("The node table of \"%1%\" is broken.") % filename << endl;
+        close();
+        return false;
+    }
+
+    this->filename = filename;
+    return true;
+}
+
+
+void PointCloudOctree::close()
+{
+    std::lock_guard<std::mutex> lock(impl->fileMutex);
+    impl->close();
+}
+
+
+void PointCloudOctreeImpl::close()
+{
+    if(file.is_open()){
+        file.close();
+    }
+    file.clear();
+    filename.clear();
+    nodes.clear();
+    numPoints = 0;
+    hasColors = false;
+    isWritable = false;
+}
+
+
+bool PointCloudOctreeImpl::openForWriting(ostream& os)
+{
+    if(isWritable){
+        return true;
+    }
+    file.close();
+    file.clear();
+    file.open(filename.c_str(), ios::in | ios::out | ios::binary);
+    if(file.is_open()){
+        isWritable = true;
+        return true;
+    }
+    os << format("\"%1%\" cannot be opened for writing.") % filename << endl;
+    file.clear();
+    file.open(filename.c_str(), ios::in | ios::binary);
+    return false;
+}
+
+
+bool PointCloudOctree::isOpen() const
+{
+    return impl->file.is_open();
+}
+
+
+const std::string& PointCloudOctree::filename() const
+{
+    return impl->filename;
+}
+
+
+int PointCloudOctree::numNodes() const
+{
+    return impl->nodes.size();
+}
+
+
+const PointCloudOctree::Node& PointCloudOctree::node(int index) const
+{
+    return impl->nodes[index];
+}
+
+
+int64_t PointCloudOctree::numPoints() const
+{
+    return impl->numPoints;
+}
+
+
+bool PointCloudOctree::hasColors() const
+{
+    return impl->hasColors;
+}
+
+
+bool PointCloudOctree::readPoints(int nodeIndex, SgVertexArray& out_points, SgColorArray* out_colors)
+{
+    std::lock_guard<std::mutex> lock(impl->fileMutex);
+    if(nodeIndex < 0 || nodeIndex >= static_cast<int>(impl->nodes.size())){
+        return false;
+    }
+    if(!out_colors || !impl->hasColors){
+        if(out_colors){
+            out_colors->clear();
+        }
+        return impl->readPoints(nodeIndex, out_points, 0);
+    }
+    vector<uint8_t> rgb;
+    if(!impl->readPoints(nodeIndex, out_points, &rgb)){
+        return false;
+    }
+    const int n = out_points.size();
+    out_colors->resize(n);
+    for(int i=0; i < n; ++i){
+        const uint8_t* c = &rgb[i * 3];
+        (*out_colors)[i] << c[0] / 255.0f, c[1] / 255.0f, c[2] / 255.0f;
+    }
+    return true;
+}
+
+
+bool PointCloudOctreeImpl::readPoints(int nodeIndex, SgVertexArray& out_points, vector<uint8_t>* out_rgb)
+{
+    const Node& node = nodes[nodeIndex];
+    out_points.resize(node.numPoints);
+    if(node.numPoints > 0){
+        file.seekg(node.dataOffset);
+        file.read(reinterpret_cast<char*>(out_points.front().data()), sizeof(float) * 3 * node.numPoints);
+        if(out_rgb && hasColors){
+            out_rgb->resize(node.numPoints * 3);
+            file.seekg(node.dataOffset + static_cast<int64_t>(node.capacity) * sizeof(float) * 3);
+            file.read(reinterpret_cast<char*>(out_rgb->data()), node.numPoints * 3);
+        }
+    }
+    if(!file){
+        file.clear();
+        out_points.clear();
+        return false;
+    }
+    return true;
+}
+
+
+void PointCloudOctreeImpl::writePoints(int nodeIndex, const SgVertexArray& points, const vector<uint8_t>* rgb)
+{
+    Node& node = nodes[nodeIndex];
+    node.numPoints = points.size();
+    if(node.numPoints > 0){
+        file.seekp(node.dataOffset);
+        file.write(reinterpret_cast<const char*>(points.front().data()), sizeof(float) * 3 * node.numPoints);
+        if(rgb && hasColors){
+            file.seekp(node.dataOffset + static_cast<int64_t>(node.capacity) * sizeof(float) * 3);
+            file.write(reinterpret_cast<const char*>(rgb->data()), node.numPoints * 3);
+        }
+    }
+    writeNumPoints(nodeIndex);
+}
+
+
+void PointCloudOctreeImpl::writeNumPoints(int nodeIndex)
+{
+    file.seekp(nodeTableOffset + static_cast<int64_t>(nodeIndex) * nodeRecordSize + numPointsFieldOffset);
+    writeValue<int32_t>(file, nodes[nodeIndex].numPoints);
+}
+
+
+void PointCloudOctree::findVisibleNodes
+(const Vector3& viewpoint, const PolyhedralRegion& viewVolume, double minSizeRatio, int pointBudget,
+ std::vector<int>& out_nodeIndices) const
+{
+    out_nodeIndices.clear();
+    const auto& nodes = impl->nodes;
+    if(nodes.empty()){
+        return;
+    }
+    const Vector3f v = viewpoint.cast<float>();
+
+    auto getSizeRatio = [&](const Node& node){
+        const Vector3f d = (node.min - v).cwiseMax(v - (node.min + Vector3f::Constant(node.size))).cwiseMax(0.0f);
+        return node.size / std::max(static_cast<double>(d.norm()), 1.0e-3);
+    };
+
+    // A cell is outside of the view volume when all its corners are outside of a bounding plane.
+    // The subtree of the cell is not visited because the child cells are inside the cell.
+    const int numPlanes = viewVolume.numBoundingPlanes();
+    auto isOutsideOfViewVolume = [&](const Node& node){
+        for(int i=0; i < numPlanes; ++i){
+            const PolyhedralRegion::Plane& plane = viewVolume.plane(i);
+            bool isOutside = true;
+            for(int j=0; j < 8; ++j){
+                if(getCorner(node, j).cast<double>().dot(plane.normal) - plane.d >= 0.0){
+                    isOutside = false;
+                    break;
+                }
+            }
+            if(isOutside){
+                return true;
+            }
+        }
+        return false;
+    };
+
+    priority_queue<pair<double, int>> queue;
+    if(!isOutsideOfViewVolume(nodes[0])){
+        queue.push(make_pair(getSizeRatio(nodes[0]), 0));
+    }
+    int64_t numPoints = 0;
+
+    while(!queue.empty()){
+        const int index = queue.top().second;
+        queue.pop();
+        const Node& node = nodes[index];
+        if(node.numPoints > 0){
+            if(numPoints + node.numPoints > pointBudget && !out_nodeIndices.empty()){
+                break;
+            }
+            out_nodeIndices.push_back(index);
+            numPoints += node.numPoints;
+        }
+        for(int i=0; i < 8; ++i){
+            const int childIndex = node.children[i];
+            if(childIndex >= 0 && !isOutsideOfViewVolume(nodes[childIndex])){
+                const double ratio = getSizeRatio(nodes[childIndex]);
+                if(ratio >= minSizeRatio){
+                    queue.push(make_pair(ratio, childIndex));
+                }
+            }
+        }
+    }
+}
+
+
+bool PointCloudOctree::removePoints
+(const PolyhedralRegion& region, std::vector<int>& out_modifiedNodeIndices, std::ostream& os)
+{
+    std::lock_guard<std::mutex> lock(impl->fileMutex);
+    out_modifiedNodeIndices.clear();
+    auto& nodes = impl->nodes;
+    if(nodes.empty()){
+        return true;
+    }
+    if(!impl->openForWriting(os)){
+        return false;
+    }
+
+    const int numPlanes = region.numBoundingPlanes();
+    int64_t numRemovedPoints = 0;
+    SgVertexArray points;
+    vector<uint8_t> rgb;
+    vector<uint8_t>* pRGB = impl->hasColors ? &rgb : 0;
+    vector<int> stack;
+    stack.push_back(0);
+
+    while(!stack.empty()){
+        const int index = stack.back();
+        stack.pop_back();
+        const Node& node = nodes[index];
+
+        // The child cells are inside the parent cell, so the children of a node
+        // that is outside of the region are not checked
+        bool isOutside = false;
+        bool isInside = true;
+        for(int i=0; i < numPlanes; ++i){
+            const PolyhedralRegion::Plane& plane = region.plane(i);
+            int numInsideCorners = 0;
+            for(int j=0; j < 8; ++j){
+                const Vector3 corner = getCorner(node, j).cast<double>();
+                if(corner.dot(plane.normal) - plane.d >= 0.0){
+                    ++numInsideCorners;
+                }
+            }
+            if(numInsideCorners == 0){
+                isOutside = true;
+                break;
+            } else if(numInsideCorners < 8){
+                isInside = false;
+            }
+        }
+        if(isOutside){
+            continue;
+        }
+        if(isInside){
+            numRemovedPoints += impl->removeSubtreePoints(index, out_modifiedNodeIndices);
+            continue;
+        }
+
+        if(node.numPoints > 0 && impl->readPoints(index, points, pRGB)){
+            int n = 0;
+            for(size_t i=0; i < points.size(); ++i){
+                if(!region.checkInside(points[i].cast<double>())){
+                    points[n] = points[i];
+                    if(pRGB){
+                        std::copy(&rgb[i * 3], &rgb[i * 3] + 3, &rgb[n * 3]);
+                    }
+                    ++n;
+                }
+            }
+            if(n < node.numPoints){
+                numRemovedPoints += node.numPoints - n;
+                points.resize(n);
+                impl->writePoints(index, points, pRGB);
+                out_modifiedNodeIndices.push_back(index);
+            }
+        }
+        for(int i=0; i < 8; ++i){
+            if(node.children[i] >= 0){
+                stack.push_back(node.children[i]);
+            }
+        }
+    }
+
+    if(numRemovedPoints > 0){
+        impl->numPoints -= numRemovedPoints;
+        impl->file.seekp(16);
+        writeValue(impl->file, impl->numPoints);
+        impl->file.flush();
+    }
+
+    if(!impl->file){
+        os << format("Writing \"%1%\" failed.") % impl->filename << endl;
+        impl->file.clear();
+        return false;
+    }
+    return true;
+}
+
+
+int64_t PointCloudOctreeImpl::removeSubtreePoints(int nodeIndex, vector<int>& out_modifiedNodeIndices)
+{
+    Node& node = nodes[nodeIndex];
+    int64_t n = node.numPoints;
+    if(n > 0){
+        node.numPoints = 0;
+        writeNumPoints(nodeIndex);
+        out_modifiedNodeIndices.push_back(nodeIndex);
+    }
+    for(int i=0; i < 8; ++i){
+        if(node.children[i] >= 0){
+            n += removeSubtreePoints(node.children[i], out_modifiedNodeIndices);
+        }
+    }
+    return n;
+}
+
+
+bool PointCloudOctree::findNearestPoint(const Vector3& point, double maxDistance, Vector3& out_nearestPoint)
+{
+    std::lock_guard<std::mutex> lock(impl->fileMutex);
+    auto& nodes = impl->nodes;
+    if(nodes.empty()){
+        return false;
+    }
+    const Vector3f p = point.cast<float>();
+    float minDistance = maxDistance;
+    bool found = false;
+    SgVertexArray points;
+    vector<int> stack;
+    stack.push_back(0);
+
+    while(!stack.empty()){
+        const int index = stack.back();
+        stack.pop_back();
+        const Node& node = nodes[index];
+        const Vector3f d = (node.min - p).cwiseMax(p - (node.min + Vector3f::Constant(node.size))).cwiseMax(0.0f);
+        if(d.norm() > minDistance){
+            continue;
+        }
+        if(node.numPoints > 0 && impl->readPoints(index, points, 0)){
+            for(auto& q : points){
+                const float distance = (q - p).norm();
+                if(distance <= minDistance){
+                    minDistance = distance;
+                    out_nearestPoint = q.cast<double>();
+                    found = true;
+                }
+            }
+        }
+        for(int i=0; i < 8; ++i){
+            if(node.children[i] >= 0){
+                stack.push_back(node.children[i]);
+            }
+        }
+    }
+
+    return found;
+}
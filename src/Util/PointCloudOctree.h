@@ -0,0 +1,98 @@
+/*!
+  @file
+*/
+
+#ifndef CNOID_UTIL_POINT_CLOUD_OCTREE_H
+#define CNOID_UTIL_POINT_CLOUD_OCTREE_H
+
+#include "SceneDrawables.h"
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <cstdint>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class PolyhedralRegion;
+class PointCloudOctreeImpl;
+
+/**
+   This class accesses a point cloud stored in an octree file without loading the whole cloud.
+   Each node of the octree has a spatially uniform subset of the points in its cell, and the
+   rest of the points are distributed to the child nodes. A coarse representation of a region
+   is given by the points of the upper nodes, and the details are added by the lower nodes.
+*/
+class CNOID_EXPORT PointCloudOctree
+{
+public:
+    /**
+       This function builds an octree file from a PCD file. The points are distributed into
+       temporary files in the directory of the octree file, so the size of the point cloud is
+       not limited by the memory.
+       \param maxNumNodePoints The maximum number of the points stored in a node
+    */
+    static bool build(const std::string& pcdFilename, const std::string& octreeFilename,
+                      std::ostream& os, int maxNumNodePoints = 20000);
+
+    PointCloudOctree();
+    ~PointCloudOctree();
+
+    bool open(const std::string& filename, std::ostream& os);
+    void close();
+    bool isOpen() const;
+    const std::string& filename() const;
+
+    struct Node {
+        Vector3f min;
+        float size;
+        int depth;
+        //! The index of a child is -1 when the child does not exist.
+        int children[8];
+        int numPoints;
+        int capacity;
+        int64_t dataOffset;
+        Vector3f center() const { return min + Vector3f::Constant(size / 2.0f); }
+    };
+
+    //! The first node is the root.
+    int numNodes() const;
+    const Node& node(int index) const;
+    int64_t numPoints() const;
+    bool hasColors() const;
+
+    /**
+       This function can be called from a thread other than the one modifying the octree.
+       The file access is serialized with the other functions accessing the file.
+    */
+    bool readPoints(int nodeIndex, SgVertexArray& out_points, SgColorArray* out_colors = 0);
+
+    /**
+       This function selects the nodes to render from the viewpoint. The nodes are selected in the
+       descending order of the ratio of the node size to the distance from the viewpoint until the
+       total number of the points exceeds the budget. A child node is not selected when its ratio
+       is smaller than minSizeRatio. The nodes outside of the view volume are not selected.
+       The view volume without any bounding plane does not cull any node.
+    */
+    void findVisibleNodes(const Vector3& viewpoint, const PolyhedralRegion& viewVolume,
+                          double minSizeRatio, int pointBudget, std::vector<int>& out_nodeIndices) const;
+
+    /**
+       This function removes the points in the region from the file.
+       The nodes that do not intersect with the region are not read.
+       \return false when the file cannot be written
+    */
+    bool removePoints(const PolyhedralRegion& region, std::vector<int>& out_modifiedNodeIndices, std::ostream& os);
+
+    bool findNearestPoint(const Vector3& point, double maxDistance, Vector3& out_nearestPoint);
+
+private:
+    PointCloudOctreeImpl* impl;
+
+    PointCloudOctree(const PointCloudOctree&) = delete;
+    PointCloudOctree& operator=(const PointCloudOctree&) = delete;
+};
+
+}
+
+#endif
@@ -4,10 +4,19 @@
 */
 
 #include "PointSetUtil.h"
-#include <cnoid/EasyScanner>
+#include "ThreadPool.h"
+#include "VoxelGrid.h"
+#include "DecimalNumber.h"
 #include <cnoid/Exception>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/format.hpp>
 #include <fstream>
+#include <sstream>
 #include <iomanip>
+#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
 
 using namespace std;
 using namespace boost;
@@ -15,7 +24,7 @@ using namespace cnoid;
 
 namespace {
 
-enum Element { E_X, E_Y, E_Z, E_NORMAL_X,E_NORMAL_Y, E_NORMAL_Z, E_RGB };
+enum Element { E_X, E_Y, E_Z, E_NORMAL_X,E_NORMAL_Y, E_NORMAL_Z, E_RGB, E_OTHER };
 
 typedef union {
     struct {
@@ -25,176 +34,847 @@ typedef union {
         unsigned char alpha;
     };
     float float_value;
+    uint32_t uint_value;
 } RGBValue;
 
+struct Field
+{
+    Element element;
+    int size;
+    char type;
+    int count;
+    int offset; // byte offset in a point record
+    int column; // index of the first value in an ascii line
+};
+
+struct Header
+{
+    vector<Field> fields;
+    int pointSize;
+    int numValuesPerPoint;
+    int numPoints;
+    string dataType;
+    size_t dataOffset;
+};
+
+// The minimum size of the ascii data assigned to a parsing thread
+const size_t minAsciiChunkSize = 1 << 20;
+
+
+void throwReadError(const string& filename, const string& message)
+{
+    throw file_read_error() << error_info_message(str(format("%1%: %2%") % filename % message));
+}
+
 
-void readPoints(SgPointSet* out_pointSet, EasyScanner& scanner, const std::vector<Element>& elements, int numPoints)
+Element getElement(const string& name)
 {
-    SgVertexArrayPtr vertices = new SgVertexArray();
-    vertices->reserve(numPoints);
+    if(name == "x"){
+        return E_X;
+    } else if(name == "y"){
+        return E_Y;
+    } else if(name == "z"){
+        return E_Z;
+    } else if(name == "normal_x"){
+        return E_NORMAL_X;
+    } else if(name == "normal_y"){
+        return E_NORMAL_Y;
+    } else if(name == "normal_z"){
+        return E_NORMAL_Z;
+    } else if(name == "rgb" || name == "rgba"){
+        return E_RGB;
+    }
+    return E_OTHER;
+}
 
-    const int numElements = elements.size();
 
+void readHeader(const char* data, size_t size, const string& filename, Header& header)
+{
+    vector<string> names;
+    vector<int> sizes;
+    vector<char> types;
+    vector<int> counts;
+    int width = -1;
+    int height = 1;
+    header.numPoints = -1;
+
+    size_t pos = 0;
+    while(pos < size){
+        size_t lineEnd = pos;
+        while(lineEnd < size && data[lineEnd] != '\n'){
+            ++lineEnd;
+        }
+        string line(data + pos, lineEnd - pos);
+        pos = (lineEnd < size) ? lineEnd + 1 : size;
+
+        size_t commentPos = line.find('#');
+        if(commentPos != string::npos){
+            line.resize(commentPos);
+        }
+        istringstream is(line);
+        string key;
+        if(!(is >> key)){
+            continue;
+        }
+        if(key == "FIELDS"){
+            string name;
+            while(is >> name){
+                names.push_back(name);
+            }
+        } else if(key == "SIZE"){
+            int value;
+            while(is >> value){
+                sizes.push_back(value);
+            }
+        } else if(key == "TYPE"){
+            char value;
+            while(is >> value){
+                types.push_back(value);
+            }
+        } else if(key == "COUNT"){
+            int value;
+            while(is >> value){
+                counts.push_back(value);
+            }
+        } else if(key == "WIDTH"){
+            is >> width;
+        } else if(key == "HEIGHT"){
+            is >> height;
+        } else if(key == "POINTS"){
+            if(!(is >> header.numPoints)){
+                throwReadError(filename, "The 'POINTS' field is not correctly specified.");
+            }
+        } else if(key == "DATA"){
+            if(!(is >> header.dataType)){
+                throwReadError(filename, "The 'DATA' field is not correctly specified.");
+            }
+            header.dataOffset = pos;
+            break;
+        }
+    }
+
+    if(header.dataType.empty()){
+        throwReadError(filename, "The 'DATA' field is not found.");
+    }
+    if(names.empty()){
+        throwReadError(filename, "The specification of field elements is not found.");
+    }
+    if(header.numPoints < 0){
+        if(width < 0){
+            throwReadError(filename, "The number of points is not specified.");
+        }
+        header.numPoints = width * height;
+    }
+
+    const bool isAscii = (header.dataType == "ascii");
+    if(!isAscii && (sizes.size() != names.size() || types.size() != names.size())){
+        throwReadError(filename, "The 'SIZE' or 'TYPE' field does not match the 'FIELDS' field.");
+    }
+
+    header.fields.resize(names.size());
+    header.pointSize = 0;
+    header.numValuesPerPoint = 0;
+    for(size_t i=0; i < names.size(); ++i){
+        Field& field = header.fields[i];
+        field.element = getElement(names[i]);
+        field.size = (i < sizes.size()) ? sizes[i] : 4;
+        field.type = (i < types.size()) ? types[i] : 'F';
+        field.count = (i < counts.size()) ? counts[i] : 1;
+        field.offset = header.pointSize;
+        field.column = header.numValuesPerPoint;
+        header.pointSize += field.size * field.count;
+        header.numValuesPerPoint += field.count;
+
+        if(!isAscii && field.element != E_OTHER){
+            bool isValidType =
+                (field.type == 'F' && (field.size == 4 || field.size == 8)) ||
+                ((field.type == 'U' || field.type == 'I') &&
+                 (field.size == 1 || field.size == 2 || field.size == 4 || field.size == 8));
+            if(!isValidType){
+                throwReadError(filename, str(format("The type of field \"%1%\" is not supported.") % names[i]));
+            }
+        }
+    }
+}
+
+
+/**
+   The output arrays of the points that are read from the data.
+   The points whose coordinates are not finite are skipped.
+*/
+struct PointBuffer
+{
+    SgVertexArrayPtr vertices;
     SgNormalArrayPtr normals;
-    bool hasNormals = false;
     SgColorArrayPtr colors;
-    bool hasColors = false;
-    for(int i=0; i < numElements; ++i){
-        Element element = elements[i];
-        if(element >= E_NORMAL_X && element <= E_NORMAL_Z){
-            hasNormals = true;
-            normals = new SgNormalArray();
-            normals->reserve(numPoints);
-        } else if(element == E_RGB){
-            hasColors = true;
-            colors = new SgColorArray();
+
+    PointBuffer(bool hasNormals, bool hasColors) {
+        vertices = new SgVertexArray;
+        if(hasNormals){
+            normals = new SgNormalArray;
+        }
+        if(hasColors){
+            colors = new SgColorArray;
+        }
+    }
+
+    void reserve(int n){
+        vertices->reserve(n);
+        if(normals){
+            normals->reserve(n);
+        }
+        if(colors){
+            colors->reserve(n);
+        }
+    }
+
+    void append(const Vector3f& vertex, const Vector3f& normal, const RGBValue& rgb){
+        if(std::isfinite(vertex.x()) && std::isfinite(vertex.y()) && std::isfinite(vertex.z())){
+            vertices->push_back(vertex);
+            if(normals){
+                normals->push_back(normal);
+            }
+            if(colors){
+                colors->push_back(Vector3f(rgb.red / 255.0, rgb.green / 255.0, rgb.blue / 255.0));
+            }
+        }
+    }
+
+    void append(const PointBuffer& buf){
+        const size_t offset = vertices->size();
+        const size_t n = buf.vertices->size();
+        vertices->resize(offset + n);
+        std::copy(buf.vertices->begin(), buf.vertices->end(), vertices->begin() + offset);
+        if(normals){
+            normals->resize(offset + n);
+            std::copy(buf.normals->begin(), buf.normals->end(), normals->begin() + offset);
+        }
+        if(colors){
+            colors->resize(offset + n);
+            std::copy(buf.colors->begin(), buf.colors->end(), colors->begin() + offset);
+        }
+    }
+};
+
+
+void setValue(Element element, double value, Vector3f& vertex, Vector3f& normal)
+{
+    switch(element){
+    case E_X: vertex.x() = value; break;
+    case E_Y: vertex.y() = value; break;
+    case E_Z: vertex.z() = value; break;
+    case E_NORMAL_X: normal.x() = value; break;
+    case E_NORMAL_Y: normal.y() = value; break;
+    case E_NORMAL_Z: normal.z() = value; break;
+    default: break;
+    }
+}
+
+
+inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+
+/**
+   This function parses a decimal number without calling strtod in most cases. The value
+   converted by DecimalNumber may differ from the correctly rounded one by a few units in the
+   last place of double, which does not matter because the values are stored in single precision.
+   The numbers such as "nan" are converted by strtod.
+*/
+bool parseDouble(const char*& p, const char* end, double& out_value)
+{
+    const char* start = p;
+    DecimalNumber number;
+    if(number.scan(p, end) && (p == end || isSpace(*p) || *p == '\n')){
+        if(number.toApproximateDouble(out_value)){
+            return true;
+        }
+    }
+
+    // The other numbers such as "nan" and "inf" are converted by strtod
+    p = start;
+    while(p < end && !isSpace(*p) && *p != '\n'){
+        ++p;
+    }
+    const size_t length = p - start;
+    if(length == 0 || length >= 64){
+        return false;
+    }
+    char buf[64];
+    memcpy(buf, start, length);
+    buf[length] = '\0';
+    char* endp;
+    out_value = strtod(buf, &endp);
+    return (endp == buf + length);
+}
+
+
+bool parseUnsignedInteger(const char*& p, const char* end, uint32_t& out_value)
+{
+    uint64_t value = 0;
+    const char* start = p;
+    while(p < end && *p >= '0' && *p <= '9'){
+        value = value * 10 + (*p - '0');
+        ++p;
+    }
+    out_value = static_cast<uint32_t>(value);
+    return p > start && (p == end || isSpace(*p) || *p == '\n');
+}
+
+
+/**
+   This function reads the lines between begin and end.
+   The lines that do not contain all the values of a point are skipped.
+*/
+void readAsciiPoints(const char* begin, const char* end, const Header& header, PointBuffer& buf)
+{
+    const int numValues = header.numValuesPerPoint;
+    vector<const Field*> columnFields(numValues);
+    for(auto& field : header.fields){
+        for(int i=0; i < field.count; ++i){
+            columnFields[field.column + i] = (field.element == E_OTHER || i > 0) ? nullptr : &field;
         }
     }
 
     Vector3f vertex = Vector3f::Zero();
     Vector3f normal = Vector3f::Zero();
-    Vector3f color = Vector3f::Zero();
     RGBValue rgb;
+    rgb.uint_value = 0;
 
-    while(!scanner.isEOF()){
-        scanner.skipBlankLines();
-
-        bool hasIllegalValue = false;
-        for(int i=0; i < numElements; ++i){
-            //double value = scanner.readDoubleEx("Illeagel point values");
-
-            if(!scanner.readDouble()){
-                // put warning here
-                hasIllegalValue = true;
-                scanner.skipToLineEnd();
+    const char* p = begin;
+    while(p < end){
+        bool isValid = true;
+        int numReadValues = 0;
+        while(true){
+            while(p < end && isSpace(*p)){
+                ++p;
+            }
+            if(p == end || *p == '\n'){
                 break;
-                    
+            }
+            if(numReadValues >= numValues){
+                isValid = false;
+                break;
+            }
+            const Field* field = columnFields[numReadValues++];
+            if(!field){
+                while(p < end && !isSpace(*p) && *p != '\n'){
+                    ++p;
+                }
+            } else if(field->element == E_RGB && field->type != 'F'){
+                if(!parseUnsignedInteger(p, end, rgb.uint_value)){
+                    isValid = false;
+                    break;
+                }
             } else {
-                double value = scanner.doubleValue;
-                switch(elements[i]){
-                case E_X: vertex.x() = value; break;
-                case E_Y: vertex.y() = value; break;
-                case E_Z: vertex.z() = value; break;
-                case E_NORMAL_X: normal.x() = value; break;
-                case E_NORMAL_Y: normal.y() = value; break;
-                case E_NORMAL_Z: normal.z() = value; break;
-                case E_RGB:
-                    rgb.float_value = value;
-                    color[0] = rgb.red / 255.0;
-                    color[1] = rgb.green / 255.0;
-                    color[2] = rgb.blue / 255.0;
+                double value;
+                if(!parseDouble(p, end, value)){
+                    isValid = false;
                     break;
                 }
+                if(field->element == E_RGB){
+                    rgb.float_value = value;
+                } else {
+                    setValue(field->element, value, vertex, normal);
+                }
             }
         }
-        if(!hasIllegalValue){
-            vertices->push_back(vertex);
-            if(hasNormals){
-                normals->push_back(normal);
+        if(isValid && numReadValues == numValues){
+            buf.append(vertex, normal, rgb);
+        }
+        while(p < end && *p != '\n'){
+            ++p;
+        }
+        if(p < end){
+            ++p;
+        }
+    }
+}
+
+
+void readAsciiData(const char* begin, const char* end, const Header& header, int numPointsToReserve, PointBuffer& out_buf)
+{
+    const size_t size = end - begin;
+    const int maxNumThreads = std::max(1u, std::thread::hardware_concurrency());
+    const int numChunks = std::max(1, std::min(maxNumThreads, static_cast<int>(size / minAsciiChunkSize)));
+
+    if(numChunks == 1){
+        out_buf.reserve(numPointsToReserve);
+        readAsciiPoints(begin, end, header, out_buf);
+        return;
+    }
+
+    // The data is divided at the line ends
+    vector<const char*> boundaries(numChunks + 1);
+    boundaries[0] = begin;
+    boundaries[numChunks] = end;
+    for(int i=1; i < numChunks; ++i){
+        const char* p = std::max(boundaries[i-1], begin + size * i / numChunks);
+        while(p < end && *p != '\n'){
+            ++p;
+        }
+        boundaries[i] = (p < end) ? p + 1 : end;
+    }
+
+    const bool hasNormals = out_buf.normals;
+    const bool hasColors = out_buf.colors;
+    vector<PointBuffer> buffers;
+    for(int i=0; i < numChunks; ++i){
+        buffers.emplace_back(hasNormals, hasColors);
+    }
+    {
+        ThreadPool threadPool(numChunks - 1);
+        for(int i=1; i < numChunks; ++i){
+            threadPool.start(
+                [&, i](){ readAsciiPoints(boundaries[i], boundaries[i+1], header, buffers[i]); });
+        }
+        readAsciiPoints(boundaries[0], boundaries[1], header, buffers[0]);
+        threadPool.wait();
+    }
+
+    size_t numPoints = 0;
+    for(auto& buf : buffers){
+        numPoints += buf.vertices->size();
+    }
+    out_buf.reserve(numPoints);
+    for(auto& buf : buffers){
+        out_buf.append(buf);
+    }
+}
+
+
+template<class T>
+inline double readBinaryValue(const char* p)
+{
+    T value;
+    memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+
+double readBinaryValue(const char* p, char type, int size)
+{
+    if(type == 'F'){
+        return (size == 4) ? readBinaryValue<float>(p) : readBinaryValue<double>(p);
+    } else if(type == 'U'){
+        switch(size){
+        case 1: return readBinaryValue<uint8_t>(p);
+        case 2: return readBinaryValue<uint16_t>(p);
+        case 4: return readBinaryValue<uint32_t>(p);
+        default: return readBinaryValue<uint64_t>(p);
+        }
+    } else {
+        switch(size){
+        case 1: return readBinaryValue<int8_t>(p);
+        case 2: return readBinaryValue<int16_t>(p);
+        case 4: return readBinaryValue<int32_t>(p);
+        default: return readBinaryValue<int64_t>(p);
+        }
+    }
+}
+
+
+/**
+   The values of a field are accessed with the address of the first point and the stride
+   so that both the point-major layout of the binary data and the field-major layout of
+   the compressed binary data are read in the same way.
+*/
+void readBinaryPoints
+(const Header& header, const vector<const char*>& fieldData, const vector<int>& strides,
+ int beginPoint, int endPoint, PointBuffer& buf)
+{
+    buf.reserve(endPoint - beginPoint);
+
+    // The common case where x, y and z are the single precision values
+    const Field* xyz[3] = { nullptr, nullptr, nullptr };
+    int xyzIndices[3] = { -1, -1, -1 };
+    for(size_t i=0; i < header.fields.size(); ++i){
+        const Field& field = header.fields[i];
+        if(field.element <= E_Z){
+            xyz[field.element] = &field;
+            xyzIndices[field.element] = i;
+        }
+    }
+    bool isFloatVertex = true;
+    for(int i=0; i < 3; ++i){
+        if(!xyz[i] || xyz[i]->type != 'F' || xyz[i]->size != 4){
+            isFloatVertex = false;
+        }
+    }
+
+    Vector3f vertex = Vector3f::Zero();
+    Vector3f normal = Vector3f::Zero();
+    RGBValue rgb;
+    rgb.uint_value = 0;
+
+    for(size_t i=beginPoint; i < static_cast<size_t>(endPoint); ++i){
+        if(isFloatVertex){
+            for(int j=0; j < 3; ++j){
+                const int k = xyzIndices[j];
+                memcpy(&vertex[j], fieldData[k] + i * strides[k], sizeof(float));
             }
-            if(hasColors){
-                colors->push_back(color);
+        }
+        for(size_t j=0; j < header.fields.size(); ++j){
+            const Field& field = header.fields[j];
+            if(field.element == E_OTHER || (isFloatVertex && field.element <= E_Z)){
+                continue;
+            }
+            const char* p = fieldData[j] + i * strides[j];
+            if(field.element == E_RGB){
+                memcpy(&rgb.uint_value, p, std::min(field.size, 4));
+            } else {
+                setValue(field.element, readBinaryValue(p, field.type, field.size), vertex, normal);
             }
         }
-        scanner.readLFEOF();
+        buf.append(vertex, normal, rgb);
     }
+}
 
-    if(vertices->empty()){
-        throw file_read_error() << error_info_message("No valid points");
-    } else {
-        out_pointSet->setVertices(vertices);
-        out_pointSet->setNormals(normals);
-        out_pointSet->normalIndices().clear();
-        out_pointSet->setColors(colors);
-        out_pointSet->colorIndices().clear();
+
+/**
+   The addresses of the first values of the fields and the strides between the points.
+   The compressed data is decompressed into the buffer of this object.
+*/
+struct BinaryFields
+{
+    vector<const char*> fieldData;
+    vector<int> strides;
+    vector<char> decompressedData;
+};
+
+
+void getBinaryFields(const char* begin, const char* end, const Header& header, const string& filename, BinaryFields& fields)
+{
+    if(static_cast<size_t>(end - begin) < static_cast<size_t>(header.numPoints) * header.pointSize){
+        throwReadError(filename, "The binary point data is truncated.");
+    }
+    const size_t numFields = header.fields.size();
+    fields.fieldData.resize(numFields);
+    fields.strides.assign(numFields, header.pointSize);
+    for(size_t i=0; i < numFields; ++i){
+        fields.fieldData[i] = begin + header.fields[i].offset;
     }
 }
 
+
+/**
+   This function decompresses the data compressed in the LZF format.
+   \return The size of the decompressed data or zero when the data is corrupted.
+*/
+size_t decompressLZF(const unsigned char* in, size_t inSize, unsigned char* out, size_t outSize)
+{
+    const unsigned char* ip = in;
+    const unsigned char* const inEnd = in + inSize;
+    unsigned char* op = out;
+    unsigned char* const outEnd = out + outSize;
+
+    while(ip < inEnd){
+        unsigned int ctrl = *ip++;
+        if(ctrl < (1 << 5)){
+            // literal run
+            ++ctrl;
+            if(op + ctrl > outEnd || ip + ctrl > inEnd){
+                return 0;
+            }
+            memcpy(op, ip, ctrl);
+            op += ctrl;
+            ip += ctrl;
+        } else {
+            // back reference
+            unsigned int len = ctrl >> 5;
+            if(len == 7){
+                if(ip >= inEnd){
+                    return 0;
+                }
+                len += *ip++;
+            }
+            if(ip >= inEnd){
+                return 0;
+            }
+            const unsigned char* ref = op - ((ctrl & 0x1f) << 8) - 1 - *ip++;
+            len += 2;
+            if(op + len > outEnd || ref < out){
+                return 0;
+            }
+            // The reference may overlap the output
+            for(unsigned int i=0; i < len; ++i){
+                *op++ = *ref++;
+            }
+        }
+    }
+    return op - out;
 }
 
 
-void cnoid::loadPCD(SgPointSet* out_pointSet, const std::string& filename)
+/**
+   This function compresses the data in the LZF format.
+   The capacity of the output buffer must be at least inSize + inSize / 32 + 1.
+*/
+size_t compressLZF(const unsigned char* in, size_t inSize, unsigned char* out)
 {
-    try {
-        EasyScanner scanner(filename);
-        scanner.setCommentChar('#');
+    const int hashLog = 16;
+    const size_t maxOffset = 1 << 13;
+    const size_t maxLength = (1 << 8) + (1 << 3) + 1;
+    vector<uint32_t> hashTable(1 << hashLog, 0);
 
-        int numPoints = 0;
+    size_t ip = 0;
+    size_t op = 0;
+    size_t literalStart = 0;
 
-        std::vector<Element> elements;
+    auto flushLiterals = [&](size_t pos){
+        while(literalStart < pos){
+            const size_t n = std::min(static_cast<size_t>(32), pos - literalStart);
+            out[op++] = n - 1;
+            memcpy(out + op, in + literalStart, n);
+            op += n;
+            literalStart += n;
+        }
+    };
 
-        while(true){
-            scanner.skipBlankLines();
-            scanner.readWordEx("Illegal header key");
-
-            if(scanner.stringValue == "FIELDS"){
-                while(scanner.readWord()){
-                    if(scanner.stringValue == "x"){
-                        elements.push_back(E_X);
-                    } else if(scanner.stringValue == "y"){
-                        elements.push_back(E_Y);
-                    } else if(scanner.stringValue == "z"){
-                        elements.push_back(E_Z);
-                    } else if(scanner.stringValue == "normal_x"){
-                        elements.push_back(E_NORMAL_X);
-                    } else if(scanner.stringValue == "normal_y"){
-                        elements.push_back(E_NORMAL_Y);
-                    } else if(scanner.stringValue == "normal_z"){
-                        elements.push_back(E_NORMAL_Z);
-                    } else if(scanner.stringValue == "rgb"){
-                        elements.push_back(E_RGB);
-                    }
+    while(ip + 3 <= inSize){
+        const uint32_t v = (in[ip] << 16) | (in[ip + 1] << 8) | in[ip + 2];
+        const uint32_t h = ((v * 2654435761u) >> (32 - hashLog));
+        const uint32_t candidate = hashTable[h];
+        hashTable[h] = ip + 1;
+        if(candidate > 0){
+            const size_t ref = candidate - 1;
+            const size_t distance = ip - ref;
+            if(distance <= maxOffset &&
+               in[ref] == in[ip] && in[ref + 1] == in[ip + 1] && in[ref + 2] == in[ip + 2]){
+                size_t len = 3;
+                const size_t maxLen = std::min(maxLength - 1, inSize - ip);
+                while(len < maxLen && in[ref + len] == in[ip + len]){
+                    ++len;
                 }
-            } else if(scanner.stringValue == "POINTS"){
-                numPoints = scanner.readIntEx("The 'POINTS' field is not correctly specified.");
-            } else if(scanner.stringValue == "DATA"){
-                scanner.readWordEx("The 'DATA' field is not correctly specified.");
-                if(scanner.stringValue == "ascii"){
-                    scanner.readLFex();
-                    if(elements.empty()){
-                        scanner.throwException("The specification of field elements is not found.");
-                    }
-                    readPoints(out_pointSet, scanner, elements, numPoints);
-                    break;
+                flushLiterals(ip);
+                const size_t offset = distance - 1;
+                const size_t code = len - 2;
+                if(code < 7){
+                    out[op++] = (code << 5) | (offset >> 8);
                 } else {
-                    scanner.throwException("The 'ascii' format is only supported for the point DATA.");
+                    out[op++] = (7 << 5) | (offset >> 8);
+                    out[op++] = code - 7;
                 }
-            } else {
-                scanner.skipToLineEnd();
+                out[op++] = offset & 0xff;
+                ip += len;
+                literalStart = ip;
+                continue;
+            }
+        }
+        ++ip;
+    }
+    flushLiterals(inSize);
+
+    return op;
+}
+
+
+void getCompressedBinaryFields
+(const char* begin, const char* end, const Header& header, const string& filename, BinaryFields& fields)
+{
+    uint32_t compressedSize;
+    uint32_t uncompressedSize;
+    if(end - begin < 8){
+        throwReadError(filename, "The compressed point data is truncated.");
+    }
+    memcpy(&compressedSize, begin, 4);
+    memcpy(&uncompressedSize, begin + 4, 4);
+    begin += 8;
+    if(static_cast<size_t>(end - begin) < compressedSize){
+        throwReadError(filename, "The compressed point data is truncated.");
+    }
+    const size_t dataSize = static_cast<size_t>(header.numPoints) * header.pointSize;
+    if(uncompressedSize != dataSize){
+        throwReadError(filename, "The size of the compressed point data does not match the number of points.");
+    }
+
+    vector<char>& data = fields.decompressedData;
+    data.resize(dataSize);
+    if(dataSize > 0 &&
+       decompressLZF(reinterpret_cast<const unsigned char*>(begin), compressedSize,
+                     reinterpret_cast<unsigned char*>(&data[0]), dataSize) != dataSize){
+        throwReadError(filename, "The compressed point data is corrupted.");
+    }
+
+    // The values are stored field by field
+    const size_t numFields = header.fields.size();
+    fields.fieldData.resize(numFields);
+    fields.strides.resize(numFields);
+    for(size_t i=0; i < numFields; ++i){
+        const Field& field = header.fields[i];
+        fields.fieldData[i] = data.data() + static_cast<size_t>(header.numPoints) * field.offset;
+        fields.strides[i] = field.size * field.count;
+    }
+}
+
+
+/**
+   The file is mapped into the memory so that only the pages that are being read are loaded.
+*/
+class PCDFile
+{
+public:
+    string filename;
+    iostreams::mapped_file_source file;
+    Header header;
+    const char* data;
+    const char* end;
+    bool hasNormals;
+    bool hasColors;
+    BinaryFields binaryFields;
+
+    PCDFile(const string& filename)
+        : filename(filename)
+    {
+        try {
+            file.open(filename);
+        } catch(const std::exception& ex){
+            throwReadError(filename, ex.what());
+        }
+        if(!file.is_open()){
+            throwReadError(filename, "The file cannot be opened.");
+        }
+        const char* begin = file.data();
+        end = begin + file.size();
+        readHeader(begin, file.size(), filename, header);
+        data = begin + header.dataOffset;
+
+        hasNormals = false;
+        hasColors = false;
+        for(auto& field : header.fields){
+            if(field.element >= E_NORMAL_X && field.element <= E_NORMAL_Z){
+                hasNormals = true;
+            } else if(field.element == E_RGB){
+                hasColors = true;
             }
-            scanner.readLFEOFex("The field value is not correctly specified.");
         }
-    } catch(EasyScanner::Exception& ex){
-        throw file_read_error() << error_info_message(ex.getFullMessage());
+
+        if(header.dataType == "binary"){
+            getBinaryFields(data, end, header, filename, binaryFields);
+        } else if(header.dataType == "binary_compressed"){
+            getCompressedBinaryFields(data, end, header, filename, binaryFields);
+        } else if(header.dataType != "ascii"){
+            throwReadError(filename, str(format("The '%1%' format of the point DATA is not supported.") % header.dataType));
+        }
     }
+
+    bool isAscii() const { return header.dataType == "ascii"; }
+
+    void readBinaryPoints(int beginPoint, int endPoint, PointBuffer& buf){
+        ::readBinaryPoints(header, binaryFields.fieldData, binaryFields.strides, beginPoint, endPoint, buf);
+    }
+};
+
 }
 
 
-void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Affine3& viewpoint)
+void cnoid::loadPCD(SgPointSet* out_pointSet, const std::string& filename)
+{
+    PCDFile pcd(filename);
+    PointBuffer buf(pcd.hasNormals, pcd.hasColors);
+
+    if(pcd.isAscii()){
+        readAsciiData(pcd.data, pcd.end, pcd.header, pcd.header.numPoints, buf);
+    } else {
+        pcd.readBinaryPoints(0, pcd.header.numPoints, buf);
+    }
+
+    if(buf.vertices->empty()){
+        throw file_read_error() << error_info_message("No valid points");
+    } else {
+        out_pointSet->setVertices(buf.vertices);
+        out_pointSet->setNormals(buf.normals);
+        out_pointSet->normalIndices().clear();
+        out_pointSet->setColors(buf.colors);
+        out_pointSet->colorIndices().clear();
+    }
+}
+
+
+void cnoid::readPCDInChunks
+(const std::string& filename, int numPointsPerChunk, std::function<void(SgPointSet* chunk)> callback)
+{
+    PCDFile pcd(filename);
+    const int numPoints = pcd.header.numPoints;
+    SgPointSetPtr chunk = new SgPointSet;
+
+    auto output = [&](PointBuffer& buf){
+        if(!buf.vertices->empty()){
+            chunk->setVertices(buf.vertices);
+            chunk->setNormals(buf.normals);
+            chunk->setColors(buf.colors);
+            callback(chunk);
+        }
+    };
+
+    if(!pcd.isAscii()){
+        for(int i=0; i < numPoints; i += numPointsPerChunk){
+            PointBuffer buf(pcd.hasNormals, pcd.hasColors);
+            pcd.readBinaryPoints(i, std::min(numPoints, i + numPointsPerChunk), buf);
+            output(buf);
+        }
+    } else {
+        // The data is divided at the line ends by the average size of the lines
+        const size_t dataSize = pcd.end - pcd.data;
+        const size_t chunkSize =
+            std::max(static_cast<size_t>(1), dataSize / std::max(1, numPoints)) * numPointsPerChunk;
+        const char* p = pcd.data;
+        while(p < pcd.end){
+            const char* chunkEnd = (static_cast<size_t>(pcd.end - p) > chunkSize) ? p + chunkSize : pcd.end;
+            while(chunkEnd < pcd.end && *chunkEnd != '\n'){
+                ++chunkEnd;
+            }
+            if(chunkEnd < pcd.end){
+                ++chunkEnd;
+            }
+            PointBuffer buf(pcd.hasNormals, pcd.hasColors);
+            readAsciiData(p, chunkEnd, pcd.header, numPointsPerChunk, buf);
+            output(buf);
+            p = chunkEnd;
+        }
+    }
+}
+
+
+void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Affine3& viewpoint, int dataType)
 {
     if(!pointSet->hasVertices()){
         throw empty_data_error() << error_info_message("Empty pointset");
     }
 
+    bool hasNormals = pointSet->hasNormals() && pointSet->normalIndices().empty();
     bool hasColors = pointSet->hasColors() && pointSet->colorIndices().empty();
 
     ofstream ofs;
-    ofs.open(filename.c_str());
+    ofs.open(filename.c_str(), ios::out | ios::binary);
     ofs << scientific << setprecision(9);
 
+    const int numFields = 3 + (hasNormals ? 3 : 0) + (hasColors ? 1 : 0);
+
     ofs << "# .PCD v.7 - Point Cloud Data file format\n";
     ofs << "VERSION .7\n";
+    ofs << "FIELDS x y z";
+    if(hasNormals){
+        ofs << " normal_x normal_y normal_z";
+    }
     if(hasColors){
-        ofs << "FIELDS x y z rgb\n";
-        ofs << "SIZE 4 4 4 4\n";
-        ofs << "TYPE F F F F\n";
-        ofs << "COUNT 1 1 1 1\n";
-    } else {
-        ofs << "FIELDS x y z\n";
-        ofs << "SIZE 4 4 4\n";
-        ofs << "TYPE F F F\n";
-        ofs << "COUNT 1 1 1\n";
+        ofs << " rgb";
     }
+    ofs << "\nSIZE";
+    for(int i=0; i < numFields; ++i){
+        ofs << " 4";
+    }
+    ofs << "\nTYPE";
+    for(int i=0; i < numFields; ++i){
+        ofs << " F";
+    }
+    ofs << "\nCOUNT";
+    for(int i=0; i < numFields; ++i){
+        ofs << " 1";
+    }
+    ofs << "\n";
 
     const SgVertexArray& points = *pointSet->vertices();
     const int numPoints = points.size();
@@ -208,27 +888,81 @@ void cnoid::savePCD(SgPointSet* pointSet, const std::string& filename, const Aff
     ofs << q.w() << " " << q.x() << " " << q.y() << " " << q.z() << "\n";
 
     ofs << "POINTS " << numPoints << "\n";
-    
-    ofs << "DATA ascii\n";
 
-    if(hasColors){
-        RGBValue rgb;
-        rgb.alpha = 0.0;
-        const SgColorArray& colors = *pointSet->colors();
-        for(int i=0; i < numPoints; ++i){
-            const Vector3f& p = points[i];
-            const Vector3f& c = colors[i];
+    // The values of each point
+    vector<float> values(static_cast<size_t>(numPoints) * numFields);
+    const SgNormalArray* normals = hasNormals ? pointSet->normals() : nullptr;
+    const SgColorArray* colors = hasColors ? pointSet->colors() : nullptr;
+    RGBValue rgb;
+    rgb.alpha = 0.0;
+    for(int i=0; i < numPoints; ++i){
+        float* v = &values[static_cast<size_t>(i) * numFields];
+        const Vector3f& p = points[i];
+        *v++ = p.x();
+        *v++ = p.y();
+        *v++ = p.z();
+        if(hasNormals){
+            const Vector3f& n = (*normals)[i];
+            *v++ = n.x();
+            *v++ = n.y();
+            *v++ = n.z();
+        }
+        if(hasColors){
+            const Vector3f& c = (*colors)[i];
             rgb.red = (unsigned char)(255.0 * c[0]);
             rgb.green = (unsigned char)(255.0 * c[1]);
             rgb.blue = (unsigned char)(255.0 * c[2]);
-            ofs << p.x() << " " << p.y() << " " << p.z() << " " << rgb.float_value << "\n";
+            *v++ = rgb.float_value;
+        }
+    }
+
+    if(dataType == PCD_BINARY){
+        ofs << "DATA binary\n";
+        ofs.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float));
+
+    } else if(dataType == PCD_BINARY_COMPRESSED){
+        ofs << "DATA binary_compressed\n";
+        // The values are rearranged field by field to be compressed efficiently
+        vector<float> fieldMajorValues(values.size());
+        for(int i=0; i < numPoints; ++i){
+            for(int j=0; j < numFields; ++j){
+                fieldMajorValues[static_cast<size_t>(j) * numPoints + i] = values[static_cast<size_t>(i) * numFields + j];
+            }
         }
+        const size_t size = fieldMajorValues.size() * sizeof(float);
+        vector<unsigned char> compressed(size + size / 32 + 1);
+        const uint32_t compressedSize =
+            compressLZF(reinterpret_cast<const unsigned char*>(fieldMajorValues.data()), size, compressed.data());
+        const uint32_t uncompressedSize = size;
+        ofs.write(reinterpret_cast<const char*>(&compressedSize), 4);
+        ofs.write(reinterpret_cast<const char*>(&uncompressedSize), 4);
+        ofs.write(reinterpret_cast<const char*>(compressed.data()), compressedSize);
+
     } else {
+        ofs << "DATA ascii\n";
         for(int i=0; i < numPoints; ++i){
-            const Vector3f& p = points[i];
-            ofs << p.x() << " " << p.y() << " " << p.z() << "\n";
+            const float* v = &values[static_cast<size_t>(i) * numFields];
+            ofs << v[0];
+            for(int j=1; j < numFields; ++j){
+                ofs << " " << v[j];
+            }
+            ofs << "\n";
         }
     }
 
     ofs.close();
 }
+
+
+SgPointSet* cnoid::voxelDownsample(const SgPointSet* pointSet, double voxelSize)
+{
+    VoxelGrid grid(voxelSize);
+    grid.addPoints(*pointSet);
+
+    SgPointSet* downsampled = new SgPointSet;
+    if(!grid.empty()){
+        SgColorArray* colors = grid.hasColors() ? downsampled->getOrCreateColors() : 0;
+        grid.getCentroids(*downsampled->getOrCreateVertices(), colors);
+    }
+    return downsampled;
+}
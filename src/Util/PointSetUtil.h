@@ -7,12 +7,35 @@
 #define CNOID_UTIL_POINT_SET_UTIL_H
 
 #include <cnoid/SceneDrawables>
+#include <functional>
 #include "exportdecl.h"
 
 namespace cnoid {
 
+/**
+   The ascii, binary and binary_compressed data formats of the PCD files are supported.
+   The points whose coordinates are not finite are skipped.
+*/
 CNOID_EXPORT void loadPCD(SgPointSet* out_pointSet, const std::string& filename);
-CNOID_EXPORT void savePCD(SgPointSet* pointSet, const std::string& filename, const Affine3d& viewpoint = Affine3d::Identity());
+
+/**
+   This function reads the points of a PCD file in chunks so that a file larger than the memory
+   can be processed. The callback function is called with each chunk, which has about the given
+   number of points. The data of the binary_compressed format is decompressed at once.
+*/
+CNOID_EXPORT void readPCDInChunks(
+    const std::string& filename, int numPointsPerChunk, std::function<void(SgPointSet* chunk)> callback);
+
+enum PCDDataType { PCD_ASCII, PCD_BINARY, PCD_BINARY_COMPRESSED };
+
+CNOID_EXPORT void savePCD(SgPointSet* pointSet, const std::string& filename, const Affine3d& viewpoint = Affine3d::Identity(),
+                          int dataType = PCD_ASCII);
+
+/**
+   This function merges the points in each cubic cell of the given size into their centroid.
+   The colors of the merged points are averaged.
+*/
+CNOID_EXPORT SgPointSet* voxelDownsample(const SgPointSet* pointSet, double voxelSize);
 
 }
 
@@ -96,6 +96,20 @@ public:
         }
     }
 
+    /**
+       \return The id of the type whose function is applied to the objects of the given type,
+       or -1 if no function is applied to them.
+    */
+    int findFunctionTypeId(int id) const {
+        while(id >= 0){
+            if(id < static_cast<int>(isFixed.size()) && isFixed[id]){
+                return id;
+            }
+            id = ObjectBase::findSuperTypePolymorphicId(id);
+        }
+        return -1;
+    }
+
     inline void dispatch(ObjectBase* obj){
         const int id = obj->polymorhicId();
         if(id >= static_cast<int>(dispatchTable.size())){
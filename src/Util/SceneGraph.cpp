@@ -6,6 +6,8 @@
 #include "SceneGraph.h"
 #include "Exception.h"
 #include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
 #include <typeindex>
 #include <mutex>
 
@@ -101,8 +103,11 @@ void SgObject::onUpdated(SgUpdate& update)
 {
     update.push(this);
     sigUpdated_(update);
+    auto transaction = update.transaction;
     for(const_parentIter p = parents.begin(); p != parents.end(); ++p){
-        (*p)->onUpdated(update);
+        if(!transaction || transaction->checkPropagation(*p)){
+            (*p)->onUpdated(update);
+        }
     }
     update.pop();
 }
@@ -459,6 +464,94 @@ void SgGroup::throwTypeMismatchError()
 }
 
 
+SgUpdateTransaction::SgUpdateTransaction(int action)
+    : update(action)
+{
+
+}
+
+
+SgUpdateTransaction::~SgUpdateTransaction()
+{
+
+}
+
+
+void SgUpdateTransaction::commit()
+{
+    if(nodes.empty()){
+        return;
+    }
+
+    auto& sorted = sortedNodesAndGroups;
+    sorted.assign(nodes.begin(), nodes.end());
+    std::sort(sorted.begin(), sorted.end());
+    auto uniqueEnd = std::unique(sorted.begin(), sorted.end());
+    if(uniqueEnd != sorted.end()){
+        // Each node is notified once even if it is added more than once
+        sorted.erase(uniqueEnd, sorted.end());
+        std::unordered_set<SgNode*> addedNodes;
+        auto p = std::remove_if(
+            nodes.begin(), nodes.end(), [&](SgNode* node){ return !addedNodes.insert(node).second; });
+        nodes.erase(p, nodes.end());
+    }
+
+    groups.clear();
+    SgObject* lastParent = nullptr;
+    for(auto& node : nodes){
+        for(auto p = node->parentBegin(); p != node->parentEnd(); ++p){
+            if(*p != lastParent){
+                groups.push_back(*p);
+                lastParent = *p;
+            }
+        }
+    }
+    std::sort(groups.begin(), groups.end());
+    groups.erase(std::unique(groups.begin(), groups.end()), groups.end());
+    auto p = std::remove_if(
+        groups.begin(), groups.end(),
+        [&](SgObject* group){ return std::binary_search(sorted.begin(), sorted.end(), group); });
+    groups.erase(p, groups.end());
+    const size_t numNodes = sorted.size();
+    sorted.insert(sorted.end(), groups.begin(), groups.end());
+    std::inplace_merge(sorted.begin(), sorted.begin() + numNodes, sorted.end());
+
+    /*
+      The nodes and their parent groups are excluded from the propagation so that the update
+      of each node stops at the node itself, and the update of each group is propagated to
+      the ancestors that have not been notified yet.
+    */
+    notifiedAncestors.clear();
+    update.transaction = this;
+    for(auto& node : nodes){
+        update.clear();
+        node->onUpdated(update);
+    }
+    for(auto& group : groups){
+        update.clear();
+        group->onUpdated(update);
+    }
+    update.transaction = nullptr;
+    update.clear();
+
+    nodes.clear();
+    groups.clear();
+}
+
+
+bool SgUpdateTransaction::checkPropagation(SgObject* object)
+{
+    if(std::binary_search(sortedNodesAndGroups.begin(), sortedNodesAndGroups.end(), object)){
+        return false;
+    }
+    if(std::find(notifiedAncestors.begin(), notifiedAncestors.end(), object) != notifiedAncestors.end()){
+        return false;
+    }
+    notifiedAncestors.push_back(object);
+    return true;
+}
+
+
 SgInvariantGroup::SgInvariantGroup()
     : SgGroup(findPolymorphicId<SgInvariantGroup>())
 {
@@ -18,6 +18,7 @@ namespace cnoid {
 
 class SgObject;
 typedef ref_ptr<SgObject> SgObjectPtr;
+class SgUpdateTransaction;
 
 class CNOID_EXPORT SgUpdate
 {
@@ -32,8 +33,8 @@ public:
 
     typedef std::vector<SgObject*> Path;
         
-    SgUpdate() : action_(MODIFIED) { path_.reserve(16); }
-    SgUpdate(int action) : action_(action) { path_.reserve(16); }
+    SgUpdate() : action_(MODIFIED), transaction(nullptr) { path_.reserve(16); }
+    SgUpdate(int action) : action_(action), transaction(nullptr) { path_.reserve(16); }
     virtual ~SgUpdate();
     int action() const { return action_; }
     bool isModified() const { return (action_ & MODIFIED) ? true:false; }
@@ -46,6 +47,12 @@ public:
 private:
     Path path_;
     int action_;
+
+    // The transaction that is notifying the update
+    SgUpdateTransaction* transaction;
+
+    friend class SgObject;
+    friend class SgUpdateTransaction;
 };
 
 
@@ -130,6 +137,8 @@ private:
     ParentContainer parents;
     Signal<void(const SgUpdate& update)> sigUpdated_;
     Signal<void(bool on)> sigGraphConnection_;
+
+    friend class SgUpdateTransaction;
 };
 
 
@@ -274,6 +283,43 @@ private:
 typedef ref_ptr<SgGroup> SgGroupPtr;
 
 
+/**
+   This class collects the nodes updated at the same time and notifies their updates at once.
+   Each collected node emits its own update, and the update is then propagated to the upper
+   nodes only once from each group that directly contains the collected nodes, instead of
+   once per collected node.
+   \note The collected nodes must not be deleted until the transaction is committed.
+*/
+class CNOID_EXPORT SgUpdateTransaction
+{
+public:
+    SgUpdateTransaction(int action = SgUpdate::MODIFIED);
+    ~SgUpdateTransaction();
+
+    int action() const { return update.action(); }
+    void setAction(int action) { update.setAction(action); }
+
+    void add(SgNode* node) { nodes.push_back(node); }
+    bool empty() const { return nodes.empty(); }
+    void clear() { nodes.clear(); }
+    void commit();
+
+private:
+    SgUpdate update;
+    std::vector<SgNode*> nodes;
+    std::vector<SgObject*> groups;
+    std::vector<SgObject*> sortedNodesAndGroups;
+    std::vector<SgObject*> notifiedAncestors;
+
+    SgUpdateTransaction(const SgUpdateTransaction&) = delete;
+    SgUpdateTransaction& operator=(const SgUpdateTransaction&) = delete;
+
+    bool checkPropagation(SgObject* object);
+    
+    friend class SgObject;
+};
+
+
 class CNOID_EXPORT SgInvariantGroup : public SgGroup
 {
 public:
@@ -0,0 +1,1049 @@
+/*!
+  @file
+*/
+
+#include "ScenePicker.h"
+#include "SceneDrawables.h"
+#include "SceneEffects.h"
+#include <Eigen/StdVector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <memory>
+#include <limits>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const int MaxNumLeafPrimitives = 4;
+const float inf = std::numeric_limits<float>::infinity();
+
+struct Bounds
+{
+    Vector3f min;
+    Vector3f max;
+
+    void clear(){
+        min.setConstant(inf);
+        max.setConstant(-inf);
+    }
+    bool empty() const {
+        return min.x() > max.x();
+    }
+    void expandBy(const Vector3f& p){
+        min = min.cwiseMin(p);
+        max = max.cwiseMax(p);
+    }
+    void expandBy(const Bounds& b){
+        min = min.cwiseMin(b.min);
+        max = max.cwiseMax(b.max);
+    }
+};
+
+typedef vector<Bounds, Eigen::aligned_allocator<Bounds>> BoundsArray;
+
+
+/**
+   The entry distance is returned by out_tmin. The components of the inverse direction may be
+   infinite, and NaN given by them is ignored by the order of the arguments of std::max and std::min.
+*/
+inline bool intersectBox
+(const Bounds& b, float margin, const Vector3f& origin, const Vector3f& invDirection, float tmax, float& out_tmin)
+{
+    float t0 = 0.0f;
+    float t1 = tmax;
+    for(int i=0; i < 3; ++i){
+        float tNear = (b.min[i] - margin - origin[i]) * invDirection[i];
+        float tFar = (b.max[i] + margin - origin[i]) * invDirection[i];
+        if(tNear > tFar){
+            std::swap(tNear, tFar);
+        }
+        t0 = std::max(t0, tNear);
+        t1 = std::min(t1, tFar);
+        if(t0 > t1){
+            return false;
+        }
+    }
+    out_tmin = t0;
+    return true;
+}
+
+
+class Bvh
+{
+public:
+    struct Node {
+        Bounds bounds;
+        //! The index of the first child. The second child follows it. This is -1 for a leaf.
+        int child;
+        int begin;
+        int end;
+    };
+    vector<Node, Eigen::aligned_allocator<Node>> nodes;
+    vector<int> primitiveIndices;
+
+    void build(const BoundsArray& primitiveBounds);
+    void refit(const BoundsArray& primitiveBounds);
+
+    const Bounds& bounds() const { return nodes.front().bounds; }
+
+    /**
+       The function to test a primitive receives the primitive index and the current maximum
+       distance, which should be shortened when the primitive is hit.
+    */
+    template<class TestFunction>
+    void traverse(const Vector3f& origin, const Vector3f& direction, float margin, float& io_tmax,
+                  TestFunction testPrimitive) const;
+
+private:
+    void buildNode(int nodeIndex, int begin, int end,
+                   const BoundsArray& primitiveBounds, const vector<Vector3f>& centers);
+};
+
+
+void Bvh::build(const BoundsArray& primitiveBounds)
+{
+    nodes.clear();
+    const int n = primitiveBounds.size();
+    primitiveIndices.resize(n);
+    if(n == 0){
+        return;
+    }
+    vector<Vector3f> centers(n);
+    for(int i=0; i < n; ++i){
+        primitiveIndices[i] = i;
+        centers[i] = (primitiveBounds[i].min + primitiveBounds[i].max) * 0.5f;
+    }
+    nodes.reserve(2 * (n / MaxNumLeafPrimitives) + 1);
+    nodes.push_back(Node());
+    buildNode(0, 0, n, primitiveBounds, centers);
+}
+
+
+void Bvh::buildNode
+(int nodeIndex, int begin, int end, const BoundsArray& primitiveBounds, const vector<Vector3f>& centers)
+{
+    Bounds bounds;
+    Bounds centerBounds;
+    bounds.clear();
+    centerBounds.clear();
+    for(int i=begin; i < end; ++i){
+        const int index = primitiveIndices[i];
+        bounds.expandBy(primitiveBounds[index]);
+        centerBounds.expandBy(centers[index]);
+    }
+    Node& node = nodes[nodeIndex];
+    node.bounds = bounds;
+    node.begin = begin;
+    node.end = end;
+
+    if(end - begin <= MaxNumLeafPrimitives){
+        node.child = -1;
+        return;
+    }
+
+    int axis;
+    (centerBounds.max - centerBounds.min).maxCoeff(&axis);
+    const int mid = (begin + end) / 2;
+    std::nth_element(
+        primitiveIndices.begin() + begin, primitiveIndices.begin() + mid, primitiveIndices.begin() + end,
+        [&](int i, int j){ return centers[i][axis] < centers[j][axis]; });
+
+    const int child = nodes.size();
+    node.child = child;
+    nodes.push_back(Node());
+    nodes.push_back(Node());
+    buildNode(child, begin, mid, primitiveBounds, centers);
+    buildNode(child + 1, mid, end, primitiveBounds, centers);
+}
+
+
+void Bvh::refit(const BoundsArray& primitiveBounds)
+{
+    // The children are always stored after their parent
+    for(int i = nodes.size() - 1; i >= 0; --i){
+        Node& node = nodes[i];
+        if(node.child < 0){
+            node.bounds.clear();
+            for(int j = node.begin; j < node.end; ++j){
+                node.bounds.expandBy(primitiveBounds[primitiveIndices[j]]);
+            }
+        } else {
+            node.bounds = nodes[node.child].bounds;
+            node.bounds.expandBy(nodes[node.child + 1].bounds);
+        }
+    }
+}
+
+
+template<class TestFunction>
+void Bvh::traverse
+(const Vector3f& origin, const Vector3f& direction, float margin, float& io_tmax, TestFunction testPrimitive) const
+{
+    if(nodes.empty()){
+        return;
+    }
+    const Vector3f invDirection = direction.cwiseInverse();
+    float tmin;
+    if(!intersectBox(nodes[0].bounds, margin, origin, invDirection, io_tmax, tmin)){
+        return;
+    }
+    int stack[64];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while(stackSize > 0){
+        const Node& node = nodes[stack[--stackSize]];
+        if(!intersectBox(node.bounds, margin, origin, invDirection, io_tmax, tmin)){
+            continue;
+        }
+        if(node.child < 0){
+            for(int i = node.begin; i < node.end; ++i){
+                testPrimitive(primitiveIndices[i], io_tmax);
+            }
+        } else {
+            float t0, t1;
+            const bool hit0 = intersectBox(nodes[node.child].bounds, margin, origin, invDirection, io_tmax, t0);
+            const bool hit1 = intersectBox(nodes[node.child + 1].bounds, margin, origin, invDirection, io_tmax, t1);
+            // The nearer child is visited first
+            if(hit0 && hit1){
+                if(t0 <= t1){
+                    stack[stackSize++] = node.child + 1;
+                    stack[stackSize++] = node.child;
+                } else {
+                    stack[stackSize++] = node.child;
+                    stack[stackSize++] = node.child + 1;
+                }
+            } else if(hit0){
+                stack[stackSize++] = node.child;
+            } else if(hit1){
+                stack[stackSize++] = node.child + 1;
+            }
+        }
+    }
+}
+
+
+inline bool intersectTriangle
+(const Vector3f& origin, const Vector3f& direction,
+ const Vector3f& v0, const Vector3f& v1, const Vector3f& v2, float& out_t)
+{
+    const Vector3f e1 = v1 - v0;
+    const Vector3f e2 = v2 - v0;
+    const Vector3f p = direction.cross(e2);
+    const float det = e1.dot(p);
+    if(det == 0.0f){
+        return false;
+    }
+    const float invDet = 1.0f / det;
+    const Vector3f s = origin - v0;
+    const float u = s.dot(p) * invDet;
+    if(u < 0.0f || u > 1.0f){
+        return false;
+    }
+    const Vector3f q = s.cross(e1);
+    const float v = direction.dot(q) * invDet;
+    if(v < 0.0f || u + v > 1.0f){
+        return false;
+    }
+    out_t = e2.dot(q) * invDet;
+    return true;
+}
+
+
+/**
+   The hierarchy of the primitives of a mesh, a point set or a line set in its local coordinate.
+   This is shared by the instances of the object.
+*/
+struct Geometry
+{
+    SgObjectPtr object;
+    Bvh bvh;
+    int lastUsedIndexId;
+};
+typedef std::shared_ptr<Geometry> GeometryPtr;
+
+
+struct Instance
+{
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    enum Type { MESH, POINTS, LINES, CUSTOM };
+    Type type;
+    SgNodePtr node;
+    SgNodePath path;
+    Affine3 T;
+    GeometryPtr geometry;
+    //! The width in pixels for a point set or a line set
+    double pickingWidth;
+    //! This is false when the bounding box of a custom node is not available.
+    bool isBounded;
+    Vector3 worldMin;
+    Vector3 worldMax;
+};
+
+
+/**
+   The groups visited in the last indexing are recorded to detect the changes of the children
+   and the switches that are not notified.
+*/
+struct VisitedGroup
+{
+    SgGroupPtr group;
+    int numChildren;
+    signed char switchState;
+};
+
+bool intersectBox(const Vector3& min, const Vector3& max, const Vector3& origin, const Vector3& direction,
+                  double tmax, double& out_tmin)
+{
+    double t0 = 0.0;
+    double t1 = tmax;
+    for(int i=0; i < 3; ++i){
+        const double invDirection = 1.0 / direction[i];
+        double tNear = (min[i] - origin[i]) * invDirection;
+        double tFar = (max[i] - origin[i]) * invDirection;
+        if(tNear > tFar){
+            std::swap(tNear, tFar);
+        }
+        t0 = std::max(t0, tNear);
+        t1 = std::min(t1, tFar);
+        if(t0 > t1){
+            return false;
+        }
+    }
+    out_tmin = t0;
+    return true;
+}
+
+
+void transformBounds(const Affine3& T, const Vector3f& min, const Vector3f& max, Vector3& out_min, Vector3& out_max)
+{
+    out_min.setConstant(std::numeric_limits<double>::max());
+    out_max.setConstant(-std::numeric_limits<double>::max());
+    for(int i=0; i < 8; ++i){
+        const Vector3 p(
+            (i & 1) ? max.x() : min.x(),
+            (i & 2) ? max.y() : min.y(),
+            (i & 4) ? max.z() : min.z());
+        const Vector3 q = T * p;
+        out_min = out_min.cwiseMin(q);
+        out_max = out_max.cwiseMax(q);
+    }
+}
+
+
+/**
+   The bounds are slightly expanded so that the rounding to float does not shrink them.
+*/
+Bounds toFloatBounds(const Vector3& min, const Vector3& max)
+{
+    Bounds b;
+    for(int i=0; i < 3; ++i){
+        const double margin = 1.0e-6 * std::max(1.0, std::max(fabs(min[i]), fabs(max[i])));
+        b.min[i] = min[i] - margin;
+        b.max[i] = max[i] + margin;
+    }
+    return b;
+}
+
+}
+
+namespace cnoid {
+
+class ScenePickerImpl
+{
+public:
+    SgNodePtr root;
+    ScopedConnection rootConnection;
+    PolymorphicFunctionSet<SgNode> functions;
+    const PolymorphicFunctionSet<SgNode>* renderingFunctions;
+    vector<signed char> customTypeFlags;
+
+    double defaultPointSize;
+    double defaultLineWidth;
+    double minPickingWidth;
+
+    bool needToRebuild;
+    int indexId;
+    vector<Instance, Eigen::aligned_allocator<Instance>> instances;
+    vector<int> meshInstanceIndices;
+    vector<int> plotInstanceIndices;
+    vector<int> customInstanceIndices;
+    Bvh meshInstanceBvh;
+    BoundsArray meshInstanceBounds;
+    unordered_map<SgObject*, GeometryPtr> geometryCache;
+    unordered_map<SgNode*, vector<pair<int, int>>> groupInstanceRanges;
+    unordered_set<SgObject*> customNodes;
+    vector<VisitedGroup> visitedGroups;
+    unordered_set<SgNode*> modifiedGroups;
+    vector<char> instanceUpdateFlags;
+
+    // Variables used in the traversal
+    SgNodePath currentPath;
+    vector<Affine3, Eigen::aligned_allocator<Affine3>> transformStack;
+
+    SgNodePath pickedNodePath;
+    Vector3 pickedPoint;
+
+    ScenePickerImpl();
+    void setRoot(SgNode* root);
+    void onSceneGraphUpdated(const SgUpdate& update);
+    bool isCustomNode(SgNode* node);
+    void updateIndex();
+    void rebuild();
+    void visitNode(SgNode* node);
+    void visitGroup(SgGroup* group);
+    void visitSwitch(SgSwitch* switchNode);
+    void visitTransform(SgTransform* transform);
+    void visitShape(SgShape* shape);
+    void visitPointSet(SgPointSet* pointSet);
+    void visitLineSet(SgLineSet* lineSet);
+    void addInstance(Instance::Type type, SgNode* node, GeometryPtr geometry, double pickingWidth);
+    GeometryPtr getOrCreateGeometry(SgObject* object, std::function<void(BoundsArray& bounds)> getBounds);
+    void updateInstanceBounds(Instance& instance);
+    void updateModifiedInstances();
+    ScenePicker::Result pick(const Vector3& origin, const Vector3& end, double pixelSizeAtOrigin, double pixelSizeAtEnd);
+};
+
+}
+
+
+ScenePicker::ScenePicker()
+{
+    impl = new ScenePickerImpl;
+}
+
+
+ScenePickerImpl::ScenePickerImpl()
+{
+    renderingFunctions = nullptr;
+    defaultPointSize = 1.0;
+    defaultLineWidth = 1.0;
+    minPickingWidth = 1.0;
+    needToRebuild = true;
+    indexId = 0;
+    pickedPoint.setZero();
+
+    functions.setFunction<SgGroup>(
+        [&](SgGroup* node){ visitGroup(node); });
+    functions.setFunction<SgTransform>(
+        [&](SgTransform* node){ visitTransform(node); });
+    functions.setFunction<SgSwitch>(
+        [&](SgSwitch* node){ visitSwitch(node); });
+    functions.setFunction<SgUnpickableGroup>(
+        [&](SgUnpickableGroup*){ });
+    functions.setFunction<SgShape>(
+        [&](SgShape* node){ visitShape(node); });
+    functions.setFunction<SgPointSet>(
+        [&](SgPointSet* node){ visitPointSet(node); });
+    functions.setFunction<SgLineSet>(
+        [&](SgLineSet* node){ visitLineSet(node); });
+    functions.setFunction<SgOverlay>(
+        [&](SgOverlay*){ });
+    functions.setFunction<SgOutlineGroup>(
+        [&](SgOutlineGroup* node){ visitGroup(node); });
+    functions.updateDispatchTable();
+}
+
+
+ScenePicker::~ScenePicker()
+{
+    delete impl;
+}
+
+
+void ScenePicker::setRoot(SgNode* root)
+{
+    impl->setRoot(root);
+}
+
+
+void ScenePickerImpl::setRoot(SgNode* root)
+{
+    rootConnection.disconnect();
+    this->root = root;
+    if(root){
+        rootConnection.reset(
+            root->sigUpdated().connect(
+                [&](const SgUpdate& update){ onSceneGraphUpdated(update); }));
+    }
+    needToRebuild = true;
+}
+
+
+SgNode* ScenePicker::root()
+{
+    return impl->root;
+}
+
+
+void ScenePicker::setRenderingFunctions(const PolymorphicFunctionSet<SgNode>* functions)
+{
+    impl->renderingFunctions = functions;
+    invalidate();
+}
+
+
+void ScenePicker::setDefaultPointSize(double size)
+{
+    if(size != impl->defaultPointSize){
+        impl->defaultPointSize = size;
+        invalidate();
+    }
+}
+
+
+void ScenePicker::setDefaultLineWidth(double width)
+{
+    if(width != impl->defaultLineWidth){
+        impl->defaultLineWidth = width;
+        invalidate();
+    }
+}
+
+
+void ScenePicker::setMinPickingWidth(double width)
+{
+    if(width != impl->minPickingWidth){
+        impl->minPickingWidth = width;
+        invalidate();
+    }
+}
+
+
+void ScenePicker::invalidate()
+{
+    impl->customTypeFlags.clear();
+    impl->needToRebuild = true;
+}
+
+
+void ScenePickerImpl::onSceneGraphUpdated(const SgUpdate& update)
+{
+    const SgUpdate::Path& path = update.path();
+    if(path.empty()){
+        return;
+    }
+    SgObject* object = path.front();
+    SgGroup* group = dynamic_cast<SgGroup*>(object);
+    const bool isAppearance =
+        dynamic_cast<SgMaterial*>(object) || dynamic_cast<SgTexture*>(object) ||
+        dynamic_cast<SgImage*>(object) || dynamic_cast<SgTextureTransform*>(object);
+
+    if(!group && !isAppearance){
+        // The geometry of a mesh, a point set or a line set may be modified
+        for(auto& element : path){
+            geometryCache.erase(element);
+        }
+    }
+    if(needToRebuild){
+        return;
+    }
+    for(auto& element : path){
+        if(dynamic_cast<SgUnpickableGroup*>(element)){
+            return;
+        }
+        if(customNodes.find(element) != customNodes.end()){
+            needToRebuild = true;
+            return;
+        }
+    }
+    if(update.action() & (SgUpdate::ADDED | SgUpdate::REMOVED)){
+        needToRebuild = true;
+
+    } else if(group){
+        /*
+          The modified group is usually a transform. The groups whose descendant transforms are
+          modified in a transaction are also notified as modified groups.
+        */
+        if(dynamic_cast<SgSwitch*>(group)){
+            needToRebuild = true;
+        } else if(groupInstanceRanges.find(group) != groupInstanceRanges.end()){
+            // The groups are notified every frame while the picking may not be done for a long time
+            modifiedGroups.insert(group);
+            if(modifiedGroups.size() >= instances.size()){
+                modifiedGroups.clear();
+                needToRebuild = true;
+            }
+        }
+    } else if(!isAppearance){
+        needToRebuild = true;
+    }
+}
+
+
+bool ScenePickerImpl::isCustomNode(SgNode* node)
+{
+    if(!renderingFunctions){
+        return false;
+    }
+    const int id = node->polymorhicId();
+    if(id >= static_cast<int>(customTypeFlags.size())){
+        customTypeFlags.resize(SgNode::numPolymorphicTypes(), -1);
+    }
+    signed char& flag = customTypeFlags[id];
+    if(flag < 0){
+        flag = (renderingFunctions->findFunctionTypeId(id) != functions.findFunctionTypeId(id)) ? 1 : 0;
+    }
+    return flag;
+}
+
+
+void ScenePickerImpl::updateIndex()
+{
+    if(!needToRebuild){
+        for(auto& visited : visitedGroups){
+            SgGroup* group = visited.group;
+            if(group->numChildren() != visited.numChildren){
+                needToRebuild = true;
+                break;
+            }
+            if(visited.switchState >= 0){
+                if(static_cast<SgSwitch*>(group)->isTurnedOn() != static_cast<bool>(visited.switchState)){
+                    needToRebuild = true;
+                    break;
+                }
+            }
+        }
+    }
+    if(needToRebuild){
+        rebuild();
+    } else if(!modifiedGroups.empty()){
+        updateModifiedInstances();
+    }
+}
+
+
+void ScenePickerImpl::rebuild()
+{
+    ++indexId;
+
+    instances.clear();
+    meshInstanceIndices.clear();
+    plotInstanceIndices.clear();
+    customInstanceIndices.clear();
+    groupInstanceRanges.clear();
+    customNodes.clear();
+    visitedGroups.clear();
+    modifiedGroups.clear();
+
+    if(root){
+        currentPath.clear();
+        transformStack.clear();
+        transformStack.push_back(Affine3::Identity());
+        visitNode(root);
+    }
+
+    // Remove the geometries of the objects removed from the scene
+    for(auto p = geometryCache.begin(); p != geometryCache.end(); ){
+        if(p->second->lastUsedIndexId != indexId){
+            p = geometryCache.erase(p);
+        } else {
+            ++p;
+        }
+    }
+
+    const int n = meshInstanceIndices.size();
+    meshInstanceBounds.resize(n);
+    for(int i=0; i < n; ++i){
+        const Instance& instance = instances[meshInstanceIndices[i]];
+        meshInstanceBounds[i] = toFloatBounds(instance.worldMin, instance.worldMax);
+    }
+    meshInstanceBvh.build(meshInstanceBounds);
+
+    instanceUpdateFlags.assign(instances.size(), 0);
+    needToRebuild = false;
+}
+
+
+void ScenePickerImpl::visitNode(SgNode* node)
+{
+    if(isCustomNode(node)){
+        addInstance(Instance::CUSTOM, node, GeometryPtr(), 0.0);
+        customNodes.insert(node);
+    } else {
+        functions.dispatch(node);
+    }
+}
+
+
+void ScenePickerImpl::visitGroup(SgGroup* group)
+{
+    VisitedGroup visited;
+    visited.group = group;
+    visited.numChildren = group->numChildren();
+    visited.switchState = -1;
+    visitedGroups.push_back(visited);
+
+    currentPath.push_back(group);
+    const int begin = instances.size();
+    for(auto p = group->cbegin(); p != group->cend(); ++p){
+        visitNode(*p);
+    }
+    const int end = instances.size();
+    if(end > begin){
+        groupInstanceRanges[group].push_back(make_pair(begin, end));
+    }
+    currentPath.pop_back();
+}
+
+
+void ScenePickerImpl::visitSwitch(SgSwitch* switchNode)
+{
+    if(switchNode->isTurnedOn()){
+        visitGroup(switchNode);
+        visitedGroups.back().switchState = 1;
+    } else {
+        VisitedGroup visited;
+        visited.group = switchNode;
+        visited.numChildren = switchNode->numChildren();
+        visited.switchState = 0;
+        visitedGroups.push_back(visited);
+    }
+}
+
+
+void ScenePickerImpl::visitTransform(SgTransform* transform)
+{
+    Affine3 T;
+    transform->getTransform(T);
+    transformStack.push_back(transformStack.back() * T);
+    visitGroup(transform);
+    transformStack.pop_back();
+}
+
+
+GeometryPtr ScenePickerImpl::getOrCreateGeometry
+(SgObject* object, std::function<void(BoundsArray& bounds)> getBounds)
+{
+    GeometryPtr& geometry = geometryCache[object];
+    if(!geometry){
+        geometry = std::make_shared<Geometry>();
+        geometry->object = object;
+        BoundsArray bounds;
+        getBounds(bounds);
+        geometry->bvh.build(bounds);
+    }
+    geometry->lastUsedIndexId = indexId;
+    return geometry;
+}
+
+
+void ScenePickerImpl::visitShape(SgShape* shape)
+{
+    SgMesh* mesh = shape->mesh();
+    if(!mesh || !mesh->hasVertices() || mesh->numTriangles() == 0){
+        return;
+    }
+    auto geometry = getOrCreateGeometry(
+        mesh,
+        [mesh](BoundsArray& bounds){
+            const SgVertexArray& vertices = *mesh->vertices();
+            const int n = mesh->numTriangles();
+            bounds.resize(n);
+            for(int i=0; i < n; ++i){
+                auto triangle = mesh->triangle(i);
+                Bounds& b = bounds[i];
+                b.clear();
+                for(int j=0; j < 3; ++j){
+                    b.expandBy(vertices[triangle[j]]);
+                }
+            }
+        });
+    addInstance(Instance::MESH, shape, geometry, 0.0);
+}
+
+
+void ScenePickerImpl::visitPointSet(SgPointSet* pointSet)
+{
+    if(!pointSet->hasVertices()){
+        return;
+    }
+    auto geometry = getOrCreateGeometry(
+        pointSet,
+        [pointSet](BoundsArray& bounds){
+            const SgVertexArray& vertices = *pointSet->vertices();
+            const int n = vertices.size();
+            bounds.resize(n);
+            for(int i=0; i < n; ++i){
+                bounds[i].min = vertices[i];
+                bounds[i].max = vertices[i];
+            }
+        });
+    const double size = pointSet->pointSize() > 0.0 ? pointSet->pointSize() : defaultPointSize;
+    addInstance(Instance::POINTS, pointSet, geometry, std::max(size, minPickingWidth));
+}
+
+
+void ScenePickerImpl::visitLineSet(SgLineSet* lineSet)
+{
+    if(!lineSet->hasVertices() || lineSet->numLines() <= 0){
+        return;
+    }
+    auto geometry = getOrCreateGeometry(
+        lineSet,
+        [lineSet](BoundsArray& bounds){
+            const SgVertexArray& vertices = *lineSet->vertices();
+            const int n = lineSet->numLines();
+            bounds.resize(n);
+            for(int i=0; i < n; ++i){
+                auto line = lineSet->line(i);
+                Bounds& b = bounds[i];
+                b.clear();
+                b.expandBy(vertices[line[0]]);
+                b.expandBy(vertices[line[1]]);
+            }
+        });
+    const double width = lineSet->lineWidth() > 0.0 ? lineSet->lineWidth() : defaultLineWidth;
+    addInstance(Instance::LINES, lineSet, geometry, std::max(width, minPickingWidth));
+}
+
+
+void ScenePickerImpl::addInstance(Instance::Type type, SgNode* node, GeometryPtr geometry, double pickingWidth)
+{
+    const int index = instances.size();
+    instances.push_back(Instance());
+    Instance& instance = instances.back();
+    instance.type = type;
+    instance.node = node;
+    instance.path = currentPath;
+    instance.path.push_back(node);
+    instance.T = transformStack.back();
+    instance.geometry = geometry;
+    instance.pickingWidth = pickingWidth;
+    updateInstanceBounds(instance);
+
+    switch(type){
+    case Instance::MESH:
+        meshInstanceIndices.push_back(index);
+        break;
+    case Instance::POINTS:
+    case Instance::LINES:
+        plotInstanceIndices.push_back(index);
+        break;
+    case Instance::CUSTOM:
+        customInstanceIndices.push_back(index);
+        break;
+    }
+}
+
+
+void ScenePickerImpl::updateInstanceBounds(Instance& instance)
+{
+    if(instance.geometry){
+        const Bounds& b = instance.geometry->bvh.bounds();
+        transformBounds(instance.T, b.min, b.max, instance.worldMin, instance.worldMax);
+        instance.isBounded = true;
+    } else {
+        BoundingBox bbox = instance.node->boundingBox();
+        if(bbox.empty()){
+            instance.isBounded = false;
+        } else {
+            bbox.transform(instance.T);
+            instance.worldMin = bbox.min();
+            instance.worldMax = bbox.max();
+            instance.isBounded = true;
+        }
+    }
+}
+
+
+void ScenePickerImpl::updateModifiedInstances()
+{
+    vector<int> indices;
+    for(auto& group : modifiedGroups){
+        auto p = groupInstanceRanges.find(group);
+        if(p != groupInstanceRanges.end()){
+            for(auto& range : p->second){
+                for(int i = range.first; i < range.second; ++i){
+                    if(!instanceUpdateFlags[i]){
+                        instanceUpdateFlags[i] = 1;
+                        indices.push_back(i);
+                    }
+                }
+            }
+        }
+    }
+    modifiedGroups.clear();
+
+    for(auto& index : indices){
+        instanceUpdateFlags[index] = 0;
+        Instance& instance = instances[index];
+        if(instance.type == Instance::MESH){
+            // The mesh of a shape may be replaced in a transaction
+            if(static_cast<SgShape*>(instance.node.get())->mesh() != instance.geometry->object){
+                rebuild();
+                return;
+            }
+        }
+        Affine3 T = Affine3::Identity();
+        for(auto& node : instance.path){
+            if(SgTransform* transform = dynamic_cast<SgTransform*>(node)){
+                Affine3 T1;
+                transform->getTransform(T1);
+                T = T * T1;
+            }
+        }
+        instance.T = T;
+        updateInstanceBounds(instance);
+    }
+
+    const int n = meshInstanceIndices.size();
+    for(int i=0; i < n; ++i){
+        const Instance& instance = instances[meshInstanceIndices[i]];
+        meshInstanceBounds[i] = toFloatBounds(instance.worldMin, instance.worldMax);
+    }
+    meshInstanceBvh.refit(meshInstanceBounds);
+}
+
+
+ScenePicker::Result ScenePicker::pick
+(const Vector3& origin, const Vector3& end, double pixelSizeAtOrigin, double pixelSizeAtEnd)
+{
+    return impl->pick(origin, end, pixelSizeAtOrigin, pixelSizeAtEnd);
+}
+
+
+ScenePicker::Result ScenePickerImpl::pick
+(const Vector3& origin, const Vector3& end, double pixelSizeAtOrigin, double pixelSizeAtEnd)
+{
+    updateIndex();
+
+    pickedNodePath.clear();
+
+    const double length = (end - origin).norm();
+    if(length == 0.0){
+        return ScenePicker::MISSED;
+    }
+    const Vector3 direction = (end - origin) / length;
+    const double pixelSizeRate = (pixelSizeAtEnd - pixelSizeAtOrigin) / length;
+
+    double tHit = length;
+    int hitInstance = -1;
+
+    // Meshes
+    float tmax = tHit;
+    meshInstanceBvh.traverse(
+        origin.cast<float>(), direction.cast<float>(), 0.0f, tmax,
+        [&](int meshInstanceIndex, float& io_tmax){
+            const int index = meshInstanceIndices[meshInstanceIndex];
+            const Instance& instance = instances[index];
+            const SgMesh* mesh = static_cast<const SgMesh*>(instance.geometry->object.get());
+            const SgVertexArray& vertices = *mesh->vertices();
+            const Affine3 Tinv = instance.T.inverse();
+            const Vector3f localOrigin = (Tinv * origin).cast<float>();
+            const Vector3f localDirection = (Tinv.linear() * direction).cast<float>();
+            instance.geometry->bvh.traverse(
+                localOrigin, localDirection, 0.0f, io_tmax,
+                [&](int triangleIndex, float& io_tmax2){
+                    auto triangle = mesh->triangle(triangleIndex);
+                    float t;
+                    if(intersectTriangle(localOrigin, localDirection,
+                                         vertices[triangle[0]], vertices[triangle[1]], vertices[triangle[2]], t)){
+                        if(t >= 0.0f && t < io_tmax2){
+                            io_tmax2 = t;
+                            tHit = t;
+                            hitInstance = index;
+                        }
+                    }
+                });
+        });
+
+    // Point sets and line sets
+    for(auto& index : plotInstanceIndices){
+        const Instance& instance = instances[index];
+        const double halfWidth = instance.pickingWidth / 2.0;
+        const double maxTolerance = halfWidth * std::max(pixelSizeAtOrigin, pixelSizeAtEnd);
+        const Vector3 margin = Vector3::Constant(maxTolerance);
+        double tEntry;
+        if(!intersectBox(instance.worldMin - margin, instance.worldMax + margin, origin, direction, tHit, tEntry)){
+            continue;
+        }
+        const Affine3 Tinv = instance.T.inverse();
+        const Vector3f localOrigin = (Tinv * origin).cast<float>();
+        const Vector3f localDirection = (Tinv.linear() * direction).cast<float>();
+        // The margin in the local coordinate is given by the smallest scale of the transform
+        Eigen::JacobiSVD<Matrix3> svd(instance.T.linear());
+        const double minScale = svd.singularValues().minCoeff();
+        if(minScale <= 0.0){
+            continue;
+        }
+        const float localMargin = maxTolerance / minScale;
+        const SgVertexArray& vertices = *static_cast<SgPlot*>(instance.node.get())->vertices();
+
+        auto testPoint = [&](const Vector3& p, double t, float& io_tmax){
+            if(t < 0.0 || t >= tHit){
+                return;
+            }
+            const double tolerance = halfWidth * (pixelSizeAtOrigin + pixelSizeRate * t);
+            if((origin + t * direction - p).squaredNorm() <= tolerance * tolerance){
+                tHit = t;
+                hitInstance = index;
+                io_tmax = std::min(io_tmax, static_cast<float>(t));
+            }
+        };
+
+        float tmax = tHit;
+        if(instance.type == Instance::POINTS){
+            instance.geometry->bvh.traverse(
+                localOrigin, localDirection, localMargin, tmax,
+                [&](int pointIndex, float& io_tmax){
+                    const Vector3 p = instance.T * vertices[pointIndex].cast<double>();
+                    testPoint(p, (p - origin).dot(direction), io_tmax);
+                });
+        } else {
+            const SgLineSet* lineSet = static_cast<SgLineSet*>(instance.node.get());
+            instance.geometry->bvh.traverse(
+                localOrigin, localDirection, localMargin, tmax,
+                [&](int lineIndex, float& io_tmax){
+                    auto line = lineSet->line(lineIndex);
+                    const Vector3 a = instance.T * vertices[line[0]].cast<double>();
+                    const Vector3 u = instance.T * vertices[line[1]].cast<double>() - a;
+                    // The closest point of the segment to the ray
+                    const Vector3 w = origin - a;
+                    const double b = direction.dot(u);
+                    const double c = u.dot(u);
+                    const double d = direction.dot(w);
+                    const double e = u.dot(w);
+                    const double denom = c - b * b;
+                    double s = (denom > 1.0e-12 * c) ? (e - b * d) / denom : 0.0;
+                    s = std::max(0.0, std::min(1.0, s));
+                    const Vector3 p = a + s * u;
+                    testPoint(p, (p - origin).dot(direction), io_tmax);
+                });
+        }
+    }
+
+    // The custom-rendered nodes in front of the hit point must be picked by the renderer
+    for(auto& index : customInstanceIndices){
+        const Instance& instance = instances[index];
+        double tEntry;
+        if(!instance.isBounded ||
+           intersectBox(instance.worldMin, instance.worldMax, origin, direction, tHit, tEntry)){
+            return ScenePicker::UNDETERMINED;
+        }
+    }
+
+    if(hitInstance < 0){
+        return ScenePicker::MISSED;
+    }
+    pickedNodePath = instances[hitInstance].path;
+    pickedPoint = origin + tHit * direction;
+    return ScenePicker::PICKED;
+}
+
+
+const SgNodePath& ScenePicker::pickedNodePath() const
+{
+    return impl->pickedNodePath;
+}
+
+
+const Vector3& ScenePicker::pickedPoint() const
+{
+    return impl->pickedPoint;
+}
@@ -0,0 +1,74 @@
+/*!
+  @file
+*/
+
+#ifndef CNOID_UTIL_SCENE_PICKER_H
+#define CNOID_UTIL_SCENE_PICKER_H
+
+#include "SceneGraph.h"
+#include "PolymorphicFunctionSet.h"
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class ScenePickerImpl;
+
+/**
+   This class picks the scene graph nodes with a ray on the CPU side. The triangles of the meshes
+   and the primitives of the point sets and line sets are stored in bounding volume hierarchies,
+   and the world-space bounds of the shapes are stored in another hierarchy. The hierarchies are
+   updated incrementally with the update notifications of the scene graph.
+
+   The picked node path is the same as the one given by the picking of the renderer: the groups
+   and the transforms from the root to the picked shape, point set or line set, excluding the
+   nodes under the unpickable groups, the overlays and the switches that are turned off.
+*/
+class CNOID_EXPORT ScenePicker
+{
+public:
+    ScenePicker();
+    ~ScenePicker();
+
+    void setRoot(SgNode* root);
+    SgNode* root();
+
+    /**
+       The nodes of the types whose rendering functions in the given function set are different
+       from the ones applied by this class are treated as the custom-rendered nodes. Their shapes
+       are unknown to this class, so the picking whose ray passes through the bounding box of such
+       a node before hitting another object is reported as UNDETERMINED.
+    */
+    void setRenderingFunctions(const PolymorphicFunctionSet<SgNode>* functions);
+
+    void setDefaultPointSize(double size);
+    void setDefaultLineWidth(double width);
+
+    //! The points and lines thinner than this width in pixels are picked with this width.
+    void setMinPickingWidth(double width);
+
+    //! This function rebuilds the whole index at the next picking.
+    void invalidate();
+
+    enum Result { MISSED, PICKED, UNDETERMINED };
+
+    /**
+       \param origin The start point of the ray, which is usually on the near clip plane
+       \param end The end point of the ray, which is usually on the far clip plane
+       \param pixelSizeAtOrigin The size of a pixel on the screen at the origin
+       \param pixelSizeAtEnd The size of a pixel on the screen at the end
+    */
+    Result pick(const Vector3& origin, const Vector3& end, double pixelSizeAtOrigin, double pixelSizeAtEnd);
+
+    const SgNodePath& pickedNodePath() const;
+    const Vector3& pickedPoint() const;
+
+private:
+    ScenePickerImpl* impl;
+
+    ScenePicker(const ScenePicker&) = delete;
+    ScenePicker& operator=(const ScenePicker&) = delete;
+};
+
+}
+
+#endif
@@ -0,0 +1,313 @@
+/**
+   @file
+*/
+
+#include "TraceProfiler.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <boost/format.hpp>
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+
+std::atomic<bool> TraceProfiler::isEnabled_(false);
+
+namespace {
+
+struct TraceRecord
+{
+    const char* name;
+    int64_t beginTime;
+    int64_t endTime;
+};
+
+/*
+  The records are only written by the owner thread. The number of the written records
+  is published with the release store so that the exporting thread can read them.
+  The buffer is never reset or resized by the other threads. Clearing only moves the
+  position from which the records are exported.
+*/
+struct ThreadBuffer
+{
+    vector<TraceRecord> records;
+    uint64_t mask;
+    std::atomic<uint64_t> numRecords;
+    std::atomic<uint64_t> numClearedRecords;
+    int threadId;
+    string threadName;
+    std::atomic<bool> isThreadFinished;
+
+    ThreadBuffer(int size, int id)
+        : records(size), mask(size - 1), numRecords(0), numClearedRecords(0),
+          threadId(id), isThreadFinished(false) { }
+};
+
+struct Registry
+{
+    std::mutex mutex;
+    vector<std::unique_ptr<ThreadBuffer>> buffers;
+    int bufferSize;
+    int nextThreadId;
+    int64_t originTime;
+
+    Registry() {
+        bufferSize = 1 << 16;
+        nextThreadId = 1;
+        originTime = TraceProfiler::now();
+    }
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+struct ThreadBufferHolder
+{
+    ThreadBuffer* buffer;
+    ThreadBufferHolder() : buffer(nullptr) { }
+    ~ThreadBufferHolder() {
+        if(buffer){
+            buffer->isThreadFinished = true;
+        }
+    }
+};
+
+thread_local ThreadBufferHolder threadBufferHolder;
+
+ThreadBuffer* getOrCreateThreadBuffer()
+{
+    ThreadBuffer* buffer = threadBufferHolder.buffer;
+    if(!buffer){
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        buffer = new ThreadBuffer(reg.bufferSize, reg.nextThreadId++);
+        reg.buffers.emplace_back(buffer);
+        threadBufferHolder.buffer = buffer;
+    }
+    return buffer;
+}
+
+void putJsonString(ostream& os, const char* s)
+{
+    os << '"';
+    for(; *s; ++s){
+        const char c = *s;
+        if(c == '"' || c == '\\'){
+            os << '\\' << c;
+        } else if(static_cast<unsigned char>(c) < 0x20){
+            os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+               << std::dec << std::setfill(' ');
+        } else {
+            os << c;
+        }
+    }
+    os << '"';
+}
+
+/*
+  This function calls the given function for each of the records that are not overwritten.
+*/
+template<class Function>
+void forEachRecord(const ThreadBuffer& buffer, Function func)
+{
+    const uint64_t n = buffer.numRecords.load(std::memory_order_acquire);
+    const uint64_t size = buffer.records.size();
+    const uint64_t begin = std::max((n > size) ? (n - size) : 0, buffer.numClearedRecords.load());
+    for(uint64_t i = begin; i < n; ++i){
+        func(buffer.records[i & buffer.mask]);
+    }
+}
+
+}
+
+
+void TraceProfiler::setEnabled(bool on)
+{
+    isEnabled_.store(on);
+}
+
+
+void TraceProfiler::setBufferSize(int size)
+{
+    int size2 = 1;
+    while(size2 < size){
+        size2 <<= 1;
+    }
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.bufferSize = size2;
+}
+
+
+int TraceProfiler::bufferSize()
+{
+    return registry().bufferSize;
+}
+
+
+void TraceProfiler::clear()
+{
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    auto iter = reg.buffers.begin();
+    while(iter != reg.buffers.end()){
+        ThreadBuffer* buffer = iter->get();
+        if(buffer->isThreadFinished){
+            iter = reg.buffers.erase(iter);
+        } else {
+            buffer->numClearedRecords = buffer->numRecords.load(std::memory_order_acquire);
+            ++iter;
+        }
+    }
+    reg.originTime = now();
+}
+
+
+void TraceProfiler::setThreadName(const std::string& name)
+{
+    ThreadBuffer* buffer = getOrCreateThreadBuffer();
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    buffer->threadName = name;
+}
+
+
+int64_t TraceProfiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void TraceProfiler::record(const char* name, int64_t beginTime, int64_t endTime)
+{
+    ThreadBuffer* buffer = threadBufferHolder.buffer;
+    if(!buffer){
+        buffer = getOrCreateThreadBuffer();
+    }
+    const uint64_t n = buffer->numRecords.load(std::memory_order_relaxed);
+    TraceRecord& record = buffer->records[n & buffer->mask];
+    record.name = name;
+    record.beginTime = beginTime;
+    record.endTime = endTime;
+    buffer->numRecords.store(n + 1, std::memory_order_release);
+}
+
+
+bool TraceProfiler::exportChromeTrace(const std::string& filename, std::ostream& os)
+{
+    ofstream file(filename.c_str(), ios::out | ios::binary);
+    if(!file){
+        os << format(_("\"%1%\" cannot be opened.")) % filename << endl;
+        return false;
+    }
+
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    file << "{\"traceEvents\":[";
+    bool isFirst = true;
+    file << std::fixed << std::setprecision(3);
+
+    for(auto& buffer : reg.buffers){
+        if(!buffer->threadName.empty()){
+            file << (isFirst ? "\n" : ",\n");
+            file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->threadId
+                 << ",\"args\":{\"name\":";
+            putJsonString(file, buffer->threadName.c_str());
+            file << "}}";
+            isFirst = false;
+        }
+        forEachRecord(
+            *buffer,
+            [&](const TraceRecord& record){
+                file << (isFirst ? "\n" : ",\n");
+                file << "{\"name\":";
+                putJsonString(file, record.name);
+                file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+                     << ",\"ts\":" << (record.beginTime - reg.originTime) * 1.0e-3
+                     << ",\"dur\":" << (record.endTime - record.beginTime) * 1.0e-3 << "}";
+                isFirst = false;
+            });
+    }
+
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    if(!file){
+        os << format(_("Writing \"%1%\" failed.")) % filename << endl;
+        return false;
+    }
+    return true;
+}
+
+
+void TraceProfiler::putSummary(std::ostream& os)
+{
+    struct Summary
+    {
+        string name;
+        int64_t numCalls;
+        int64_t totalTime;
+        int64_t maxTime;
+    };
+    vector<Summary> summaries;
+    unordered_map<string, int> nameToIndexMap;
+
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for(auto& buffer : reg.buffers){
+            forEachRecord(
+                *buffer,
+                [&](const TraceRecord& record){
+                    auto inserted = nameToIndexMap.insert(make_pair(string(record.name), summaries.size()));
+                    if(inserted.second){
+                        summaries.push_back(Summary{ record.name, 0, 0, 0 });
+                    }
+                    Summary& summary = summaries[inserted.first->second];
+                    const int64_t time = record.endTime - record.beginTime;
+                    ++summary.numCalls;
+                    summary.totalTime += time;
+                    summary.maxTime = std::max(summary.maxTime, time);
+                });
+        }
+    }
+
+    std::sort(summaries.begin(), summaries.end(),
+              [](const Summary& s1, const Summary& s2){ return s1.totalTime > s2.totalTime; });
+
+    size_t nameWidth = 4;
+    for(auto& summary : summaries){
+        nameWidth = std::max(nameWidth, summary.name.size());
+    }
+
+    const auto flags = os.flags();
+    const auto precision = os.precision();
+    os << std::left << std::setw(nameWidth) << "Zone" << std::right
+       << std::setw(10) << "Calls"
+       << std::setw(14) << "Total [ms]"
+       << std::setw(12) << "Mean [us]"
+       << std::setw(12) << "Max [us]" << "\n";
+    os << std::fixed << std::setprecision(1);
+    for(auto& summary : summaries){
+        os << std::left << std::setw(nameWidth) << summary.name << std::right
+           << std::setw(10) << summary.numCalls
+           << std::setw(14) << summary.totalTime * 1.0e-6
+           << std::setw(12) << summary.totalTime * 1.0e-3 / summary.numCalls
+           << std::setw(12) << summary.maxTime * 1.0e-3 << "\n";
+    }
+    os.flags(flags);
+    os.precision(precision);
+    os.flush();
+}
@@ -1016,3 +1016,56 @@ void Listing::write(int i, const std::string& value, StringStyle stringStyle)
 {
     values[i] = new ScalarNode(value, stringStyle);
 }
+
+
+PackedNumberListing::PackedNumberListing()
+    : data(std::make_shared<Data>())
+{
+    data->offsets.push_back(0);
+    data->errorLine = -1;
+    data->errorColumn = -1;
+}
+
+
+PackedNumberListing::PackedNumberListing(int line, int column)
+    : Listing(line, column),
+      data(std::make_shared<Data>())
+{
+    data->offsets.push_back(0);
+    data->errorLine = -1;
+    data->errorColumn = -1;
+}
+
+
+PackedNumberListing::PackedNumberListing(const PackedNumberListing& org)
+    : Listing(org),
+      data(org.data)
+{
+
+}
+
+
+ValueNode* PackedNumberListing::clone() const
+{
+    return new PackedNumberListing(*this);
+}
+
+
+void PackedNumberListing::checkValidity() const
+{
+    if(!data->errorMessage.empty()){
+        Exception ex;
+        ex.setPosition(data->errorLine, data->errorColumn);
+        ex.setMessage(data->errorMessage);
+        throw ex;
+    }
+}
+
+
+void PackedNumberListing::throwElementException(int index, const std::string& message) const
+{
+    Exception ex;
+    ex.setPosition(data->lines[index], data->columns[index]);
+    ex.setMessage(message);
+    throw ex;
+}
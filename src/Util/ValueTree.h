@@ -8,6 +8,7 @@
 #include "Referenced.h"
 #include <map>
 #include <vector>
+#include <memory>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -558,11 +559,62 @@ private:
     bool doInsertLFBeforeNextElement;
 
     friend class Mapping;
+    friend class PackedNumberListing;
     friend class YAMLReaderImpl;
 };
 
 typedef ref_ptr<Listing> ListingPtr;
 
+
+/**
+   This listing stores the numbers of its element listings in one array instead of the scalar nodes.
+   It is created by YAMLReader for the listings specified with YAMLReader::packNumberListings to
+   reduce the time and memory to read large numerical data such as the frames of sequence files.
+   The listing itself has no element node, and the numbers of each element are accessed with
+   the functions of this class. The numbers in the nested listings of an element are flattened.
+*/
+class CNOID_EXPORT PackedNumberListing : public Listing
+{
+public:
+    PackedNumberListing();
+        
+    virtual ValueNode* clone() const;
+
+    int numElements() const { return static_cast<int>(data->offsets.size()) - 1; }
+    int elementSize(int index) const {
+        return static_cast<int>(data->offsets[index + 1] - data->offsets[index]);
+    }
+    const double* element(int index) const { return &data->values[data->offsets[index]]; }
+
+    /**
+       The listing is invalid if it contains a value which is not a number, such as a string or
+       a mapping. In that case, no element is stored and this function throws an exception.
+    */
+    void checkValidity() const;
+
+    void throwElementException(int index, const std::string& message) const;
+
+private:
+    struct Data
+    {
+        std::vector<double> values;
+        std::vector<size_t> offsets;
+        std::vector<int> lines;
+        std::vector<int> columns;
+        std::string errorMessage;
+        int errorLine;
+        int errorColumn;
+    };
+    std::shared_ptr<Data> data;
+    
+    PackedNumberListing(int line, int column);
+    PackedNumberListing(const PackedNumberListing& org);
+
+    friend class YAMLReaderImpl;
+};
+
+typedef ref_ptr<PackedNumberListing> PackedNumberListingPtr;
+
 #ifdef CNOID_BACKWARD_COMPATIBILITY
 typedef ValueNode YamlNode;
 typedef ValueNodePtr YamlNodePtr;
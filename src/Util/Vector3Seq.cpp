@@ -60,7 +60,8 @@ bool Vector3Seq::doReadSeq(const Mapping* archive, std::ostream& os)
                 v.throwException(_("The number of elements specified as a 3D vector is invalid."));
             }
             value << v[topIndex].toDouble(), v[topIndex+1].toDouble(), v[topIndex+2].toDouble();
-        });
+        },
+        3, [](const double* src, Vector3& value){ value << src[0], src[1], src[2]; });
 }
 
 
@@ -82,12 +83,8 @@ bool Vector3Seq::writeVector3SeqFrames(YAMLWriter& writer)
     writer.startListing();
     const int n = numFrames();
     for(int i=0; i < n; ++i){
-        writer.startFlowStyleListing();
         const Vector3& v = (*this)[i];
-        for(int j=0; j < 3; ++j){
-            writer.putScalar(v[j]);
-        }
-        writer.endListing();
+        writer.putFlowStyleListing(v.data(), 3);
     }
     writer.endListing();
     return true;
@@ -0,0 +1,277 @@
+/*!
+  @file
+*/
+
+#include "VoxelGrid.h"
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// The corners of a voxel are ordered as (+,+,+), (-,+,+), (-,-,+), (+,-,+), (+,+,-), (-,+,-), (-,-,-), (+,-,-)
+const int boxTriangles[][3] = {
+    { 0, 1, 2 }, { 0, 2, 3 }, // +Z
+    { 0, 5, 1 }, { 0, 4, 5 }, // +Y
+    { 1, 5, 2 }, { 2, 5, 6 }, // -X
+    { 2, 6, 3 }, { 3, 6, 7 }, // -Y
+    { 0, 3, 4 }, { 3, 7, 4 }, // +X
+    { 4, 6, 5 }, { 4, 7, 6 }  // -Z
+};
+
+// The index of the normal in the normal array created in createMesh and the direction to the adjacent voxel
+const int faceNormalIndices[] = { 4, 2, 1, 3, 0, 5 };
+const int faceDirections[][3] = {
+    { 0, 0, 1 }, { 0, 1, 0 }, { -1, 0, 0 }, { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, -1 }
+};
+
+}
+
+
+VoxelGrid::VoxelGrid(double voxelSize)
+    : voxelSize_(voxelSize),
+      invVoxelSize(1.0 / voxelSize)
+{
+    hasColors_ = false;
+}
+
+
+void VoxelGrid::setVoxelSize(double size)
+{
+    if(size != voxelSize_){
+        voxelSize_ = size;
+        invVoxelSize = 1.0 / size;
+        clear();
+    }
+}
+
+
+void VoxelGrid::clear()
+{
+    voxels.clear();
+    voxelMap.clear();
+    hasColors_ = false;
+}
+
+
+Vector3i VoxelGrid::voxelIndex(const Vector3f& point) const
+{
+    return Vector3i(
+        static_cast<int>(std::floor(point.x() * invVoxelSize)),
+        static_cast<int>(std::floor(point.y() * invVoxelSize)),
+        static_cast<int>(std::floor(point.z() * invVoxelSize)));
+}
+
+
+Vector3f VoxelGrid::voxelCenter(const Vector3i& index) const
+{
+    return ((index.cast<double>() + Vector3d(0.5, 0.5, 0.5)) * voxelSize_).cast<float>();
+}
+
+
+VoxelGrid::Voxel& VoxelGrid::getOrCreateVoxel(const Vector3f& point)
+{
+    const Vector3i index = voxelIndex(point);
+    auto inserted = voxelMap.insert(make_pair(index, static_cast<int>(voxels.size())));
+    if(inserted.second){
+        voxels.push_back(Voxel());
+        Voxel& voxel = voxels.back();
+        voxel.index = index;
+        voxel.numPoints = 0;
+        voxel.positionSum.setZero();
+        voxel.colorSum.setZero();
+        return voxel;
+    }
+    return voxels[inserted.first->second];
+}
+
+
+void VoxelGrid::addPoint(const Vector3f& point)
+{
+    Voxel& voxel = getOrCreateVoxel(point);
+    ++voxel.numPoints;
+    voxel.positionSum += point.cast<double>();
+}
+
+
+void VoxelGrid::addPoint(const Vector3f& point, const Vector3f& color)
+{
+    Voxel& voxel = getOrCreateVoxel(point);
+    ++voxel.numPoints;
+    voxel.positionSum += point.cast<double>();
+    voxel.colorSum += color;
+    hasColors_ = true;
+}
+
+
+bool VoxelGrid::removePoint(const Vector3f& point)
+{
+    return removePointSub(point, 0);
+}
+
+
+bool VoxelGrid::removePoint(const Vector3f& point, const Vector3f& color)
+{
+    return removePointSub(point, &color);
+}
+
+
+bool VoxelGrid::removePointSub(const Vector3f& point, const Vector3f* color)
+{
+    auto p = voxelMap.find(voxelIndex(point));
+    if(p == voxelMap.end()){
+        return false;
+    }
+    const int index = p->second;
+    Voxel& voxel = voxels[index];
+    if(--voxel.numPoints > 0){
+        voxel.positionSum -= point.cast<double>();
+        if(color){
+            voxel.colorSum -= *color;
+        }
+    } else {
+        voxelMap.erase(p);
+        const int last = voxels.size() - 1;
+        if(index != last){
+            voxel = voxels[last];
+            voxelMap[voxel.index] = index;
+        }
+        voxels.pop_back();
+    }
+    return true;
+}
+
+
+void VoxelGrid::addPoints(const SgPointSet& pointSet)
+{
+    if(!pointSet.hasVertices()){
+        return;
+    }
+    const SgVertexArray& points = *pointSet.vertices();
+    const int n = points.size();
+    voxels.reserve(voxels.size() + n / 8);
+    voxelMap.reserve(voxels.capacity());
+
+    const SgColorArray* colors = pointSet.colors();
+    const SgIndexArray& colorIndices = pointSet.colorIndices();
+    if(colors && !colorIndices.empty() && static_cast<int>(colorIndices.size()) == n){
+        for(int i=0; i < n; ++i){
+            addPoint(points[i], (*colors)[colorIndices[i]]);
+        }
+    } else if(colors && static_cast<int>(colors->size()) == n){
+        for(int i=0; i < n; ++i){
+            addPoint(points[i], (*colors)[i]);
+        }
+    } else {
+        for(int i=0; i < n; ++i){
+            addPoint(points[i]);
+        }
+    }
+}
+
+
+void VoxelGrid::getCentroids(SgVertexArray& out_points, SgColorArray* out_colors) const
+{
+    const int n = voxels.size();
+    out_points.resize(n);
+    for(int i=0; i < n; ++i){
+        const Voxel& voxel = voxels[i];
+        out_points[i] = (voxel.positionSum / voxel.numPoints).cast<float>();
+    }
+    if(out_colors){
+        if(!hasColors_){
+            out_colors->clear();
+        } else {
+            out_colors->resize(n);
+            for(int i=0; i < n; ++i){
+                const Voxel& voxel = voxels[i];
+                (*out_colors)[i] = voxel.colorSum / voxel.numPoints;
+            }
+        }
+    }
+}
+
+
+SgMesh* VoxelGrid::createMesh() const
+{
+    if(voxels.empty()){
+        return 0;
+    }
+
+    SgMesh* mesh = new SgMesh;
+    mesh->setSolid(true);
+    SgVertexArray& vertices = *mesh->getOrCreateVertices();
+    SgNormalArray& normals = *mesh->setNormals(new SgNormalArray(6));
+    normals[0] <<  1.0f,  0.0f,  0.0f;
+    normals[1] << -1.0f,  0.0f,  0.0f;
+    normals[2] <<  0.0f,  1.0f,  0.0f;
+    normals[3] <<  0.0f, -1.0f,  0.0f;
+    normals[4] <<  0.0f,  0.0f,  1.0f;
+    normals[5] <<  0.0f,  0.0f, -1.0f;
+    SgIndexArray& normalIndices = mesh->normalIndices();
+    SgColorArray* colors = 0;
+    if(hasColors_){
+        colors = mesh->setColors(new SgColorArray);
+    }
+    SgIndexArray& colorIndices = mesh->colorIndices();
+
+    const float s = voxelSize_;
+    const int n = voxels.size();
+
+    for(int i=0; i < n; ++i){
+        const Voxel& voxel = voxels[i];
+        const Vector3i& index = voxel.index;
+
+        int exposedFaces[6];
+        int numExposedFaces = 0;
+        for(int j=0; j < 6; ++j){
+            const int* d = faceDirections[j];
+            if(voxelMap.find(Vector3i(index.x() + d[0], index.y() + d[1], index.z() + d[2])) == voxelMap.end()){
+                exposedFaces[numExposedFaces++] = j;
+            }
+        }
+        if(numExposedFaces == 0){
+            continue;
+        }
+
+        const int top = vertices.size();
+        const float x0 = (index.x() + 1) * s;
+        const float x1 = index.x() * s;
+        const float y0 = (index.y() + 1) * s;
+        const float y1 = index.y() * s;
+        const float z0 = (index.z() + 1) * s;
+        const float z1 = index.z() * s;
+        vertices.push_back(Vector3f(x0, y0, z0));
+        vertices.push_back(Vector3f(x1, y0, z0));
+        vertices.push_back(Vector3f(x1, y1, z0));
+        vertices.push_back(Vector3f(x0, y1, z0));
+        vertices.push_back(Vector3f(x0, y0, z1));
+        vertices.push_back(Vector3f(x1, y0, z1));
+        vertices.push_back(Vector3f(x1, y1, z1));
+        vertices.push_back(Vector3f(x0, y1, z1));
+
+        int colorIndex = 0;
+        if(colors){
+            colorIndex = colors->size();
+            colors->push_back(voxel.colorSum / voxel.numPoints);
+        }
+
+        for(int j=0; j < numExposedFaces; ++j){
+            const int face = exposedFaces[j];
+            const int normalIndex = faceNormalIndices[face];
+            for(int k=0; k < 2; ++k){
+                const int* tri = boxTriangles[face * 2 + k];
+                mesh->addTriangle(top + tri[0], top + tri[1], top + tri[2]);
+                for(int l=0; l < 3; ++l){
+                    normalIndices.push_back(normalIndex);
+                    if(colors){
+                        colorIndices.push_back(colorIndex);
+                    }
+                }
+            }
+        }
+    }
+
+    return mesh;
+}
@@ -0,0 +1,86 @@
+/*!
+  @file
+*/
+
+#ifndef CNOID_UTIL_VOXEL_GRID_H
+#define CNOID_UTIL_VOXEL_GRID_H
+
+#include "SceneDrawables.h"
+#include <unordered_map>
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class merges points into the cubic cells of a sparse grid whose occupied cells
+   are stored in a hash table. Each cell keeps the number, the position sum and the color
+   sum of its points, so points can be removed without rebuilding the grid.
+*/
+class CNOID_EXPORT VoxelGrid
+{
+public:
+    VoxelGrid(double voxelSize = 0.01);
+
+    //! The grid is cleared when the size is changed.
+    void setVoxelSize(double size);
+    double voxelSize() const { return voxelSize_; }
+
+    void clear();
+    bool empty() const { return voxels.empty(); }
+    int numVoxels() const { return voxels.size(); }
+
+    Vector3i voxelIndex(const Vector3f& point) const;
+    Vector3f voxelCenter(const Vector3i& index) const;
+
+    void addPoint(const Vector3f& point);
+    void addPoint(const Vector3f& point, const Vector3f& color);
+
+    //! The color is the value of the point given to addPoint.
+    bool removePoint(const Vector3f& point);
+    bool removePoint(const Vector3f& point, const Vector3f& color);
+
+    //! The colors are used when the point set has one color for each point.
+    void addPoints(const SgPointSet& pointSet);
+
+    bool hasColors() const { return hasColors_; }
+
+    /**
+       This function outputs the centroid of the points in each voxel.
+       The average colors are also output when the grid has colors.
+    */
+    void getCentroids(SgVertexArray& out_points, SgColorArray* out_colors = 0) const;
+
+    /**
+       This function creates the mesh of the voxel faces that are exposed to empty cells.
+       The faces between adjacent occupied cells are not included.
+    */
+    SgMesh* createMesh() const;
+
+private:
+    struct Voxel {
+        Vector3i index;
+        int numPoints;
+        Vector3d positionSum;
+        Vector3f colorSum;
+    };
+    struct IndexHash {
+        size_t operator()(const Vector3i& i) const {
+            return (static_cast<size_t>(i.x()) * 73856093u) ^ (static_cast<size_t>(i.y()) * 19349663u)
+                ^ (static_cast<size_t>(i.z()) * 83492791u);
+        }
+    };
+
+    double voxelSize_;
+    double invVoxelSize;
+    bool hasColors_;
+    std::vector<Voxel> voxels;
+    std::unordered_map<Vector3i, int, IndexHash> voxelMap;
+
+    Voxel& getOrCreateVoxel(const Vector3f& point);
+    bool removePointSub(const Vector3f& point, const Vector3f* color);
+};
+
+}
+
+#endif
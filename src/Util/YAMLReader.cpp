@@ -3,8 +3,13 @@
 */
 
 #include "YAMLReader.h"
+#include "DecimalNumber.h"
 #include <cerrno>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
 #include <stack>
+#include <algorithm>
 #include <iostream>
 #include <yaml.h>
 #include <boost/format.hpp>
@@ -14,7 +19,25 @@ using namespace boost;
 using namespace cnoid;
 
 namespace {
+
 const bool debugTrace = false;
+
+/*
+  The numbers that can be converted exactly by DecimalNumber are not converted by strtod,
+  which gives the same values. The string must be terminated with NUL.
+*/
+bool parseNumber(const char* s, double& out_value)
+{
+    const char* p = s;
+    DecimalNumber number;
+    if(number.scan(p, s + strlen(s)) && *p == '\0' && number.toExactDouble(out_value)){
+        return true;
+    }
+    char* endptr;
+    out_value = strtod(s, &endptr);
+    return (endptr != s);
+}
+
 }
 
 namespace cnoid {
@@ -67,6 +90,13 @@ public:
     bool isRegularMultiListingExpected;
     vector<int> expectedListingSizes;
 
+    vector<string> packedNumberListingKeys;
+    PackedNumberListing* currentPackedListing;
+    int packedListingDepth;
+    bool isPackedListingKey(const NodeInfo& info) const;
+    void onPackedListingEvent(yaml_event_t& event);
+    void setPackedListingError(const string& message, const yaml_mark_t& mark);
+
     string errorMessage;
 };
 }
@@ -85,6 +115,8 @@ YAMLReaderImpl::YAMLReaderImpl()
     mappingFactory = new YAMLReader::MappingFactory<Mapping>();
     currentDocumentIndex = 0;
     isRegularMultiListingExpected = false;
+    currentPackedListing = nullptr;
+    packedListingDepth = 0;
 }
 
 
@@ -126,6 +158,20 @@ void YAMLReader::expectRegularMultiListing()
 }
 
 
+/**
+   The listings which are the values of the given key are read as PackedNumberListing.
+   Each element of such a listing must be a listing of numbers, and the numbers are stored
+   without creating the scalar nodes. This function can be called for multiple keys.
+*/
+void YAMLReader::packNumberListings(const std::string& key)
+{
+    auto& keys = impl->packedNumberListingKeys;
+    if(std::find(keys.begin(), keys.end(), key) == keys.end()){
+        keys.push_back(key);
+    }
+}
+
+
 void YAMLReader::clearDocuments()
 {
     impl->clearDocuments();
@@ -139,6 +185,8 @@ void YAMLReaderImpl::clearDocuments()
     }
     anchorMap.clear();
     documents.clear();
+    currentPackedListing = nullptr;
+    packedListingDepth = 0;
 }
 
 
@@ -222,6 +270,12 @@ bool YAMLReaderImpl::parse()
             goto error;
         }
 
+        if(currentPackedListing){
+            onPackedListingEvent(event);
+            yaml_event_delete(&event);
+            continue;
+        }
+
         switch(event.type){
             
         case YAML_STREAM_START_EVENT:
@@ -383,7 +437,11 @@ void YAMLReaderImpl::onListingStart(yaml_event_t& event)
 
     const yaml_mark_t& mark = event.start_mark;
 
-    if(!isRegularMultiListingExpected){
+    if(!nodeStack.empty() && isPackedListingKey(nodeStack.top())){
+        currentPackedListing = new PackedNumberListing(mark.line, mark.column);
+        packedListingDepth = 0;
+        listing = currentPackedListing;
+    } else if(!isRegularMultiListingExpected){
         listing = new Listing(mark.line, mark.column);
     } else {
         size_t level = nodeStack.size();
@@ -420,6 +478,102 @@ void YAMLReaderImpl::onListingEnd(yaml_event_t&)
 }
 
 
+bool YAMLReaderImpl::isPackedListingKey(const NodeInfo& info) const
+{
+    if(packedNumberListingKeys.empty() || !info.node->isMapping()){
+        return false;
+    }
+    return std::find(packedNumberListingKeys.begin(), packedNumberListingKeys.end(), info.key)
+        != packedNumberListingKeys.end();
+}
+
+
+/*
+  The events in a packed listing are processed here instead of the ordinary handlers.
+  An invalid value does not throw an exception because the listing may be a part of
+  the data which is not read by the application. The error is reported when the listing
+  is checked by PackedNumberListing::checkValidity.
+*/
+void YAMLReaderImpl::onPackedListingEvent(yaml_event_t& event)
+{
+    PackedNumberListing::Data& data = *currentPackedListing->data;
+    const bool isValid = data.errorMessage.empty();
+    const yaml_mark_t& mark = event.start_mark;
+    
+    switch(event.type){
+
+    case YAML_SEQUENCE_START_EVENT:
+        if(packedListingDepth == 0 && isValid){
+            data.lines.push_back(mark.line + 1);
+            data.columns.push_back(mark.column + 1);
+        }
+        ++packedListingDepth;
+        break;
+
+    case YAML_SEQUENCE_END_EVENT:
+        if(packedListingDepth > 0){
+            --packedListingDepth;
+            if(packedListingDepth == 0 && isValid){
+                data.offsets.push_back(data.values.size());
+            }
+        } else {
+            if(!isValid){
+                vector<double>().swap(data.values);
+                vector<size_t>(1, 0).swap(data.offsets);
+                vector<int>().swap(data.lines);
+                vector<int>().swap(data.columns);
+            }
+            currentPackedListing = nullptr;
+            popNode();
+        }
+        break;
+
+    case YAML_SCALAR_EVENT:
+        if(isValid){
+            const char* value = (const char*)event.data.scalar.value;
+            double number;
+            if(packedListingDepth == 0){
+                setPackedListingError("The element must be a listing of numbers", mark);
+            } else if(!parseNumber(value, number)){
+                setPackedListingError(str(format("The value \"%1%\" must be a double value") % value), mark);
+            } else {
+                data.values.push_back(number);
+            }
+        }
+        break;
+
+    case YAML_MAPPING_START_EVENT:
+        if(isValid){
+            setPackedListingError("A mapping cannot be put in the listing of numbers", mark);
+        }
+        ++packedListingDepth;
+        break;
+
+    case YAML_MAPPING_END_EVENT:
+        --packedListingDepth;
+        break;
+
+    case YAML_ALIAS_EVENT:
+        if(isValid){
+            setPackedListingError("An alias cannot be put in the listing of numbers", mark);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+void YAMLReaderImpl::setPackedListingError(const string& message, const yaml_mark_t& mark)
+{
+    PackedNumberListing::Data& data = *currentPackedListing->data;
+    data.errorMessage = message;
+    data.errorLine = mark.line + 1;
+    data.errorColumn = mark.column + 1;
+}
+
+
 void YAMLReaderImpl::onScalar(yaml_event_t& event)
 {
     if(debugTrace){
@@ -35,6 +35,7 @@ public:
     }
         
     void expectRegularMultiListing();
+    void packNumberListings(const std::string& key);
 #ifdef CNOID_BACKWARD_COMPATIBILITY
     void expectRegularMultiSequence() { expectRegularMultiListing(); }
     bool load_string(const std::string& yamlstring) { return parse(yamlstring); }
@@ -4,15 +4,167 @@
 
 #include "YAMLWriter.h"
 #include "NullOut.h"
+#include "DecimalNumber.h"
 #include <boost/tokenizer.hpp>
 #include <iostream>
 #include <algorithm>
 #include <stack>
 #include <fstream>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
 
 using namespace std;
 using namespace cnoid;
 
+namespace {
+
+/**
+   This function returns the precision of the format if it is "%g" or "%.Ng" and the
+   output of the format can be produced by formatDoubleInGeneralFormat. Otherwise -1.
+*/
+int getGeneralFormatPrecision(const char* format)
+{
+    if(format[0] != '%'){
+        return -1;
+    }
+    if(format[1] == 'g' && format[2] == '\0'){
+        return 6;
+    }
+    if(format[1] != '.'){
+        return -1;
+    }
+    int precision = 0;
+    const char* p = format + 2;
+    while(*p >= '0' && *p <= '9' && precision < 100){
+        precision = precision * 10 + (*p++ - '0');
+    }
+    if(p == format + 2 || p[0] != 'g' || p[1] != '\0'){
+        return -1;
+    }
+    if(precision == 0){
+        precision = 1;
+    }
+    return (precision <= 15) ? precision : -1;
+}
+
+/**
+   This function gives the same output as snprintf with "%.Ng", where N is the precision.
+   The significand is obtained by one multiplication or division with an exact power of ten,
+   so its error is less than one ulp. The output is determined only when the error does not
+   affect the rounding to the precision, and otherwise false is returned.
+*/
+bool formatDoubleInGeneralFormat(double value, int precision, char* buf, int& out_length)
+{
+    if(!std::isfinite(value)){
+        return false;
+    }
+    char* p = buf;
+    if(std::signbit(value)){
+        *p++ = '-';
+        value = -value;
+    }
+    if(value == 0.0){
+        *p++ = '0';
+        *p = '\0';
+        out_length = p - buf;
+        return true;
+    }
+
+    const double lower = exactPowersOf10[precision - 1];
+    const double upper = exactPowersOf10[precision];
+    int exponent = static_cast<int>(std::floor(std::log10(value)));
+    double scaled = 0.0;
+    for(int i=0; i < 2; ++i){
+        const int k = precision - 1 - exponent;
+        if(k > 22 || k < -22){
+            return false;
+        }
+        scaled = (k >= 0) ? (value * exactPowersOf10[k]) : (value / exactPowersOf10[-k]);
+        if(scaled < lower){
+            --exponent;
+        } else if(scaled >= upper){
+            ++exponent;
+        } else {
+            break;
+        }
+    }
+    if(scaled < lower || scaled >= upper){
+        return false;
+    }
+
+    double integral = std::floor(scaled);
+    const double fraction = scaled - integral;
+    if(std::fabs(fraction - 0.5) <= scaled * 4.0e-16){
+        return false;
+    }
+    uint64_t significand = static_cast<uint64_t>(integral);
+    if(fraction > 0.5){
+        ++significand;
+        if(significand == static_cast<uint64_t>(upper)){
+            significand /= 10;
+            ++exponent;
+        }
+    }
+
+    char digits[16];
+    for(int i = precision - 1; i >= 0; --i){
+        digits[i] = '0' + (significand % 10);
+        significand /= 10;
+    }
+    int numDigits = precision;
+    while(numDigits > 1 && digits[numDigits - 1] == '0'){
+        --numDigits;
+    }
+
+    if(exponent < -4 || exponent >= precision){
+        *p++ = digits[0];
+        if(numDigits > 1){
+            *p++ = '.';
+            for(int i=1; i < numDigits; ++i){
+                *p++ = digits[i];
+            }
+        }
+        *p++ = 'e';
+        if(exponent < 0){
+            *p++ = '-';
+            exponent = -exponent;
+        } else {
+            *p++ = '+';
+        }
+        if(exponent >= 100){
+            *p++ = '0' + exponent / 100;
+            exponent %= 100;
+        }
+        *p++ = '0' + exponent / 10;
+        *p++ = '0' + exponent % 10;
+    } else if(exponent >= 0){
+        for(int i=0; i <= exponent; ++i){
+            *p++ = digits[i];
+        }
+        if(numDigits > exponent + 1){
+            *p++ = '.';
+            for(int i = exponent + 1; i < numDigits; ++i){
+                *p++ = digits[i];
+            }
+        }
+    } else {
+        *p++ = '0';
+        *p++ = '.';
+        for(int i = exponent + 1; i < 0; ++i){
+            *p++ = '0';
+        }
+        for(int i=0; i < numDigits; ++i){
+            *p++ = digits[i];
+        }
+    }
+    *p = '\0';
+    out_length = p - buf;
+    return true;
+}
+
+}
+
 namespace cnoid {
 
 enum { TOP, MAPPING, LISTING };
@@ -39,6 +191,8 @@ public:
     bool doInsertLineFeed;
 
     const char* doubleFormat;
+    int doublePrecision;
+    string buf;
 
     std::stack<State> states;
 
@@ -58,6 +212,9 @@ public:
     bool makeValuePutReady();
     bool startValuePut();
     void endValuePut();
+    int formatDouble(double value, char* buf);
+    void appendDouble(double value);
+    void putFlowStyleListing(const double* values, int size, int subListingSize);
     template<class StringType> void putString(const StringType& value);
     template<class StringType> void putSingleQuotedString(const StringType& value);
     template<class StringType> void putDoubleQuotedString(const StringType& value);
@@ -106,6 +263,7 @@ YAMLWriterImpl::YAMLWriterImpl(std::ostream& os)
     messageSink_ = &nullout();
 
     doubleFormat = "%.7g";
+    doublePrecision = 7;
 
     pushState(TOP, false);
 
@@ -421,14 +579,25 @@ void YAMLWriter::putScalar(int value)
 }
 
 
-void YAMLWriter::putScalar(double value)
+int YAMLWriterImpl::formatDouble(double value, char* buf)
 {
-    char buf[32];
+    int length;
+    if(doublePrecision > 0 && formatDoubleInGeneralFormat(value, doublePrecision, buf, length)){
+        return length;
+    }
 #ifdef _WIN32
-    _snprintf(buf, 32, impl->doubleFormat, value);
+    length = _snprintf(buf, 32, doubleFormat, value);
 #else
-    snprintf(buf, 32, impl->doubleFormat, value);
+    length = snprintf(buf, 32, doubleFormat, value);
 #endif
+    return std::min(std::max(length, 0), 31);
+}
+
+
+void YAMLWriter::putScalar(double value)
+{
+    char buf[32];
+    impl->formatDouble(value, buf);
     impl->putString(buf);
 }
 
@@ -436,6 +605,7 @@ void YAMLWriter::putScalar(double value)
 void YAMLWriter::setDoubleFormat(const char* format)
 {
     impl->doubleFormat = format;
+    impl->doublePrecision = getGeneralFormatPrecision(format);
 }
 
 
@@ -574,6 +744,62 @@ void YAMLWriter::endListing()
 }
 
 
+/**
+   This function puts a flow-style listing of the given values with one output to the stream.
+   The output is the same as the one by startFlowStyleListing, putScalar for each value and
+   endListing. If subListingSize is specified, the values are put as the nested flow-style
+   listings with that number of values.
+*/
+void YAMLWriter::putFlowStyleListing(const double* values, int size, int subListingSize)
+{
+    impl->putFlowStyleListing(values, size, subListingSize);
+}
+
+
+void YAMLWriterImpl::appendDouble(double value)
+{
+    char s[32];
+    const int length = formatDouble(value, s);
+    buf.append(s, length);
+}
+
+
+void YAMLWriterImpl::putFlowStyleListing(const double* values, int size, int subListingSize)
+{
+    if(startValuePut()){
+        buf.clear();
+        buf += "[ ";
+        if(subListingSize <= 0){
+            for(int i=0; i < size; ++i){
+                if(i > 0){
+                    buf += ", ";
+                }
+                appendDouble(values[i]);
+            }
+        } else {
+            for(int i=0; i < size; i += subListingSize){
+                if(i > 0){
+                    buf += ", ";
+                }
+                buf += "[ ";
+                const int n = std::min(subListingSize, size - i);
+                for(int j=0; j < n; ++j){
+                    if(j > 0){
+                        buf += ", ";
+                    }
+                    appendDouble(values[i + j]);
+                }
+                buf += " ]";
+            }
+        }
+        buf += " ]";
+        os.write(buf.data(), buf.size());
+        isCurrentNewLine = false;
+        endValuePut();
+    }
+}
+
+
 void YAMLWriter::putNode(const ValueNode* node)
 {
     impl->putNodeMain(node, false);
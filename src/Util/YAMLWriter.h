@@ -75,6 +75,8 @@ public:
     void startFlowStyleListing();
     void endListing();
 
+    void putFlowStyleListing(const double* values, int size, int subListingSize = 0);
+
     const Mapping* info() const;
     Mapping* info();
     
@@ -0,0 +1,209 @@
+/**
+   This test checks that the seqs and body motions are restored from the binary seq files
+   and that a broken header is rejected.
+*/
+
+#include <cnoid/BodyMotion>
+#include <cnoid/ZMPSeq>
+#include <cnoid/MultiVector3Seq>
+#include <cnoid/BinarySeqFile>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <cmath>
+#include <cstdint>
+#include "TestUtil.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+void createMotion(BodyMotion& motion)
+{
+    const int numFrames = 50;
+    motion.setFrameRate(200.0);
+    motion.setDimension(numFrames, 3, 2);
+    auto zmpSeq = motion.getOrCreateExtraSeq<ZMPSeq>(ZMPSeq::key());
+    zmpSeq->setSeqContentName(ZMPSeq::key());
+    zmpSeq->setRootRelative(true);
+    auto forceSeq = motion.getOrCreateExtraSeq<MultiVector3Seq>("Forces");
+    forceSeq->setSeqContentName("Forces");
+    forceSeq->setDimension(numFrames, 2);
+
+    for(int i=0; i < numFrames; ++i){
+        const double t = i / 200.0;
+        auto q = motion.jointPosSeq()->frame(i);
+        for(int j=0; j < q.size(); ++j){
+            q[j] = std::sin(t * (j + 1)) / 3.0;
+        }
+        auto p = motion.linkPosSeq()->frame(i);
+        for(int j=0; j < p.size(); ++j){
+            p[j].translation() = Vector3(t, j / 7.0, -t / 3.0);
+            p[j].rotation() = Quat(AngleAxis(t + j, Vector3(1.0, 2.0, 3.0).normalized()));
+        }
+        (*zmpSeq)[i] = Vector3(t / 9.0, -t, 0.0);
+        for(int j=0; j < 2; ++j){
+            forceSeq->frame(i)[j] = Vector3(j, t * 11.0, -1.0 / 3.0);
+        }
+    }
+    motion.setOffsetTime(0.25);
+}
+
+double maxDifference(BodyMotion& motion1, BodyMotion& motion2)
+{
+    const double infinity = 1.0e10;
+    
+    if(motion1.numFrames() != motion2.numFrames() ||
+       motion1.numJoints() != motion2.numJoints() ||
+       motion1.numLinks() != motion2.numLinks() ||
+       motion1.frameRate() != motion2.frameRate() ||
+       motion1.getOffsetTime() != motion2.getOffsetTime()){
+        return infinity;
+    }
+    auto zmpSeq1 = motion1.extraSeq<ZMPSeq>(ZMPSeq::key());
+    auto zmpSeq2 = motion2.extraSeq<ZMPSeq>(ZMPSeq::key());
+    auto forceSeq1 = motion1.extraSeq<MultiVector3Seq>("Forces");
+    auto forceSeq2 = motion2.extraSeq<MultiVector3Seq>("Forces");
+    if(!zmpSeq2 || zmpSeq2->isRootRelative() != zmpSeq1->isRootRelative() ||
+       !forceSeq2 || forceSeq2->numParts() != forceSeq1->numParts()){
+        return infinity;
+    }
+
+    double d = 0.0;
+    for(int i=0; i < motion1.numFrames(); ++i){
+        auto q1 = motion1.jointPosSeq()->frame(i);
+        auto q2 = motion2.jointPosSeq()->frame(i);
+        for(int j=0; j < q1.size(); ++j){
+            d = std::max(d, std::fabs(q1[j] - q2[j]));
+        }
+        auto p1 = motion1.linkPosSeq()->frame(i);
+        auto p2 = motion2.linkPosSeq()->frame(i);
+        for(int j=0; j < p1.size(); ++j){
+            d = std::max(d, (p1[j].translation() - p2[j].translation()).cwiseAbs().maxCoeff());
+            d = std::max(d, (p1[j].rotation().coeffs() - p2[j].rotation().coeffs()).cwiseAbs().maxCoeff());
+        }
+        d = std::max(d, ((*zmpSeq1)[i] - (*zmpSeq2)[i]).cwiseAbs().maxCoeff());
+        for(int j=0; j < forceSeq1->numParts(); ++j){
+            d = std::max(d, (forceSeq1->frame(i)[j] - forceSeq2->frame(i)[j]).cwiseAbs().maxCoeff());
+        }
+    }
+    return d;
+}
+
+void testBodyMotion()
+{
+    BodyMotion motion;
+    createMotion(motion);
+
+    const char* filename = "test-body-motion.bseq";
+    
+    for(int type = BinarySeqWriter::FLOAT64; type <= BinarySeqWriter::FLOAT32; ++type){
+        for(int layout = BinarySeqWriter::FRAME_MAJOR; layout <= BinarySeqWriter::PART_MAJOR; ++layout){
+            const string condition = string(type == BinarySeqWriter::FLOAT64 ? "float64" : "float32") +
+                (layout == BinarySeqWriter::FRAME_MAJOR ? ", frame-major" : ", part-major");
+            bool saved = motion.saveAsBinaryFormat(
+                filename, cerr, static_cast<BinarySeqWriter::ElementType>(type), static_cast<BinarySeqWriter::Layout>(layout));
+            check(saved, "saving a body motion (" + condition + ")");
+            BodyMotion motion2;
+            check(motion2.loadBinaryFormat(filename, cerr), "loading a body motion (" + condition + ")");
+            const double tolerance = (type == BinarySeqWriter::FLOAT64) ? 0.0 : 1.0e-6;
+            check(maxDifference(motion, motion2) <= tolerance, "restoring a body motion (" + condition + ")");
+        }
+    }
+}
+
+void testSingleSeq()
+{
+    BodyMotion motion;
+    createMotion(motion);
+    auto seq = motion.jointPosSeq();
+
+    const char* filename = "test-multi-value-seq.bseq";
+    check(saveSeqAsBinaryFile(seq.get(), filename, cerr), "saving a multi value seq");
+
+    MultiValueSeq seq2;
+    check(loadSeqFromBinaryFile(&seq2, filename, cerr), "loading a multi value seq");
+    bool isSame = seq2.numFrames() == seq->numFrames() && seq2.numParts() == seq->numParts();
+    for(int i=0; isSame && i < seq->numFrames(); ++i){
+        for(int j=0; j < seq->numParts(); ++j){
+            isSame &= (seq2.frame(i)[j] == seq->frame(i)[j]);
+        }
+    }
+    check(isSame, "restoring a multi value seq");
+
+    MultiSE3Seq seq3;
+    check(!loadSeqFromBinaryFile(&seq3, filename), "rejecting a seq of another type");
+}
+
+void putString(ofstream& file, const string& s)
+{
+    uint32_t size = s.size();
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    file.write(s.data(), s.size());
+}
+
+template<class T> void put(ofstream& file, T value)
+{
+    file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void align(ofstream& file)
+{
+    while(file.tellp() % 8){
+        file.put(0);
+    }
+}
+
+/**
+   The product of the numbers of frames and parts and the value size is 32 in the 64-bit
+   unsigned arithmetic, which is the actual data size in the file.
+*/
+void testOverflowingHeader()
+{
+    const char* filename = "test-overflowing-header.bseq";
+    {
+        ofstream file(filename, ios::out | ios::binary | ios::trunc);
+        file.write("CNOIDSEQ", 8);
+        put<uint32_t>(file, 1);
+        put<uint32_t>(file, 0x01020304);
+        putString(file, "MultiValueSeq");
+        putString(file, "");
+        align(file);
+        putString(file, "MultiValueSeq");
+        putString(file, "");
+        align(file);
+        put<double>(file, 100.0);
+        put<double>(file, 0.0);
+        put<int64_t>(file, 1824726041);
+        put<int32_t>(file, 1263665316);
+        put<int32_t>(file, 1);
+        put<uint8_t>(file, BinarySeqWriter::FLOAT64);
+        put<uint8_t>(file, BinarySeqWriter::FRAME_MAJOR);
+        put<uint16_t>(file, 0);
+        put<uint32_t>(file, 0);
+        put<uint32_t>(file, 0);
+        align(file);
+        put<uint64_t>(file, 32);
+        for(int i=0; i < 4; ++i){
+            put<double>(file, i);
+        }
+    }
+    BinarySeqReader reader;
+    check(!reader.open(filename), "rejecting a header whose data size overflows");
+}
+
+}
+
+int main()
+{
+    testBodyMotion();
+    testSingleSeq();
+    testOverflowingHeader();
+
+    if(numErrors > 0){
+        cerr << numErrors << " check(s) failed." << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+/**
+   This test checks that the sweep and prune broadphase of AISTCollisionDetector gives the
+   same contacts as the all-pairs mode. Randomly placed boxes are moved to new random
+   positions in every step, and the collision pairs and their contacts are compared in
+   the order given by the detector. The detection time of both modes is also reported.
+*/
+
+#include <cnoid/AISTCollisionDetector>
+#include <cnoid/MeshGenerator>
+#include <cnoid/SceneDrawables>
+#include <boost/format.hpp>
+#include <iostream>
+#include <vector>
+#include <map>
+#include <random>
+#include <chrono>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+
+namespace {
+
+const int numBoxes = 400;
+const int numSteps = 50;
+
+// The geometries are identified by the order of the addition because the handles depend on the detector
+struct PairContacts {
+    int geometries[2];
+    CollisionArray collisions;
+};
+
+typedef vector<vector<PairContacts>> ContactHistory;
+
+/**
+   \param range The boxes are placed in the cube whose edges have this length.
+   A smaller range makes more overlapping pairs.
+*/
+double detect(bool isBroadphaseEnabled, double range, ContactHistory& out_history)
+{
+    AISTCollisionDetectorPtr detector = new AISTCollisionDetector;
+    detector->setBroadphaseEnabled(isBroadphaseEnabled);
+
+    MeshGenerator generator;
+    vector<CollisionDetector::GeometryHandle> handles;
+    map<CollisionDetector::GeometryHandle, int> handleToIndex;
+    for(int i=0; i < numBoxes; ++i){
+        SgShapePtr shape = new SgShape;
+        shape->setMesh(generator.generateBox(Vector3(0.1, 0.2, 0.3)));
+        if(auto handle = detector->addGeometry(shape)){
+            handleToIndex[*handle] = handles.size();
+            handles.push_back(*handle);
+        }
+    }
+    detector->makeReady();
+
+    // The same sequence of the positions is given to both modes
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> positionDistribution(-range / 2.0, range / 2.0);
+    std::uniform_real_distribution<double> angleDistribution(-M_PI, M_PI);
+
+    out_history.clear();
+    std::chrono::duration<double> detectionTime(0.0);
+
+    for(int i=0; i < numSteps; ++i){
+        for(auto handle : handles){
+            Position T = Position::Identity();
+            T.translation() = Vector3(positionDistribution(random), positionDistribution(random), positionDistribution(random));
+            T.linear() = AngleAxis(angleDistribution(random), Vector3(1.0, 1.0, 1.0).normalized()).toRotationMatrix();
+            detector->updatePosition(handle, T);
+        }
+        out_history.emplace_back();
+        auto& pairs = out_history.back();
+        auto start = std::chrono::steady_clock::now();
+        detector->detectCollisions(
+            [&](const CollisionPair& collisionPair){
+                pairs.emplace_back();
+                pairs.back().geometries[0] = handleToIndex[collisionPair.geometry(0)];
+                pairs.back().geometries[1] = handleToIndex[collisionPair.geometry(1)];
+                pairs.back().collisions = collisionPair.collisions();
+            });
+        detectionTime += std::chrono::steady_clock::now() - start;
+    }
+
+    return detectionTime.count();
+}
+
+
+bool isSameCollision(const Collision& c1, const Collision& c2)
+{
+    return c1.point == c2.point && c1.normal == c2.normal && c1.depth == c2.depth;
+}
+
+
+bool isSame(const ContactHistory& history1, const ContactHistory& history2)
+{
+    if(history1.size() != history2.size()){
+        return false;
+    }
+    for(size_t i=0; i < history1.size(); ++i){
+        auto& pairs1 = history1[i];
+        auto& pairs2 = history2[i];
+        if(pairs1.size() != pairs2.size()){
+            return false;
+        }
+        for(size_t j=0; j < pairs1.size(); ++j){
+            auto& p1 = pairs1[j];
+            auto& p2 = pairs2[j];
+            if(p1.geometries[0] != p2.geometries[0] || p1.geometries[1] != p2.geometries[1] ||
+               p1.collisions.size() != p2.collisions.size()){
+                return false;
+            }
+            for(size_t k=0; k < p1.collisions.size(); ++k){
+                if(!isSameCollision(p1.collisions[k], p2.collisions[k])){
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+
+int countContacts(const ContactHistory& history)
+{
+    int n = 0;
+    for(auto& pairs : history){
+        for(auto& pair : pairs){
+            n += pair.collisions.size();
+        }
+    }
+    return n;
+}
+
+}
+
+int main()
+{
+    int numErrors = 0;
+
+    cout << "layout   contacts   all-pairs [s]   broadphase [s]" << endl;
+
+    for(double range : { 20.0, 3.0 }){
+        ContactHistory allPairsHistory;
+        ContactHistory broadphaseHistory;
+        const double allPairsTime = detect(false, range, allPairsHistory);
+        const double broadphaseTime = detect(true, range, broadphaseHistory);
+        const char* layout = (range > 10.0) ? "sparse" : "dense";
+
+        cout << format("%-6s   %8d   %13.3f   %14.3f")
+            % layout % countContacts(allPairsHistory) % allPairsTime % broadphaseTime << endl;
+
+        if(countContacts(allPairsHistory) == 0){
+            cerr << "Failed: no contact is detected in the " << layout << " layout." << endl;
+            ++numErrors;
+        }
+        if(!isSame(allPairsHistory, broadphaseHistory)){
+            cerr << "Failed: the contacts of the broadphase are different from the ones of all pairs in the "
+                 << layout << " layout." << endl;
+            ++numErrors;
+        }
+    }
+
+    return (numErrors > 0) ? 1 : 0;
+}
@@ -0,0 +1,182 @@
+/**
+   This test checks that the forward kinematics and the Jacobians calculated by
+   CompiledKinematics are the same as the ones calculated by the Link objects.
+   A branched body with general and axis-aligned revolute joints, prismatic joints and
+   fixed joints is built in code, and the results with random joint positions and velocities
+   are compared bit by bit with Body::calcForwardKinematics and setJacobian.
+*/
+
+#include <cnoid/Body>
+#include <cnoid/CompiledKinematics>
+#include <cnoid/JointPath>
+#include <cnoid/Jacobian>
+#include <cnoid/EigenUtil>
+#include <iostream>
+#include <string>
+#include <cstring>
+#include "TestUtil.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+/**
+   Each link is connected to a random preceding link, so the tree has many branches.
+   Half of the revolute and prismatic joints have the axes along the axes of the local frame
+   because the rotations of such revolute joints are calculated differently.
+*/
+BodyPtr createBody(int numLinks)
+{
+    BodyPtr body = new Body;
+    vector<Link*> links;
+    Link* root = body->createLink();
+    root->setJointType(Link::FREE_JOINT);
+    body->setRootLink(root);
+    links.push_back(root);
+
+    int jointId = 0;
+    for(int i=1; i < numLinks; ++i){
+        Link* link = body->createLink();
+        const int type = randomInt(5);
+        if(type == 0){
+            link->setJointType(Link::FIXED_JOINT);
+        } else {
+            link->setJointType((type <= 2) ? Link::REVOLUTE_JOINT : Link::PRISMATIC_JOINT);
+            link->setJointId(jointId++);
+            if(type % 2 == 0){
+                link->setJointAxis(randomVector(-1.0, 1.0).normalized());
+            } else {
+                Vector3 axis = Vector3::Zero();
+                axis[randomInt(3)] = (randomInt(2) == 0) ? 1.0 : -1.0;
+                link->setJointAxis(axis);
+            }
+        }
+        link->setOffsetTranslation(randomVector(-0.3, 0.3));
+        if(randomInt(2) == 0){
+            link->setOffsetRotation(randomRotation());
+        }
+        links[randomInt(links.size())]->appendChild(link);
+        links.push_back(link);
+    }
+    body->updateLinkTree();
+    return body;
+}
+
+void setRandomState(Body* body)
+{
+    Link* root = body->rootLink();
+    root->p() = randomVector(-1.0, 1.0);
+    root->R() = randomRotation();
+    root->v() = randomVector(-1.0, 1.0);
+    root->w() = randomVector(-1.0, 1.0);
+    for(int i=0; i < body->numJoints(); ++i){
+        body->joint(i)->q() = random(-3.0, 3.0);
+        body->joint(i)->dq() = random(-2.0, 2.0);
+    }
+}
+
+template<class Derived1, class Derived2>
+bool isSame(const Eigen::MatrixBase<Derived1>& m1, const Eigen::MatrixBase<Derived2>& m2)
+{
+    if(m1.rows() != m2.rows() || m1.cols() != m2.cols()){
+        return false;
+    }
+    for(int j=0; j < m1.cols(); ++j){
+        for(int i=0; i < m1.rows(); ++i){
+            const double v1 = m1(i, j);
+            const double v2 = m2(i, j);
+            if(std::memcmp(&v1, &v2, sizeof(double)) != 0){
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void checkForwardKinematics(Body* body, CompiledKinematics& kinematics, bool isWrittenBack)
+{
+    for(int i=0; i < body->numLinks(); ++i){
+        Link* link = body->link(i);
+        const string name = "link " + std::to_string(i) + (isWrittenBack ? " written back" : "");
+        check(isSame(kinematics.R(i), link->R()), "the rotation of " + name + " is different");
+        check(isSame(kinematics.p(i), link->p()), "the position of " + name + " is different");
+        check(isSame(kinematics.v(i), link->v()), "the linear velocity of " + name + " is different");
+        check(isSame(kinematics.w(i), link->w()), "the angular velocity of " + name + " is different");
+    }
+}
+
+void checkJacobians(Body* body, CompiledKinematics& kinematics)
+{
+    const int n = body->numJoints();
+    const Vector3 localPosition = randomVector(-0.2, 0.2);
+    MatrixXd J, Jpath, Jexpected;
+
+    for(int i=1; i < body->numLinks(); ++i){
+        Link* link = body->link(i);
+        JointPath path(body->rootLink(), link);
+        const int m = path.numJoints();
+        Jpath.resize(6, m);
+
+        for(int j=0; j < 2; ++j){
+            const bool useLocalPosition = (j == 1);
+            if(useLocalPosition){
+                setJacobian<0x3f, 0, 0, true>(path, link, localPosition, Jpath);
+                kinematics.calcJacobian(i, localPosition, J);
+            } else {
+                setJacobian<0x3f, 0, 0>(path, link, Jpath);
+                kinematics.calcJacobian(i, J);
+            }
+            Jexpected.setZero(6, n);
+            for(int k=0; k < m; ++k){
+                Jexpected.col(path.joint(k)->jointId()) = Jpath.col(k);
+            }
+            check(isSame(J, Jexpected), "the Jacobian of link " + std::to_string(i) +
+                  (useLocalPosition ? " at a local position" : "") + " is different");
+        }
+    }
+}
+
+}
+
+int main()
+{
+    BodyPtr body = createBody(40);
+    CompiledKinematics kinematics(body);
+    check(kinematics.numLinks() == body->numLinks() && kinematics.numJoints() == body->numJoints(),
+          "the numbers of the links and joints are different");
+
+    for(int i=0; i < 10; ++i){
+        setRandomState(body);
+        kinematics.readStateFromBody();
+        body->calcForwardKinematics(true);
+        kinematics.calcForwardKinematics(true);
+        checkForwardKinematics(body, kinematics, false);
+        checkJacobians(body, kinematics);
+
+        // The joint positions set to the compiled kinematics are written back to the links
+        VectorXd q(body->numJoints());
+        VectorXd dq(body->numJoints());
+        for(int j=0; j < q.size(); ++j){
+            q[j] = random(-3.0, 3.0);
+            dq[j] = random(-2.0, 2.0);
+        }
+        kinematics.setJointPositions(q);
+        kinematics.setJointVelocities(dq);
+        kinematics.calcForwardKinematics(true);
+        kinematics.writeStateToBody(true);
+        for(int j=0; j < q.size(); ++j){
+            check(body->joint(j)->q() == q[j] && body->joint(j)->dq() == dq[j],
+                  "the joint state " + std::to_string(j) + " is not written back");
+        }
+        checkForwardKinematics(body, kinematics, true);
+        body->calcForwardKinematics(true);
+        checkForwardKinematics(body, kinematics, false);
+
+        if(numErrors > 0){
+            break;
+        }
+    }
+
+    return (numErrors > 0) ? 1 : 0;
+}
@@ -0,0 +1,79 @@
+/**
+   This test checks that the columns of the constraint acceleration matrix calculated
+   by the worker threads are the same as the ones calculated by a single thread.
+   The matrix is internal to the solver, so the states of the bodies in a scene with
+   many contacts are compared instead. Any difference in the matrix changes the solved
+   contact forces and the states.
+*/
+
+#include "TestBodies.h"
+#include <cnoid/BatchSimulator>
+#include <cnoid/ConstraintForceSolver>
+#include <cnoid/DyBody>
+#include <iostream>
+#include <vector>
+#include <cstring>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+vector<double> simulate(int numThreads, bool isIslandDecompositionEnabled)
+{
+    BatchSimulator simulator;
+    simulator.setTimeStep(0.001);
+    simulator.setMaterialTableFile("");
+
+    // The boxes are stacked with small overlaps so that they are in contact from the beginning
+    addFloor(simulator, 4.0, 4.0);
+    addBoxStack(simulator, 3, 0.1, 0.0);
+
+    ConstraintForceSolver& solver = simulator.constraintForceSolver();
+    solver.setNumThreads(numThreads);
+    solver.setIslandDecompositionEnabled(isIslandDecompositionEnabled);
+
+    vector<double> states;
+    if(!simulator.initialize()){
+        return states;
+    }
+    for(int i=0; i < 100; ++i){
+        simulator.step();
+    }
+    for(int i=0; i < simulator.numBodies(); ++i){
+        DyLink* link = simulator.body(i)->rootLink();
+        states.insert(states.end(), link->p().data(), link->p().data() + 3);
+        states.insert(states.end(), link->R().data(), link->R().data() + 9);
+        states.insert(states.end(), link->v().data(), link->v().data() + 3);
+        states.insert(states.end(), link->w().data(), link->w().data() + 3);
+    }
+    return states;
+}
+
+
+bool isSame(const vector<double>& states1, const vector<double>& states2)
+{
+    return !states1.empty() && states1.size() == states2.size() &&
+        memcmp(states1.data(), states2.data(), states1.size() * sizeof(double)) == 0;
+}
+
+}
+
+int main()
+{
+    int numErrors = 0;
+
+    for(int i=0; i < 2; ++i){
+        const bool isIslandDecompositionEnabled = (i == 1);
+        const vector<double> states = simulate(1, isIslandDecompositionEnabled);
+        for(int numThreads : { 2, 4 }){
+            if(!isSame(states, simulate(numThreads, isIslandDecompositionEnabled))){
+                cerr << "Failed: the states with " << numThreads << " threads are different from the ones with a single thread"
+                     << (isIslandDecompositionEnabled ? " (island decomposition)." : ".") << endl;
+                ++numErrors;
+            }
+        }
+    }
+
+    return (numErrors > 0) ? 1 : 0;
+}
@@ -0,0 +1,113 @@
+/**
+   This benchmark measures how the step time of the constraint force solver scales with
+   the number of independent robots. Each robot is a chain of box links connected by
+   revolute joints and lying on a floor, so that a robot is a contact island coupled by
+   its joints and its contacts. The step time is measured with a single LCP, with the
+   islands solved by a single thread and with the islands solved by the worker threads.
+
+   Usage: bench-constraint-islands [number of robots ...]
+*/
+
+#include "TestBodies.h"
+#include <cnoid/BatchSimulator>
+#include <cnoid/ConstraintForceSolver>
+#include <boost/format.hpp>
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+
+namespace {
+
+const int numRobotLinks = 4;
+const double linkLength = 0.2;
+const double linkWidth = 0.1;
+const int numMeasuredSteps = 20;
+
+BodyPtr createChainRobot()
+{
+    BodyPtr robot = createBox(Vector3(linkLength, linkWidth, linkWidth), false);
+    Link* parent = robot->rootLink();
+    for(int i=1; i < numRobotLinks; ++i){
+        BodyPtr linkBody = createBox(Vector3(linkLength, linkWidth, linkWidth), false);
+        Link* link = linkBody->rootLink();
+        link->setJointType(Link::REVOLUTE_JOINT);
+        link->setJointAxis(Vector3::UnitZ());
+        link->setJointId(i - 1);
+        link->setOffsetTranslation(Vector3(linkLength * 1.05, 0.0, 0.0));
+        parent->appendChild(link);
+        parent = link;
+    }
+    robot->updateLinkTree();
+    return robot;
+}
+
+
+double measureStepTime(int numRobots, bool isIslandDecompositionEnabled, int numThreads)
+{
+    BatchSimulator simulator;
+    simulator.setTimeStep(0.001);
+    simulator.setMaterialTableFile("");
+
+    const int numColumns = std::ceil(std::sqrt(static_cast<double>(numRobots)));
+    const double pitchX = linkLength * numRobotLinks * 1.5;
+    const double pitchY = linkWidth * 3.0;
+    addFloor(simulator, numColumns * pitchX + 1.0, numColumns * pitchY + 1.0);
+
+    for(int i=0; i < numRobots; ++i){
+        BodyPtr robot = createChainRobot();
+        robot->rootLink()->p() = Vector3(
+            (i % numColumns - numColumns / 2.0) * pitchX, (i / numColumns - numColumns / 2.0) * pitchY,
+            linkWidth / 2.0 - 0.001);
+        robot->calcForwardKinematics();
+        simulator.addBody(robot);
+    }
+
+    ConstraintForceSolver& solver = simulator.constraintForceSolver();
+    solver.setIslandDecompositionEnabled(isIslandDecompositionEnabled);
+    solver.setNumThreads(numThreads);
+
+    if(!simulator.initialize()){
+        return 0.0;
+    }
+    simulator.step();
+
+    auto start = std::chrono::steady_clock::now();
+    for(int i=0; i < numMeasuredSteps; ++i){
+        simulator.step();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / numMeasuredSteps;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    vector<int> robotCounts;
+    for(int i=1; i < argc; ++i){
+        robotCounts.push_back(std::atoi(argv[i]));
+    }
+    if(robotCounts.empty()){
+        robotCounts = { 1, 2, 4, 8, 16, 32, 64 };
+    }
+    const int numThreads = std::max(2u, std::thread::hardware_concurrency());
+
+    cout << format("robots   single LCP [ms/step]   islands [ms/step]   islands, %d threads [ms/step]") % numThreads << endl;
+
+    for(auto numRobots : robotCounts){
+        const double singleTime = measureStepTime(numRobots, false, 1);
+        const double islandTime = measureStepTime(numRobots, true, 1);
+        const double threadTime = measureStepTime(numRobots, true, numThreads);
+        cout << format("%6d   %20.3f   %17.3f   %29.3f")
+            % numRobots % (singleTime * 1000.0) % (islandTime * 1000.0) % (threadTime * 1000.0) << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+/**
+   This test checks that the mass matrix calculated by the composite rigid body algorithm is
+   the same as the one constructed by the inverse dynamics with the unit accelerations.
+   The body is a floating-base tree of revolute and prismatic joints built in code, and the
+   matrices are compared in random configurations with random velocities.
+*/
+
+#include <cnoid/Body>
+#include <cnoid/MassMatrix>
+#include <cnoid/InverseDynamics>
+#include <cnoid/EigenUtil>
+#include <iostream>
+#include <string>
+#include "TestUtil.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+Link* createLink(Body* body, Link::JointType jointType, int jointId)
+{
+    Link* link = body->createLink();
+    link->setJointType(jointType);
+    link->setJointId(jointId);
+    link->setJointAxis(randomVector(-1.0, 1.0).normalized());
+    link->setOffsetTranslation(randomVector(-0.3, 0.3));
+    link->setOffsetRotation(randomRotation());
+    link->setMass(random(0.5, 3.0));
+    link->setCenterOfMass(randomVector(-0.1, 0.1));
+    const Matrix3 R = randomRotation();
+    const Vector3 d = randomVector(0.01, 0.1);
+    link->setInertia(R * d.asDiagonal() * R.transpose());
+    link->setEquivalentRotorInertia((jointType == Link::FIXED_JOINT) ? 0.0 : random(0.0, 0.1));
+    return link;
+}
+
+/**
+   The root link has two chains. One of them has a fixed joint in the middle and the other
+   branches again, so that the matrix has the elements of the joints which are not in an
+   ancestor-descendant relation.
+*/
+BodyPtr createBody(bool isRootFixed)
+{
+    BodyPtr body = new Body;
+    Link* root = createLink(body, isRootFixed ? Link::FIXED_JOINT : Link::FREE_JOINT, -1);
+    body->setRootLink(root);
+
+    const Link::JointType R = Link::REVOLUTE_JOINT;
+    const Link::JointType P = Link::PRISMATIC_JOINT;
+
+    Link* link1 = createLink(body, R, 0);
+    Link* link2 = createLink(body, P, 1);
+    Link* link3 = createLink(body, Link::FIXED_JOINT, -1);
+    Link* link4 = createLink(body, R, 2);
+    root->appendChild(link1);
+    link1->appendChild(link2);
+    link2->appendChild(link3);
+    link3->appendChild(link4);
+
+    Link* link5 = createLink(body, P, 3);
+    Link* link6 = createLink(body, R, 4);
+    Link* link7 = createLink(body, R, 5);
+    Link* link8 = createLink(body, P, 6);
+    root->appendChild(link5);
+    link5->appendChild(link6);
+    link6->appendChild(link7);
+    link6->appendChild(link8);
+
+    body->updateLinkTree();
+    return body;
+}
+
+void setRandomState(Body* body)
+{
+    Link* root = body->rootLink();
+    if(!root->isFixedJoint()){
+        root->p() = randomVector(-1.0, 1.0);
+        root->R() = randomRotation();
+        root->v() = randomVector(-1.0, 1.0);
+        root->w() = randomVector(-1.0, 1.0);
+    }
+    for(int i=0; i < body->numJoints(); ++i){
+        Link* joint = body->joint(i);
+        joint->q() = random(-1.5, 1.5);
+        joint->dq() = random(-2.0, 2.0);
+    }
+    body->calcForwardKinematics(true);
+}
+
+/**
+   The column of the matrix is the generalized force given by the inverse dynamics with
+   the unit acceleration of the DOF minus the one with no acceleration. The root torque is
+   expressed around the root link origin because the root DOFs are (dv, dw).
+*/
+void calcInverseDynamicsForces(Body* body, VectorXd& out_f)
+{
+    Link* root = body->rootLink();
+    Vector6 f = calcInverseDynamics(root);
+    int offset = 0;
+    if(!root->isFixedJoint()){
+        f.tail<3>() -= root->p().cross(f.head<3>());
+        out_f.head<6>() = f;
+        offset = 6;
+    }
+    for(int i=0; i < body->numJoints(); ++i){
+        out_f[i + offset] = body->joint(i)->u();
+    }
+}
+
+void calcMassMatrixByUnitAccelerations(Body* body, MatrixXd& out_M)
+{
+    Link* root = body->rootLink();
+    const int rootDof = root->isFixedJoint() ? 0 : 6;
+    const int n = body->numJoints() + rootDof;
+    out_M.resize(n, n);
+
+    VectorXd b(n);
+    VectorXd f(n);
+    for(int i=-1; i < n; ++i){
+        root->dv().setZero();
+        root->dw().setZero();
+        for(int j=0; j < body->numJoints(); ++j){
+            body->joint(j)->ddq() = 0.0;
+        }
+        if(i >= 0){
+            if(i >= rootDof){
+                body->joint(i - rootDof)->ddq() = 1.0;
+            } else if(i < 3){
+                root->dv()[i] = 1.0;
+            } else {
+                root->dw()[i - 3] = 1.0;
+            }
+        }
+        if(i < 0){
+            calcInverseDynamicsForces(body, b);
+        } else {
+            calcInverseDynamicsForces(body, f);
+            out_M.col(i) = f - b;
+        }
+    }
+}
+
+void checkMassMatrix(bool isRootFixed)
+{
+    BodyPtr body = createBody(isRootFixed);
+    const string rootType = isRootFixed ? "fixed" : "floating";
+
+    for(int i=0; i < 20; ++i){
+        setRandomState(body);
+        MatrixXd M_crba;
+        calcMassMatrix(body, M_crba);
+        MatrixXd M_id;
+        calcMassMatrixByUnitAccelerations(body, M_id);
+
+        if(M_crba.rows() != M_id.rows() || M_crba.cols() != M_id.cols()){
+            check(false, "the size of the mass matrix of the " + rootType + "-base body is wrong");
+            return;
+        }
+        const double error = (M_crba - M_id).cwiseAbs().maxCoeff() / M_id.cwiseAbs().maxCoeff();
+        if(error > 1.0e-12){
+            check(false, "the mass matrix of the " + rootType + "-base body differs by " + std::to_string(error));
+            cerr << "CRBA:\n" << M_crba << "\nUnit accelerations:\n" << M_id << endl;
+            return;
+        }
+        check(M_crba.isApprox(M_crba.transpose(), 1.0e-14), "the mass matrix is not symmetric");
+    }
+}
+
+}
+
+int main()
+{
+    checkMassMatrix(false);
+    checkMassMatrix(true);
+    return (numErrors > 0) ? 1 : 0;
+}
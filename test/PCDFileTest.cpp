@@ -0,0 +1,136 @@
+/**
+   This test saves a point set with normals and colors in the ascii, binary and
+   binary_compressed data formats of PCD and checks that loading the files gives
+   the original points. The points on a grid are followed by random points so
+   that the LZF compressor finds both repeated and unique byte sequences.
+*/
+
+#include <cnoid/PointSetUtil>
+#include <cnoid/SceneDrawables>
+#include <cnoid/Exception>
+#include <boost/format.hpp>
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+
+namespace {
+
+SgPointSetPtr createPointSet(int numPoints)
+{
+    SgPointSetPtr pointSet = new SgPointSet;
+    auto& vertices = *pointSet->getOrCreateVertices();
+    auto& normals = *pointSet->getOrCreateNormals();
+    auto& colors = *pointSet->getOrCreateColors();
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+    std::uniform_int_distribution<int> colorDistribution(0, 255);
+
+    for(int i=0; i < numPoints; ++i){
+        if(i < numPoints / 2){
+            vertices.push_back(Vector3f(i % 100, (i / 100) % 100, i / 10000) * 0.01f);
+            normals.push_back(Vector3f::UnitZ());
+            colors.push_back(Vector3f(1.0f, 0.5f, 0.0f));
+        } else {
+            vertices.push_back(Vector3f(distribution(random), distribution(random), distribution(random)));
+            normals.push_back(vertices.back().normalized());
+            colors.push_back(Vector3f(colorDistribution(random), colorDistribution(random), colorDistribution(random)) / 255.0f);
+        }
+    }
+    return pointSet;
+}
+
+
+template<class ArrayType>
+bool isSameArray(const ArrayType* array1, const ArrayType* array2)
+{
+    return array1 && array2 && array1->size() == array2->size() &&
+        memcmp(array1->data(), array2->data(), array1->size() * sizeof(typename ArrayType::value_type)) == 0;
+}
+
+
+bool checkPointSet(const SgPointSet* org, const SgPointSet* loaded, const string& format_)
+{
+    bool ok = true;
+    if(!isSameArray(org->vertices(), loaded->vertices())){
+        cerr << "Failed: the vertices loaded from the " << format_ << " file are different." << endl;
+        ok = false;
+    }
+    if(!isSameArray(org->normals(), loaded->normals())){
+        cerr << "Failed: the normals loaded from the " << format_ << " file are different." << endl;
+        ok = false;
+    }
+    // The colors are stored as the 8-bit values
+    const SgColorArray* colors = loaded->colors();
+    if(!colors || colors->size() != org->colors()->size()){
+        cerr << "Failed: the colors are not loaded from the " << format_ << " file." << endl;
+        ok = false;
+    } else {
+        for(size_t i=0; i < colors->size(); ++i){
+            if(((*colors)[i] - (*org->colors())[i]).cwiseAbs().maxCoeff() > 1.0f / 255.0f){
+                cerr << "Failed: the colors loaded from the " << format_ << " file are different." << endl;
+                ok = false;
+                break;
+            }
+        }
+    }
+    return ok;
+}
+
+}
+
+int main()
+{
+    int numErrors = 0;
+
+    const int numPoints = 20000;
+    SgPointSetPtr org = createPointSet(numPoints);
+
+    struct Format { int type; const char* name; };
+    const Format formats[] = {
+        { PCD_ASCII, "ascii" }, { PCD_BINARY, "binary" }, { PCD_BINARY_COMPRESSED, "binary_compressed" } };
+
+    SgPointSetPtr reference;
+
+    for(auto& f : formats){
+        const string filename = str(format("test-%1%.pcd") % f.name);
+        SgPointSetPtr loaded = new SgPointSet;
+        try {
+            savePCD(org, filename, Affine3::Identity(), f.type);
+            loadPCD(loaded, filename);
+        } catch(const std::exception&){
+            cerr << "Failed: the " << f.name << " file cannot be saved or loaded." << endl;
+            ++numErrors;
+            continue;
+        }
+        if(!checkPointSet(org, loaded, f.name)){
+            ++numErrors;
+        }
+
+        // All the formats must give the same colors
+        if(!reference){
+            reference = loaded;
+        } else if(!isSameArray(reference->colors(), loaded->colors())){
+            cerr << "Failed: the colors loaded from the " << f.name << " file are different from the ascii file." << endl;
+            ++numErrors;
+        }
+
+        // The points read in chunks must be the same as the ones loaded at once
+        SgVertexArrayPtr vertices = new SgVertexArray;
+        readPCDInChunks(filename, 3000, [&](SgPointSet* chunk){
+                for(auto& p : *chunk->vertices()){
+                    vertices->push_back(p);
+                }
+            });
+        if(!isSameArray(org->vertices(), vertices.get())){
+            cerr << "Failed: the vertices read from the " << f.name << " file in chunks are different." << endl;
+            ++numErrors;
+        }
+    }
+
+    return (numErrors > 0) ? 1 : 0;
+}
@@ -0,0 +1,202 @@
+/**
+   This benchmark compares the load time of the PCD data formats with the loader which only
+   supported the ascii format and read the values with EasyScanner. The previous loader is
+   kept here as the reference. The loaded points are also checked to be the same as the ones
+   of the reference loader.
+
+   Usage: bench-pcd-load [number of points]
+*/
+
+#include <cnoid/PointSetUtil>
+#include <cnoid/SceneDrawables>
+#include <cnoid/EasyScanner>
+#include <boost/format.hpp>
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+
+namespace {
+
+enum Element { E_X, E_Y, E_Z, E_NORMAL_X,E_NORMAL_Y, E_NORMAL_Z, E_RGB };
+
+typedef union {
+    struct {
+        unsigned char blue;
+        unsigned char green;
+        unsigned char red;
+        unsigned char alpha;
+    };
+    float float_value;
+} RGBValue;
+
+
+/**
+   The reference loader, which is the same as loadPCD before the binary formats were supported.
+*/
+void loadPCDWithEasyScanner(SgPointSet* out_pointSet, const std::string& filename)
+{
+    EasyScanner scanner(filename);
+    scanner.setCommentChar('#');
+
+    vector<Element> elements;
+
+    while(true){
+        scanner.skipBlankLines();
+        scanner.readWordEx("Illegal header key");
+
+        if(scanner.stringValue == "FIELDS"){
+            while(scanner.readWord()){
+                if(scanner.stringValue == "x"){
+                    elements.push_back(E_X);
+                } else if(scanner.stringValue == "y"){
+                    elements.push_back(E_Y);
+                } else if(scanner.stringValue == "z"){
+                    elements.push_back(E_Z);
+                } else if(scanner.stringValue == "normal_x"){
+                    elements.push_back(E_NORMAL_X);
+                } else if(scanner.stringValue == "normal_y"){
+                    elements.push_back(E_NORMAL_Y);
+                } else if(scanner.stringValue == "normal_z"){
+                    elements.push_back(E_NORMAL_Z);
+                } else if(scanner.stringValue == "rgb"){
+                    elements.push_back(E_RGB);
+                }
+            }
+        } else if(scanner.stringValue == "DATA"){
+            scanner.readWordEx("The 'DATA' field is not correctly specified.");
+            scanner.readLFex();
+            break;
+        } else {
+            scanner.skipToLineEnd();
+        }
+        scanner.readLFEOFex("The field value is not correctly specified.");
+    }
+
+    SgVertexArrayPtr vertices = new SgVertexArray;
+    SgColorArrayPtr colors;
+    const int numElements = elements.size();
+    for(auto element : elements){
+        if(element == E_RGB){
+            colors = new SgColorArray;
+        }
+    }
+    Vector3f vertex = Vector3f::Zero();
+    Vector3f color = Vector3f::Zero();
+    RGBValue rgb;
+
+    while(!scanner.isEOF()){
+        scanner.skipBlankLines();
+        bool hasIllegalValue = false;
+        for(int i=0; i < numElements; ++i){
+            if(!scanner.readDouble()){
+                hasIllegalValue = true;
+                scanner.skipToLineEnd();
+                break;
+            }
+            double value = scanner.doubleValue;
+            switch(elements[i]){
+            case E_X: vertex.x() = value; break;
+            case E_Y: vertex.y() = value; break;
+            case E_Z: vertex.z() = value; break;
+            case E_RGB:
+                rgb.float_value = value;
+                color[0] = rgb.red / 255.0;
+                color[1] = rgb.green / 255.0;
+                color[2] = rgb.blue / 255.0;
+                break;
+            default:
+                break;
+            }
+        }
+        if(!hasIllegalValue){
+            vertices->push_back(vertex);
+            if(colors){
+                colors->push_back(color);
+            }
+        }
+        scanner.readLFEOF();
+    }
+
+    out_pointSet->setVertices(vertices);
+    out_pointSet->setColors(colors);
+}
+
+
+SgPointSetPtr createPointSet(int numPoints)
+{
+    SgPointSetPtr pointSet = new SgPointSet;
+    auto& vertices = *pointSet->getOrCreateVertices();
+    auto& colors = *pointSet->getOrCreateColors();
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> distribution(-10.0f, 10.0f);
+    std::uniform_int_distribution<int> colorDistribution(0, 255);
+    for(int i=0; i < numPoints; ++i){
+        vertices.push_back(Vector3f(distribution(random), distribution(random), distribution(random)));
+        colors.push_back(Vector3f(colorDistribution(random), colorDistribution(random), colorDistribution(random)) / 255.0f);
+    }
+    return pointSet;
+}
+
+
+template<class ArrayType>
+bool isSameArray(const ArrayType* array1, const ArrayType* array2)
+{
+    return array1 && array2 && array1->size() == array2->size() &&
+        memcmp(array1->data(), array2->data(), array1->size() * sizeof(typename ArrayType::value_type)) == 0;
+}
+
+
+template<class Function>
+double measureLoadTime(Function load, SgPointSet* out_pointSet)
+{
+    auto start = std::chrono::steady_clock::now();
+    load(out_pointSet);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    const int numPoints = (argc > 1) ? std::atoi(argv[1]) : 2000000;
+    SgPointSetPtr org = createPointSet(numPoints);
+
+    savePCD(org, "bench-ascii.pcd", Affine3::Identity(), PCD_ASCII);
+    savePCD(org, "bench-binary.pcd", Affine3::Identity(), PCD_BINARY);
+    savePCD(org, "bench-binary_compressed.pcd", Affine3::Identity(), PCD_BINARY_COMPRESSED);
+
+    cout << format("%1% points (x y z rgb)") % numPoints << endl;
+    cout << "format              loader       load time [s]   same as reference" << endl;
+
+    SgPointSetPtr reference = new SgPointSet;
+    double time = measureLoadTime([](SgPointSet* out){ loadPCDWithEasyScanner(out, "bench-ascii.pcd"); }, reference);
+    cout << format("%-18s  %-10s   %13.3f") % "ascii" % "reference" % time << endl;
+
+    const char* formats[] = { "ascii", "binary", "binary_compressed" };
+    int numErrors = 0;
+    for(auto f : formats){
+        const string filename = str(format("bench-%1%.pcd") % f);
+        SgPointSetPtr loaded = new SgPointSet;
+        time = measureLoadTime([&](SgPointSet* out){ loadPCD(out, filename); }, loaded);
+        const bool isSame =
+            isSameArray(reference->vertices(), loaded->vertices()) && isSameArray(reference->colors(), loaded->colors());
+        if(!isSame){
+            ++numErrors;
+        }
+        cout << format("%-18s  %-10s   %13.3f   %s") % f % "loadPCD" % time % (isSame ? "yes" : "no") << endl;
+    }
+
+    for(auto f : formats){
+        std::remove(str(format("bench-%1%.pcd") % f).c_str());
+    }
+
+    return (numErrors > 0) ? 1 : 0;
+}
@@ -0,0 +1,189 @@
+/**
+   This test builds an octree file from a random point cloud and checks the bounds and the
+   point counts of the nodes and that the points of all the nodes are the points of the cloud.
+   The points in a region are then removed, and the file is opened again to check that the
+   point counts patched in the header and in the node table are read back.
+*/
+
+#include <cnoid/PointCloudOctree>
+#include <cnoid/PointSetUtil>
+#include <cnoid/PolyhedralRegion>
+#include <cnoid/Exception>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <array>
+#include <algorithm>
+#include <cstdio>
+#include "TestUtil.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const string pcdFilename = "octree-test.pcd";
+const string octreeFilename = "octree-test.octree";
+
+// A point is represented by its position and its color
+typedef std::array<float, 6> Point;
+
+SgPointSetPtr createPointSet(int numPoints)
+{
+    SgPointSetPtr pointSet = new SgPointSet;
+    auto& vertices = *pointSet->getOrCreateVertices();
+    auto& colors = *pointSet->getOrCreateColors();
+    for(int i=0; i < numPoints; ++i){
+        // Half of the points are in a small cluster so that the tree has deep nodes
+        if(i % 2 == 0){
+            vertices.push_back(randomVector(-2.0, 2.0).cast<float>());
+        } else {
+            vertices.push_back((Vector3(0.5, 0.5, 0.5) + randomVector(-0.1, 0.1)).cast<float>());
+        }
+        // The colors are stored in 8 bits
+        colors.push_back(Vector3f(randomInt(256), randomInt(256), randomInt(256)) / 255.0f);
+    }
+    return pointSet;
+}
+
+vector<Point> getSortedPoints(const SgPointSet* pointSet, const PolyhedralRegion* removedRegion = 0)
+{
+    vector<Point> points;
+    const SgVertexArray& vertices = *pointSet->vertices();
+    const SgColorArray& colors = *pointSet->colors();
+    for(size_t i=0; i < vertices.size(); ++i){
+        const Vector3f& p = vertices[i];
+        if(removedRegion && removedRegion->checkInside(p.cast<double>())){
+            continue;
+        }
+        const Vector3f& c = colors[i];
+        points.push_back({ p.x(), p.y(), p.z(), c[0], c[1], c[2] });
+    }
+    std::sort(points.begin(), points.end());
+    return points;
+}
+
+bool isInsideCell(const PointCloudOctree::Node& node, const Vector3f& p)
+{
+    return (p.array() >= node.min.array()).all() &&
+        (p.array() <= (node.min + Vector3f::Constant(node.size)).array()).all();
+}
+
+void checkOctree(PointCloudOctree& octree, const vector<Point>& expected, const string& phase)
+{
+    check(octree.numPoints() == static_cast<int64_t>(expected.size()),
+          phase + ": the number of the points is " + std::to_string(octree.numPoints()) +
+          " while the cloud has " + std::to_string(expected.size()));
+    check(octree.hasColors(), phase + ": the octree does not have the colors");
+
+    vector<Point> points;
+    int64_t numNodePoints = 0;
+    bool areBoundsValid = true;
+    bool arePointsInCells = true;
+    SgVertexArray vertices;
+    SgColorArray colors;
+
+    for(int i=0; i < octree.numNodes(); ++i){
+        const PointCloudOctree::Node& node = octree.node(i);
+        if(node.numPoints < 0 || node.numPoints > node.capacity){
+            areBoundsValid = false;
+        }
+        for(int j=0; j < 8; ++j){
+            const int childIndex = node.children[j];
+            if(childIndex < 0){
+                continue;
+            }
+            if(childIndex <= i || childIndex >= octree.numNodes()){
+                areBoundsValid = false;
+                continue;
+            }
+            // The cell of a child is the octant of the parent cell
+            const PointCloudOctree::Node& child = octree.node(childIndex);
+            const float h = node.size / 2.0f;
+            const Vector3f min(
+                (j & 1) ? node.min.x() + h : node.min.x(),
+                (j & 2) ? node.min.y() + h : node.min.y(),
+                (j & 4) ? node.min.z() + h : node.min.z());
+            if(child.min != min || child.size != h || child.depth != node.depth + 1){
+                areBoundsValid = false;
+            }
+        }
+        if(!octree.readPoints(i, vertices, &colors)){
+            check(false, phase + ": the points of node " + std::to_string(i) + " cannot be read");
+            return;
+        }
+        if(static_cast<int>(vertices.size()) != node.numPoints || colors.size() != vertices.size()){
+            areBoundsValid = false;
+        }
+        numNodePoints += vertices.size();
+        for(size_t j=0; j < vertices.size() && j < colors.size(); ++j){
+            const Vector3f& p = vertices[j];
+            const Vector3f& c = colors[j];
+            if(!isInsideCell(node, p)){
+                arePointsInCells = false;
+            }
+            points.push_back({ p.x(), p.y(), p.z(), c[0], c[1], c[2] });
+        }
+    }
+    std::sort(points.begin(), points.end());
+
+    check(areBoundsValid, phase + ": the node bounds or the point counts are broken");
+    check(arePointsInCells, phase + ": some points are outside of the cells of their nodes");
+    check(numNodePoints == octree.numPoints(), phase + ": the sum of the node points is " +
+          std::to_string(numNodePoints) + " while the octree has " + std::to_string(octree.numPoints()));
+    check(points == expected, phase + ": the points of the nodes are different from the cloud");
+}
+
+}
+
+int main()
+{
+    SgPointSetPtr pointSet = createPointSet(20000);
+    try {
+        savePCD(pointSet, pcdFilename, Affine3d::Identity(), PCD_BINARY);
+    } catch(const exception_base&){
+        cerr << "Failed: the PCD file cannot be saved" << endl;
+        return 1;
+    }
+
+    if(!PointCloudOctree::build(pcdFilename, octreeFilename, cerr, 500)){
+        check(false, "the octree cannot be built");
+        std::remove(pcdFilename.c_str());
+        return 1;
+    }
+    std::remove(pcdFilename.c_str());
+
+    PointCloudOctree octree;
+    if(!octree.open(octreeFilename, cerr)){
+        check(false, "the octree file cannot be opened");
+        std::remove(octreeFilename.c_str());
+        return 1;
+    }
+    check(octree.numNodes() > 8, "the octree has only " + std::to_string(octree.numNodes()) + " nodes");
+    checkOctree(octree, getSortedPoints(pointSet), "built octree");
+
+    // The region has the whole cells as well as the cells crossing its bounding planes
+    PolyhedralRegion region;
+    region.addBoundingPlane(Vector3::UnitX(), Vector3(-1.0, 0.0, 0.0));
+    region.addBoundingPlane(-Vector3::UnitX(), Vector3(0.55, 0.0, 0.0));
+    region.addBoundingPlane(Vector3::UnitY(), Vector3(0.0, -2.5, 0.0));
+    region.addBoundingPlane(-Vector3::UnitY(), Vector3(0.0, 0.52, 0.0));
+
+    vector<int> modifiedNodeIndices;
+    check(octree.removePoints(region, modifiedNodeIndices, cerr), "removePoints failed");
+    check(!modifiedNodeIndices.empty(), "no node is modified by removePoints");
+    const vector<Point> remainingPoints = getSortedPoints(pointSet, &region);
+    checkOctree(octree, remainingPoints, "octree with the points removed");
+
+    octree.close();
+    if(!octree.open(octreeFilename, cerr)){
+        check(false, "the modified octree file cannot be opened");
+    } else {
+        checkOctree(octree, remainingPoints, "reopened octree");
+    }
+    octree.close();
+
+    std::remove(octreeFilename.c_str());
+
+    return (numErrors > 0) ? 1 : 0;
+}
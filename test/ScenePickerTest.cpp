@@ -0,0 +1,322 @@
+/**
+   This test checks that ScenePicker picks the same node and point as a brute-force scan of
+   all the triangles, points and lines of the scene. The scene has meshes under rigid and
+   scaled transforms, a point set and a line set picked with their widths in pixels, and a
+   switch turned off. The rays are cast again after the transforms are moved and notified
+   with notifyUpdate so that the incremental refit of the index is also checked.
+*/
+
+#include <cnoid/ScenePicker>
+#include <cnoid/SceneDrawables>
+#include <cnoid/MeshGenerator>
+#include <cnoid/EigenUtil>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <limits>
+#include <typeinfo>
+#include "TestUtil.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const double minPickingWidth = 4.0;
+const double pointSize = 3.0;
+const double lineWidth = 6.0;
+const double pixelSizeAtOrigin = 0.001;
+const double pixelSizeAtEnd = 0.03;
+const double rayLength = 30.0;
+
+struct Hit {
+    double t;
+    SgNodePath path;
+    Hit() : t(std::numeric_limits<double>::max()) { }
+};
+
+/**
+   The brute-force picking visits all the nodes with the rules of ScenePicker and keeps
+   the nearest hit of each node so that the hits of different nodes at almost the same
+   distance can be distinguished from the mismatches.
+*/
+class BruteForcePicker
+{
+public:
+    Vector3 origin;
+    Vector3 direction;
+    double rate;
+    Hit nearest;
+    vector<Hit> nodeHits;
+    SgNodePath path;
+
+    void pick(SgNode* root, const Vector3& origin_, const Vector3& end)
+    {
+        origin = origin_;
+        direction = (end - origin).normalized();
+        rate = (pixelSizeAtEnd - pixelSizeAtOrigin) / rayLength;
+        nearest = Hit();
+        nodeHits.clear();
+        path.clear();
+        visit(root, Affine3::Identity());
+    }
+
+    void addHit(double t)
+    {
+        if(t < 0.0 || t >= rayLength){
+            return;
+        }
+        if(nodeHits.empty() || nodeHits.back().path != path){
+            nodeHits.push_back(Hit());
+            nodeHits.back().path = path;
+        }
+        Hit& hit = nodeHits.back();
+        if(t < hit.t){
+            hit.t = t;
+        }
+        if(t < nearest.t){
+            nearest = hit;
+        }
+    }
+
+    void testPoint(const Vector3& p, double halfWidth)
+    {
+        const double t = (p - origin).dot(direction);
+        const double tolerance = halfWidth * (pixelSizeAtOrigin + rate * t);
+        if((origin + t * direction - p).squaredNorm() <= tolerance * tolerance){
+            addHit(t);
+        }
+    }
+
+    void visit(SgNode* node, const Affine3& T)
+    {
+        path.push_back(node);
+
+        if(auto switchNode = dynamic_cast<SgSwitch*>(node)){
+            if(switchNode->isTurnedOn()){
+                for(auto& child : *switchNode){
+                    visit(child, T);
+                }
+            }
+        } else if(auto transform = dynamic_cast<SgTransform*>(node)){
+            Affine3 T_local;
+            transform->getTransform(T_local);
+            const Affine3 T_child = T * T_local;
+            for(auto& child : *transform){
+                visit(child, T_child);
+            }
+        } else if(auto group = dynamic_cast<SgGroup*>(node)){
+            for(auto& child : *group){
+                visit(child, T);
+            }
+        } else if(auto shape = dynamic_cast<SgShape*>(node)){
+            const SgMesh* mesh = shape->mesh();
+            const SgVertexArray& vertices = *mesh->vertices();
+            for(int i=0; i < mesh->numTriangles(); ++i){
+                auto triangle = mesh->triangle(i);
+                const Vector3 v0 = T * vertices[triangle[0]].cast<double>();
+                const Vector3 e1 = T * vertices[triangle[1]].cast<double>() - v0;
+                const Vector3 e2 = T * vertices[triangle[2]].cast<double>() - v0;
+                const Vector3 p = direction.cross(e2);
+                const double det = e1.dot(p);
+                if(det == 0.0){
+                    continue;
+                }
+                const Vector3 s = origin - v0;
+                const double u = s.dot(p) / det;
+                const Vector3 q = s.cross(e1);
+                const double v = direction.dot(q) / det;
+                if(u >= 0.0 && v >= 0.0 && u + v <= 1.0){
+                    addHit(e2.dot(q) / det);
+                }
+            }
+        } else if(auto pointSet = dynamic_cast<SgPointSet*>(node)){
+            for(auto& vertex : *pointSet->vertices()){
+                testPoint(T * vertex.cast<double>(), std::max(static_cast<double>(pointSet->pointSize()), minPickingWidth) / 2.0);
+            }
+        } else if(auto lineSet = dynamic_cast<SgLineSet*>(node)){
+            const SgVertexArray& vertices = *lineSet->vertices();
+            const double halfWidth = std::max(static_cast<double>(lineSet->lineWidth()), minPickingWidth) / 2.0;
+            for(int i=0; i < lineSet->numLines(); ++i){
+                auto line = lineSet->line(i);
+                const Vector3 a = T * vertices[line[0]].cast<double>();
+                const Vector3 u = T * vertices[line[1]].cast<double>() - a;
+                const Vector3 w = origin - a;
+                const double b = direction.dot(u);
+                const double c = u.dot(u);
+                const double d = direction.dot(w);
+                const double e = u.dot(w);
+                const double denom = c - b * b;
+                double s = (denom > 1.0e-12 * c) ? (e - b * d) / denom : 0.0;
+                s = std::max(0.0, std::min(1.0, s));
+                testPoint(a + s * u, halfWidth);
+            }
+        }
+
+        path.pop_back();
+    }
+
+    double hitDistance(const SgNodePath& path) const
+    {
+        for(auto& hit : nodeHits){
+            if(hit.path == path){
+                return hit.t;
+            }
+        }
+        return std::numeric_limits<double>::max();
+    }
+};
+
+struct Scene {
+    SgGroupPtr root;
+    vector<SgPosTransformPtr> transforms;
+};
+
+Scene createScene()
+{
+    Scene scene;
+    scene.root = new SgGroup;
+    MeshGenerator generator;
+    SgMeshPtr sphere = generator.generateSphere(0.3);
+    SgMeshPtr box = generator.generateBox(Vector3(0.4, 0.2, 0.6));
+
+    for(int i=0; i < 30; ++i){
+        SgPosTransformPtr transform = new SgPosTransform;
+        transform->setTranslation(randomVector(-2.0, 2.0));
+        transform->setRotation(randomRotation());
+        SgShapePtr shape = new SgShape;
+        // The meshes are shared by the shapes
+        shape->setMesh((i % 2 == 0) ? sphere : box);
+        if(i % 5 == 0){
+            SgScaleTransformPtr scale = new SgScaleTransform;
+            scale->setScale(Vector3(0.5, 1.5, 1.0));
+            scale->addChild(shape);
+            transform->addChild(scale);
+        } else {
+            transform->addChild(shape);
+        }
+        scene.root->addChild(transform);
+        scene.transforms.push_back(transform);
+    }
+
+    SgPosTransformPtr pointTransform = new SgPosTransform;
+    SgPointSetPtr pointSet = new SgPointSet;
+    pointSet->setPointSize(pointSize);
+    SgVertexArray& points = *pointSet->getOrCreateVertices();
+    for(int i=0; i < 3000; ++i){
+        points.push_back(randomVector(-1.5, 1.5).cast<float>());
+    }
+    pointTransform->addChild(pointSet);
+    scene.root->addChild(pointTransform);
+    scene.transforms.push_back(pointTransform);
+
+    SgPosTransformPtr lineTransform = new SgPosTransform;
+    SgLineSetPtr lineSet = new SgLineSet;
+    lineSet->setLineWidth(lineWidth);
+    SgVertexArray& lineVertices = *lineSet->getOrCreateVertices();
+    for(int i=0; i < 300; ++i){
+        const Vector3f a = randomVector(-1.5, 1.5).cast<float>();
+        lineVertices.push_back(a);
+        lineVertices.push_back(a + randomVector(-0.3, 0.3).cast<float>());
+        lineSet->addLine(i * 2, i * 2 + 1);
+    }
+    lineTransform->addChild(lineSet);
+    scene.root->addChild(lineTransform);
+    scene.transforms.push_back(lineTransform);
+
+    // The shape in the switch turned off must not be picked
+    SgSwitchPtr switchNode = new SgSwitch;
+    switchNode->turnOff();
+    SgShapePtr hidden = new SgShape;
+    hidden->setMesh(generator.generateBox(Vector3(10.0, 10.0, 10.0)));
+    switchNode->addChild(hidden);
+    scene.root->addChild(switchNode);
+
+    return scene;
+}
+
+string toString(const SgNodePath& path)
+{
+    string s;
+    for(auto& node : path){
+        s += string(" ") + typeid(*node).name();
+    }
+    return s;
+}
+
+void checkPicking(ScenePicker& picker, Scene& scene, const string& phase)
+{
+    BruteForcePicker bruteForce;
+    int numPicked = 0;
+    int numMismatches = 0;
+
+    for(int i=0; i < 300; ++i){
+        const Vector3 origin = randomVector(-1.0, 1.0).normalized() * 10.0;
+        const Vector3 target = randomVector(-2.5, 2.5);
+        const Vector3 end = origin + (target - origin).normalized() * rayLength;
+
+        const auto result = picker.pick(origin, end, pixelSizeAtOrigin, pixelSizeAtEnd);
+        bruteForce.pick(scene.root, origin, end);
+        const bool isHit = !bruteForce.nodeHits.empty();
+
+        if(result == ScenePicker::UNDETERMINED || (result == ScenePicker::PICKED) != isHit){
+            ++numMismatches;
+            continue;
+        }
+        if(!isHit){
+            continue;
+        }
+        ++numPicked;
+        const SgNodePath& path = picker.pickedNodePath();
+        const double t = (picker.pickedPoint() - origin).norm();
+        // The mesh picking is done in single precision
+        const double tolerance = 1.0e-4 * rayLength;
+        if(path != bruteForce.nearest.path){
+            // The nodes hit at almost the same distance may be picked in either order
+            if(std::abs(bruteForce.hitDistance(path) - bruteForce.nearest.t) > tolerance){
+                cerr << "The picked path" << toString(path) << " is different from"
+                     << toString(bruteForce.nearest.path) << endl;
+                ++numMismatches;
+                continue;
+            }
+        }
+        if(std::abs(t - bruteForce.nearest.t) > tolerance){
+            cerr << "The picked distance " << t << " is different from " << bruteForce.nearest.t << endl;
+            ++numMismatches;
+        }
+    }
+
+    check(numPicked > 100, phase + ": only " + std::to_string(numPicked) + " rays hit the objects");
+    check(numMismatches == 0, phase + ": " + std::to_string(numMismatches) + " mismatches with the brute-force picking");
+}
+
+}
+
+int main()
+{
+    Scene scene = createScene();
+
+    ScenePicker picker;
+    picker.setRoot(scene.root);
+    picker.setMinPickingWidth(minPickingWidth);
+
+    checkPicking(picker, scene, "initial scene");
+
+    for(int i=0; i < 3; ++i){
+        for(auto& transform : scene.transforms){
+            transform->setTranslation(randomVector(-2.0, 2.0));
+            transform->setRotation(randomRotation());
+            transform->notifyUpdate();
+        }
+        checkPicking(picker, scene, "moved scene " + std::to_string(i + 1));
+    }
+
+    // Only some of the transforms are moved
+    for(size_t i=0; i < scene.transforms.size(); i += 3){
+        scene.transforms[i]->translation() += Vector3(0.5, -0.5, 0.25);
+        scene.transforms[i]->notifyUpdate();
+    }
+    checkPicking(picker, scene, "partly moved scene");
+
+    return (numErrors > 0) ? 1 : 0;
+}
@@ -0,0 +1,31 @@
+# This script is run by CTest with CONVERTER, INPUT and WORK_DIR.
+
+function(convert input output)
+  execute_process(COMMAND ${CONVERTER} ${ARGN} ${input} ${output} RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${input} cannot be converted into ${output}.")
+  endif()
+endfunction()
+
+function(compare file1 file2)
+  execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${file1} ${file2} RESULT_VARIABLE result)
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${file1} and ${file2} are different.")
+  endif()
+endfunction()
+
+set(prefix ${WORK_DIR}/seq-convert)
+
+# The values of the input file are rounded by the YAML writer at the first conversion,
+# so the files are compared after it.
+convert(${INPUT} ${prefix}-1.bseq)
+convert(${prefix}-1.bseq ${prefix}-1.seq)
+convert(${prefix}-1.seq ${prefix}-2.bseq)
+convert(${prefix}-2.bseq ${prefix}-2.seq)
+compare(${prefix}-1.seq ${prefix}-2.seq)
+convert(${prefix}-2.seq ${prefix}-3.bseq)
+compare(${prefix}-2.bseq ${prefix}-3.bseq)
+
+convert(${prefix}-1.seq ${prefix}-4.bseq --part-major)
+convert(${prefix}-4.bseq ${prefix}-4.seq)
+compare(${prefix}-1.seq ${prefix}-4.seq)
@@ -0,0 +1,120 @@
+/**
+   This benchmark compares the step time of the dense and sparse Gauss-Seidel modes of the
+   constraint force solver. Boxes resting on a floor are solved as a single island, and the
+   number of the boxes is chosen so that the scene has the given number of contacts.
+   The maximum difference of the contact forces of the first step is also reported.
+
+   Usage: bench-sparse-gauss-seidel [number of contacts ...]
+*/
+
+#include "TestBodies.h"
+#include <cnoid/BatchSimulator>
+#include <cnoid/ConstraintForceSolver>
+#include <cnoid/DyBody>
+#include <boost/format.hpp>
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+
+using namespace std;
+using namespace cnoid;
+using boost::format;
+
+namespace {
+
+const int numContactsPerBox = 8;
+const int numMeasuredSteps = 5;
+
+struct Result {
+    int numContacts;
+    double stepTime;
+    vector<double> forces;
+};
+
+
+Result simulate(int numBoxes, bool isSparseGaussSeidelEnabled)
+{
+    BatchSimulator simulator;
+    simulator.setTimeStep(0.001);
+    simulator.setMaterialTableFile("");
+
+    const int numColumns = std::ceil(std::sqrt(static_cast<double>(numBoxes)));
+    const double s = 0.1;
+    const double width = numColumns * s * 2.0 + 1.0;
+    addFloor(simulator, width, width);
+
+    for(int i=0; i < numBoxes; ++i){
+        BodyPtr box = createBox(Vector3(s, s, s), false);
+        box->rootLink()->p() = Vector3(
+            (i % numColumns - numColumns / 2.0) * s * 2.0, (i / numColumns - numColumns / 2.0) * s * 2.0, s / 2.0 - 0.001);
+        simulator.addBody(box);
+    }
+
+    ConstraintForceSolver& solver = simulator.constraintForceSolver();
+    solver.setIslandDecompositionEnabled(false);
+    solver.setSparseGaussSeidelEnabled(isSparseGaussSeidelEnabled);
+    solver.enableConstraintForceOutput(true);
+
+    Result result;
+    result.numContacts = 0;
+    result.stepTime = 0.0;
+    if(!simulator.initialize()){
+        return result;
+    }
+
+    simulator.step();
+    for(int i=0; i < simulator.numBodies(); ++i){
+        for(auto& constraintForce : simulator.body(i)->rootLink()->constraintForces()){
+            result.forces.insert(result.forces.end(), constraintForce.force.data(), constraintForce.force.data() + 3);
+            ++result.numContacts;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for(int i=0; i < numMeasuredSteps; ++i){
+        simulator.step();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    result.stepTime = elapsed.count() / numMeasuredSteps;
+
+    return result;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    vector<int> contactCounts;
+    for(int i=1; i < argc; ++i){
+        contactCounts.push_back(std::atoi(argv[i]));
+    }
+    if(contactCounts.empty()){
+        contactCounts = { 10, 50, 100, 200, 500, 1000, 2000 };
+    }
+
+    cout << "contacts   dense [ms/step]   sparse [ms/step]   speedup   max |f_dense - f_sparse|" << endl;
+
+    for(auto numRequestedContacts : contactCounts){
+        const int numBoxes = std::max(1, (numRequestedContacts + numContactsPerBox - 1) / numContactsPerBox);
+        const Result dense = simulate(numBoxes, false);
+        const Result sparse = simulate(numBoxes, true);
+
+        double maxDiff = 0.0;
+        if(dense.forces.size() == sparse.forces.size()){
+            for(size_t i=0; i < dense.forces.size(); ++i){
+                maxDiff = std::max(maxDiff, std::abs(dense.forces[i] - sparse.forces[i]));
+            }
+        } else {
+            maxDiff = std::numeric_limits<double>::quiet_NaN();
+        }
+
+        cout << format("%8d   %15.3f   %16.3f   %7.1f   %g")
+            % dense.numContacts % (dense.stepTime * 1000.0) % (sparse.stepTime * 1000.0)
+            % (dense.stepTime / sparse.stepTime) % maxDiff << endl;
+    }
+
+    return 0;
+}
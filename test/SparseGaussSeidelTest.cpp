@@ -0,0 +1,106 @@
+/**
+   This test checks that the sparse Gauss-Seidel mode of the constraint force solver gives
+   the same contact forces as the dense mode. The MCP matrix is internal to the solver, so
+   the same scene is simulated in both modes and the constraint forces solved from the same
+   initial state are compared. The sparse mode only skips the zero blocks of the matrix rows,
+   so the forces may differ only by the rounding errors of the different summation order.
+*/
+
+#include "TestBodies.h"
+#include <cnoid/BatchSimulator>
+#include <cnoid/ConstraintForceSolver>
+#include <cnoid/DyBody>
+#include <iostream>
+#include <vector>
+#include <cmath>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+/**
+   The forces of the first step are solved from the same matrix in both modes.
+   The forces of the later steps are compared with a looser tolerance because
+   the warm start and the states differ by the rounding errors of the previous steps.
+*/
+vector<vector<double>> simulate(bool isSparseGaussSeidelEnabled, int numSteps)
+{
+    BatchSimulator simulator;
+    simulator.setTimeStep(0.001);
+    simulator.setMaterialTableFile("");
+
+    // The stacked boxes make a single island in which each contact is coupled
+    // with the contacts of the adjacent boxes only
+    addFloor(simulator, 4.0, 4.0);
+    addBoxStack(simulator, 3, 0.1, -0.001);
+
+    ConstraintForceSolver& solver = simulator.constraintForceSolver();
+    solver.setIslandDecompositionEnabled(false);
+    solver.setSparseGaussSeidelEnabled(isSparseGaussSeidelEnabled);
+    solver.enableConstraintForceOutput(true);
+
+    vector<vector<double>> forces;
+    if(!simulator.initialize()){
+        return forces;
+    }
+    for(int i=0; i < numSteps; ++i){
+        simulator.step();
+        vector<double> stepForces;
+        for(int j=0; j < simulator.numBodies(); ++j){
+            for(auto& constraintForce : simulator.body(j)->rootLink()->constraintForces()){
+                stepForces.insert(stepForces.end(), constraintForce.force.data(), constraintForce.force.data() + 3);
+            }
+        }
+        forces.push_back(stepForces);
+    }
+    return forces;
+}
+
+
+double calcMaxRelativeDifference(const vector<double>& forces1, const vector<double>& forces2)
+{
+    double maxForce = 0.0;
+    double maxDiff = 0.0;
+    for(size_t i=0; i < forces1.size(); ++i){
+        maxForce = std::max(maxForce, std::abs(forces1[i]));
+        maxDiff = std::max(maxDiff, std::abs(forces1[i] - forces2[i]));
+    }
+    return (maxForce > 0.0) ? (maxDiff / maxForce) : maxDiff;
+}
+
+}
+
+int main()
+{
+    const int numSteps = 20;
+    const auto dense = simulate(false, numSteps);
+    const auto sparse = simulate(true, numSteps);
+
+    if(dense.size() != static_cast<size_t>(numSteps) || sparse.size() != dense.size()){
+        cerr << "Failed: the simulation could not be done." << endl;
+        return 1;
+    }
+    if(dense.front().empty()){
+        cerr << "Failed: no contact force is solved in the first step." << endl;
+        return 1;
+    }
+
+    int numErrors = 0;
+    for(int i=0; i < numSteps; ++i){
+        if(dense[i].size() != sparse[i].size()){
+            cerr << "Failed: the numbers of the contacts at step " << i << " are different." << endl;
+            ++numErrors;
+            continue;
+        }
+        const double tolerance = (i == 0) ? 1.0e-9 : 1.0e-6;
+        const double diff = calcMaxRelativeDifference(dense[i], sparse[i]);
+        if(diff > tolerance){
+            cerr << "Failed: the contact forces at step " << i << " differ by " << diff
+                 << " relative to the maximum force." << endl;
+            ++numErrors;
+        }
+    }
+
+    return (numErrors > 0) ? 1 : 0;
+}
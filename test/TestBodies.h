@@ -0,0 +1,67 @@
+/**
+   Bodies built in code for the tests and benchmarks so that they do not depend on model files.
+*/
+
+#ifndef CNOID_TEST_TEST_BODIES_H
+#define CNOID_TEST_TEST_BODIES_H
+
+#include <cnoid/Body>
+#include <cnoid/BatchSimulator>
+#include <cnoid/MeshGenerator>
+#include <cnoid/SceneDrawables>
+
+namespace cnoid {
+
+inline BodyPtr createBox(const Vector3& size, bool isStatic, double mass = 1.0)
+{
+    BodyPtr body = new Body;
+    Link* link = body->createLink();
+    link->setJointType(isStatic ? Link::FIXED_JOINT : Link::FREE_JOINT);
+    link->setMass(mass);
+    Matrix3 I = Matrix3::Zero();
+    I(0, 0) = mass * (size.y() * size.y() + size.z() * size.z()) / 12.0;
+    I(1, 1) = mass * (size.z() * size.z() + size.x() * size.x()) / 12.0;
+    I(2, 2) = mass * (size.x() * size.x() + size.y() * size.y()) / 12.0;
+    link->setInertia(I);
+    MeshGenerator generator;
+    SgShapePtr shape = new SgShape;
+    shape->setMesh(generator.generateBox(size));
+    link->setShape(shape);
+    body->setRootLink(link);
+    return body;
+}
+
+/**
+   Adds a static floor whose top surface is at z = 0.
+*/
+inline void addFloor(BatchSimulator& simulator, double width, double depth)
+{
+    BodyPtr floor = createBox(Vector3(width, depth, 0.2), true);
+    floor->rootLink()->p() = Vector3(0.0, 0.0, -0.1);
+    simulator.addBody(floor);
+}
+
+/**
+   Adds n x n x n boxes stacked on the floor. The boxes of a layer overlap the boxes of
+   the lower layer by one percent of the size, and each box is rotated by a different angle
+   around the z axis so that the contacts are not symmetric.
+*/
+inline void addBoxStack(BatchSimulator& simulator, int n, double size, double zOffset)
+{
+    const double center = (n - 1) / 2.0;
+    for(int i=0; i < n; ++i){
+        for(int j=0; j < n; ++j){
+            for(int k=0; k < n; ++k){
+                BodyPtr box = createBox(Vector3(size, size, size), false);
+                box->rootLink()->p() = Vector3(
+                    (i - center) * size * 1.5, (j - center) * size * 1.5, size / 2.0 + zOffset + k * size * 0.99);
+                box->rootLink()->R() = AngleAxis(0.1 * (i + j + k), Vector3::UnitZ()).toRotationMatrix();
+                simulator.addBody(box);
+            }
+        }
+    }
+}
+
+}
+
+#endif
@@ -0,0 +1,52 @@
+/**
+   The error counting and the random values shared by the tests. Each test is built from a
+   single source file, so the variables are defined in the anonymous namespace of the header.
+   The random engine has a fixed seed so that a failure can be reproduced.
+*/
+
+#ifndef CNOID_TEST_TEST_UTIL_H
+#define CNOID_TEST_TEST_UTIL_H
+
+#include <cnoid/EigenTypes>
+#include <iostream>
+#include <string>
+#include <random>
+
+namespace {
+
+int numErrors = 0;
+
+inline void check(bool condition, const std::string& message)
+{
+    if(!condition){
+        std::cerr << "Failed: " << message << std::endl;
+        ++numErrors;
+    }
+}
+
+std::mt19937 randomEngine(1);
+
+inline double random(double min, double max)
+{
+    return std::uniform_real_distribution<double>(min, max)(randomEngine);
+}
+
+//! This function returns an integer in [0, n).
+inline int randomInt(int n)
+{
+    return std::uniform_int_distribution<int>(0, n - 1)(randomEngine);
+}
+
+inline cnoid::Vector3 randomVector(double min, double max)
+{
+    return cnoid::Vector3(random(min, max), random(min, max), random(min, max));
+}
+
+inline cnoid::Matrix3 randomRotation()
+{
+    return cnoid::AngleAxis(random(-3.0, 3.0), randomVector(-1.0, 1.0).normalized()).toRotationMatrix();
+}
+
+}
+
+#endif
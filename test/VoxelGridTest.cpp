@@ -0,0 +1,251 @@
+/**
+   This test checks the exposed faces of the voxel mesh created by VoxelGrid, the incremental
+   removal of points and the centroids given by voxelDownsample. The order of the voxels
+   depends on the order of the insertion and the removal, so the meshes and the centroids
+   are compared after they are sorted.
+*/
+
+#include <cnoid/VoxelGrid>
+#include <cnoid/PointSetUtil>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <map>
+#include <array>
+#include <cmath>
+#include "TestUtil.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+const double voxelSize = 0.1;
+
+// A triangle is represented by the positions of its vertices, its normal and its color
+typedef std::array<float, 15> Triangle;
+
+vector<Triangle> getSortedTriangles(const SgMesh* mesh)
+{
+    vector<Triangle> triangles;
+    if(!mesh){
+        return triangles;
+    }
+    const SgVertexArray& vertices = *mesh->vertices();
+    const SgNormalArray& normals = *mesh->normals();
+    const SgColorArray* colors = mesh->colors();
+    for(int i=0; i < mesh->numTriangles(); ++i){
+        Triangle triangle;
+        auto indices = mesh->triangle(i);
+        for(int j=0; j < 3; ++j){
+            const Vector3f& v = vertices[indices[j]];
+            triangle[j * 3] = v.x();
+            triangle[j * 3 + 1] = v.y();
+            triangle[j * 3 + 2] = v.z();
+        }
+        const Vector3f& n = normals[mesh->normalIndices()[i * 3]];
+        Vector3f c = Vector3f::Zero();
+        if(colors){
+            c = (*colors)[mesh->colorIndices()[i * 3]];
+        }
+        for(int j=0; j < 3; ++j){
+            triangle[9 + j] = n[j];
+            triangle[12 + j] = c[j];
+        }
+        triangles.push_back(triangle);
+    }
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+vector<std::array<float, 6>> getSortedCentroids(const VoxelGrid& grid)
+{
+    SgVertexArray points;
+    SgColorArray colors;
+    grid.getCentroids(points, &colors);
+    vector<std::array<float, 6>> centroids(points.size());
+    for(size_t i=0; i < points.size(); ++i){
+        for(int j=0; j < 3; ++j){
+            centroids[i][j] = points[i][j];
+            centroids[i][j + 3] = colors.empty() ? 0.0f : colors[i][j];
+        }
+    }
+    std::sort(centroids.begin(), centroids.end());
+    return centroids;
+}
+
+Vector3f getVoxelCenter(int x, int y, int z)
+{
+    return Vector3f((x + 0.5f) * voxelSize, (y + 0.5f) * voxelSize, (z + 0.5f) * voxelSize);
+}
+
+void checkExposedFaces()
+{
+    VoxelGrid grid(voxelSize);
+    grid.addPoint(getVoxelCenter(0, 0, 0));
+    SgMeshPtr mesh = grid.createMesh();
+    check(mesh && mesh->numTriangles() == 12, "a single voxel does not have 6 faces");
+
+    // The faces between the voxels of a 2 x 2 x 2 block are culled
+    grid.clear();
+    for(int x=0; x < 2; ++x){
+        for(int y=0; y < 2; ++y){
+            for(int z=0; z < 2; ++z){
+                grid.addPoint(getVoxelCenter(x, y, z));
+                grid.addPoint(getVoxelCenter(x, y, z) + Vector3f(0.01f, -0.02f, 0.03f));
+            }
+        }
+    }
+    check(grid.numVoxels() == 8, "the points of a 2 x 2 x 2 block are not merged into 8 voxels");
+    mesh = grid.createMesh();
+    check(mesh && mesh->numTriangles() == 24 * 2, "a 2 x 2 x 2 block does not have 24 exposed faces");
+
+    // The center voxel of a 3 x 3 x 3 block has no exposed face
+    grid.clear();
+    for(int x=0; x < 3; ++x){
+        for(int y=0; y < 3; ++y){
+            for(int z=0; z < 3; ++z){
+                grid.addPoint(getVoxelCenter(x, y, z));
+            }
+        }
+    }
+    mesh = grid.createMesh();
+    check(mesh && mesh->numTriangles() == 54 * 2, "a 3 x 3 x 3 block does not have 54 exposed faces");
+}
+
+void checkRemoval()
+{
+    std::mt19937 engine(1);
+    std::uniform_real_distribution<float> position(-0.3f, 0.3f);
+    std::uniform_real_distribution<float> intensity(0.0f, 1.0f);
+
+    vector<Vector3f> points;
+    vector<Vector3f> colors;
+    for(int i=0; i < 2000; ++i){
+        points.emplace_back(position(engine), position(engine), position(engine));
+        colors.emplace_back(intensity(engine), intensity(engine), intensity(engine));
+    }
+
+    VoxelGrid grid(voxelSize);
+    for(size_t i=0; i < points.size(); ++i){
+        grid.addPoint(points[i], colors[i]);
+    }
+
+    // All the points of some voxels and some points of the other voxels are removed
+    vector<bool> isRemoved(points.size(), false);
+    std::map<std::array<int, 3>, int> removedVoxels;
+    for(size_t i=0; i < points.size(); ++i){
+        const Vector3i index = grid.voxelIndex(points[i]);
+        const bool isVoxelRemoved = (index.x() + index.y() * 3 + index.z() * 5) % 4 == 0;
+        if(isVoxelRemoved || i % 7 == 0){
+            check(grid.removePoint(points[i], colors[i]), "an added point cannot be removed");
+            isRemoved[i] = true;
+            if(isVoxelRemoved){
+                removedVoxels[{ index.x(), index.y(), index.z() }]++;
+            }
+        }
+    }
+    check(!removedVoxels.empty(), "no voxel is removed");
+    check(!grid.removePoint(getVoxelCenter(100, 0, 0)), "a point in an empty voxel is removed");
+
+    VoxelGrid rebuilt(voxelSize);
+    for(size_t i=0; i < points.size(); ++i){
+        if(!isRemoved[i]){
+            rebuilt.addPoint(points[i], colors[i]);
+        }
+    }
+
+    check(grid.numVoxels() == rebuilt.numVoxels(), "the number of the voxels is different from the rebuilt grid");
+
+    // The sums of the positions are kept in double, so the removal of the float values is exact.
+    // The sums of the colors are kept in float and may have rounding errors.
+    const auto centroids1 = getSortedCentroids(grid);
+    const auto centroids2 = getSortedCentroids(rebuilt);
+    bool isSameCentroids = (centroids1.size() == centroids2.size());
+    for(size_t i=0; isSameCentroids && i < centroids1.size(); ++i){
+        for(int j=0; j < 3; ++j){
+            if(centroids1[i][j] != centroids2[i][j] || std::abs(centroids1[i][j + 3] - centroids2[i][j + 3]) > 1.0e-5f){
+                isSameCentroids = false;
+            }
+        }
+    }
+    check(isSameCentroids, "the centroids are different from the ones of the rebuilt grid");
+
+    SgMeshPtr mesh1 = grid.createMesh();
+    SgMeshPtr mesh2 = rebuilt.createMesh();
+    const auto triangles1 = getSortedTriangles(mesh1);
+    const auto triangles2 = getSortedTriangles(mesh2);
+    check(!triangles1.empty() && triangles1.size() == triangles2.size(),
+          "the number of the faces is different from the rebuilt grid");
+    bool isSame = (triangles1.size() == triangles2.size());
+    for(size_t i=0; isSame && i < triangles1.size(); ++i){
+        for(int j=0; j < 12; ++j){
+            if(triangles1[i][j] != triangles2[i][j]){
+                isSame = false;
+            }
+        }
+        for(int j=12; j < 15; ++j){
+            if(std::abs(triangles1[i][j] - triangles2[i][j]) > 1.0e-5f){
+                isSame = false;
+            }
+        }
+    }
+    check(isSame, "the mesh is different from the one of the rebuilt grid");
+}
+
+void checkDownsampling()
+{
+    std::mt19937 engine(2);
+    std::uniform_real_distribution<float> position(-0.5f, 0.5f);
+
+    SgPointSetPtr pointSet = new SgPointSet;
+    SgVertexArray& points = *pointSet->getOrCreateVertices();
+    SgColorArray& colors = *pointSet->getOrCreateColors();
+    VoxelGrid indexer(voxelSize);
+    std::map<std::array<int, 3>, std::pair<int, Vector3d>> cells;
+    for(int i=0; i < 5000; ++i){
+        const Vector3f p(position(engine), position(engine), position(engine));
+        points.push_back(p);
+        colors.push_back(Vector3f(0.5f, 0.25f, (i % 2) ? 1.0f : 0.0f));
+        const Vector3i index = indexer.voxelIndex(p);
+        auto& cell = cells[{ index.x(), index.y(), index.z() }];
+        if(cell.first == 0){
+            cell.second.setZero();
+        }
+        ++cell.first;
+        cell.second += p.cast<double>();
+    }
+
+    SgPointSetPtr downsampled = voxelDownsample(pointSet, voxelSize);
+    check(downsampled->hasVertices() && static_cast<int>(downsampled->vertices()->size()) == static_cast<int>(cells.size()),
+          "the number of the downsampled points is not the number of the occupied cells");
+    check(downsampled->hasColors() && downsampled->colors()->size() == downsampled->vertices()->size(),
+          "the downsampled points do not have the colors");
+
+    vector<std::array<float, 3>> expected;
+    for(auto& kv : cells){
+        const Vector3f c = (kv.second.second / kv.second.first).cast<float>();
+        expected.push_back({ c.x(), c.y(), c.z() });
+    }
+    std::sort(expected.begin(), expected.end());
+    vector<std::array<float, 3>> centroids;
+    if(downsampled->hasVertices()){
+        for(auto& p : *downsampled->vertices()){
+            centroids.push_back({ p.x(), p.y(), p.z() });
+        }
+    }
+    std::sort(centroids.begin(), centroids.end());
+    check(centroids == expected, "the downsampled points are not the centroids of the cells");
+}
+
+}
+
+int main()
+{
+    checkExposedFaces();
+    checkRemoval();
+    checkDownsampling();
+    return (numErrors > 0) ? 1 : 0;
+}
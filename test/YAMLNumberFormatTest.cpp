@@ -0,0 +1,233 @@
+/**
+   This test checks that YAMLWriter::putScalar gives the same output as snprintf for the
+   double formats which are not processed by snprintf, and that the frames of a seq read
+   by YAMLReader::packNumberListings are the same as the ones read from the scalar nodes.
+*/
+
+#include <cnoid/YAMLWriter>
+#include <cnoid/YAMLReader>
+#include <cnoid/MultiValueSeq>
+#include <sstream>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <limits>
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include "TestUtil.h"
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+string putScalar(const char* format, double value)
+{
+    ostringstream os;
+    YAMLWriter writer(os);
+    writer.setDoubleFormat(format);
+    writer.putScalar(value);
+    string s = os.str();
+    s.erase(s.find_last_not_of(" \n") + 1);
+    return s;
+}
+
+string formatBySnprintf(const char* format, double value)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), format, value);
+    return buf;
+}
+
+void checkFormat(const char* format, double value)
+{
+    const string output = putScalar(format, value);
+    const string expected = formatBySnprintf(format, value);
+    if(output != expected){
+        char hex[32];
+        snprintf(hex, sizeof(hex), "%a", value);
+        check(false, string("putScalar gives \"") + output + "\" for " + hex + " with " + format +
+              " while snprintf gives \"" + expected + "\"");
+    }
+}
+
+void checkFormats()
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    const vector<double> values = {
+        // Ties at .5 which are rounded to even by snprintf
+        0.5, 1.5, 2.5, 0.125, 0.375, 1234565.0, 1234575.0, 12345665.0, 0.0000125,
+        // Values near the boundary of the rounding and of the fixed notation
+        9.9999995e-5, 9.999995e-5, 9.9999994999e-5, 9.99999949999999e-5, 0.0001, 0.00009999999999999999,
+        999999.5, 9999999.5, 999999999999999.5, 1e15, 1e16, 1e22, 1e23, 1e-22, 1e-23,
+        123456.7, 0.1, 0.2, 0.3, 1.0 / 3.0, 2.0 / 3.0, 100.0, 1e6, 1e7,
+        // Zeros, subnormals and the extreme values
+        0.0, -0.0, 5e-324, -5e-324, 2.2250738585072009e-308, 2.2250738585072014e-308,
+        std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(),
+        inf, -inf, nan, -nan
+    };
+
+    for(auto format : { "%g", "%.7g", "%.15g", "%.1g", "%.3g" }){
+        for(auto value : values){
+            checkFormat(format, value);
+            checkFormat(format, -value);
+        }
+    }
+
+    // Random values over the whole range of the exponent including the values whose
+    // significands are the exact numbers of the format digits
+    std::mt19937_64 engine(1);
+    for(int i=0; i < 100000; ++i){
+        uint64_t bits = engine();
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        checkFormat("%.7g", value);
+        std::uniform_real_distribution<double> uniform(-10.0, 10.0);
+        const double x = uniform(engine);
+        checkFormat("%g", x);
+        checkFormat("%.7g", x);
+        checkFormat("%.15g", x);
+        checkFormat("%.7g", std::round(x * 1.0e6) / 1.0e6 + 5.0e-7);
+    }
+}
+
+void checkFlowStyleListing()
+{
+    const double values[] = { 0.5, -0.0, 1.0 / 3.0, 1e15, 9.9999995e-5, 5e-324, 123456.75 };
+    const int n = sizeof(values) / sizeof(values[0]);
+
+    ostringstream os1;
+    YAMLWriter writer1(os1);
+    writer1.putFlowStyleListing(values, n);
+
+    ostringstream os2;
+    YAMLWriter writer2(os2);
+    writer2.startFlowStyleListing();
+    for(int i=0; i < n; ++i){
+        writer2.putScalar(values[i]);
+    }
+    writer2.endListing();
+
+    check(os1.str() == os2.str(), "putFlowStyleListing gives \"" + os1.str() +
+          "\" while putScalar gives \"" + os2.str() + "\"");
+}
+
+string createSeqText(const vector<vector<string>>& frames)
+{
+    string text =
+        "type: MultiValueSeq\n"
+        "content: JointDisplacement\n"
+        "formatVersion: 2.0\n"
+        "frameRate: 100\n"
+        "numFrames: " + std::to_string(frames.size()) + "\n"
+        "numParts: " + std::to_string(frames.front().size()) + "\n"
+        "frames:\n";
+    for(auto& frame : frames){
+        text += "  - [ ";
+        for(size_t i=0; i < frame.size(); ++i){
+            if(i > 0){
+                text += ", ";
+            }
+            text += frame[i];
+        }
+        text += " ]\n";
+    }
+    return text;
+}
+
+bool readSeq(const string& text, bool doPack, MultiValueSeq& seq, string& out_message)
+{
+    YAMLReader reader;
+    if(doPack){
+        reader.packNumberListings("frames");
+    }
+    ostringstream os;
+    bool result = false;
+    try {
+        reader.parse(text);
+        result = seq.readSeq(reader.document()->toMapping(), os);
+    } catch(const ValueNode::Exception& ex){
+        os << ex.message();
+    }
+    out_message = os.str();
+    return result;
+}
+
+void checkPackedNumberListings()
+{
+    // The numbers which are not converted by the fast path of the packed reader are included.
+    // The numbers followed by other characters are read as the leading numbers as strtod does.
+    const vector<string> numbers = {
+        "0", "-0", "+1", "1.", ".5", "0.1", "-0.30000000000000004", "1e-5", "1E+22", "1e23",
+        "9007199254740993", "123456789012345678901", "0.000000000000000000000001", "4.9e-324",
+        "2.2250738585072011e-308", "1.7976931348623157e308", "0x1p3", "inf", "-infinity", "nan",
+        "3.14159265358979323846", "1_000", "12e", "5e-3x"
+    };
+
+    vector<vector<string>> frames;
+    std::mt19937 engine(2);
+    std::uniform_real_distribution<double> uniform(-100.0, 100.0);
+    for(int i=0; i < 20; ++i){
+        vector<string> frame;
+        for(int j=0; j < 6; ++j){
+            if(j == 0 && i < static_cast<int>(numbers.size())){
+                frame.push_back(numbers[i]);
+            } else if(j == 1 && i + 20 < static_cast<int>(numbers.size())){
+                frame.push_back(numbers[i + 20]);
+            } else {
+                char buf[32];
+                snprintf(buf, sizeof(buf), "%.17g", uniform(engine));
+                frame.push_back(buf);
+            }
+        }
+        frames.push_back(frame);
+    }
+
+    MultiValueSeq unpacked, packed;
+    string message1, message2;
+    const string text = createSeqText(frames);
+    const bool result1 = readSeq(text, false, unpacked, message1);
+    const bool result2 = readSeq(text, true, packed, message2);
+    check(result1 && result2, "the seq cannot be read: " + message1 + message2);
+    if(result1 && result2){
+        check(unpacked.numFrames() == packed.numFrames() && unpacked.numParts() == packed.numParts(),
+              "the sizes of the packed and unpacked seqs are different");
+        bool isSame = true;
+        for(int i=0; i < unpacked.numFrames() && i < packed.numFrames(); ++i){
+            for(int j=0; j < unpacked.numParts() && j < packed.numParts(); ++j){
+                if(std::memcmp(&unpacked(i, j), &packed(i, j), sizeof(double)) != 0){
+                    isSame = false;
+                }
+            }
+        }
+        check(isSame, "the values of the packed seq are different from the unpacked one");
+    }
+
+    // An invalid scalar must be reported at the same position in both paths
+    for(auto invalid : { "abc", ".nan", "-.inf", "\"x\"", "'-'" }){
+        vector<vector<string>> invalidFrames = frames;
+        invalidFrames[7][3] = invalid;
+        const string text = createSeqText(invalidFrames);
+        MultiValueSeq seq1, seq2;
+        const bool result1 = readSeq(text, false, seq1, message1);
+        const bool result2 = readSeq(text, true, seq2, message2);
+        check(!result1 && !result2, string("the invalid value \"") + invalid + "\" is accepted");
+        check(message1 == message2, string("the errors for \"") + invalid + "\" are different: \"" +
+              message1 + "\" and \"" + message2 + "\"");
+    }
+}
+
+}
+
+int main()
+{
+    checkFormats();
+    checkFlowStyleListing();
+    checkPackedNumberListings();
+    return (numErrors > 0) ? 1 : 0;
+}